@@ -28,8 +28,11 @@
 
 #include <algorithm>
 #include <functional>
+#include <map>
 #include <memory>
+#include <optional>
 #include <string>
+#include <tuple>
 #include <utility>
 #include <vector>
 
@@ -43,6 +46,7 @@
 #include "edify/expr.h"
 #include "otautil/paths.h"
 #include "otautil/print_sha1.h"
+#include "otautil/sysutil.h"
 
 using namespace std::string_literals;
 
@@ -66,6 +70,73 @@ bool LoadFileContents(const std::string& filename, FileContents* file) {
   return true;
 }
 
+// Verdicts from partition hash checks made earlier in this invocation, keyed by
+// (device, size, hash). A check costs a full read of the partition, and the entry points stack
+// the same question (a check mode followed by patching, the target probe before the source
+// probe), so remembering the answer saves whole passes over the device. Writes to a partition
+// invalidate its entries, so a verdict can't go stale within the process.
+static std::map<std::tuple<std::string, size_t, std::string>, bool> partition_verdicts;
+
+static std::optional<bool> CachedPartitionVerdict(const Partition& partition) {
+  auto it = partition_verdicts.find({ partition.name, partition.size, partition.hash });
+  if (it == partition_verdicts.end()) {
+    return std::nullopt;
+  }
+  return it->second;
+}
+
+static void RecordPartitionVerdict(const Partition& partition, bool matched) {
+  partition_verdicts[{ partition.name, partition.size, partition.hash }] = matched;
+}
+
+// Streams the shared device of |candidates| once, deciding which (if any) of the expected states
+// — prefixes of the same device, ordered by ascending size — is currently present. The digest at
+// the shorter size usually disambiguates patched from pending on its own, in which case the tail
+// of the longer prefix is never read. Unlike ReadPartitionToBuffer() this keeps nothing in
+// memory, so it's the cheap way to answer yes/no questions. Every candidate that gets checked
+// has its verdict recorded.
+static const Partition* FindMatchingState(const std::vector<const Partition*>& candidates) {
+  android::base::unique_fd dev(open(candidates.front()->name.c_str(), O_RDONLY));
+  if (dev == -1) {
+    PLOG(ERROR) << "Failed to open eMMC partition \"" << candidates.front()->name << "\"";
+    return nullptr;
+  }
+
+  SHA_CTX ctx;
+  SHA1_Init(&ctx);
+  std::vector<unsigned char> chunk(1024 * 1024);
+  size_t hashed = 0;
+  for (const Partition* candidate : candidates) {
+    uint8_t expected_sha1[SHA_DIGEST_LENGTH];
+    if (ParseSha1(candidate->hash, expected_sha1) != 0) {
+      LOG(ERROR) << "Failed to parse hash \"" << candidate->hash << "\"";
+      return nullptr;
+    }
+
+    while (hashed < candidate->size) {
+      size_t to_read = std::min(chunk.size(), candidate->size - hashed);
+      if (!android::base::ReadFully(dev, chunk.data(), to_read)) {
+        PLOG(ERROR) << "Failed to read " << to_read << " bytes of data for partition "
+                    << candidate->name;
+        return nullptr;
+      }
+      SHA1_Update(&ctx, chunk.data(), to_read);
+      hashed += to_read;
+    }
+
+    // The stream may continue to a larger candidate; finalize a copy at this one's size.
+    SHA_CTX at_size = ctx;
+    uint8_t digest[SHA_DIGEST_LENGTH];
+    SHA1_Final(digest, &at_size);
+    bool matched = memcmp(digest, expected_sha1, SHA_DIGEST_LENGTH) == 0;
+    RecordPartitionVerdict(*candidate, matched);
+    if (matched) {
+      return candidate;
+    }
+  }
+  return nullptr;
+}
+
 // Reads the contents of a Partition to the given FileContents buffer.
 static bool ReadPartitionToBuffer(const Partition& partition, FileContents* out,
                                   bool check_backup) {
@@ -75,19 +146,29 @@ static bool ReadPartitionToBuffer(const Partition& partition, FileContents* out,
     return false;
   }
 
-  android::base::unique_fd dev(open(partition.name.c_str(), O_RDONLY));
-  if (dev == -1) {
-    PLOG(ERROR) << "Failed to open eMMC partition \"" << partition << "\"";
+  // A negative verdict from earlier in this invocation means the device can't produce this
+  // state; don't pay another full read just to re-prove that.
+  auto verdict = CachedPartitionVerdict(partition);
+  if (verdict.has_value() && !*verdict) {
+    LOG(INFO) << "Partition " << partition.name << " already known not to match "
+              << partition.hash.substr(0, 8);
   } else {
-    std::vector<unsigned char> buffer(partition.size);
-    if (!android::base::ReadFully(dev, buffer.data(), buffer.size())) {
-      PLOG(ERROR) << "Failed to read " << buffer.size() << " bytes of data for partition "
-                  << partition;
+    android::base::unique_fd dev(open(partition.name.c_str(), O_RDONLY));
+    if (dev == -1) {
+      PLOG(ERROR) << "Failed to open eMMC partition \"" << partition << "\"";
     } else {
-      SHA1(buffer.data(), buffer.size(), out->sha1);
-      if (memcmp(out->sha1, expected_sha1, SHA_DIGEST_LENGTH) == 0) {
-        out->data = std::move(buffer);
-        return true;
+      std::vector<unsigned char> buffer(partition.size);
+      if (!android::base::ReadFully(dev, buffer.data(), buffer.size())) {
+        PLOG(ERROR) << "Failed to read " << buffer.size() << " bytes of data for partition "
+                    << partition;
+      } else {
+        SHA1(buffer.data(), buffer.size(), out->sha1);
+        bool matched = memcmp(out->sha1, expected_sha1, SHA_DIGEST_LENGTH) == 0;
+        RecordPartitionVerdict(partition, matched);
+        if (matched) {
+          out->data = std::move(buffer);
+          return true;
+        }
       }
     }
   }
@@ -133,9 +214,8 @@ bool SaveFileContents(const std::string& filename, const FileContents* file) {
 }
 
 // Writes a memory buffer to 'target' Partition.
-static bool WriteBufferToPartition(const FileContents& file_contents, const Partition& partition) {
-  const unsigned char* data = file_contents.data.data();
-  size_t len = file_contents.data.size();
+static bool WriteBufferToPartition(const unsigned char* data, size_t len,
+                                   const Partition& partition) {
   size_t start = 0;
   bool success = false;
   for (size_t attempt = 0; attempt < 2; ++attempt) {
@@ -225,6 +305,17 @@ static bool WriteBufferToPartition(const FileContents& file_contents, const Part
 
   sync();
 
+  // The device contents changed; drop every verdict recorded against it, then remember the state
+  // we just wrote (and verified byte for byte above).
+  for (auto it = partition_verdicts.begin(); it != partition_verdicts.end();) {
+    if (std::get<0>(it->first) == partition.name) {
+      it = partition_verdicts.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  RecordPartitionVerdict(partition, true);
+
   return true;
 }
 
@@ -254,10 +345,50 @@ int ParseSha1(const std::string& str, uint8_t* digest) {
 }
 
 bool PatchPartitionCheck(const Partition& target, const Partition& source) {
-  FileContents target_file;
-  FileContents source_file;
-  return (ReadPartitionToBuffer(target, &target_file, false) ||
-          ReadPartitionToBuffer(source, &source_file, true));
+  auto target_verdict = CachedPartitionVerdict(target);
+  auto source_verdict = CachedPartitionVerdict(source);
+  if ((target_verdict.has_value() && *target_verdict) ||
+      (source_verdict.has_value() && *source_verdict)) {
+    return true;
+  }
+
+  // This is a pure yes/no question, so don't buffer the partition twice the way the patching
+  // path has to: stream it once, hashing both expected prefixes as we go and stopping at the
+  // shorter one when it already identifies the state. Skip the read entirely if both states were
+  // ruled out earlier in this invocation.
+  if (!target_verdict.has_value() || !source_verdict.has_value()) {
+    const Partition* matched = nullptr;
+    if (target.name == source.name) {
+      std::vector<const Partition*> candidates{ &target, &source };
+      if (source.size < target.size) {
+        std::swap(candidates[0], candidates[1]);
+      }
+      matched = FindMatchingState(candidates);
+    } else {
+      matched = FindMatchingState({ &target });
+      if (matched == nullptr) {
+        matched = FindMatchingState({ &source });
+      }
+    }
+    if (matched != nullptr) {
+      return true;
+    }
+  }
+
+  // Same backup fallback that loading the source with check_backup would use.
+  uint8_t source_sha1[SHA_DIGEST_LENGTH];
+  if (ParseSha1(source.hash, source_sha1) != 0) {
+    LOG(ERROR) << "Failed to parse source hash \"" << source.hash << "\"";
+    return false;
+  }
+  FileContents backup;
+  if (LoadFileContents(Paths::Get().cache_temp_source(), &backup) &&
+      memcmp(backup.sha1, source_sha1, SHA_DIGEST_LENGTH) == 0) {
+    return true;
+  }
+
+  LOG(ERROR) << "Both of partition contents and backup don't have the expected checksum";
+  return false;
 }
 
 int ShowLicenses() {
@@ -299,26 +430,37 @@ bool FlashPartition(const Partition& partition, const std::string& source_filena
     return true;
   }
 
-  FileContents source_file;
-  if (!LoadFileContents(source_filename, &source_file)) {
+  // No longer allow loading contents from eMMC partitions.
+  if (android::base::StartsWith(source_filename, "EMMC:")) {
     LOG(ERROR) << "Failed to load source file";
     return false;
   }
 
+  // Map the source image instead of reading it into a heap buffer. The hash pass below faults the
+  // pages in sequentially (with kernel read-ahead) and the write pass reuses them, so we avoid an
+  // up-front allocation the size of the partition.
+  MemMapping source_map;
+  if (!source_map.MapFile(source_filename)) {
+    LOG(ERROR) << "Failed to map source file \"" << source_filename << "\"";
+    return false;
+  }
+
   uint8_t expected_sha1[SHA_DIGEST_LENGTH];
   if (ParseSha1(partition.hash, expected_sha1) != 0) {
     LOG(ERROR) << "Failed to parse source hash \"" << partition.hash << "\"";
     return false;
   }
 
-  if (memcmp(source_file.sha1, expected_sha1, SHA_DIGEST_LENGTH) != 0) {
+  uint8_t source_sha1[SHA_DIGEST_LENGTH];
+  SHA1(source_map.addr, source_map.length, source_sha1);
+  if (memcmp(source_sha1, expected_sha1, SHA_DIGEST_LENGTH) != 0) {
     // The source doesn't have desired checksum.
     LOG(ERROR) << "source \"" << source_filename << "\" doesn't have expected SHA-1 sum";
     LOG(ERROR) << "expected: " << partition.hash.substr(0, 8)
-               << ", found: " << short_sha1(source_file.sha1);
+               << ", found: " << short_sha1(source_sha1);
     return false;
   }
-  if (!WriteBufferToPartition(source_file, partition)) {
+  if (!WriteBufferToPartition(source_map.addr, source_map.length, partition)) {
     LOG(ERROR) << "Failed to write to " << partition;
     return false;
   }
@@ -409,7 +551,7 @@ static bool GenerateTarget(const Partition& target, const FileContents& source_f
   LOG(INFO) << "  now " << short_sha1(expected_sha1);
 
   // Write back the temp file to the partition.
-  if (!WriteBufferToPartition(patched, target)) {
+  if (!WriteBufferToPartition(patched.data.data(), patched.data.size(), target)) {
     LOG(ERROR) << "Failed to write patched data to " << target.name;
     return false;
   }
@@ -424,8 +566,10 @@ static bool GenerateTarget(const Partition& target, const FileContents& source_f
 }
 
 bool CheckPartition(const Partition& partition) {
-  FileContents target_file;
-  return ReadPartitionToBuffer(partition, &target_file, false);
+  if (auto verdict = CachedPartitionVerdict(partition); verdict.has_value()) {
+    return *verdict;
+  }
+  return FindMatchingState({ &partition }) != nullptr;
 }
 
 Partition Partition::Parse(const std::string& input_str, std::string* err) {
@@ -23,7 +23,11 @@
 #include <stdio.h>
 #include <sys/types.h>
 
+#include <algorithm>
 #include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
 
 #include <android-base/logging.h>
 #include <bsdiff/bspatch.h>
@@ -67,18 +71,78 @@ void ShowBSDiffLicense() {
 
 int ApplyBSDiffPatch(const unsigned char* old_data, size_t old_size, const Value& patch,
                      size_t patch_offset, SinkFn sink) {
-  CHECK_LE(patch_offset, patch.data.size());
+  return ApplyBSDiffPatch(old_data, old_size, std::string_view(patch.data), patch_offset,
+                          std::move(sink));
+}
+
+int ApplyBSDiffPatch(const unsigned char* old_data, size_t old_size, std::string_view patch,
+                     size_t patch_offset, SinkFn sink) {
+  CHECK_LE(patch_offset, patch.size());
+
+  // bspatch emits one sink call per control entry, which can be just a handful of bytes. Batch
+  // the output into larger chunks before handing it downstream; each downstream call typically
+  // costs a write syscall. Chunks that already arrive at full size are passed straight through
+  // to avoid the extra copy.
+  constexpr size_t kSinkChunkSize = 256 * 1024;
+  std::vector<uint8_t> chunk;
+  chunk.reserve(kSinkChunkSize);
+  bool sink_failed = false;
+
+  auto flush = [&]() {
+    size_t offset = 0;
+    while (offset < chunk.size()) {
+      size_t written = sink(chunk.data() + offset, chunk.size() - offset);
+      if (written == 0) {
+        sink_failed = true;
+        return false;
+      }
+      offset += written;
+    }
+    chunk.clear();
+    return true;
+  };
+
+  auto chunked_sink = [&](const uint8_t* data, size_t size) -> size_t {
+    if (sink_failed) {
+      return 0;
+    }
+    size_t accepted = size;
+    while (size > 0) {
+      if (chunk.empty() && size >= kSinkChunkSize) {
+        size_t written = sink(data, size);
+        if (written == 0) {
+          sink_failed = true;
+          return 0;
+        }
+        data += written;
+        size -= written;
+        continue;
+      }
+      size_t take = std::min(size, kSinkChunkSize - chunk.size());
+      chunk.insert(chunk.end(), data, data + take);
+      data += take;
+      size -= take;
+      if (chunk.size() == kSinkChunkSize && !flush()) {
+        return 0;
+      }
+    }
+    return accepted;
+  };
 
   int result = bsdiff::bspatch(old_data, old_size,
-                               reinterpret_cast<const uint8_t*>(&patch.data[patch_offset]),
-                               patch.data.size() - patch_offset, sink);
+                               reinterpret_cast<const uint8_t*>(&patch[patch_offset]),
+                               patch.size() - patch_offset, chunked_sink);
+  if (result == 0 && !flush()) {
+    LOG(ERROR) << "failed to flush bspatch output";
+    result = 1;
+  }
   if (result != 0) {
     LOG(ERROR) << "bspatch failed, result: " << result;
     // print SHA1 of the patch in the case of a data error.
     if (result == 2) {
       uint8_t digest[SHA_DIGEST_LENGTH];
-      SHA1(reinterpret_cast<const uint8_t*>(patch.data.data() + patch_offset),
-           patch.data.size() - patch_offset, digest);
+      SHA1(reinterpret_cast<const uint8_t*>(patch.data() + patch_offset),
+           patch.size() - patch_offset, digest);
       std::string patch_sha1 = print_sha1(digest);
       LOG(ERROR) << "Patch may be corrupted, offset: " << patch_offset << ", SHA1: " << patch_sha1;
     }
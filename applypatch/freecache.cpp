@@ -25,10 +25,14 @@
 #include <unistd.h>
 
 #include <algorithm>
+#include <atomic>
+#include <future>
 #include <limits>
 #include <memory>
 #include <set>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include <android-base/file.h>
 #include <android-base/logging.h>
@@ -39,39 +43,77 @@
 #include "applypatch/applypatch.h"
 #include "otautil/paths.h"
 
+// Scans one process's fd table and returns the open files under |dirname|.
+static std::vector<std::string> FindOpenFilesForPid(const std::string& pid,
+                                                    const std::string& dirname) {
+  std::vector<std::string> open_files;
+  std::string path = android::base::StringPrintf("/proc/%s/fd/", pid.c_str());
+
+  std::unique_ptr<DIR, decltype(&closedir)> fdd(opendir(path.c_str()), closedir);
+  if (!fdd) {
+    PLOG(ERROR) << "Failed to open " << path;
+    return open_files;
+  }
+  struct dirent* fdde;
+  while ((fdde = readdir(fdd.get())) != 0) {
+    std::string fd_path = path + fdde->d_name;
+    char link[FILENAME_MAX];
+
+    int count = readlink(fd_path.c_str(), link, sizeof(link) - 1);
+    if (count >= 0) {
+      link[count] = '\0';
+      if (android::base::StartsWith(link, dirname)) {
+        open_files.emplace_back(link);
+      }
+    }
+  }
+  return open_files;
+}
+
 static int EliminateOpenFiles(const std::string& dirname, std::set<std::string>* files) {
+  // No deletion candidates, no need to walk /proc at all.
+  if (files->empty()) {
+    return 0;
+  }
+
   std::unique_ptr<DIR, decltype(&closedir)> d(opendir("/proc"), closedir);
   if (!d) {
     PLOG(ERROR) << "Failed to open /proc";
     return -1;
   }
+  std::vector<std::string> pids;
   struct dirent* de;
   while ((de = readdir(d.get())) != 0) {
     unsigned int pid;
     if (!android::base::ParseUint(de->d_name, &pid)) {
         continue;
     }
-    std::string path = android::base::StringPrintf("/proc/%s/fd/", de->d_name);
+    pids.emplace_back(de->d_name);
+  }
 
-    struct dirent* fdde;
-    std::unique_ptr<DIR, decltype(&closedir)> fdd(opendir(path.c_str()), closedir);
-    if (!fdd) {
-      PLOG(ERROR) << "Failed to open " << path;
-      continue;
-    }
-    while ((fdde = readdir(fdd.get())) != 0) {
-      std::string fd_path = path + fdde->d_name;
-      char link[FILENAME_MAX];
-
-      int count = readlink(fd_path.c_str(), link, sizeof(link)-1);
-      if (count >= 0) {
-        link[count] = '\0';
-        if (android::base::StartsWith(link, dirname)) {
-          if (files->erase(link) > 0) {
-            LOG(INFO) << link << " is open by " << de->d_name;
-          }
+  // The walk is dominated by per-fd readlink calls across every process, so scan the fd tables
+  // concurrently and merge the results afterwards.
+  size_t thread_num = std::min<size_t>(std::thread::hardware_concurrency() ?: 4, pids.size());
+  std::vector<std::future<std::vector<std::string>>> scans;
+  std::atomic<size_t> next_pid{ 0 };
+  for (size_t t = 0; t < thread_num; t++) {
+    scans.emplace_back(std::async(std::launch::async, [&pids, &next_pid, &dirname]() {
+      std::vector<std::string> open_files;
+      size_t i;
+      while ((i = next_pid.fetch_add(1)) < pids.size()) {
+        for (auto& file : FindOpenFilesForPid(pids[i], dirname)) {
+          open_files.push_back(std::move(file));
         }
       }
+      return open_files;
+    }));
+  }
+
+  for (auto& scan : scans) {
+    for (const auto& link : scan.get()) {
+      if (files->erase(link) > 0) {
+        LOG(INFO) << link << " is open";
+      }
     }
   }
   return 0;
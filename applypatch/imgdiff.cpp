@@ -153,7 +153,13 @@
 #include <unistd.h>
 
 #include <algorithm>
+#include <atomic>
+#include <future>
+#include <list>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
 #include <android-base/file.h>
@@ -164,6 +170,7 @@
 #include <android-base/strings.h>
 #include <android-base/unique_fd.h>
 #include <bsdiff/bsdiff.h>
+#include <openssl/sha.h>
 #include <ziparchive/zip_archive.h>
 #include <zlib.h>
 
@@ -180,6 +187,67 @@ static_assert(VERSION <= 9, "VERSION occupies more than one byte");
 static constexpr size_t BLOCK_SIZE = 4096;
 static constexpr size_t BUFFER_SIZE = 0x8000;
 
+// Approximate memory budget for cached bsdiff suffix arrays; the index costs roughly eight bytes
+// per source byte, so this holds the pseudo source of a zip split plus a tail of smaller chunks.
+static constexpr size_t kSuffixArrayCacheBudget = 1024 * 1024 * 1024;
+
+// Run-wide cache of bsdiff suffix arrays, keyed by the SHA-1 of the source bytes they index.
+// Building the suffix array dominates bsdiff time, and one imgdiff run diffs against the same
+// source bytes repeatedly — every missing-in-source chunk of a zip image diffs against that
+// image's pseudo source — so identical source data should be indexed once per process, not once
+// per call. Entries are evicted least-recently-used under kSuffixArrayCacheBudget. Only for use
+// on the sequential zip-mode path; it is not thread-safe.
+class SuffixArrayCache {
+ public:
+  // Returns the cache slot for the suffix array over |data|. *slot is null if the array hasn't
+  // been built yet; bsdiff() fills it in on first use. The slot stays valid until the next call.
+  bsdiff::SuffixArrayIndexInterface** SlotFor(const uint8_t* data, size_t size) {
+    uint8_t digest[SHA_DIGEST_LENGTH];
+    SHA1(data, size, digest);
+    std::string key(reinterpret_cast<const char*>(digest), sizeof(digest));
+
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+      entries_.splice(entries_.begin(), entries_, it->second);
+      return &entries_.front().sai;
+    }
+
+    // Make room first so the slot being handed out is never the one evicted. An entry larger
+    // than the whole budget still gets cached (alone) until the next insertion pushes it out.
+    size_t cost = size * 8;
+    while (!entries_.empty() && bytes_ + cost > kSuffixArrayCacheBudget) {
+      const Entry& last = entries_.back();
+      bytes_ -= last.cost;
+      delete last.sai;
+      index_.erase(last.key);
+      entries_.pop_back();
+    }
+
+    entries_.push_front({ key, nullptr, cost });
+    index_[key] = entries_.begin();
+    bytes_ += cost;
+    return &entries_.front().sai;
+  }
+
+  ~SuffixArrayCache() {
+    for (auto& entry : entries_) {
+      delete entry.sai;
+    }
+  }
+
+ private:
+  struct Entry {
+    std::string key;
+    bsdiff::SuffixArrayIndexInterface* sai;
+    size_t cost;
+  };
+
+  // Most recently used first; the map points into the list for O(1) promotion.
+  std::list<Entry> entries_;
+  std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+  size_t bytes_{ 0 };
+};
+
 // If we use this function to write the offset and length (type size_t), their values should not
 // exceed 2^63; because the signed bit will be casted away.
 static inline bool Write8(int fd, int64_t value) {
@@ -383,11 +451,23 @@ bool ImageChunk::ReconstructDeflateChunk() {
     return false;
   }
 
-  // We only check two combinations of encoder parameters:  level 6 (the default) and level 9
-  // (the maximum).
-  for (int level = 6; level <= 9; level += 3) {
+  // We only check two combinations of encoder parameters: level 6 (the default) and level 9
+  // (the maximum). Zip tools compress every entry of an archive with the same settings, so the
+  // level that reconstructed the previous chunk almost always reconstructs the next one too;
+  // remember it and try it first, which saves a full failed deflate pass per chunk on level-9
+  // archives.
+  static std::atomic<int> cached_level{ 6 };
+
+  const int first = cached_level.load();
+  const int candidates[] = { first, 6, 9 };
+  for (size_t i = 0; i < std::size(candidates); i++) {
+    int level = candidates[i];
+    if (i > 0 && level == first) {
+      continue;  // Already tried as the cached candidate.
+    }
     if (TryReconstruction(level)) {
       compress_level_ = level;
+      cached_level.store(level);
       return true;
     }
   }
@@ -495,8 +575,8 @@ size_t PatchChunk::GetHeaderSize() const {
   }
 }
 
-// Return the offset of the next patch into the patch data.
-size_t PatchChunk::WriteHeaderToFd(int fd, size_t offset, size_t index) const {
+// Write the chunk header, pointing the patch data at |patch_offset| within the patch file.
+void PatchChunk::WriteHeaderToFd(int fd, size_t patch_offset, size_t index) const {
   Write4(fd, type_);
   switch (type_) {
     case CHUNK_NORMAL:
@@ -504,14 +584,14 @@ size_t PatchChunk::WriteHeaderToFd(int fd, size_t offset, size_t index) const {
                                                target_start_, target_len_, data_.size());
       Write8(fd, static_cast<int64_t>(source_start_));
       Write8(fd, static_cast<int64_t>(source_len_));
-      Write8(fd, static_cast<int64_t>(offset));
-      return offset + data_.size();
+      Write8(fd, static_cast<int64_t>(patch_offset));
+      break;
     case CHUNK_DEFLATE:
       LOG(INFO) << android::base::StringPrintf("chunk %zu: deflate  (%10zu, %10zu)  %10zu", index,
                                                target_start_, target_len_, data_.size());
       Write8(fd, static_cast<int64_t>(source_start_));
       Write8(fd, static_cast<int64_t>(source_len_));
-      Write8(fd, static_cast<int64_t>(offset));
+      Write8(fd, static_cast<int64_t>(patch_offset));
       Write8(fd, static_cast<int64_t>(source_uncompressed_len_));
       Write8(fd, static_cast<int64_t>(target_uncompressed_len_));
       Write4(fd, target_compress_level_);
@@ -519,7 +599,7 @@ size_t PatchChunk::WriteHeaderToFd(int fd, size_t offset, size_t index) const {
       Write4(fd, ImageChunk::WINDOWBITS);
       Write4(fd, ImageChunk::MEMLEVEL);
       Write4(fd, ImageChunk::STRATEGY);
-      return offset + data_.size();
+      break;
     case CHUNK_RAW:
       LOG(INFO) << android::base::StringPrintf("chunk %zu: raw      (%10zu, %10zu)", index,
                                                target_start_, target_len_);
@@ -527,10 +607,9 @@ size_t PatchChunk::WriteHeaderToFd(int fd, size_t offset, size_t index) const {
       if (!android::base::WriteFully(fd, data_.data(), data_.size())) {
         CHECK(false) << "Failed to write " << data_.size() << " bytes patch";
       }
-      return offset;
+      break;
     default:
       CHECK(false) << "unexpected chunk type: " << type_;
-      return offset;
   }
 }
 
@@ -550,7 +629,33 @@ bool PatchChunk::WritePatchDataToFd(const std::vector<PatchChunk>& patch_chunks,
     total_header_size += patch.GetHeaderSize();
   }
 
+  // Deduplicate identical patch payloads. Images with repeated content (duplicated resources,
+  // identical firmware blobs) produce byte-identical bsdiff patches, and since every chunk
+  // header carries its own patch offset, the duplicates can all point at a single copy.
   size_t offset = total_header_size;
+  std::unordered_map<std::string_view, size_t> patch_data_offsets;
+  std::vector<size_t> chunk_offsets(patch_chunks.size(), 0);
+  std::vector<bool> writes_patch_data(patch_chunks.size(), false);
+  size_t deduped = 0;
+  for (size_t i = 0; i < patch_chunks.size(); ++i) {
+    const auto& patch = patch_chunks[i];
+    if (patch.type_ == CHUNK_RAW) {
+      continue;  // Raw data is stored inline in the header.
+    }
+    std::string_view data_view(reinterpret_cast<const char*>(patch.data_.data()),
+                               patch.data_.size());
+    auto [it, inserted] = patch_data_offsets.emplace(data_view, offset);
+    chunk_offsets[i] = it->second;
+    if (inserted) {
+      writes_patch_data[i] = true;
+      offset += patch.data_.size();
+    } else {
+      deduped++;
+    }
+  }
+  if (deduped > 0) {
+    LOG(INFO) << "Deduplicated " << deduped << " identical patch payloads";
+  }
 
   // Write out the headers.
   if (!android::base::WriteStringToFd("IMGDIFF" + std::to_string(VERSION), patch_fd)) {
@@ -561,12 +666,14 @@ bool PatchChunk::WritePatchDataToFd(const std::vector<PatchChunk>& patch_chunks,
   Write4(patch_fd, static_cast<int32_t>(patch_chunks.size()));
   LOG(INFO) << "Writing " << patch_chunks.size() << " patch headers...";
   for (size_t i = 0; i < patch_chunks.size(); ++i) {
-    offset = patch_chunks[i].WriteHeaderToFd(patch_fd, offset, i);
+    patch_chunks[i].WriteHeaderToFd(patch_fd, chunk_offsets[i], i);
   }
 
-  // Append each chunk's bsdiff patch, in order.
-  for (const auto& patch : patch_chunks) {
-    if (patch.type_ == CHUNK_RAW) {
+  // Append each chunk's bsdiff patch, in order, skipping payloads that an earlier identical
+  // chunk already wrote.
+  for (size_t i = 0; i < patch_chunks.size(); ++i) {
+    const auto& patch = patch_chunks[i];
+    if (patch.type_ == CHUNK_RAW || !writes_patch_data[i]) {
       continue;
     }
     if (!android::base::WriteFully(patch_fd, patch.data_.data(), patch.data_.size())) {
@@ -856,28 +963,66 @@ ImageChunk ZipModeImage::PseudoSource() const {
   return ImageChunk(CHUNK_NORMAL, 0, &file_content_, file_content_.size());
 }
 
+// Returns the SHA-1 digest of a chunk's raw bytes as a string key for content lookups.
+static std::string ChunkContentKey(const ImageChunk& chunk) {
+  uint8_t digest[SHA_DIGEST_LENGTH];
+  SHA1(chunk.GetRawData(), chunk.GetRawDataLength(), digest);
+  return std::string(reinterpret_cast<const char*>(digest), SHA_DIGEST_LENGTH);
+}
+
+void ZipModeImage::BuildChunkIndices() const {
+  if (indexed_chunk_count_ == chunks_.size()) {
+    return;
+  }
+  entry_name_index_.clear();
+  content_hash_index_.clear();
+  entry_name_index_.reserve(chunks_.size());
+  content_hash_index_.reserve(chunks_.size());
+  for (size_t i = 0; i < chunks_.size(); ++i) {
+    const auto& chunk = chunks_[i];
+    if (!chunk.GetEntryName().empty()) {
+      entry_name_index_.emplace(chunk.GetEntryName(), i);
+    }
+    content_hash_index_.emplace(ChunkContentKey(chunk), i);
+  }
+  indexed_chunk_count_ = chunks_.size();
+}
+
 const ImageChunk* ZipModeImage::FindChunkByName(const std::string& name, bool find_normal) const {
   if (name.empty()) {
     return nullptr;
   }
-  for (auto& chunk : chunks_) {
+  BuildChunkIndices();
+
+  auto lookup = [this, find_normal](const std::string& key) -> const ImageChunk* {
+    auto it = entry_name_index_.find(key);
+    if (it == entry_name_index_.end()) {
+      return nullptr;
+    }
+    const ImageChunk& chunk = chunks_[it->second];
     if (chunk.GetType() != CHUNK_DEFLATE && !find_normal) {
-      continue;
+      return nullptr;
     }
+    return &chunk;
+  };
 
-    if (chunk.GetEntryName() == name) {
-      return &chunk;
-    }
+  if (const ImageChunk* chunk = lookup(name)) {
+    return chunk;
+  }
 
-    // Edge case when target chunk is split due to size limit but source chunk isn't.
-    if (name == (chunk.GetEntryName() + "-0") || chunk.GetEntryName() == (name + "-0")) {
-      return &chunk;
+  // Edge case when target chunk is split due to size limit but source chunk isn't.
+  if (const ImageChunk* chunk = lookup(name + "-0")) {
+    return chunk;
+  }
+  if (android::base::EndsWith(name, "-0")) {
+    if (const ImageChunk* chunk = lookup(name.substr(0, name.size() - 2))) {
+      return chunk;
     }
-
-    // TODO handle the .so files with incremental version number.
-    // (e.g. lib/arm64-v8a/libcronet.59.0.3050.4.so)
   }
 
+  // TODO handle the .so files with incremental version number.
+  // (e.g. lib/arm64-v8a/libcronet.59.0.3050.4.so)
+
   return nullptr;
 }
 
@@ -886,6 +1031,31 @@ ImageChunk* ZipModeImage::FindChunkByName(const std::string& name, bool find_nor
       static_cast<const ZipModeImage*>(this)->FindChunkByName(name, find_normal));
 }
 
+const ImageChunk* ZipModeImage::FindChunkByContent(const ImageChunk& chunk,
+                                                   bool find_normal) const {
+  BuildChunkIndices();
+
+  auto it = content_hash_index_.find(ChunkContentKey(chunk));
+  if (it == content_hash_index_.end()) {
+    return nullptr;
+  }
+  const ImageChunk& candidate = chunks_[it->second];
+  if (candidate.GetType() != CHUNK_DEFLATE && !find_normal) {
+    return nullptr;
+  }
+  // Digest equality isn't byte equality; confirm before pairing.
+  if (candidate.GetRawDataLength() != chunk.GetRawDataLength() ||
+      memcmp(candidate.GetRawData(), chunk.GetRawData(), chunk.GetRawDataLength()) != 0) {
+    return nullptr;
+  }
+  return &candidate;
+}
+
+ImageChunk* ZipModeImage::FindChunkByContent(const ImageChunk& chunk, bool find_normal) {
+  return const_cast<ImageChunk*>(
+      static_cast<const ZipModeImage*>(this)->FindChunkByContent(chunk, find_normal));
+}
+
 bool ZipModeImage::CheckAndProcessChunks(ZipModeImage* tgt_image, ZipModeImage* src_image) {
   for (auto& tgt_chunk : *tgt_image) {
     if (tgt_chunk.GetType() != CHUNK_DEFLATE) {
@@ -893,6 +1063,15 @@ bool ZipModeImage::CheckAndProcessChunks(ZipModeImage* tgt_image, ZipModeImage*
     }
 
     ImageChunk* src_chunk = src_image->FindChunkByName(tgt_chunk.GetEntryName());
+    if (src_chunk == nullptr) {
+      // A renamed entry keeps its bits: pair it by content so it still collapses to the trivial
+      // identical-data patch below instead of shipping as full data.
+      src_chunk = src_image->FindChunkByContent(tgt_chunk);
+      if (src_chunk != nullptr) {
+        LOG(INFO) << "Matched renamed entry [" << tgt_chunk.GetEntryName() << "] to ["
+                  << src_chunk->GetEntryName() << "] by content";
+      }
+    }
     if (src_chunk == nullptr) {
       tgt_chunk.ChangeDeflateChunkToNormal();
     } else if (tgt_chunk == *src_chunk) {
@@ -950,6 +1129,10 @@ bool ZipModeImage::SplitZipModeImageWithLimit(const ZipModeImage& tgt_image,
   std::vector<ImageChunk> split_tgt_chunks;
   for (auto tgt = tgt_image.cbegin(); tgt != tgt_image.cend(); tgt++) {
     const ImageChunk* src = src_image.FindChunkByName(tgt->GetEntryName(), true);
+    if (src == nullptr) {
+      // Renamed-but-identical entries still contribute their old bytes as the diff source.
+      src = src_image.FindChunkByContent(*tgt, true);
+    }
     if (src == nullptr) {
       split_tgt_chunks.emplace_back(CHUNK_NORMAL, tgt->GetStartOffset(), &tgt_image.file_content_,
                                     tgt->GetRawDataLength());
@@ -1127,7 +1310,10 @@ bool ZipModeImage::GeneratePatchesInternal(const ZipModeImage& tgt_image,
   LOG(INFO) << "Constructing patches for " << tgt_image.NumOfChunks() << " chunks...";
   patch_chunks->clear();
 
-  bsdiff::SuffixArrayIndexInterface* bsdiff_cache = nullptr;
+  // Shared across calls, so successive split images in the same run (and any recurring identical
+  // source chunks) reuse already-built suffix arrays instead of recomputing them.
+  static SuffixArrayCache suffix_array_cache;
+
   for (size_t i = 0; i < tgt_image.NumOfChunks(); i++) {
     const auto& tgt_chunk = tgt_image[i];
 
@@ -1142,7 +1328,28 @@ bool ZipModeImage::GeneratePatchesInternal(const ZipModeImage& tgt_image,
 
     const auto& src_ref = (src_chunk == nullptr) ? src_image.PseudoSource() : *src_chunk;
     bsdiff::SuffixArrayIndexInterface** bsdiff_cache_ptr =
-        (src_chunk == nullptr) ? &bsdiff_cache : nullptr;
+        suffix_array_cache.SlotFor(src_ref.DataForPatch(), src_ref.DataLengthForPatch());
+
+    // For a deflate target with a matched source entry, race a second candidate on another
+    // thread: diffing the stored (compressed) bytes as a normal chunk. When an entry was
+    // recompressed the uncompressed diff wins easily, but for entries that merely moved or had
+    // trivial edits the raw diff can come out smaller, and it saves the device an inflate step.
+    // The raw-data candidate needs no trial thread since comparing lengths is free.
+    bool race_normal_form = (tgt_chunk.GetType() == CHUNK_DEFLATE && src_chunk != nullptr);
+    ImageChunk normal_tgt = tgt_chunk;
+    ImageChunk normal_src = src_ref;
+    std::vector<uint8_t> normal_patch_data;
+    std::future<bool> normal_future;
+    if (race_normal_form) {
+      normal_tgt.ChangeDeflateChunkToNormal();
+      normal_src.ChangeDeflateChunkToNormal();
+      // The racer builds its own suffix array; the shared cache slots are handed out one at a
+      // time and stay with the deflate-form diff below.
+      normal_future = std::async(std::launch::async, [&normal_tgt, &normal_src,
+                                                      &normal_patch_data]() {
+        return ImageChunk::MakePatch(normal_tgt, normal_src, &normal_patch_data, nullptr);
+      });
+    }
 
     std::vector<uint8_t> patch_data;
     if (!ImageChunk::MakePatch(tgt_chunk, src_ref, &patch_data, bsdiff_cache_ptr)) {
@@ -1150,17 +1357,26 @@ bool ZipModeImage::GeneratePatchesInternal(const ZipModeImage& tgt_image,
       return false;
     }
 
+    // Keep whichever candidate came out smaller. A failed raw-bytes trial just loses the race.
+    const ImageChunk* final_tgt = &tgt_chunk;
+    const ImageChunk* final_src = &src_ref;
+    if (race_normal_form && normal_future.get() && normal_patch_data.size() < patch_data.size()) {
+      LOG(INFO) << "keeping raw-bytes patch for " << tgt_chunk.GetEntryName() << " ("
+                << normal_patch_data.size() << " vs " << patch_data.size() << " bytes)";
+      patch_data = std::move(normal_patch_data);
+      final_tgt = &normal_tgt;
+      final_src = &normal_src;
+    }
+
     LOG(INFO) << "patch " << i << " is " << patch_data.size() << " bytes (of "
               << tgt_chunk.GetRawDataLength() << ")";
 
-    if (PatchChunk::RawDataIsSmaller(tgt_chunk, patch_data.size())) {
-      patch_chunks->emplace_back(tgt_chunk);
+    if (PatchChunk::RawDataIsSmaller(*final_tgt, patch_data.size())) {
+      patch_chunks->emplace_back(*final_tgt);
     } else {
-      patch_chunks->emplace_back(tgt_chunk, src_ref, std::move(patch_data));
+      patch_chunks->emplace_back(*final_tgt, *final_src, std::move(patch_data));
     }
   }
-  delete bsdiff_cache;
-
   CHECK_EQ(patch_chunks->size(), tgt_image.NumOfChunks());
   return true;
 }
@@ -1461,27 +1677,53 @@ bool ImageModeImage::GeneratePatches(const ImageModeImage& tgt_image,
   std::vector<PatchChunk> patch_chunks;
   patch_chunks.reserve(tgt_image.NumOfChunks());
 
+  // Each target chunk diffs against its own source chunk (no shared suffix-array cache in image
+  // mode), so the expensive bsdiff/deflate work parallelizes cleanly across chunks. Compute the
+  // patches concurrently and assemble the results in chunk order below.
+  struct ChunkPatch {
+    bool use_raw_data = false;
+    bool failed = false;
+    std::vector<uint8_t> data;
+  };
+
+  std::vector<std::future<ChunkPatch>> patch_futures;
+  for (size_t i = 0; i < tgt_image.NumOfChunks(); i++) {
+    patch_futures.emplace_back(
+        std::async(std::launch::async, [&tgt_image, &src_image, i]() {
+          ChunkPatch patch;
+          const auto& tgt_chunk = tgt_image[i];
+          if (PatchChunk::RawDataIsSmaller(tgt_chunk, 0)) {
+            patch.use_raw_data = true;
+            return patch;
+          }
+          if (!ImageChunk::MakePatch(tgt_chunk, src_image[i], &patch.data, nullptr)) {
+            patch.failed = true;
+          }
+          return patch;
+        }));
+  }
+
   for (size_t i = 0; i < tgt_image.NumOfChunks(); i++) {
     const auto& tgt_chunk = tgt_image[i];
     const auto& src_chunk = src_image[i];
+    ChunkPatch patch = patch_futures[i].get();
 
-    if (PatchChunk::RawDataIsSmaller(tgt_chunk, 0)) {
+    if (patch.failed) {
+      LOG(ERROR) << "Failed to generate patch for target chunk " << i;
+      return false;
+    }
+    if (patch.use_raw_data) {
       patch_chunks.emplace_back(tgt_chunk);
       continue;
     }
 
-    std::vector<uint8_t> patch_data;
-    if (!ImageChunk::MakePatch(tgt_chunk, src_chunk, &patch_data, nullptr)) {
-      LOG(ERROR) << "Failed to generate patch for target chunk " << i;
-      return false;
-    }
-    LOG(INFO) << "patch " << i << " is " << patch_data.size() << " bytes (of "
+    LOG(INFO) << "patch " << i << " is " << patch.data.size() << " bytes (of "
               << tgt_chunk.GetRawDataLength() << ")";
 
-    if (PatchChunk::RawDataIsSmaller(tgt_chunk, patch_data.size())) {
+    if (PatchChunk::RawDataIsSmaller(tgt_chunk, patch.data.size())) {
       patch_chunks.emplace_back(tgt_chunk);
     } else {
-      patch_chunks.emplace_back(tgt_chunk, src_chunk, std::move(patch_data));
+      patch_chunks.emplace_back(tgt_chunk, src_chunk, std::move(patch.data));
     }
   }
 
@@ -26,8 +26,11 @@
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include <future>
 #include <memory>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
 
 #include <android-base/logging.h>
@@ -51,7 +54,7 @@ static inline int32_t Read4(const void *address) {
 // This function is a wrapper of ApplyBSDiffPatch(). It has a custom sink function to deflate the
 // patched data and stream the deflated data to output.
 static bool ApplyBSDiffPatchAndStreamOutput(const uint8_t* src_data, size_t src_len,
-                                            const Value& patch, size_t patch_offset,
+                                            std::string_view patch, size_t patch_offset,
                                             const char* deflate_header, SinkFn sink) {
   size_t expected_target_length = static_cast<size_t>(Read8(deflate_header + 32));
   CHECK_GT(expected_target_length, static_cast<size_t>(0));
@@ -78,13 +81,15 @@ static bool ApplyBSDiffPatchAndStreamOutput(const uint8_t* src_data, size_t src_
   size_t actual_target_length = 0;
   size_t total_written = 0;
   static constexpr size_t buffer_size = 32768;
+  // One deflate output buffer for the whole chunk; the sink gets called for every bspatch
+  // control entry, so allocating inside it shows up on fragmented diffs.
+  std::vector<uint8_t> buffer(buffer_size);
   auto compression_sink = [&strm, &actual_target_length, &expected_target_length, &total_written,
-                           &ret, &sink](const uint8_t* data, size_t len) -> size_t {
+                           &ret, &sink, &buffer](const uint8_t* data, size_t len) -> size_t {
     // The input patch length for an update never exceeds INT_MAX.
     strm.avail_in = len;
     strm.next_in = data;
     do {
-      std::vector<uint8_t> buffer(buffer_size);
       strm.avail_out = buffer_size;
       strm.next_out = buffer.data();
       if (actual_target_length + len < expected_target_length) {
@@ -132,23 +137,92 @@ static bool ApplyBSDiffPatchAndStreamOutput(const uint8_t* src_data, size_t src_
   return true;
 }
 
+// Inflates the source data of a CHUNK_DEFLATE record into |out|, appending the bonus data when
+// |use_bonus| is set. The chunk header tells us exactly how big the decompressed source is.
+// Returns false if the recorded lengths don't match what inflation produces.
+static bool InflateChunkSource(const unsigned char* old_data, size_t old_size,
+                               const char* deflate_header, const Value* bonus_data, bool use_bonus,
+                               std::vector<unsigned char>* out) {
+  size_t src_start = static_cast<size_t>(Read8(deflate_header));
+  size_t src_len = static_cast<size_t>(Read8(deflate_header + 8));
+  size_t expanded_len = static_cast<size_t>(Read8(deflate_header + 24));
+
+  if (src_start + src_len > old_size) {
+    printf("source data too short\n");
+    return false;
+  }
+
+  // Note: expanded_len will include the bonus data size if the patch was constructed with
+  // bonus data. The deflation will come up 'bonus_size' bytes short; these must be appended
+  // from the bonus_data value.
+  size_t bonus_size = (use_bonus && bonus_data != nullptr) ? bonus_data->data.size() : 0;
+
+  out->resize(expanded_len);
+
+  // inflate() doesn't like strm.next_out being a nullptr even with
+  // avail_out being zero (Z_STREAM_ERROR).
+  if (expanded_len != 0) {
+    z_stream strm;
+    strm.zalloc = Z_NULL;
+    strm.zfree = Z_NULL;
+    strm.opaque = Z_NULL;
+    strm.avail_in = src_len;
+    strm.next_in = old_data + src_start;
+    strm.avail_out = expanded_len;
+    strm.next_out = out->data();
+
+    int ret = inflateInit2(&strm, -15);
+    if (ret != Z_OK) {
+      printf("failed to init source inflation: %d\n", ret);
+      return false;
+    }
+
+    // Because we've provided enough room to accommodate the output
+    // data, we expect one call to inflate() to suffice.
+    ret = inflate(&strm, Z_SYNC_FLUSH);
+    if (ret != Z_STREAM_END) {
+      printf("source inflation returned %d\n", ret);
+      return false;
+    }
+    // We should have filled the output buffer exactly, except
+    // for the bonus_size.
+    if (strm.avail_out != bonus_size) {
+      printf("source inflation short by %zu bytes\n", strm.avail_out - bonus_size);
+      return false;
+    }
+    inflateEnd(&strm);
+
+    if (bonus_size) {
+      memcpy(out->data() + (expanded_len - bonus_size), bonus_data->data.data(), bonus_size);
+    }
+  }
+
+  return true;
+}
+
 int ApplyImagePatch(const unsigned char* old_data, size_t old_size, const unsigned char* patch_data,
                     size_t patch_size, SinkFn sink) {
-  Value patch(Value::Type::BLOB,
-              std::string(reinterpret_cast<const char*>(patch_data), patch_size));
-  return ApplyImagePatch(old_data, old_size, patch, sink, nullptr);
+  return ApplyImagePatch(old_data, old_size,
+                         std::string_view(reinterpret_cast<const char*>(patch_data), patch_size),
+                         std::move(sink), nullptr);
 }
 
 int ApplyImagePatch(const unsigned char* old_data, size_t old_size, const Value& patch, SinkFn sink,
                     const Value* bonus_data) {
-  if (patch.data.size() < 12) {
+  return ApplyImagePatch(old_data, old_size, std::string_view(patch.data), std::move(sink),
+                         bonus_data);
+}
+
+int ApplyImagePatch(const unsigned char* old_data, size_t old_size, std::string_view patch,
+                    SinkFn sink, const Value* bonus_data) {
+  if (patch.size() < 12) {
     printf("patch too short to contain header\n");
     return -1;
   }
 
   // IMGDIFF2 uses CHUNK_NORMAL, CHUNK_DEFLATE, and CHUNK_RAW. (IMGDIFF1, which is no longer
   // supported, used CHUNK_NORMAL and CHUNK_GZIP.)
-  const char* const patch_header = patch.data.data();
+  const char* const patch_header = patch.data();
   if (memcmp(patch_header, "IMGDIFF2", 8) != 0) {
     printf("corrupt patch file header (magic number)\n");
     return -1;
@@ -156,136 +230,133 @@ int ApplyImagePatch(const unsigned char* old_data, size_t old_size, const Value&
 
   int num_chunks = Read4(patch_header + 8);
   size_t pos = 12;
+
+  // Parse all the chunk records up front. Besides failing on a truncated patch before any data
+  // has been sunk, this lets the deflate chunks ahead of the current one be seen early enough to
+  // inflate their sources in the background.
+  struct ChunkRecord {
+    int type;
+    const char* header;
+    size_t raw_data_pos;
+    size_t raw_data_len;
+  };
+  std::vector<ChunkRecord> chunks;
+  chunks.reserve(num_chunks);
   for (int i = 0; i < num_chunks; ++i) {
     // each chunk's header record starts with 4 bytes.
-    if (pos + 4 > patch.data.size()) {
+    if (pos + 4 > patch.size()) {
       printf("failed to read chunk %d record\n", i);
       return -1;
     }
     int type = Read4(patch_header + pos);
     pos += 4;
 
+    ChunkRecord record{ type, patch_header + pos, 0, 0 };
     if (type == CHUNK_NORMAL) {
-      const char* normal_header = patch_header + pos;
       pos += 24;
-      if (pos > patch.data.size()) {
+      if (pos > patch.size()) {
         printf("failed to read chunk %d normal header data\n", i);
         return -1;
       }
-
-      size_t src_start = static_cast<size_t>(Read8(normal_header));
-      size_t src_len = static_cast<size_t>(Read8(normal_header + 8));
-      size_t patch_offset = static_cast<size_t>(Read8(normal_header + 16));
-
-      if (src_start + src_len > old_size) {
-        printf("source data too short\n");
-        return -1;
-      }
-      if (ApplyBSDiffPatch(old_data + src_start, src_len, patch, patch_offset, sink) != 0) {
-        printf("Failed to apply bsdiff patch.\n");
-        return -1;
-      }
-
-      LOG(DEBUG) << "Processed chunk type normal";
     } else if (type == CHUNK_RAW) {
-      const char* raw_header = patch_header + pos;
       pos += 4;
-      if (pos > patch.data.size()) {
+      if (pos > patch.size()) {
         printf("failed to read chunk %d raw header data\n", i);
         return -1;
       }
-
-      size_t data_len = static_cast<size_t>(Read4(raw_header));
-
-      if (pos + data_len > patch.data.size()) {
+      record.raw_data_len = static_cast<size_t>(Read4(record.header));
+      record.raw_data_pos = pos;
+      if (pos + record.raw_data_len > patch.size()) {
         printf("failed to read chunk %d raw data\n", i);
         return -1;
       }
-      if (sink(reinterpret_cast<const unsigned char*>(patch_header + pos), data_len) != data_len) {
-        printf("failed to write chunk %d raw data\n", i);
-        return -1;
-      }
-      pos += data_len;
-
-      LOG(DEBUG) << "Processed chunk type raw";
+      pos += record.raw_data_len;
     } else if (type == CHUNK_DEFLATE) {
       // deflate chunks have an additional 60 bytes in their chunk header.
-      const char* deflate_header = patch_header + pos;
       pos += 60;
-      if (pos > patch.data.size()) {
+      if (pos > patch.size()) {
         printf("failed to read chunk %d deflate header data\n", i);
         return -1;
       }
+    } else {
+      printf("patch chunk %d is unknown type %d\n", i, type);
+      return -1;
+    }
+    chunks.push_back(record);
+  }
+
+  // Pipeline the deflate chunks: while the current chunk is being bspatched and its target
+  // recompressed (both pure CPU, and the recompression is the hottest part of an incremental
+  // update), the next deflate chunk's source inflates on a worker thread. Recompression itself
+  // stays on stock zlib: imgdiff requires the recompressed bytes to be bit-identical to the
+  // original target at the recorded parameters, and the patch format carries no per-chunk hash
+  // that could vet a faster, non-identical deflate before its output hits the sink.
+  struct InflatedSource {
+    std::vector<unsigned char> data;
+    bool ok;
+  };
+  auto launch_inflate = [&chunks, old_data, old_size, bonus_data](size_t chunk_index) {
+    return std::async(std::launch::async,
+                      [&chunks, old_data, old_size, bonus_data, chunk_index]() {
+                        InflatedSource source;
+                        source.ok =
+                            InflateChunkSource(old_data, old_size, chunks[chunk_index].header,
+                                               bonus_data, chunk_index == 1, &source.data);
+                        return source;
+                      });
+  };
+
+  std::future<InflatedSource> pending_source;
+  auto launch_next_inflate = [&chunks, &pending_source, &launch_inflate](size_t after) {
+    for (size_t j = after; j < chunks.size(); ++j) {
+      if (chunks[j].type == CHUNK_DEFLATE) {
+        pending_source = launch_inflate(j);
+        return;
+      }
+    }
+  };
+  launch_next_inflate(0);
 
-      size_t src_start = static_cast<size_t>(Read8(deflate_header));
-      size_t src_len = static_cast<size_t>(Read8(deflate_header + 8));
-      size_t patch_offset = static_cast<size_t>(Read8(deflate_header + 16));
-      size_t expanded_len = static_cast<size_t>(Read8(deflate_header + 24));
+  for (size_t i = 0; i < chunks.size(); ++i) {
+    const ChunkRecord& chunk = chunks[i];
+    if (chunk.type == CHUNK_NORMAL) {
+      size_t src_start = static_cast<size_t>(Read8(chunk.header));
+      size_t src_len = static_cast<size_t>(Read8(chunk.header + 8));
+      size_t patch_offset = static_cast<size_t>(Read8(chunk.header + 16));
 
       if (src_start + src_len > old_size) {
         printf("source data too short\n");
         return -1;
       }
+      if (ApplyBSDiffPatch(old_data + src_start, src_len, patch, patch_offset, sink) != 0) {
+        printf("Failed to apply bsdiff patch.\n");
+        return -1;
+      }
 
-      // Decompress the source data; the chunk header tells us exactly
-      // how big we expect it to be when decompressed.
-
-      // Note: expanded_len will include the bonus data size if the patch was constructed with
-      // bonus data. The deflation will come up 'bonus_size' bytes short; these must be appended
-      // from the bonus_data value.
-      size_t bonus_size = (i == 1 && bonus_data != nullptr) ? bonus_data->data.size() : 0;
-
-      std::vector<unsigned char> expanded_source(expanded_len);
-
-      // inflate() doesn't like strm.next_out being a nullptr even with
-      // avail_out being zero (Z_STREAM_ERROR).
-      if (expanded_len != 0) {
-        z_stream strm;
-        strm.zalloc = Z_NULL;
-        strm.zfree = Z_NULL;
-        strm.opaque = Z_NULL;
-        strm.avail_in = src_len;
-        strm.next_in = old_data + src_start;
-        strm.avail_out = expanded_len;
-        strm.next_out = expanded_source.data();
-
-        int ret = inflateInit2(&strm, -15);
-        if (ret != Z_OK) {
-          printf("failed to init source inflation: %d\n", ret);
-          return -1;
-        }
-
-        // Because we've provided enough room to accommodate the output
-        // data, we expect one call to inflate() to suffice.
-        ret = inflate(&strm, Z_SYNC_FLUSH);
-        if (ret != Z_STREAM_END) {
-          printf("source inflation returned %d\n", ret);
-          return -1;
-        }
-        // We should have filled the output buffer exactly, except
-        // for the bonus_size.
-        if (strm.avail_out != bonus_size) {
-          printf("source inflation short by %zu bytes\n", strm.avail_out - bonus_size);
-          return -1;
-        }
-        inflateEnd(&strm);
-
-        if (bonus_size) {
-          memcpy(expanded_source.data() + (expanded_len - bonus_size), bonus_data->data.data(),
-                 bonus_size);
-        }
+      LOG(DEBUG) << "Processed chunk type normal";
+    } else if (chunk.type == CHUNK_RAW) {
+      if (sink(reinterpret_cast<const unsigned char*>(patch_header + chunk.raw_data_pos),
+               chunk.raw_data_len) != chunk.raw_data_len) {
+        printf("failed to write chunk %zu raw data\n", i);
+        return -1;
       }
 
-      if (!ApplyBSDiffPatchAndStreamOutput(expanded_source.data(), expanded_len, patch,
-                                           patch_offset, deflate_header, sink)) {
+      LOG(DEBUG) << "Processed chunk type raw";
+    } else {  // CHUNK_DEFLATE
+      InflatedSource source = pending_source.get();
+      launch_next_inflate(i + 1);
+      if (!source.ok) {
+        return -1;
+      }
+
+      size_t patch_offset = static_cast<size_t>(Read8(chunk.header + 16));
+      if (!ApplyBSDiffPatchAndStreamOutput(source.data.data(), source.data.size(), patch,
+                                           patch_offset, chunk.header, sink)) {
         LOG(ERROR) << "Fail to apply streaming bspatch.";
         return -1;
       }
 
       LOG(DEBUG) << "Processed chunk type deflate";
-    } else {
-      printf("patch chunk %d is unknown type %d\n", i, type);
-      return -1;
     }
   }
 
@@ -23,6 +23,7 @@
 #include <memory>
 #include <ostream>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include <openssl/sha.h>
@@ -109,6 +110,12 @@ void ShowBSDiffLicense();
 int ApplyBSDiffPatch(const unsigned char* old_data, size_t old_size, const Value& patch,
                      size_t patch_offset, SinkFn sink);
 
+// Same as above, but borrows the patch bytes for the duration of the call instead of requiring an
+// owning Value, so callers that already have the patch in memory (e.g. within a mapped package)
+// don't have to copy it.
+int ApplyBSDiffPatch(const unsigned char* old_data, size_t old_size, std::string_view patch,
+                     size_t patch_offset, SinkFn sink);
+
 // imgpatch.cpp
 
 // Applies the imgdiff-patch given in 'patch' to the source data given by (old_data, old_size), with
@@ -117,6 +124,10 @@ int ApplyBSDiffPatch(const unsigned char* old_data, size_t old_size, const Value
 int ApplyImagePatch(const unsigned char* old_data, size_t old_size, const Value& patch, SinkFn sink,
                     const Value* bonus_data);
 
+// Same as above, with the patch bytes borrowed for the duration of the call.
+int ApplyImagePatch(const unsigned char* old_data, size_t old_size, std::string_view patch,
+                    SinkFn sink, const Value* bonus_data);
+
 // freecache.cpp
 
 // Checks whether /cache partition has at least 'bytes'-byte free space. Returns true immediately
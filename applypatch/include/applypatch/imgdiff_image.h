@@ -22,6 +22,7 @@
 #include <sys/types.h>
 
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include <bsdiff/bsdiff.h>
@@ -138,7 +139,7 @@ class PatchChunk {
 
  private:
   size_t GetHeaderSize() const;
-  size_t WriteHeaderToFd(int fd, size_t offset, size_t index) const;
+  void WriteHeaderToFd(int fd, size_t patch_offset, size_t index) const;
 
   // The patch chunk type is the same as the target chunk type. The only exception is we change
   // the |type_| to CHUNK_RAW if target length is smaller than the patch size.
@@ -229,6 +230,12 @@ class ZipModeImage : public Image {
 
   const ImageChunk* FindChunkByName(const std::string& name, bool find_normal = false) const;
 
+  // Find a source chunk whose raw bytes equal |chunk|'s, for pairing entries that were renamed
+  // without changing content. Search for normal chunks also if |find_normal| is true.
+  ImageChunk* FindChunkByContent(const ImageChunk& chunk, bool find_normal = false);
+
+  const ImageChunk* FindChunkByContent(const ImageChunk& chunk, bool find_normal = false) const;
+
   // Verify that we can reconstruct the deflate chunks; also change the type to CHUNK_NORMAL if
   // src and tgt are identical.
   static bool CheckAndProcessChunks(ZipModeImage* tgt_image, ZipModeImage* src_image);
@@ -254,6 +261,11 @@ class ZipModeImage : public Image {
                                          std::vector<SortedRangeSet>* split_src_ranges);
 
  private:
+  // (Re)builds the entry-name and content-hash lookup tables when chunks_ has changed since the
+  // last build. Chunk pairing used to scan chunks_ linearly per target entry, which is quadratic
+  // over images with thousands of entries.
+  void BuildChunkIndices() const;
+
   // Initialize image chunks based on the zip entries.
   bool InitializeChunks(const std::string& filename, ZipArchiveHandle handle);
   // Add the a zip entry to the list.
@@ -284,6 +296,14 @@ class ZipModeImage : public Image {
   // size limit in bytes of each chunk. Also, if the length of one zip_entry exceeds the limit,
   // we'll split that entry into several smaller chunks in advance.
   size_t limit_;
+
+  // Lookup tables from entry name / raw-content digest to position in chunks_, built lazily by
+  // BuildChunkIndices(). Mutable because the const lookup functions populate them on first use;
+  // they are keyed to the chunk count so a chunks_ rewrite (e.g. a merge pass) invalidates them.
+  // Chunk types may still change after a build, so lookups re-check the type filter.
+  mutable std::unordered_map<std::string, size_t> entry_name_index_;
+  mutable std::unordered_map<std::string, size_t> content_hash_index_;
+  mutable size_t indexed_chunk_count_ = 0;
 };
 
 class ImageModeImage : public Image {
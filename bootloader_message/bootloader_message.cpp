@@ -20,6 +20,8 @@
 #include <fcntl.h>
 #include <string.h>
 
+#include <chrono>
+#include <mutex>
 #include <optional>
 #include <string>
 #include <string_view>
@@ -32,6 +34,8 @@
 #include <android-base/unique_fd.h>
 #include <fstab/fstab.h>
 
+#include "otautil/sysutil.h"
+
 #ifndef __ANDROID__
 #include <cutils/memory.h>  // for strlcpy
 #endif
@@ -41,15 +45,30 @@ using android::fs_mgr::ReadDefaultFstab;
 
 static std::optional<std::string> g_misc_device_for_test;
 
+// The misc device never changes within a process, but resolving it costs a full fstab parse and,
+// early in recovery, waiting for the kernel to create the node — both on the critical path of
+// recovery entry (reading the BCB) and exit (clearing it). Cache the resolved path and the device
+// availability so that only the first access pays for them.
+static std::mutex g_misc_device_lock;
+static std::string g_resolved_misc_device;
+static std::string g_present_misc_device;
+
 // Exposed for test purpose.
 void SetMiscBlockDeviceForTest(std::string_view misc_device) {
+  std::lock_guard<std::mutex> lock(g_misc_device_lock);
   g_misc_device_for_test = misc_device;
+  g_resolved_misc_device.clear();
+  g_present_misc_device.clear();
 }
 
 std::string get_misc_blk_device(std::string* err) {
+  std::lock_guard<std::mutex> lock(g_misc_device_lock);
   if (g_misc_device_for_test.has_value() && !g_misc_device_for_test->empty()) {
     return *g_misc_device_for_test;
   }
+  if (!g_resolved_misc_device.empty()) {
+    return g_resolved_misc_device;
+  }
   Fstab fstab;
   if (!ReadDefaultFstab(&fstab)) {
     *err = "failed to read default fstab";
@@ -57,7 +76,8 @@ std::string get_misc_blk_device(std::string* err) {
   }
   for (const auto& entry : fstab) {
     if (entry.mount_point == "/misc") {
-      return entry.blk_device;
+      g_resolved_misc_device = entry.blk_device;
+      return g_resolved_misc_device;
     }
   }
 
@@ -68,24 +88,22 @@ std::string get_misc_blk_device(std::string* err) {
 // In recovery mode, recovery can get started and try to access the misc
 // device before the kernel has actually created it.
 static bool wait_for_device(const std::string& blk_device, std::string* err) {
-  int tries = 0;
-  int ret;
-  err->clear();
-  do {
-    ++tries;
-    struct stat buf;
-    ret = stat(blk_device.c_str(), &buf);
-    if (ret == -1) {
-      *err += android::base::StringPrintf("failed to stat %s try %d: %s\n",
-                                          blk_device.c_str(), tries, strerror(errno));
-      sleep(1);
+  {
+    std::lock_guard<std::mutex> lock(g_misc_device_lock);
+    if (blk_device == g_present_misc_device) {
+      return true;
     }
-  } while (ret && tries < 10);
-
-  if (ret) {
-    *err += android::base::StringPrintf("failed to stat %s\n", blk_device.c_str());
   }
-  return ret == 0;
+  err->clear();
+  // Sleep on the kernel's uevents instead of a retry loop, so the wait ends the moment the node
+  // appears. The 10s budget matches the old ten 1s retries.
+  if (!WaitForBlockDevice(blk_device, std::chrono::seconds(10))) {
+    *err = android::base::StringPrintf("timed out waiting for %s", blk_device.c_str());
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(g_misc_device_lock);
+  g_present_misc_device = blk_device;
+  return true;
 }
 
 static bool read_misc_partition(void* p, size_t size, const std::string& misc_blk_device,
@@ -241,14 +259,61 @@ bool write_reboot_bootloader(std::string* err) {
   return write_bootloader_message(boot, err);
 }
 
-bool read_wipe_package(std::string* package_data, size_t size, std::string* err) {
+// The wipe package region ends where the system space begins.
+static constexpr size_t kMaximumWipePackageSize =
+    SYSTEM_SPACE_OFFSET_IN_MISC - WIPE_PACKAGE_OFFSET_IN_MISC;
+
+// Validates a wipe package size claimed by the caller (it comes from the recovery command line,
+// not from misc itself) before any allocation or I/O happens on its behalf.
+static bool validate_wipe_package_size(size_t size, std::string* err) {
+  if (size == 0 || size > kMaximumWipePackageSize) {
+    *err = "Wipe package size " + std::to_string(size) + " is invalid (region holds " +
+           std::to_string(kMaximumWipePackageSize) + " bytes)";
+    return false;
+  }
+  return true;
+}
+
+static bool read_wipe_package_data(char* data, size_t size, std::string* err) {
   std::string misc_blk_device = get_misc_blk_device(err);
   if (misc_blk_device.empty()) {
     return false;
   }
+  // Read the first block alone and check that it actually starts a zip archive before paying for
+  // the rest. The package carries no length header of its own (adding one would break the
+  // uncrypt <-> recovery on-disk format), but a wipe package is always a zip, so a stale or
+  // garbage region fails after one block instead of after a multi-megabyte read.
+  size_t probe = std::min<size_t>(size, 4096);
+  if (!read_misc_partition(data, probe, misc_blk_device, WIPE_PACKAGE_OFFSET_IN_MISC, err)) {
+    return false;
+  }
+  static constexpr char kZipMagic[4] = { 'P', 'K', 0x03, 0x04 };
+  if (probe >= sizeof(kZipMagic) && memcmp(data, kZipMagic, sizeof(kZipMagic)) != 0) {
+    *err = "wipe package data does not start with a zip local file header";
+    return false;
+  }
+  if (size > probe &&
+      !read_misc_partition(data + probe, size - probe, misc_blk_device,
+                           WIPE_PACKAGE_OFFSET_IN_MISC + probe, err)) {
+    return false;
+  }
+  return true;
+}
+
+bool read_wipe_package(std::string* package_data, size_t size, std::string* err) {
+  if (!validate_wipe_package_size(size, err)) {
+    return false;
+  }
+  package_data->resize(size);
+  return read_wipe_package_data(&(*package_data)[0], size, err);
+}
+
+bool read_wipe_package(std::vector<uint8_t>* package_data, size_t size, std::string* err) {
+  if (!validate_wipe_package_size(size, err)) {
+    return false;
+  }
   package_data->resize(size);
-  return read_misc_partition(&(*package_data)[0], size, misc_blk_device,
-                             WIPE_PACKAGE_OFFSET_IN_MISC, err);
+  return read_wipe_package_data(reinterpret_cast<char*>(package_data->data()), size, err);
 }
 
 bool write_wipe_package(const std::string& package_data, std::string* err) {
@@ -256,8 +321,6 @@ bool write_wipe_package(const std::string& package_data, std::string* err) {
   if (misc_blk_device.empty()) {
     return false;
   }
-  static constexpr size_t kMaximumWipePackageSize =
-      SYSTEM_SPACE_OFFSET_IN_MISC - WIPE_PACKAGE_OFFSET_IN_MISC;
   if (package_data.size() > kMaximumWipePackageSize) {
     *err = "Wipe package size " + std::to_string(package_data.size()) + " exceeds " +
            std::to_string(kMaximumWipePackageSize) + " bytes";
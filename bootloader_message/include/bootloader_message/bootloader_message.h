@@ -219,8 +219,11 @@ bool clear_bootloader_message(std::string* err);
 // Writes the reboot-bootloader reboot reason to the bootloader_message.
 bool write_reboot_bootloader(std::string* err);
 
-// Read the wipe package from BCB (from offset WIPE_PACKAGE_OFFSET_IN_MISC).
+// Read the wipe package from BCB (from offset WIPE_PACKAGE_OFFSET_IN_MISC). Rejects sizes that
+// don't fit the wipe package region, and data that doesn't start with a zip archive. The vector
+// overload lets the caller hand the buffer to the installer without another copy.
 bool read_wipe_package(std::string* package_data, size_t size, std::string* err);
+bool read_wipe_package(std::vector<uint8_t>* package_data, size_t size, std::string* err);
 
 // Write the wipe package into BCB (to offset WIPE_PACKAGE_OFFSET_IN_MISC).
 bool write_wipe_package(const std::string& package_data, std::string* err);
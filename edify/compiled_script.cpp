@@ -0,0 +1,272 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Optional on-disk cache of a parsed Expr tree, so a process that runs the same updater-script
+// repeatedly (a retried install, or the host simulator looping over a corpus) can skip the yacc
+// parser. The cache is keyed by a hash of the script text and is simply ignored when it doesn't
+// match; correctness never depends on it.
+//
+// Layout (all integers little-endian):
+//   u32 magic, u32 version
+//   u64 script length, u64 FNV-1a hash of the script text
+//   the Expr tree in pre-order; per node:
+//     u8 node kind (literal / operator / registered function)
+//     u8 operator index (operator nodes only)
+//     i32 start, i32 end
+//     u32 name length, name bytes
+//     u32 argument count, then the argument subtrees
+//
+// Function pointers obviously can't be stored. Operator nodes (the functions the parser wires up
+// for ';', '+', '&&', ...) are stored as an index into a fixed table below; call sites are stored
+// by name and re-resolved against the function registry on load, so the loading process must have
+// registered the same set of functions as the one that saved the cache.
+
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+#include <utility>
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+
+#include "edify/expr.h"
+
+static constexpr uint32_t kCompiledScriptMagic = 0x31434445;  // "EDC1"
+static constexpr uint32_t kCompiledScriptVersion = 1;
+
+// Deep expression trees deserialize (and evaluate) recursively; bail out rather than overflow the
+// stack on a corrupt or hostile cache. A 5,000-statement script nests about as many sequence
+// nodes, so leave generous headroom.
+static constexpr int kMaxTreeDepth = 65536;
+
+enum NodeKind : uint8_t {
+  kLiteralNode = 0,
+  kOperatorNode = 1,
+  kFunctionNode = 2,
+};
+
+// The functions the parser uses for operator nodes; they aren't in the registry, so they're
+// serialized as
+// an index into this table. Only append to it — existing indices are baked into cache files.
+static const Function kOperatorTable[] = {
+  SequenceFn, ConcatFn, EqualityFn, InequalityFn,
+  LogicalAndFn, LogicalOrFn, LogicalNotFn, IfElseFn,
+};
+
+static uint64_t HashScriptText(const std::string& script) {
+  // FNV-1a; this guards against reusing a cache across different scripts, not against tampering.
+  uint64_t hash = 14695981039346656037ULL;
+  for (char c : script) {
+    hash ^= static_cast<uint8_t>(c);
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+static void AppendU8(std::string* out, uint8_t value) {
+  out->push_back(static_cast<char>(value));
+}
+
+static void AppendU32(std::string* out, uint32_t value) {
+  for (int i = 0; i < 4; ++i) {
+    out->push_back(static_cast<char>(value >> (8 * i)));
+  }
+}
+
+static void AppendU64(std::string* out, uint64_t value) {
+  for (int i = 0; i < 8; ++i) {
+    out->push_back(static_cast<char>(value >> (8 * i)));
+  }
+}
+
+static bool SerializeExpr(const Expr* expr, std::string* out) {
+  if (expr->fn == Literal) {
+    AppendU8(out, kLiteralNode);
+  } else {
+    int op_index = -1;
+    for (size_t i = 0; i < sizeof(kOperatorTable) / sizeof(kOperatorTable[0]); ++i) {
+      if (kOperatorTable[i] == expr->fn) {
+        op_index = i;
+        break;
+      }
+    }
+    if (op_index != -1) {
+      AppendU8(out, kOperatorNode);
+      AppendU8(out, static_cast<uint8_t>(op_index));
+    } else if (FindFunction(expr->name) == expr->fn) {
+      AppendU8(out, kFunctionNode);
+    } else {
+      // The function can't be re-resolved by name in another process; don't cache this tree.
+      return false;
+    }
+  }
+  AppendU32(out, static_cast<uint32_t>(expr->start));
+  AppendU32(out, static_cast<uint32_t>(expr->end));
+  AppendU32(out, static_cast<uint32_t>(expr->name.size()));
+  out->append(expr->name);
+  AppendU32(out, static_cast<uint32_t>(expr->argv.size()));
+  for (const auto& arg : expr->argv) {
+    if (!SerializeExpr(arg.get(), out)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+namespace {
+
+// Bounds-checked read cursor over the serialized blob.
+struct Cursor {
+  const std::string& blob;
+  size_t pos = 0;
+
+  bool ReadU8(uint8_t* value) {
+    if (blob.size() - pos < 1) return false;
+    *value = static_cast<uint8_t>(blob[pos++]);
+    return true;
+  }
+
+  bool ReadU32(uint32_t* value) {
+    if (blob.size() - pos < 4) return false;
+    *value = 0;
+    for (int i = 0; i < 4; ++i) {
+      *value |= static_cast<uint32_t>(static_cast<uint8_t>(blob[pos++])) << (8 * i);
+    }
+    return true;
+  }
+
+  bool ReadU64(uint64_t* value) {
+    if (blob.size() - pos < 8) return false;
+    *value = 0;
+    for (int i = 0; i < 8; ++i) {
+      *value |= static_cast<uint64_t>(static_cast<uint8_t>(blob[pos++])) << (8 * i);
+    }
+    return true;
+  }
+
+  bool ReadString(size_t length, std::string* value) {
+    if (blob.size() - pos < length) return false;
+    value->assign(blob, pos, length);
+    pos += length;
+    return true;
+  }
+};
+
+}  // namespace
+
+static std::unique_ptr<Expr> DeserializeExpr(Cursor* cursor, int depth) {
+  if (depth > kMaxTreeDepth) {
+    return nullptr;
+  }
+
+  uint8_t kind;
+  if (!cursor->ReadU8(&kind)) {
+    return nullptr;
+  }
+  uint8_t op_index = 0;
+  if (kind == kOperatorNode && !cursor->ReadU8(&op_index)) {
+    return nullptr;
+  }
+  uint32_t start;
+  uint32_t end;
+  uint32_t name_length;
+  std::string name;
+  if (!cursor->ReadU32(&start) || !cursor->ReadU32(&end) || !cursor->ReadU32(&name_length) ||
+      !cursor->ReadString(name_length, &name)) {
+    return nullptr;
+  }
+
+  Function fn = nullptr;
+  switch (kind) {
+    case kLiteralNode:
+      fn = Literal;
+      break;
+    case kOperatorNode:
+      if (op_index >= sizeof(kOperatorTable) / sizeof(kOperatorTable[0])) {
+        return nullptr;
+      }
+      fn = kOperatorTable[op_index];
+      break;
+    case kFunctionNode:
+      fn = FindFunction(name);
+      break;
+    default:
+      return nullptr;
+  }
+  if (fn == nullptr) {
+    return nullptr;
+  }
+
+  uint32_t argc;
+  if (!cursor->ReadU32(&argc)) {
+    return nullptr;
+  }
+  // Each serialized node takes at least 17 bytes; reject counts the blob can't possibly hold.
+  if (argc > (cursor->blob.size() - cursor->pos) / 17) {
+    return nullptr;
+  }
+
+  auto expr = std::make_unique<Expr>(fn, name, static_cast<int>(start), static_cast<int>(end));
+  expr->argv.reserve(argc);
+  for (uint32_t i = 0; i < argc; ++i) {
+    std::unique_ptr<Expr> arg = DeserializeExpr(cursor, depth + 1);
+    if (!arg) {
+      return nullptr;
+    }
+    expr->argv.push_back(std::move(arg));
+  }
+  return expr;
+}
+
+bool SaveCompiledScript(const std::string& script, const Expr* root, const std::string& path) {
+  std::string blob;
+  AppendU32(&blob, kCompiledScriptMagic);
+  AppendU32(&blob, kCompiledScriptVersion);
+  AppendU64(&blob, script.size());
+  AppendU64(&blob, HashScriptText(script));
+  if (!SerializeExpr(root, &blob)) {
+    return false;
+  }
+  return android::base::WriteStringToFile(blob, path);
+}
+
+std::unique_ptr<Expr> LoadCompiledScript(const std::string& script, const std::string& path) {
+  std::string blob;
+  if (!android::base::ReadFileToString(path, &blob)) {
+    return nullptr;
+  }
+
+  Cursor cursor{ blob };
+  uint32_t magic;
+  uint32_t version;
+  uint64_t script_size;
+  uint64_t script_hash;
+  if (!cursor.ReadU32(&magic) || !cursor.ReadU32(&version) || !cursor.ReadU64(&script_size) ||
+      !cursor.ReadU64(&script_hash)) {
+    return nullptr;
+  }
+  if (magic != kCompiledScriptMagic || version != kCompiledScriptVersion ||
+      script_size != script.size() || script_hash != HashScriptText(script)) {
+    return nullptr;
+  }
+
+  std::unique_ptr<Expr> root = DeserializeExpr(&cursor, 0);
+  if (!root || cursor.pos != blob.size()) {
+    return nullptr;
+  }
+  return root;
+}
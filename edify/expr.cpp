@@ -22,9 +22,11 @@
 #include <string.h>
 #include <unistd.h>
 
+#include <future>
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include <android-base/parseint.h>
@@ -56,7 +58,7 @@ bool Evaluate(State* state, const std::unique_ptr<Expr>& expr, std::string* resu
       return false;
     }
 
-    *result = v->data;
+    *result = std::move(v->data);
     return true;
 }
 
@@ -71,8 +73,8 @@ Value* StringValue(const char* str) {
     return new Value(Value::Type::STRING, str);
 }
 
-Value* StringValue(const std::string& str) {
-    return StringValue(str.c_str());
+Value* StringValue(std::string str) {
+    return new Value(Value::Type::STRING, std::move(str));
 }
 
 Value* ConcatFn(const char* name, State* state, const std::vector<std::unique_ptr<Expr>>& argv) {
@@ -88,7 +90,7 @@ Value* ConcatFn(const char* name, State* state, const std::vector<std::unique_pt
         result += str;
     }
 
-    return StringValue(result);
+    return StringValue(std::move(result));
 }
 
 Value* IfElseFn(const char* name, State* state, const std::vector<std::unique_ptr<Expr>>& argv) {
@@ -307,6 +309,58 @@ Value* GreaterThanIntFn(const char* name, State* state,
     return StringValue(l_int > r_int ? "t" : "");
 }
 
+Value* ParallelFn(const char* name, State* state, const std::vector<std::unique_ptr<Expr>>& argv) {
+    if (argv.empty()) {
+        return StringValue("");
+    }
+    // A single argument has nothing to overlap with; evaluate it in place so it keeps the
+    // caller's State and any abort message lands there directly.
+    if (argv.size() == 1) {
+        return EvaluateValue(state, argv[0]);
+    }
+
+    // Each argument evaluates on its own thread against its own State, so an abort in one branch
+    // can't race the others' error reporting. The script author is responsible for the branches
+    // actually being independent — two branches must not touch the same partition or stash.
+    struct Branch {
+        State state;
+        std::unique_ptr<Value> result;
+        Branch(const std::string& script, UpdaterInterface* updater) : state(script, updater) {}
+    };
+    std::vector<Branch> branches;
+    branches.reserve(argv.size());
+    for (size_t i = 0; i < argv.size(); ++i) {
+        branches.emplace_back(state->script, state->updater);
+        branches.back().state.is_retry = state->is_retry;
+    }
+
+    std::vector<std::future<void>> workers;
+    for (size_t i = 0; i < argv.size(); ++i) {
+        workers.emplace_back(std::async(std::launch::async, [&argv, &branches, i]() {
+            branches[i].result.reset(EvaluateValue(&branches[i].state, argv[i]));
+        }));
+    }
+    for (auto& worker : workers) {
+        worker.wait();
+    }
+
+    // Join in argument order: the first failed branch wins, and its error context is copied back
+    // so the abort report looks the same as it would have under sequential evaluation.
+    std::string joined;
+    for (auto& branch : branches) {
+        if (!branch.result) {
+            state->errmsg = branch.state.errmsg;
+            state->error_code = branch.state.error_code;
+            state->cause_code = branch.state.cause_code;
+            return nullptr;
+        }
+        if (branch.result->type == Value::Type::STRING) {
+            joined += branch.result->data;
+        }
+    }
+    return StringValue(std::move(joined));
+}
+
 Value* Literal(const char* name, State* state, const std::vector<std::unique_ptr<Expr>>& argv) {
     return StringValue(name);
 }
@@ -317,16 +371,67 @@ Value* Literal(const char* name, State* state, const std::vector<std::unique_ptr
 
 static std::unordered_map<std::string, Function> fn_table;
 
+// The underlying implementations of functions registered as pure, dispatched to via
+// MemoizedCallFn().
+static std::unordered_map<std::string, Function> pure_fn_table;
+
 void RegisterFunction(const std::string& name, Function fn) {
+    if (fn_table.empty()) {
+        // The builtins plus the updater functions add up to around 50 entries; reserving up front
+        // avoids rehashing while the modules register themselves.
+        fn_table.reserve(64);
+    }
     fn_table[name] = fn;
 }
 
-Function FindFunction(const std::string& name) {
-    if (fn_table.find(name) == fn_table.end()) {
+// Dispatcher for pure functions: evaluates the arguments once, then serves repeated calls with
+// the same argument values from State::memoized_results instead of re-running the
+// implementation (and its property fetches or file reads).
+static Value* MemoizedCallFn(const char* name, State* state,
+                             const std::vector<std::unique_ptr<Expr>>& argv) {
+    Function fn = pure_fn_table[name];
+
+    std::vector<std::string> args;
+    if (!ReadArgs(state, argv, &args)) {
         return nullptr;
-    } else {
-        return fn_table[name];
     }
+
+    // Join with 0x1f (unit separator) so ("ab", "c") and ("a", "bc") get distinct keys.
+    std::string key = name;
+    for (const auto& arg : args) {
+        key += '\x1f';
+        key += arg;
+    }
+    if (auto cached = state->memoized_results.find(key); cached != state->memoized_results.end()) {
+        return StringValue(cached->second);
+    }
+
+    // Hand the already-evaluated arguments to the implementation as literals, so the original
+    // argument expressions aren't evaluated a second time.
+    std::vector<std::unique_ptr<Expr>> literal_argv;
+    literal_argv.reserve(args.size());
+    for (const auto& arg : args) {
+        literal_argv.emplace_back(std::make_unique<Expr>(Literal, arg, 0, 0));
+    }
+
+    std::unique_ptr<Value> result(fn(name, state, literal_argv));
+    if (!result) {
+        return nullptr;
+    }
+    if (result->type == Value::Type::STRING) {
+        state->memoized_results.emplace(key, result->data);
+    }
+    return result.release();
+}
+
+void RegisterPureFunction(const std::string& name, Function fn) {
+    pure_fn_table[name] = fn;
+    RegisterFunction(name, MemoizedCallFn);
+}
+
+Function FindFunction(const std::string& name) {
+    auto it = fn_table.find(name);
+    return (it != fn_table.end()) ? it->second : nullptr;
 }
 
 void RegisterBuiltins() {
@@ -337,6 +442,7 @@ void RegisterBuiltins() {
     RegisterFunction("is_substring", SubstringFn);
     RegisterFunction("stdout", StdoutFn);
     RegisterFunction("sleep", SleepFn);
+    RegisterFunction("parallel", ParallelFn);
 
     RegisterFunction("less_than_int", LessThanIntFn);
     RegisterFunction("greater_than_int", GreaterThanIntFn);
@@ -21,6 +21,7 @@
 
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "edify/updater_interface.h"
@@ -52,6 +53,11 @@ struct State {
   CauseCode cause_code;
 
   bool is_retry = false;
+
+  // Results of functions registered with RegisterPureFunction(), keyed by function name and
+  // evaluated arguments. Scoped to one evaluation, so each parallel() branch (which gets its own
+  // State) keeps a private table and no locking is needed.
+  std::unordered_map<std::string, std::string> memoized_results;
 };
 
 struct Value {
@@ -111,16 +117,29 @@ Value* SequenceFn(const char* name, State* state, const std::vector<std::unique_
 Value* IfElseFn(const char* name, State* state, const std::vector<std::unique_ptr<Expr>>& argv);
 Value* AssertFn(const char* name, State* state, const std::vector<std::unique_ptr<Expr>>& argv);
 Value* AbortFn(const char* name, State* state, const std::vector<std::unique_ptr<Expr>>& argv);
+// Evaluates each argument expression on its own worker thread with an isolated error context,
+// then joins the string results in argument order. On failure the first failed argument's error
+// context is propagated. The argument expressions must be independent of each other.
+Value* ParallelFn(const char* name, State* state, const std::vector<std::unique_ptr<Expr>>& argv);
 
 // Register a new function.  The same Function may be registered under
 // multiple names, but a given name should only be used once.
 void RegisterFunction(const std::string& name, Function fn);
 
+// Registers a pure function: one whose result depends only on its (string) argument values, with
+// no side effects worth repeating. Calls are dispatched through a memoizing wrapper that
+// evaluates the arguments once, serves repeated calls from State::memoized_results, and passes
+// the evaluated arguments to |fn| as literals. Only functions that take string arguments and
+// return a string qualify.
+void RegisterPureFunction(const std::string& name, Function fn);
+
 // Register all the builtins.
 void RegisterBuiltins();
 
 // Find the Function for a given name; return NULL if no such function
-// exists.
+// exists. The parser calls this once per call site when the script is
+// parsed and stores the result in the Expr node, so evaluation never
+// looks names up again.
 Function FindFunction(const std::string& name);
 
 // --- convenience functions for use in functions ---
@@ -152,8 +171,16 @@ Value* ErrorAbort(State* state, CauseCode cause_code, const char* format, ...)
 // Copying the string into a Value.
 Value* StringValue(const char* str);
 
-Value* StringValue(const std::string& str);
+Value* StringValue(std::string str);
 
 int ParseString(const std::string& str, std::unique_ptr<Expr>* root, int* error_count);
 
+// Optional compiled-script cache (compiled_script.cpp). SaveCompiledScript() serializes a parsed
+// Expr tree to |path|, keyed by a hash of the script text; LoadCompiledScript() returns the
+// deserialized tree if the cache on disk matches |script|, or nullptr if it is missing, stale or
+// corrupt. Call sites are stored by function name and re-resolved against the registry on load,
+// so the loading process must have registered the same functions as the saving one.
+bool SaveCompiledScript(const std::string& script, const Expr* root, const std::string& path);
+std::unique_ptr<Expr> LoadCompiledScript(const std::string& script, const std::string& path);
+
 #endif  // _EXPRESSION_H
@@ -24,6 +24,7 @@
 struct ZipArchive;
 typedef ZipArchive* ZipArchiveHandle;
 
+class MemMapping;
 class UpdaterRuntimeInterface;
 
 class UpdaterInterface {
@@ -45,4 +46,8 @@ class UpdaterInterface {
   virtual std::string GetResult() const = 0;
   virtual uint8_t* GetMappedPackageAddress() const = 0;
   virtual size_t GetMappedPackageLength() const = 0;
+
+  // Returns the mapping of the package, so consumers can issue access-pattern hints for the
+  // windows they are about to touch (see MemMapping::Advise). May return nullptr.
+  virtual const MemMapping* GetMappedPackage() const = 0;
 };
@@ -0,0 +1,442 @@
+/*
+ * Copyright (C) 2009 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Hand-written recursive-descent front end, replacing the old flex/bison one. The lexer walks
+// the script in place and only materializes a heap string per token when it becomes an Expr
+// name; the generated scanner copied every token. Grammar, operator precedence, node locations
+// and the skip-to-next-';' error recovery all match the old lexer.ll/parser.yy.
+
+#include <ctype.h>
+#include <stdio.h>
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "edify/expr.h"
+
+namespace {
+
+enum class TokenKind {
+  kEof,
+  kString,
+  kIf,
+  kThen,
+  kElse,
+  kEndif,
+  kAnd,     // &&
+  kOr,      // ||
+  kEq,      // ==
+  kNe,      // !=
+  kPlus,    // +
+  kNot,     // !
+  kLParen,  // (
+  kRParen,  // )
+  kComma,   // ,
+  kSemi,    // ;
+  kBad,
+};
+
+struct Token {
+  TokenKind kind = TokenKind::kEof;
+  std::string text;  // decoded text of a kString token
+  int start = 0;     // offset of the token's first character in the script
+  int end = 0;       // offset one past its last character
+};
+
+static bool IsWordChar(char c) {
+  return isalnum(static_cast<unsigned char>(c)) || c == '_' || c == ':' || c == '/' || c == '.';
+}
+
+static int HexValue(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+class Parser {
+ public:
+  Parser(std::string_view input, int* error_count) : input_(input), error_count_(error_count) {
+    Advance();
+  }
+
+  // Parses the whole script. Returns nullptr if the input can't be reduced to one expression,
+  // mirroring the old parser's overall success/failure; recovered errors only bump the count.
+  std::unique_ptr<Expr> ParseScript() {
+    std::unique_ptr<Expr> e = ParseExpr();
+    while (e && cur_.kind != TokenKind::kEof) {
+      Error("syntax error");
+      if (!SkipToSemicolon()) return nullptr;
+      // Equivalent of the old "error ';' expr" rule: the expression after the next ';'
+      // replaces the failed parse.
+      e = ParseExpr();
+    }
+    return e;
+  }
+
+ private:
+  // expr ';' expr — the sequence operator, lowest precedence; a trailing ';' is allowed.
+  std::unique_ptr<Expr> ParseExpr() {
+    std::unique_ptr<Expr> left = ParseOr();
+    if (!left) {
+      if (!SkipToSemicolon()) return nullptr;
+      return ParseExpr();
+    }
+    while (cur_.kind == TokenKind::kSemi) {
+      Advance();
+      if (!StartsExpr()) break;
+      std::unique_ptr<Expr> right = ParseOr();
+      if (!right) {
+        if (!SkipToSemicolon()) return nullptr;
+        right = ParseExpr();
+        if (!right) return nullptr;
+        return MakeBinary(SequenceFn, std::move(left), std::move(right));
+      }
+      left = MakeBinary(SequenceFn, std::move(left), std::move(right));
+    }
+    return left;
+  }
+
+  std::unique_ptr<Expr> ParseOr() {
+    std::unique_ptr<Expr> left = ParseAnd();
+    while (left && cur_.kind == TokenKind::kOr) {
+      Advance();
+      std::unique_ptr<Expr> right = ParseAnd();
+      if (!right) return nullptr;
+      left = MakeBinary(LogicalOrFn, std::move(left), std::move(right));
+    }
+    return left;
+  }
+
+  std::unique_ptr<Expr> ParseAnd() {
+    std::unique_ptr<Expr> left = ParseEquality();
+    while (left && cur_.kind == TokenKind::kAnd) {
+      Advance();
+      std::unique_ptr<Expr> right = ParseEquality();
+      if (!right) return nullptr;
+      left = MakeBinary(LogicalAndFn, std::move(left), std::move(right));
+    }
+    return left;
+  }
+
+  std::unique_ptr<Expr> ParseEquality() {
+    std::unique_ptr<Expr> left = ParseConcat();
+    while (left && (cur_.kind == TokenKind::kEq || cur_.kind == TokenKind::kNe)) {
+      Function fn = (cur_.kind == TokenKind::kEq) ? EqualityFn : InequalityFn;
+      Advance();
+      std::unique_ptr<Expr> right = ParseConcat();
+      if (!right) return nullptr;
+      left = MakeBinary(fn, std::move(left), std::move(right));
+    }
+    return left;
+  }
+
+  std::unique_ptr<Expr> ParseConcat() {
+    std::unique_ptr<Expr> left = ParseUnary();
+    while (left && cur_.kind == TokenKind::kPlus) {
+      Advance();
+      std::unique_ptr<Expr> right = ParseUnary();
+      if (!right) return nullptr;
+      left = MakeBinary(ConcatFn, std::move(left), std::move(right));
+    }
+    return left;
+  }
+
+  std::unique_ptr<Expr> ParseUnary() {
+    if (cur_.kind != TokenKind::kNot) {
+      return ParsePrimary();
+    }
+    int start = cur_.start;
+    Advance();
+    std::unique_ptr<Expr> operand = ParseUnary();
+    if (!operand) return nullptr;
+    auto e = std::make_unique<Expr>(LogicalNotFn, "(operator)", start, operand->end);
+    e->argv.emplace_back(std::move(operand));
+    return e;
+  }
+
+  std::unique_ptr<Expr> ParsePrimary() {
+    switch (cur_.kind) {
+      case TokenKind::kString: {
+        Token name = std::move(cur_);
+        Advance();
+        if (cur_.kind == TokenKind::kLParen) {
+          return ParseCall(std::move(name));
+        }
+        return std::make_unique<Expr>(Literal, name.text, name.start, name.end);
+      }
+
+      case TokenKind::kLParen: {
+        int start = cur_.start;
+        Advance();
+        std::unique_ptr<Expr> e = ParseExpr();
+        if (!e) return nullptr;
+        if (cur_.kind != TokenKind::kRParen) {
+          Error("syntax error, expected ')'");
+          return nullptr;
+        }
+        // A parenthesized expression keeps its node but takes the parens' span.
+        e->start = start;
+        e->end = cur_.end;
+        Advance();
+        return e;
+      }
+
+      case TokenKind::kIf: {
+        int start = cur_.start;
+        Advance();
+        std::unique_ptr<Expr> cond = ParseExpr();
+        if (!cond) return nullptr;
+        if (cur_.kind != TokenKind::kThen) {
+          Error("syntax error, expected 'then'");
+          return nullptr;
+        }
+        Advance();
+        std::unique_ptr<Expr> then_expr = ParseExpr();
+        if (!then_expr) return nullptr;
+        std::unique_ptr<Expr> else_expr;
+        if (cur_.kind == TokenKind::kElse) {
+          Advance();
+          else_expr = ParseExpr();
+          if (!else_expr) return nullptr;
+        }
+        if (cur_.kind != TokenKind::kEndif) {
+          Error("syntax error, expected 'endif'");
+          return nullptr;
+        }
+        auto e = std::make_unique<Expr>(IfElseFn, "(operator)", start, cur_.end);
+        Advance();
+        e->argv.emplace_back(std::move(cond));
+        e->argv.emplace_back(std::move(then_expr));
+        if (else_expr) {
+          e->argv.emplace_back(std::move(else_expr));
+        }
+        return e;
+      }
+
+      default:
+        Error("syntax error");
+        return nullptr;
+    }
+  }
+
+  // STRING '(' arglist ')' — cur_ is the '('.
+  std::unique_ptr<Expr> ParseCall(Token name) {
+    Advance();
+    std::vector<std::unique_ptr<Expr>> args;
+    if (cur_.kind != TokenKind::kRParen) {
+      while (true) {
+        std::unique_ptr<Expr> arg = ParseExpr();
+        if (!arg) return nullptr;
+        args.emplace_back(std::move(arg));
+        if (cur_.kind != TokenKind::kComma) break;
+        Advance();
+      }
+      if (cur_.kind != TokenKind::kRParen) {
+        Error("syntax error, expected ')'");
+        return nullptr;
+      }
+    }
+    int end = cur_.end;
+    Advance();
+
+    Function fn = FindFunction(name.text);
+    if (fn == nullptr) {
+      Error("unknown function \"" + name.text + "\"");
+      return nullptr;
+    }
+    auto e = std::make_unique<Expr>(fn, name.text, name.start, end);
+    e->argv = std::move(args);
+    return e;
+  }
+
+  static std::unique_ptr<Expr> MakeBinary(Function fn, std::unique_ptr<Expr> left,
+                                          std::unique_ptr<Expr> right) {
+    auto e = std::make_unique<Expr>(fn, "(operator)", left->start, right->end);
+    e->argv.emplace_back(std::move(left));
+    e->argv.emplace_back(std::move(right));
+    return e;
+  }
+
+  bool StartsExpr() const {
+    return cur_.kind == TokenKind::kString || cur_.kind == TokenKind::kLParen ||
+           cur_.kind == TokenKind::kNot || cur_.kind == TokenKind::kIf;
+  }
+
+  // Consumes tokens up to and including the next ';'. Returns false on end of input.
+  bool SkipToSemicolon() {
+    while (cur_.kind != TokenKind::kSemi) {
+      if (cur_.kind == TokenKind::kEof) return false;
+      Advance();
+    }
+    Advance();
+    return true;
+  }
+
+  void Error(const std::string& msg) {
+    printf("line %d col %d: %s\n", line_, column_, msg.c_str());
+    ++*error_count_;
+  }
+
+  // Lexes the next token into cur_, skipping whitespace and #-comments.
+  void Advance() {
+    while (pos_ < input_.size()) {
+      char c = input_[pos_];
+      if (c == ' ' || c == '\t') {
+        ++pos_;
+        ++column_;
+      } else if (c == '\n') {
+        ++pos_;
+        ++line_;
+        column_ = 1;
+      } else if (c == '#') {
+        while (pos_ < input_.size() && input_[pos_] != '\n') ++pos_;
+      } else {
+        break;
+      }
+    }
+
+    cur_ = Token();
+    cur_.start = static_cast<int>(pos_);
+    if (pos_ >= input_.size()) {
+      cur_.end = cur_.start;
+      return;
+    }
+
+    char c = input_[pos_];
+    if (c == '"') {
+      LexQuotedString();
+      return;
+    }
+    if (IsWordChar(c)) {
+      size_t start = pos_;
+      while (pos_ < input_.size() && IsWordChar(input_[pos_])) ++pos_;
+      std::string_view word = input_.substr(start, pos_ - start);
+      column_ += static_cast<int>(word.size());
+      cur_.end = static_cast<int>(pos_);
+      if (word == "if") {
+        cur_.kind = TokenKind::kIf;
+      } else if (word == "then") {
+        cur_.kind = TokenKind::kThen;
+      } else if (word == "else") {
+        cur_.kind = TokenKind::kElse;
+      } else if (word == "endif") {
+        cur_.kind = TokenKind::kEndif;
+      } else {
+        cur_.kind = TokenKind::kString;
+        cur_.text = std::string(word);
+      }
+      return;
+    }
+
+    auto two_char = [this](TokenKind kind) {
+      cur_.kind = kind;
+      pos_ += 2;
+      column_ += 2;
+      cur_.end = static_cast<int>(pos_);
+    };
+    if (pos_ + 1 < input_.size()) {
+      std::string_view op = input_.substr(pos_, 2);
+      if (op == "&&") return two_char(TokenKind::kAnd);
+      if (op == "||") return two_char(TokenKind::kOr);
+      if (op == "==") return two_char(TokenKind::kEq);
+      if (op == "!=") return two_char(TokenKind::kNe);
+    }
+
+    switch (c) {
+      case '+': cur_.kind = TokenKind::kPlus; break;
+      case '!': cur_.kind = TokenKind::kNot; break;
+      case '(': cur_.kind = TokenKind::kLParen; break;
+      case ')': cur_.kind = TokenKind::kRParen; break;
+      case ',': cur_.kind = TokenKind::kComma; break;
+      case ';': cur_.kind = TokenKind::kSemi; break;
+      default: cur_.kind = TokenKind::kBad; break;
+    }
+    ++pos_;
+    ++column_;
+    cur_.end = static_cast<int>(pos_);
+  }
+
+  // Lexes a quoted string with the \n, \t, \", \\ and \xHH escapes; an unrecognized escape
+  // keeps the backslash literally, and an unterminated string becomes a bad token.
+  void LexQuotedString() {
+    ++pos_;
+    ++column_;
+    std::string out;
+    while (pos_ < input_.size()) {
+      char c = input_[pos_];
+      if (c == '"') {
+        ++pos_;
+        ++column_;
+        cur_.kind = TokenKind::kString;
+        cur_.text = std::move(out);
+        cur_.end = static_cast<int>(pos_);
+        return;
+      }
+      if (c == '\n') {
+        ++pos_;
+        ++line_;
+        column_ = 1;
+        out.push_back('\n');
+        continue;
+      }
+      if (c == '\\' && pos_ + 1 < input_.size()) {
+        char esc = input_[pos_ + 1];
+        if (esc == 'n' || esc == 't' || esc == '"' || esc == '\\') {
+          out.push_back(esc == 'n' ? '\n' : esc == 't' ? '\t' : esc);
+          pos_ += 2;
+          column_ += 2;
+          continue;
+        }
+        if (esc == 'x' && pos_ + 3 < input_.size() && HexValue(input_[pos_ + 2]) != -1 &&
+            HexValue(input_[pos_ + 3]) != -1) {
+          out.push_back(
+              static_cast<char>(HexValue(input_[pos_ + 2]) * 16 + HexValue(input_[pos_ + 3])));
+          pos_ += 4;
+          column_ += 4;
+          continue;
+        }
+      }
+      out.push_back(c);
+      ++pos_;
+      ++column_;
+    }
+    cur_.kind = TokenKind::kBad;
+    cur_.end = static_cast<int>(pos_);
+  }
+
+  std::string_view input_;
+  size_t pos_ = 0;
+  int line_ = 1;
+  int column_ = 1;
+  Token cur_;
+  int* error_count_;
+};
+
+}  // namespace
+
+int ParseString(const std::string& str, std::unique_ptr<Expr>* root, int* error_count) {
+  Parser parser(str, error_count);
+  std::unique_ptr<Expr> e = parser.ParseScript();
+  if (!e) {
+    return 1;
+  }
+  *root = std::move(e);
+  return 0;
+}
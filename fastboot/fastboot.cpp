@@ -72,6 +72,11 @@ void FillWearableFastbootLines(std::vector<std::string>& title_lines) {
   title_lines.push_back("Serial #: " + android::base::GetProperty("ro.serialno", ""));
 }
 
+// Presents the fastbootd menu. Note that recovery only owns this UI: the fastboot protocol
+// engine — USB download buffering, sparse image handling and the partition writes — is
+// fastbootd itself (system/core/fastboot/device), which init starts alongside us when the
+// device boots with androidboot.force_normal_boot unset and the fastbootd flag. Any change to
+// how downloads overlap with flash writes belongs in that daemon, not here.
 Device::BuiltinAction StartFastboot(Device* device, const std::vector<std::string>& /* args */) {
   RecoveryUI* ui = device->GetUI();
   std::vector<std::string> title_lines;
@@ -45,6 +45,7 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <inttypes.h>
 #include <limits.h>  // PATH_MAX
 #include <linux/fuse.h>
 #include <stdint.h>
@@ -58,13 +59,21 @@
 #include <unistd.h>
 
 #include <array>
+#include <condition_variable>
+#include <future>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 
 #include <android-base/stringprintf.h>
 #include <android-base/unique_fd.h>
 #include <openssl/sha.h>
 
+#include "otautil/trace.h"
+
 static constexpr uint64_t PACKAGE_FILE_ID = FUSE_ROOT_ID + 1;
 static constexpr uint64_t EXIT_FLAG_ID = FUSE_ROOT_ID + 2;
 
@@ -75,6 +84,13 @@ using SHA256Digest = std::array<uint8_t, SHA256_DIGEST_LENGTH>;
 
 #define INSTALL_REQUIRED_MEMORY (400 * 1024 * 1024)
 
+// How far ahead of the reader the prefetch thread is allowed to fetch. The updater consumes the
+// package almost entirely sequentially, so this lets USB transfer and hashing overlap FUSE reads.
+static constexpr uint32_t READAHEAD_BLOCKS = 16;
+
+// Upper bound on the buffer used for one batched readahead fetch.
+static constexpr uint32_t READAHEAD_BATCH_BYTES = 2 * 1024 * 1024;
+
 struct fuse_data {
   android::base::unique_fd ffd;  // file descriptor for the fuse socket
 
@@ -90,6 +106,11 @@ struct fuse_data {
 
   uint32_t curr_block;  // cache the block most recently used
   uint8_t* block_data;
+  // Bytes of curr_block as handed to writev(): either block_data or the block's cache entry.
+  // Cache hits serve straight out of the cache instead of being copied into block_data first;
+  // the eviction policy never frees curr_block's entry, so the pointer stays valid until the
+  // next fetch.
+  uint8_t* curr_block_data;
 
   uint8_t* extra_block;  // another block of storage for reads that span two blocks
 
@@ -100,6 +121,24 @@ struct fuse_data {
   uint32_t block_cache_max_size;  // Max allowed block cache size
   uint32_t block_cache_size;      // Current block cache size
   uint8_t** block_cache;          // Block cache data
+
+  // Readahead state. When the block cache is enabled, the prefetch thread is the only caller into
+  // the provider: the FUSE loop posts a demand for the block it's stalled on and waits for it to
+  // land in the cache, and while no demand is pending the thread reads ahead of the reader. The
+  // provider protocol allows one outstanding request, so all fetches stay serialized. The mutex
+  // guards the cache, the hashes, curr_block and the fields below.
+  std::thread prefetch_thread;
+  std::mutex mutex;
+  std::condition_variable cond;  // signalled for new demands and for completed fetches
+  uint32_t demand_block;         // block the reader is waiting on, or -1 if none
+  int demand_status;             // 1 while pending, 0 on success, negative errno on failure
+  uint32_t readahead_next;       // next block the prefetch thread will fetch
+  uint32_t readahead_limit;      // exclusive end of the current readahead window
+  bool prefetch_error;           // provider failed; stop reading ahead
+  bool prefetch_exit;            // tells the prefetch thread to quit
+
+  bool trusted_source;              // re-reads from the provider can't change; hash blocks once
+  uint64_t verifications_avoided;   // re-fetched blocks whose hash check was skipped
 };
 
 static uint64_t free_memory() {
@@ -136,16 +175,17 @@ static int block_cache_fetch(struct fuse_data* fd, uint32_t block) {
   if (fd->block_cache[block] == nullptr) {
     return -1;
   }
-  memcpy(fd->block_data, fd->block_cache[block], fd->block_size);
+  fd->curr_block_data = fd->block_cache[block];
   return 0;
 }
 
-static void block_cache_enter(struct fuse_data* fd, uint32_t block) {
+static void block_cache_enter(struct fuse_data* fd, uint32_t block, const uint8_t* data) {
   if (!fd->block_cache) return;
   if (fd->block_cache_size == fd->block_cache_max_size) {
     // Evict a block from the cache.  Since the file is typically read
     // sequentially, start looking from the block behind the current
-    // block and proceed backward.
+    // block and proceed backward.  The loop can't land on curr_block itself,
+    // which also keeps the entry a read reply may still be serving alive.
     int n;
     for (n = fd->curr_block - 1; n != (int)fd->curr_block; --n) {
       if (n < 0) {
@@ -161,7 +201,7 @@ static void block_cache_enter(struct fuse_data* fd, uint32_t block) {
   }
 
   fd->block_cache[block] = (uint8_t*)malloc(fd->block_size);
-  memcpy(fd->block_cache[block], fd->block_data, fd->block_size);
+  memcpy(fd->block_cache[block], data, fd->block_size);
 
   fd->block_cache_size++;
 }
@@ -282,6 +322,10 @@ static int handle_open(void* /* data */, const fuse_data* fd, const fuse_in_head
 
   fuse_open_out out = {};
   out.fh = 10;  // an arbitrary number; we always use the same handle
+  // Every served block has already passed its SHA check, so let the kernel keep the pages
+  // across opens; a verify-then-write pair of passes over the package hits the page cache
+  // instead of going back over USB.
+  out.open_flags = FOPEN_KEEP_CACHE;
   fuse_reply(fd, hdr->unique, &out, sizeof(out));
   return NO_STATUS;
 }
@@ -294,66 +338,206 @@ static int handle_release(void* /* data */, fuse_data* /* fd */, const fuse_in_h
   return 0;
 }
 
-// Fetch a block from the host into fd->curr_block and fd->block_data.
-// Returns 0 on successful fetch, negative otherwise.
+// Reads one block from the host into |buffer|, padding the last (partial) block of the file with
+// zeroes. No locking; the provider belongs to the caller (the prefetch thread, or the FUSE loop
+// when the cache is disabled and no prefetch thread is running).
+static int read_block_from_host(fuse_data* fd, uint32_t block, uint8_t* buffer) {
+  uint32_t fetch_size = fd->block_size;
+  if (static_cast<uint64_t>(block) * fd->block_size + fetch_size > fd->file_size) {
+    // If we're reading the last (partial) block of the file, expect a shorter response from the
+    // host, and pad the rest of the block with zeroes.
+    fetch_size = fd->file_size - (static_cast<uint64_t>(block) * fd->block_size);
+    memset(buffer + fetch_size, 0, fd->block_size - fetch_size);
+  }
+
+  if (!fd->provider->ReadBlockAlignedData(buffer, fetch_size, block)) {
+    return -EIO;
+  }
+  return 0;
+}
+
+// Verify the hash of a block we just got from the host, and enter it into the cache.
+//
+// - If the hash of the just-received data matches the stored hash for the block, accept it.
+// - If the stored hash is all zeroes, store the new hash and accept the block (this is the first
+//   time we've read this block).
+// - Otherwise, return -EIO for the read.
+//
+// The caller must hold fd->mutex while the prefetch thread is running.
+static int verify_and_cache_block(fuse_data* fd, uint32_t block, const uint8_t* data) {
+  const SHA256Digest& blockhash = fd->hashes[block];
+  bool seen_before = false;
+  for (uint8_t i : blockhash) {
+    if (i != 0) {
+      seen_before = true;
+      break;
+    }
+  }
+
+  // A trusted (local, immutable) source can't return different data on a re-read, so a block only
+  // needs its hash computed the first time it's fetched. The updater reading the package twice
+  // (verify, then install) otherwise pays the full hash cost both times.
+  if (seen_before && fd->trusted_source) {
+    fd->verifications_avoided++;
+  } else {
+    SHA256Digest hash;
+    SHA256(data, fd->block_size, hash.data());
+    if (hash != blockhash) {
+      if (seen_before) {
+        return -EIO;
+      }
+      fd->hashes[block] = hash;
+    }
+  }
+
+  if (fd->block_cache && fd->block_cache[block] == nullptr) {
+    block_cache_enter(fd, block, data);
+  }
+  return 0;
+}
+
+// Runs on the prefetch thread. A block the reader is stalled on is served first; while no demand
+// is pending, the thread reads ahead of the reader until the window or the cache budget runs out,
+// so the host transfer and hashing of upcoming blocks overlap the reader's use of earlier ones.
+static void prefetch_loop(fuse_data* fd) {
+  // Readahead fetches are batched so providers with per-request latency can pipeline them; cap
+  // the batch buffer so large negotiated block sizes don't blow up memory.
+  uint32_t batch_max = MAX(1u, MIN(READAHEAD_BLOCKS, READAHEAD_BATCH_BYTES / fd->block_size));
+  std::vector<uint8_t> buffer(static_cast<size_t>(batch_max) * fd->block_size);
+  std::unique_lock<std::mutex> lock(fd->mutex);
+  while (!fd->prefetch_exit) {
+    uint32_t block;
+    uint32_t count = 1;
+    bool demand = (fd->demand_block != static_cast<uint32_t>(-1));
+    if (demand) {
+      block = fd->demand_block;
+    } else if (!fd->prefetch_error && fd->readahead_next < fd->readahead_limit &&
+               fd->block_cache_size + 1 < fd->block_cache_max_size) {
+      block = fd->readahead_next;
+      if (fd->block_cache[block] != nullptr) {
+        ++fd->readahead_next;
+        continue;
+      }
+      count = MIN(batch_max, fd->readahead_limit - block);
+      count = MIN(count, fd->block_cache_max_size - fd->block_cache_size - 1);
+      // Stop the batch at the first block that's already cached.
+      for (uint32_t i = 1; i < count; ++i) {
+        if (fd->block_cache[block + i] != nullptr) {
+          count = i;
+          break;
+        }
+      }
+    } else {
+      fd->cond.wait(lock);
+      continue;
+    }
+
+    lock.unlock();
+    uint64_t offset = static_cast<uint64_t>(block) * fd->block_size;
+    uint32_t span = count * fd->block_size;
+    uint32_t fetch_size = MIN(static_cast<uint64_t>(span), fd->file_size - offset);
+    if (fetch_size < span) {
+      // Pad the tail of the last (partial) block of the file with zeroes.
+      memset(buffer.data() + fetch_size, 0, span - fetch_size);
+    }
+    int result =
+        fd->provider->ReadBlocksAlignedData(buffer.data(), fetch_size, block, count) ? 0 : -EIO;
+    lock.lock();
+
+    for (uint32_t i = 0; result == 0 && i < count; ++i) {
+      result = verify_and_cache_block(fd, block + i,
+                                      buffer.data() + static_cast<size_t>(i) * fd->block_size);
+    }
+
+    if (demand && fd->demand_block == block) {
+      // The reader serves demand blocks straight from the cache entry; only fall back to a copy
+      // into block_data if the cache insert didn't take (e.g. allocation failure).
+      if (result == 0 && fd->block_cache[block] == nullptr) {
+        memcpy(fd->block_data, buffer.data(), fd->block_size);
+      }
+      fd->demand_block = -1;
+      fd->demand_status = result;
+      fd->cond.notify_all();
+    } else if (result == 0 && block == fd->readahead_next) {
+      fd->readahead_next += count;
+    }
+    if (result != 0) {
+      fd->prefetch_error = true;
+    }
+  }
+}
+
+// Makes |block| the current block, with its bytes available at fd->curr_block_data -- a cache
+// entry on a cache hit, fd->block_data otherwise. Returns 0 on successful fetch, negative
+// otherwise.
 static int fetch_block(fuse_data* fd, uint64_t block) {
   if (block == fd->curr_block) {
     return 0;
   }
 
+  std::unique_lock<std::mutex> lock(fd->mutex, std::defer_lock);
+  if (fd->prefetch_thread.joinable()) {
+    lock.lock();
+  }
+
   if (block >= fd->file_blocks) {
     memset(fd->block_data, 0, fd->block_size);
     fd->curr_block = block;
+    fd->curr_block_data = fd->block_data;
     return 0;
   }
 
-  if (block_cache_fetch(fd, block) == 0) {
+  if (lock.owns_lock()) {
+    // Keep the readahead window just ahead of the reader; a seek outside the window snaps it back
+    // to the blocks following the one being read.
+    fd->readahead_limit = MIN(block + 1 + READAHEAD_BLOCKS, fd->file_blocks);
+    if (block + 1 > fd->readahead_next || fd->readahead_next > fd->readahead_limit) {
+      fd->readahead_next = block + 1;
+    }
+
+    if (block_cache_fetch(fd, block) == 0) {
+      fd->curr_block = block;
+      // The window moved; wake the prefetch thread in case it had gone idle.
+      fd->cond.notify_all();
+      return 0;
+    }
+
+    fd->demand_block = block;
+    fd->demand_status = 1;
+    fd->cond.notify_all();
+    fd->cond.wait(lock, [fd] { return fd->demand_status <= 0; });
+    if (fd->demand_status != 0) {
+      fd->curr_block = -1;
+      return fd->demand_status;
+    }
     fd->curr_block = block;
+    // The demand fetch normally lands in the cache; the prefetch thread only falls back to
+    // block_data when the cache insert failed.
+    fd->curr_block_data = fd->block_cache[block] != nullptr ? fd->block_cache[block]
+                                                            : fd->block_data;
     return 0;
   }
 
-  uint32_t fetch_size = fd->block_size;
-  if (block * fd->block_size + fetch_size > fd->file_size) {
-    // If we're reading the last (partial) block of the file, expect a shorter response from the
-    // host, and pad the rest of the block with zeroes.
-    fetch_size = fd->file_size - (block * fd->block_size);
-    memset(fd->block_data + fetch_size, 0, fd->block_size - fetch_size);
+  if (block_cache_fetch(fd, block) == 0) {
+    fd->curr_block = block;
+    return 0;
   }
 
-  if (!fd->provider->ReadBlockAlignedData(fd->block_data, fetch_size, block)) {
-    return -EIO;
+  int result = read_block_from_host(fd, block, fd->block_data);
+  if (result != 0) {
+    return result;
   }
 
   fd->curr_block = block;
-
-  // Verify the hash of the block we just got from the host.
-  //
-  // - If the hash of the just-received data matches the stored hash for the block, accept it.
-  // - If the stored hash is all zeroes, store the new hash and accept the block (this is the first
-  //   time we've read this block).
-  // - Otherwise, return -EINVAL for the read.
-
-  SHA256Digest hash;
-  SHA256(fd->block_data, fd->block_size, hash.data());
-
-  const SHA256Digest& blockhash = fd->hashes[block];
-  if (hash == blockhash) {
-    return 0;
+  fd->curr_block_data = fd->block_data;
+  if ((result = verify_and_cache_block(fd, block, fd->block_data)) != 0) {
+    fd->curr_block = -1;
   }
-
-  for (uint8_t i : blockhash) {
-    if (i != 0) {
-      fd->curr_block = -1;
-      return -EIO;
-    }
-  }
-
-  fd->hashes[block] = hash;
-  block_cache_enter(fd, block);
-  return 0;
+  return result;
 }
 
 static int handle_read(void* data, fuse_data* fd, const fuse_in_header* hdr) {
+  ScopedTrace trace("fuse_read");
   if (hdr->nodeid != PACKAGE_FILE_ID) return -ENOENT;
 
   const fuse_read_in* req = static_cast<const fuse_read_in*>(data);
@@ -395,19 +579,19 @@ static int handle_read(void* data, fuse_data* fd, const fuse_in_header* hdr) {
   if (size + block_offset <= fd->block_size) {
     // First case: the read fits entirely in the first block.
 
-    vec[1].iov_base = fd->block_data + block_offset;
+    vec[1].iov_base = fd->curr_block_data + block_offset;
     vec[1].iov_len = size;
     vec_used = 2;
   } else {
     // Second case: the read spills over into the next block.
 
-    memcpy(fd->extra_block, fd->block_data + block_offset, fd->block_size - block_offset);
+    memcpy(fd->extra_block, fd->curr_block_data + block_offset, fd->block_size - block_offset);
     vec[1].iov_base = fd->extra_block;
     vec[1].iov_len = fd->block_size - block_offset;
 
     result = fetch_block(fd, block + 1);
     if (result != 0) return result;
-    vec[2].iov_base = fd->block_data;
+    vec[2].iov_base = fd->curr_block_data;
     vec[2].iov_len = size - vec[1].iov_len;
     vec_used = 3;
   }
@@ -418,7 +602,23 @@ static int handle_read(void* data, fuse_data* fd, const fuse_in_header* hdr) {
   return NO_STATUS;
 }
 
-int run_fuse_sideload(std::unique_ptr<FuseDataProvider>&& provider, const char* mount_point) {
+// Teardown of the previous sideload, still draining on a background worker. The caller gets its
+// result as soon as the FUSE loop exits; the unmount, provider close and cache frees finish here.
+// The next run_fuse_sideload() waits for it, so two instances never fight over the mount point.
+static std::future<void> g_pending_teardown;
+
+int run_fuse_sideload(std::unique_ptr<FuseDataProvider>&& provider, const char* mount_point,
+                      const std::function<void()>& on_mount) {
+  // The FUSE provider usually lives in its own (forked or minadbd) process, so it latches the
+  // trace flag and dumps its own timeline; the pid-suffixed output file keeps it separate from
+  // the installer's.
+  InitTracing();
+
+  // Let any previous instance finish tearing down before touching the mount point.
+  if (g_pending_teardown.valid()) {
+    g_pending_teardown.wait();
+  }
+
   // If something's already mounted on our mountpoint, try to remove it. (Mostly in case of a
   // previous abnormal exit.)
   umount2(mount_point, MNT_FORCE);
@@ -436,7 +636,9 @@ int run_fuse_sideload(std::unique_ptr<FuseDataProvider>&& provider, const char*
     return -1;
   }
 
-  fuse_data fd = {};
+  // Heap-allocated so the deferred teardown worker can outlive this function.
+  auto fd_holder = std::make_unique<fuse_data>();
+  fuse_data& fd = *fd_holder;
   fd.provider = provider.get();
   fd.file_size = file_size;
   fd.block_size = block_size;
@@ -464,6 +666,7 @@ int run_fuse_sideload(std::unique_ptr<FuseDataProvider>&& provider, const char*
     result = -1;
     goto done;
   }
+  fd.curr_block_data = fd.block_data;
   fd.extra_block = static_cast<uint8_t*>(malloc(block_size));
   if (fd.extra_block == nullptr) {
     fprintf(stderr, "failed to allocate %d bites for extra_block\n", block_size);
@@ -487,6 +690,20 @@ int run_fuse_sideload(std::unique_ptr<FuseDataProvider>&& provider, const char*
     }
   }
 
+  fd.demand_block = -1;
+  fd.demand_status = 0;
+  fd.readahead_next = 0;
+  fd.readahead_limit = 0;
+  fd.prefetch_error = false;
+  fd.prefetch_exit = false;
+  fd.trusted_source = provider->IsTrustedSource();
+  fd.verifications_avoided = 0;
+  // Without a cache there's nowhere to keep blocks fetched ahead of the reader, so reads stay
+  // synchronous in that case.
+  if (fd.block_cache) {
+    fd.prefetch_thread = std::thread(prefetch_loop, &fd);
+  }
+
   fd.ffd.reset(open("/dev/fuse", O_RDWR));
   if (fd.ffd == -1) {
     perror("open /dev/fuse");
@@ -507,6 +724,10 @@ int run_fuse_sideload(std::unique_ptr<FuseDataProvider>&& provider, const char*
     }
   }
 
+  if (on_mount) {
+    on_mount();
+  }
+
   uint8_t request_buffer[sizeof(fuse_in_header) + PATH_MAX * 8];
   for (;;) {
     ssize_t len = TEMP_FAILURE_RETRY(read(fd.ffd, request_buffer, sizeof(request_buffer)));
@@ -578,22 +799,46 @@ int run_fuse_sideload(std::unique_ptr<FuseDataProvider>&& provider, const char*
   }
 
 done:
-  provider->Close();
-
-  if (umount2(mount_point, MNT_DETACH) == -1) {
-    fprintf(stderr, "fuse_sideload umount failed: %s\n", strerror(errno));
+  if (fd.verifications_avoided > 0) {
+    printf("fuse: skipped re-verifying %" PRIu64 " block fetches from trusted source\n",
+           fd.verifications_avoided);
   }
 
-  if (fd.block_cache) {
-    uint32_t n;
-    for (n = 0; n < fd.file_blocks; ++n) {
-      free(fd.block_cache[n]);
-    }
-    free(fd.block_cache);
+  // The result is known here; everything left is cleanup. Joining the prefetch thread, closing
+  // the provider's USB resources and a slow lazy unmount can take seconds, so hand them to a
+  // background worker and report the result immediately instead of freezing the caller's screen.
+  {
+    std::lock_guard<std::mutex> lg(fd.mutex);
+    fd.prefetch_exit = true;
   }
-
-  free(fd.block_data);
-  free(fd.extra_block);
+  fd.cond.notify_all();
+
+  g_pending_teardown = std::async(
+      std::launch::async, [fd_holder = std::move(fd_holder), provider = std::move(provider),
+                           mount = std::string(mount_point)]() mutable {
+        fuse_data& fd = *fd_holder;
+        if (fd.prefetch_thread.joinable()) {
+          fd.prefetch_thread.join();
+        }
+
+        provider->Close();
+
+        if (umount2(mount.c_str(), MNT_DETACH) == -1) {
+          fprintf(stderr, "fuse_sideload umount failed: %s\n", strerror(errno));
+        }
+
+        if (fd.block_cache) {
+          for (uint32_t n = 0; n < fd.file_blocks; ++n) {
+            free(fd.block_cache[n]);
+          }
+          free(fd.block_cache);
+        }
+
+        free(fd.block_data);
+        free(fd.extra_block);
+      });
+
+  DumpTrace();
 
   return result;
 }
@@ -20,6 +20,7 @@
 
 #include <memory>
 #include <string>
+#include <vector>
 
 #include <android-base/unique_fd.h>
 
@@ -44,8 +45,22 @@ class FuseDataProvider {
   virtual bool ReadBlockAlignedData(uint8_t* buffer, uint32_t fetch_size,
                                     uint32_t start_block) const = 0;
 
+  // Reads |fetch_size| bytes spanning the |block_count| blocks starting at |start_block| into
+  // |buffer| (only the last block of the span may be partial). The default implementation issues
+  // one ReadBlockAlignedData() per block; providers whose backend charges a round trip per
+  // request can override this to keep several requests in flight.
+  virtual bool ReadBlocksAlignedData(uint8_t* buffer, uint32_t fetch_size, uint32_t start_block,
+                                     uint32_t block_count) const;
+
   virtual bool Valid() const = 0;
 
+  // Whether the source is local and immutable for the duration of the session. Blocks from a
+  // trusted source only need their hash verified the first time they are fetched; an untrusted
+  // source (e.g. the adb host) must be re-checked on every fetch.
+  virtual bool IsTrustedSource() const {
+    return false;
+  }
+
   virtual void Close() {}
 
  protected:
@@ -72,6 +87,10 @@ class FuseFileDataProvider : public FuseDataProvider {
     return fd_ != -1;
   }
 
+  bool IsTrustedSource() const override {
+    return true;
+  }
+
   void Close() override;
 
  private:
@@ -93,19 +112,36 @@ class FuseBlockDataProvider : public FuseDataProvider {
   bool ReadBlockAlignedData(uint8_t* buffer, uint32_t fetch_size,
                             uint32_t start_block) const override;
 
+  // One range walk covers the whole span; the per-block default would repeat the range lookup
+  // (and split fragment reads at every fuse block boundary) block by block.
+  bool ReadBlocksAlignedData(uint8_t* buffer, uint32_t fetch_size, uint32_t start_block,
+                             uint32_t block_count) const override;
+
   bool Valid() const override {
     return fd_ != -1;
   }
 
+  bool IsTrustedSource() const override {
+    return true;
+  }
+
   void Close() override;
 
  private:
   FuseBlockDataProvider(uint64_t file_size, uint32_t fuse_block_size, android::base::unique_fd&& fd,
                         uint32_t source_block_size, RangeSet ranges);
+
+  // Reads |size| bytes of the mapped file starting at byte |offset| into |buffer|.
+  bool ReadFileBytes(uint8_t* buffer, uint64_t offset, uint64_t size) const;
+
   // The underlying block device to read data from.
   android::base::unique_fd fd_;
   // The block size of the source block device.
   uint32_t source_block_size_;
   // The block ranges from the source block device that consist of the file
   RangeSet ranges_;
+  // Cumulative count of file blocks before each entry of |ranges_|, with one terminating entry
+  // holding the total. Maps a file block to its (range, offset-within-range) with one binary
+  // search instead of a scan over the range list per request.
+  std::vector<uint64_t> range_file_start_;
 };
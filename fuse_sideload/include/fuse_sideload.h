@@ -17,6 +17,7 @@
 #ifndef __FUSE_SIDELOAD_H
 #define __FUSE_SIDELOAD_H
 
+#include <functional>
 #include <memory>
 
 #include "fuse_provider.h"
@@ -28,7 +29,11 @@ static constexpr const char* FUSE_SIDELOAD_HOST_PATHNAME = "/sideload/package.zi
 static constexpr const char* FUSE_SIDELOAD_HOST_EXIT_FLAG = "exit";
 static constexpr const char* FUSE_SIDELOAD_HOST_EXIT_PATHNAME = "/sideload/exit";
 
+// Serves the provider's data as a FUSE filesystem at |mount_point| until the exit flag is read.
+// |on_mount| (if set) runs right after the filesystem is mounted, so callers can announce the
+// package path only once opening it can succeed instead of having readers poll for it.
 int run_fuse_sideload(std::unique_ptr<FuseDataProvider>&& provider,
-                      const char* mount_point = FUSE_SIDELOAD_HOST_MOUNTPOINT);
+                      const char* mount_point = FUSE_SIDELOAD_HOST_MOUNTPOINT,
+                      const std::function<void()>& on_mount = {});
 
 #endif
@@ -30,7 +30,11 @@
 
 #include <atomic>
 #include <functional>
+#include <future>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <string>
 #include <utility>
 #include <vector>
 
@@ -59,6 +63,103 @@ static bool SetUsbConfig(const std::string& state) {
   return android::base::WaitForProperty("sys.usb.state", state);
 }
 
+// Forks and execs the minadbd service, with the child's end of a socket pair passed on its command
+// line. Returns the child's pid and stores recovery's end in |recovery_socket|, or returns -1 on
+// error.
+static pid_t ForkMinadbdService(bool rescue_mode, android::base::unique_fd* recovery_socket) {
+  android::base::unique_fd minadbd_socket;
+  if (!android::base::Socketpair(AF_UNIX, SOCK_STREAM, 0, recovery_socket, &minadbd_socket)) {
+    PLOG(ERROR) << "Failed to create socket";
+    return -1;
+  }
+
+  pid_t child = fork();
+  if (child == -1) {
+    PLOG(ERROR) << "Failed to fork child process";
+    return -1;
+  }
+  if (child == 0) {
+    recovery_socket->reset();
+    std::vector<std::string> minadbd_commands = {
+      "/system/bin/minadbd",
+      "--socket_fd",
+      std::to_string(minadbd_socket.release()),
+    };
+    if (rescue_mode) {
+      minadbd_commands.push_back("--rescue");
+    }
+    auto exec_args = StringVectorToNullTerminatedArray(minadbd_commands);
+    execv(exec_args[0], exec_args.data());
+    _exit(EXIT_FAILURE);
+  }
+
+  return child;
+}
+
+// A sideload service brought up ahead of the user's selection: the forked minadbd child with
+// recovery's end of the command socket, plus the USB state to restore once sideload finishes.
+struct PrewarmedSideload {
+  pid_t child = -1;
+  android::base::unique_fd socket;
+  std::string saved_usb_state;
+};
+
+static std::mutex g_prewarm_mutex;
+static std::future<std::unique_ptr<PrewarmedSideload>> g_prewarmed_sideload;
+
+// Claims the pending pre-warm, waiting for it to finish coming up if necessary. Returns nullptr
+// if nothing was pre-warmed or the pre-warm failed.
+static std::unique_ptr<PrewarmedSideload> TakeSideloadPrewarm() {
+  std::lock_guard<std::mutex> lock(g_prewarm_mutex);
+  if (!g_prewarmed_sideload.valid()) return nullptr;
+  return g_prewarmed_sideload.get();
+}
+
+void PrewarmSideload() {
+  std::lock_guard<std::mutex> lock(g_prewarm_mutex);
+  if (g_prewarmed_sideload.valid()) return;
+
+  // The USB reconfiguration dominates the sideload entry latency: each SetUsbConfig() blocks
+  // until the gadget state settles. Do the whole bring-up off the UI thread so the menu stays
+  // responsive while it runs.
+  g_prewarmed_sideload = std::async(std::launch::async, []() -> std::unique_ptr<PrewarmedSideload> {
+    auto service = std::make_unique<PrewarmedSideload>();
+    service->saved_usb_state = android::base::GetProperty("sys.usb.state", "none");
+    if (service->saved_usb_state != "none" && !SetUsbConfig("none")) {
+      LOG(ERROR) << "Failed to clear USB config";
+      return nullptr;
+    }
+    service->child = ForkMinadbdService(false /* rescue_mode */, &service->socket);
+    if (service->child == -1) {
+      return nullptr;
+    }
+    if (!SetUsbConfig("sideload")) {
+      LOG(ERROR) << "Failed to set usb config to sideload";
+      kill(service->child, SIGKILL);
+      waitpid(service->child, nullptr, 0);
+      if (service->saved_usb_state != "none") {
+        SetUsbConfig(service->saved_usb_state);
+      }
+      return nullptr;
+    }
+    return service;
+  });
+}
+
+void DiscardSideloadPrewarm() {
+  auto service = TakeSideloadPrewarm();
+  if (!service) return;
+
+  kill(service->child, SIGKILL);
+  waitpid(service->child, nullptr, 0);
+  if (!SetUsbConfig("none")) {
+    LOG(ERROR) << "Failed to clear USB config";
+  }
+  if (service->saved_usb_state != "none" && !SetUsbConfig(service->saved_usb_state)) {
+    LOG(ERROR) << "Failed to restore USB config to " << service->saved_usb_state;
+  }
+}
+
 // Parses the minadbd command in |message|; returns MinadbdCommand::kError upon errors.
 static MinadbdCommand ParseMinadbdCommand(const std::string& message) {
   if (!android::base::StartsWith(message, kMinadbdCommandPrefix)) {
@@ -91,10 +192,10 @@ static bool WriteStatusToFd(MinadbdCommandStatus status, int fd) {
 // Installs the package from FUSE. Returns the installation result and whether it should continue
 // waiting for new commands.
 static auto AdbInstallPackageHandler(Device* device, InstallResult* result) {
-  // How long (in seconds) we wait for the package path to be ready. It doesn't need to be too long
-  // because the minadbd service has already issued an install command. FUSE_SIDELOAD_HOST_PATHNAME
-  // will start to exist once the host connects and starts serving a package. Poll for its
-  // appearance. (Note that inotify doesn't work with FUSE.)
+  // minadbd only issues the install command after mounting the FUSE, so the package path normally
+  // exists by the time the command arrives and the first stat() succeeds. Keep a bounded poll as a
+  // safety net for a mount that disappears underneath us. (Note that inotify doesn't work with
+  // FUSE.)
   auto ui = device->GetUI();
   constexpr int ADB_INSTALL_TIMEOUT = 15;
   bool should_continue = true;
@@ -278,44 +379,29 @@ static void ListenAndExecuteMinadbdCommands(
 //                               b11. exit the listening loop
 //
 static void CreateMinadbdServiceAndExecuteCommands(
-    Device* device, const std::map<MinadbdCommand, CommandFunction>& command_map,
-    bool rescue_mode) {
+    Device* device, const std::map<MinadbdCommand, CommandFunction>& command_map, bool rescue_mode,
+    std::unique_ptr<PrewarmedSideload> prewarmed) {
   signal(SIGPIPE, SIG_IGN);
 
+  pid_t child;
   android::base::unique_fd recovery_socket;
-  android::base::unique_fd minadbd_socket;
-  if (!android::base::Socketpair(AF_UNIX, SOCK_STREAM, 0, &recovery_socket, &minadbd_socket)) {
-    PLOG(ERROR) << "Failed to create socket";
-    return;
-  }
-
-  pid_t child = fork();
-  if (child == -1) {
-    PLOG(ERROR) << "Failed to fork child process";
-    return;
-  }
-  if (child == 0) {
-    recovery_socket.reset();
-    std::vector<std::string> minadbd_commands = {
-      "/system/bin/minadbd",
-      "--socket_fd",
-      std::to_string(minadbd_socket.release()),
-    };
-    if (rescue_mode) {
-      minadbd_commands.push_back("--rescue");
+  if (prewarmed) {
+    // The service was already forked and the gadget switched to sideload while the user was still
+    // in the menu; just pick up where the pre-warm left off.
+    child = prewarmed->child;
+    recovery_socket = std::move(prewarmed->socket);
+  } else {
+    child = ForkMinadbdService(rescue_mode, &recovery_socket);
+    if (child == -1) {
+      return;
     }
-    auto exec_args = StringVectorToNullTerminatedArray(minadbd_commands);
-    execv(exec_args[0], exec_args.data());
-    _exit(EXIT_FAILURE);
-  }
 
-  minadbd_socket.reset();
-
-  // We need to call SetUsbConfig() after forking minadbd service. Because the function waits for
-  // the usb state to be updated, which depends on sys.usb.ffs.ready=1 set in the adb daemon.
-  if (!SetUsbConfig("sideload")) {
-    LOG(ERROR) << "Failed to set usb config to sideload";
-    return;
+    // We need to call SetUsbConfig() after forking minadbd service. Because the function waits for
+    // the usb state to be updated, which depends on sys.usb.ffs.ready=1 set in the adb daemon.
+    if (!SetUsbConfig("sideload")) {
+      LOG(ERROR) << "Failed to set usb config to sideload";
+      return;
+    }
   }
 
   RecoveryUI* ui = device->GetUI();
@@ -353,12 +439,27 @@ static void CreateMinadbdServiceAndExecuteCommands(
 }
 
 InstallResult ApplyFromAdb(Device* device, bool rescue_mode, Device::BuiltinAction* reboot_action) {
+  // Use the pre-warmed service when one is pending. Rescue mode needs different minadbd arguments,
+  // so it discards any (non-rescue) pre-warm and starts fresh.
+  std::unique_ptr<PrewarmedSideload> prewarmed;
+  if (!rescue_mode) {
+    prewarmed = TakeSideloadPrewarm();
+  } else {
+    DiscardSideloadPrewarm();
+  }
+
   // Save the usb state to restore after the sideload operation.
-  std::string usb_state = android::base::GetProperty("sys.usb.state", "none");
-  // Clean up state and stop adbd.
-  if (usb_state != "none" && !SetUsbConfig("none")) {
-    LOG(ERROR) << "Failed to clear USB config";
-    return INSTALL_ERROR;
+  std::string usb_state;
+  if (prewarmed) {
+    // The pre-warm already stopped adbd and recorded the state to restore.
+    usb_state = prewarmed->saved_usb_state;
+  } else {
+    usb_state = android::base::GetProperty("sys.usb.state", "none");
+    // Clean up state and stop adbd.
+    if (usb_state != "none" && !SetUsbConfig("none")) {
+      LOG(ERROR) << "Failed to clear USB config";
+      return INSTALL_ERROR;
+    }
   }
 
   RecoveryUI* ui = device->GetUI();
@@ -393,7 +494,7 @@ InstallResult ApplyFromAdb(Device* device, bool rescue_mode, Device::BuiltinActi
     ui->Print("\n\nWaiting for rescue commands...\n");
   }
 
-  CreateMinadbdServiceAndExecuteCommands(device, command_map, rescue_mode);
+  CreateMinadbdServiceAndExecuteCommands(device, command_map, rescue_mode, std::move(prewarmed));
 
   // Clean up before switching to the older state, for example setting the state
   // to none sets sys/class/android_usb/android0/enable to 0.
@@ -23,3 +23,15 @@
 // has been requested, INSTALL_REBOOT will be the return value, with the reboot target set in
 // reboot_action.
 InstallResult ApplyFromAdb(Device* device, bool rescue_mode, Device::BuiltinAction* reboot_action);
+
+// Starts forking the minadbd service and switching the USB gadget to sideload in the background,
+// so that a subsequent ApplyFromAdb() can begin the transfer right away instead of paying the
+// reconfiguration wait after the user selects sideload. Call when the sideload menu entry is
+// shown; a no-op if a pre-warm is already pending. Note that the USB gadget stays in sideload
+// mode (i.e. no regular adb) until the pre-warm is consumed or discarded.
+void PrewarmSideload();
+
+// Tears down a pre-warmed sideload service that ApplyFromAdb() didn't consume: kills the minadbd
+// child and restores the previous USB configuration. Call when leaving the menu that offered
+// sideload. A no-op if nothing was pre-warmed.
+void DiscardSideloadPrewarm();
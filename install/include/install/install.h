@@ -53,6 +53,10 @@ InstallResult InstallPackage(Package* package, const std::string_view package_id
                              bool should_wipe_cache, int retry_count,
                              Device* ui);
 
+// Starts parsing the ota keys from otacerts.zip on a background thread, so that a later
+// verify_package() doesn't pay for the certificate loading. Safe to call more than once.
+void PreloadOtaKeys();
+
 // Verifies the package by ota keys. Returns true if the package is verified successfully,
 // otherwise returns false.
 bool verify_package(Package* package, RecoveryUI* ui);
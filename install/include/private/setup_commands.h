@@ -37,3 +37,9 @@ bool SetUpNonAbUpdateCommands(const std::string& package, ZipArchiveHandle zip,
 // parameter |retry_count| than the non-A/B version.
 bool SetUpAbUpdateCommands(const std::string& package, ZipArchiveHandle zip, int status_fd,
                            std::vector<std::string>* cmd);
+
+// Same as above, but takes the already-extracted contents of payload_properties.txt, so callers
+// that need the properties elsewhere during the install don't pay for a second extraction.
+bool SetUpAbUpdateCommands(const std::string& package, ZipArchiveHandle zip,
+                           const std::string& payload_properties, int status_fd,
+                           std::vector<std::string>* cmd);
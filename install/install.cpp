@@ -27,17 +27,16 @@
 #include <unistd.h>
 
 #include <algorithm>
-#include <atomic>
 #include <chrono>
-#include <condition_variable>
 #include <filesystem>
 #include <functional>
+#include <future>
 #include <limits>
 #include <mutex>
-#include <thread>
 #include <vector>
 
 #include <android-base/file.h>
+#include <android-base/hex.h>
 #include <android-base/logging.h>
 #include <android-base/parsedouble.h>
 #include <android-base/parseint.h>
@@ -45,6 +44,7 @@
 #include <android-base/stringprintf.h>
 #include <android-base/strings.h>
 #include <android-base/unique_fd.h>
+#include <openssl/sha.h>
 
 #include "bootloader_message/bootloader_message.h"
 #include "install/snapshot_utils.h"
@@ -52,17 +52,18 @@
 #include "install/wipe_data.h"
 #include "install/wipe_device.h"
 #include "otautil/error_code.h"
+#include "otautil/hang_watchdog.h"
 #include "otautil/package.h"
 #include "otautil/paths.h"
+#include "otautil/performance_mode.h"
 #include "otautil/sysutil.h"
 #include "otautil/verifier.h"
 #include "private/setup_commands.h"
 #include "recovery_ui/device.h"
 #include "recovery_ui/ui.h"
+#include "recovery_utils/health_monitor.h"
+#include "recovery_utils/metrics.h"
 #include "recovery_utils/roots.h"
-#include "recovery_utils/thermalutil.h"
-
-using namespace std::chrono_literals;
 
 bool ask_to_ab_reboot(Device* device);
 bool ask_to_continue_unverified(Device* device);
@@ -82,7 +83,6 @@ static constexpr auto&& RELEASE_KEYS_TAG = "release-keys";
 // If brick packages are smaller than |MEMORY_PACKAGE_LIMIT|, read the entire package into memory
 static constexpr size_t MEMORY_PACKAGE_LIMIT = 1024 * 1024;
 
-static std::condition_variable finish_log_temperature;
 static bool isInStringList(const std::string& target_token, const std::string& str_list,
                            const std::string& deliminator);
 
@@ -297,11 +297,14 @@ static std::string ExtractPayloadProperties(ZipArchiveHandle zip) {
 
 bool SetUpAbUpdateCommands(const std::string& package, ZipArchiveHandle zip, int status_fd,
                            std::vector<std::string>* cmd) {
+  return SetUpAbUpdateCommands(package, zip, ExtractPayloadProperties(zip), status_fd, cmd);
+}
+
+bool SetUpAbUpdateCommands(const std::string& package, ZipArchiveHandle zip,
+                           const std::string& payload_properties, int status_fd,
+                           std::vector<std::string>* cmd) {
   CHECK(cmd != nullptr);
 
-  // For A/B updates we extract the payload properties to a buffer and obtain the RAW payload offset
-  // in the zip file.
-  const auto payload_properties = ExtractPayloadProperties(zip);
   if (payload_properties.empty()) {
     return false;
   }
@@ -323,6 +326,22 @@ bool SetUpAbUpdateCommands(const std::string& package, ZipArchiveHandle zip, int
   return true;
 }
 
+// Token binding an extracted update binary to the package it came from, so that a retry of the
+// same package can reuse the copy already sitting in /tmp instead of repeating a multi-second
+// extraction from slow media. The zip entry's CRC and uncompressed size digest the bytes being
+// cached; the package's path, size and mtime bind the token to the source file the same way the
+// verification token does. Any mismatch falls back to a fresh extraction.
+static std::string UpdateBinaryToken(const std::string& package, const ZipEntry64& entry) {
+  struct stat st;
+  if (stat(package.c_str(), &st) != 0) {
+    return "";
+  }
+  return android::base::StringPrintf(
+      "%s|%" PRId64 "|%" PRId64 "|%" PRIx32 "|%" PRIu64, package.c_str(),
+      static_cast<int64_t>(st.st_size), static_cast<int64_t>(st.st_mtime), entry.crc32,
+      entry.uncompressed_length);
+}
+
 bool SetUpNonAbUpdateCommands(const std::string& package, ZipArchiveHandle zip, int retry_count,
                               int status_fd, std::vector<std::string>* cmd) {
   CHECK(cmd != nullptr);
@@ -336,17 +355,40 @@ bool SetUpNonAbUpdateCommands(const std::string& package, ZipArchiveHandle zip,
   }
 
   const std::string binary_path = Paths::Get().temporary_update_binary();
-  unlink(binary_path.c_str());
-  android::base::unique_fd fd(
-      open(binary_path.c_str(), O_CREAT | O_WRONLY | O_TRUNC | O_CLOEXEC, 0755));
-  if (fd == -1) {
-    PLOG(ERROR) << "Failed to create " << binary_path;
-    return false;
-  }
+  const std::string token_path = binary_path + ".token";
+  std::string token = UpdateBinaryToken(package, binary_entry);
+
+  std::string cached_token;
+  struct stat binary_st;
+  if (!token.empty() && android::base::ReadFileToString(token_path, &cached_token) &&
+      cached_token == token && stat(binary_path.c_str(), &binary_st) == 0 &&
+      static_cast<uint64_t>(binary_st.st_size) == binary_entry.uncompressed_length) {
+    LOG(INFO) << "Reusing cached update binary at " << binary_path;
+  } else {
+    unlink(token_path.c_str());
+    unlink(binary_path.c_str());
+    android::base::unique_fd fd(
+        open(binary_path.c_str(), O_CREAT | O_WRONLY | O_TRUNC | O_CLOEXEC, 0755));
+    if (fd == -1) {
+      PLOG(ERROR) << "Failed to create " << binary_path;
+      return false;
+    }
 
-  if (auto error = ExtractEntryToFile(zip, &binary_entry, fd); error != 0) {
-    LOG(ERROR) << "Failed to extract " << UPDATE_BINARY_NAME << ": " << ErrorCodeString(error);
-    return false;
+    // Preallocate the full file so extraction writes into place instead of growing it page by
+    // page. Best effort; not every filesystem supports it.
+    if (binary_entry.uncompressed_length > 0 &&
+        fallocate(fd, 0, 0, binary_entry.uncompressed_length) != 0) {
+      PLOG(WARNING) << "Failed to preallocate " << binary_path;
+    }
+
+    if (auto error = ExtractEntryToFile(zip, &binary_entry, fd); error != 0) {
+      LOG(ERROR) << "Failed to extract " << UPDATE_BINARY_NAME << ": " << ErrorCodeString(error);
+      return false;
+    }
+
+    if (!token.empty() && !android::base::WriteStringToFile(token, token_path)) {
+      PLOG(WARNING) << "Failed to write " << token_path;
+    }
   }
 
   // When executing the update binary contained in the package, the arguments passed are:
@@ -366,18 +408,7 @@ bool SetUpNonAbUpdateCommands(const std::string& package, ZipArchiveHandle zip,
   return true;
 }
 
-static void log_max_temperature(int* max_temperature, const std::atomic<bool>& logger_finished) {
-  CHECK(max_temperature != nullptr);
-  std::mutex mtx;
-  std::unique_lock<std::mutex> lck(mtx);
-  while (!logger_finished.load() &&
-         finish_log_temperature.wait_for(lck, 20s) == std::cv_status::timeout) {
-    *max_temperature = std::max(*max_temperature, GetMaxValueFromThermalZone());
-  }
-}
-
-static bool PerformPowerwashIfRequired(ZipArchiveHandle zip, Device *device) {
-  const auto payload_properties = ExtractPayloadProperties(zip);
+static bool PerformPowerwashIfRequired(const std::string& payload_properties, Device* device) {
   if (payload_properties.find("POWERWASH=1") != std::string::npos) {
     LOG(INFO) << "Payload properties has POWERWASH=1, wiping userdata...";
     return WipeData(device);
@@ -385,10 +416,14 @@ static bool PerformPowerwashIfRequired(ZipArchiveHandle zip, Device *device) {
   return true;
 }
 
-// If the package contains an update binary, extract it and run it.
+// If the package contains an update binary, extract it and run it. A non-null |verification|
+// carries the result of a whole-package verification still running on a worker thread (the
+// overlapped A/B flow); it's settled before the install is allowed to succeed, and a failure
+// aborts the updater early.
 static InstallResult TryUpdateBinary(Package* package, bool* wipe_cache,
                                      std::vector<std::string>* log_buffer, int retry_count,
-                                     int* max_temperature, Device* device) {
+                                     PerformanceMode* performance_mode, Device* device,
+                                     std::future<bool>* verification) {
   auto ui = device->GetUI();
   std::map<std::string, std::string> metadata;
   auto zip = package->GetZipArchiveHandle();
@@ -503,10 +538,29 @@ static InstallResult TryUpdateBinary(Package* package, bool* wipe_cache,
 
   std::string package_path = package->GetPath();
 
+  // Hand the already-open package down to the forked updater through an inherited fd, so the
+  // child maps /proc/self/fd/<n> instead of reopening and re-reading the path. On a FUSE-backed
+  // sideload a fresh open in the child is a second full pass over USB; through the inherited fd
+  // its reads share this process's FUSE session and block cache. Only the non-A/B updater is a
+  // direct child of ours; update_engine can't inherit our descriptors.
+  android::base::unique_fd package_fd;
+  if (!package_is_ab) {
+    package_fd = package->CreateShareableFd();
+    if (package_fd != -1) {
+      // Clear FD_CLOEXEC so the fd survives the exec of the update binary.
+      fcntl(package_fd.get(), F_SETFD, 0);
+      package_path = android::base::StringPrintf("/proc/self/fd/%d", package_fd.get());
+    }
+  }
+
+  // Extracted once and shared: both the updater command setup and the post-install powerwash
+  // check need the payload properties.
+  const std::string payload_properties = package_is_ab ? ExtractPayloadProperties(zip) : "";
+
   std::vector<std::string> args;
   if (auto setup_result =
           package_is_ab
-              ? SetUpAbUpdateCommands(package_path, zip, pipe_write.get(), &args)
+              ? SetUpAbUpdateCommands(package_path, zip, payload_properties, pipe_write.get(), &args)
               : SetUpNonAbUpdateCommands(package_path, zip, retry_count, pipe_write.get(), &args);
       !setup_result) {
     log_buffer->push_back(android::base::StringPrintf("error: %d", kUpdateBinaryCommandFailure));
@@ -535,15 +589,53 @@ static InstallResult TryUpdateBinary(Package* package, bool* wipe_cache,
   }
   pipe_write.reset();
 
-  std::atomic<bool> logger_finished(false);
-  std::thread temperature_logger(log_max_temperature, max_temperature, std::ref(logger_finished));
-
   *wipe_cache = false;
   bool retry_update = false;
+  bool verification_failed = false;
+
+  // Settles an overlapped verification result. On failure, gives the user the same chance to
+  // continue anyway as the synchronous flow does; the updater blocks on its end of the pipe
+  // while the prompt is up.
+  auto settle_verification = [&]() {
+    if (!verification->get()) {
+      log_buffer->push_back(android::base::StringPrintf("error: %d", kZipVerificationFailure));
+      if (!ui->IsTextVisible() || !ask_to_continue_unverified(device)) {
+        verification_failed = true;
+      }
+    }
+  };
+
+  // Backstop for an updater that wedges without pipe traffic. The updater's own watchdog (same
+  // property, and a head start of a minute here) normally fires first and exits cleanly; this one
+  // catches the cases where the updater can't, dumps the child's thread and I/O state, and kills
+  // it so the install fails instead of freezing. The resume machinery handles the rest on retry.
+  uint64_t hang_timeout_s =
+      android::base::GetUintProperty<uint64_t>("ro.recovery.hang_timeout_s", 600);
+  HangWatchdog updater_watchdog(
+      "update_binary", std::chrono::seconds(hang_timeout_s > 0 ? hang_timeout_s + 60 : 0),
+      [pid]() {
+        HangWatchdog::DumpProcessState(pid, "update_binary");
+        kill(pid, SIGKILL);
+      });
+
+  // Throttle-aware pacing: when the sampler reports the device hot, drop the cpufreq boost so
+  // the install slows down and cools off instead of climbing toward a thermal shutdown; reapply
+  // it once the temperature falls back. Reading the cached state is one atomic load per pipe
+  // line, so this adds no sysfs I/O to the communication path.
+  bool thermal_throttled = false;
 
   char buffer[1024];
   FILE* from_child = android::base::Fdopen(std::move(pipe_read), "r");
   while (fgets(buffer, sizeof(buffer), from_child) != nullptr) {
+    updater_watchdog.Pet();
+    if (bool throttle = HealthMonitor::Get().ThrottleRequested(); throttle != thermal_throttled) {
+      thermal_throttled = throttle;
+      if (thermal_throttled) {
+        performance_mode->Suspend();
+      } else {
+        performance_mode->Resume();
+      }
+    }
     std::string line(buffer);
     size_t space = line.find_first_of(" \n");
     std::string command(line.substr(0, space));
@@ -594,15 +686,29 @@ static InstallResult TryUpdateBinary(Package* package, bool* wipe_cache,
     } else {
       LOG(ERROR) << "unknown command [" << command << "]";
     }
+
+    // Kill the updater as soon as an overlapped verification failure is known, rather than
+    // letting it consume the rest of a bad package.
+    if (verification && verification->valid() &&
+        verification->wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+      settle_verification();
+      if (verification_failed) {
+        kill(pid, SIGTERM);
+      }
+    }
   }
   fclose(from_child);
 
   int status;
   waitpid(pid, &status, 0);
 
-  logger_finished.store(true);
-  finish_log_temperature.notify_one();
-  temperature_logger.join();
+  if (verification && verification->valid()) {
+    settle_verification();
+  }
+  if (verification_failed) {
+    LOG(ERROR) << "Signature verification failed; aborted the A/B install";
+    return INSTALL_CORRUPT;
+  }
 
   if (retry_update) {
     return INSTALL_RETRY;
@@ -620,7 +726,7 @@ static InstallResult TryUpdateBinary(Package* package, bool* wipe_cache,
   }
   if (package_is_ab) {
     ab_package_installed = true;
-    PerformPowerwashIfRequired(zip, device);
+    PerformPowerwashIfRequired(payload_properties, device);
     if (!ui->IsSideloadAutoReboot() && ask_to_ab_reboot(device)) {
       reboot_to_recovery();
     }
@@ -629,21 +735,110 @@ static InstallResult TryUpdateBinary(Package* package, bool* wipe_cache,
   return INSTALL_SUCCESS;
 }
 
+// Token recording a successful whole-package verification, so that a reboot-and-retry of the very
+// same bytes doesn't pay the full sequential hash a second time. The token binds the package's
+// path, size and mtime plus a digest over sparse samples of its content; a package that was
+// swapped or rewritten in between fails the match and goes through full verification again.
+static constexpr const char* kVerificationTokenPath = "/cache/recovery/verified_package_token";
+
+static std::string VerificationToken(Package* package) {
+  std::string path = package->GetPath();
+  if (path.empty()) {
+    return "";
+  }
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0) {
+    return "";
+  }
+
+  // Hash 16 evenly spaced 64 KiB windows. The first and last window always fall in the sample, so
+  // the zip headers, central directory and signature footer are all covered.
+  uint64_t size = package->GetPackageSize();
+  constexpr uint64_t kSampleWindow = 64 * 1024;
+  constexpr int kSampleCount = 16;
+  SHA256_CTX ctx;
+  SHA256_Init(&ctx);
+  std::vector<uint8_t> buffer(kSampleWindow);
+  for (int i = 0; i < kSampleCount; ++i) {
+    uint64_t offset = (size > kSampleWindow) ? (size - kSampleWindow) * i / (kSampleCount - 1) : 0;
+    uint64_t count = std::min<uint64_t>(kSampleWindow, size - offset);
+    if (!package->ReadFullyAtOffset(buffer.data(), count, offset)) {
+      return "";
+    }
+    SHA256_Update(&ctx, buffer.data(), count);
+    if (count == size) {
+      break;
+    }
+  }
+  uint8_t digest[SHA256_DIGEST_LENGTH];
+  SHA256_Final(digest, &ctx);
+
+  return android::base::StringPrintf("%s|%" PRIu64 "|%" PRId64 "|%s", path.c_str(), size,
+                                     static_cast<int64_t>(st.st_mtime),
+                                     android::base::HexString(digest, sizeof(digest)).c_str());
+}
+
+static void SaveVerificationToken(Package* package) {
+  std::string token = VerificationToken(package);
+  if (token.empty()) {
+    return;
+  }
+  if (!android::base::WriteStringToFile(token, kVerificationTokenPath)) {
+    PLOG(WARNING) << "Failed to write verification token to " << kVerificationTokenPath;
+  }
+}
+
+static bool MatchesVerificationToken(Package* package) {
+  std::string saved;
+  if (!android::base::ReadFileToString(kVerificationTokenPath, &saved)) {
+    return false;
+  }
+  std::string token = VerificationToken(package);
+  return !token.empty() && token == saved;
+}
+
 static InstallResult VerifyAndInstallPackage(Package* package, bool* wipe_cache,
                                              std::vector<std::string>* log_buffer, int retry_count,
-                                             int* max_temperature, Device* device) {
+                                             PerformanceMode* performance_mode, Device* device) {
   auto ui = device->GetUI();
   ui->SetBackground(RecoveryUI::INSTALLING_UPDATE);
   // Give verification half the progress bar...
   ui->SetProgressType(RecoveryUI::DETERMINATE);
   ui->ShowProgress(VERIFICATION_PROGRESS_FRACTION, VERIFICATION_PROGRESS_TIME);
 
-  // Verify package.
-  if (!verify_package(package, ui)) {
+  // An A/B payload carries its own signature that update_engine checks before it commits the
+  // slot switch, so the whole-package verification doesn't have to finish before update_engine
+  // starts reading: run it on a worker thread and let TryUpdateBinary overlap it with the
+  // install, aborting the updater if verification fails. Non-A/B updaters start modifying
+  // partitions as soon as they run, so they keep the verify-before-execute order.
+  std::map<std::string, std::string> metadata;
+  bool overlap_verification =
+      ReadMetadataFromPackage(package->GetZipArchiveHandle(), &metadata) &&
+      get_value(metadata, "ota-type") == OtaTypeToString(OtaType::AB);
+
+  // On a retry the package was already verified in full on the previous attempt; accept the
+  // recorded token instead of rehashing everything, as long as the package still matches it.
+  bool previously_verified = retry_count > 0 && MatchesVerificationToken(package);
+  if (previously_verified) {
+    ui->Print("Package verified on the previous attempt; skipping re-verification.\n");
+  }
+
+  std::future<bool> verification;
+  if (previously_verified) {
+    // Nothing to verify; TryUpdateBinary() runs as if verification had already settled.
+  } else if (overlap_verification) {
+    verification = std::async(std::launch::async, [package, ui]() {
+      bool ok = verify_package(package, ui);
+      if (ok) SaveVerificationToken(package);
+      return ok;
+    });
+  } else if (!verify_package(package, ui)) {
     log_buffer->push_back(android::base::StringPrintf("error: %d", kZipVerificationFailure));
     if (!ui->IsTextVisible() || !ask_to_continue_unverified(ui->GetDevice())) {
         return INSTALL_CORRUPT;
     }
+  } else {
+    SaveVerificationToken(package);
   }
 
   // Verify and install the contents of the package.
@@ -653,7 +848,8 @@ static InstallResult VerifyAndInstallPackage(Package* package, bool* wipe_cache,
   }
   ui->SetEnableReboot(false);
   auto result =
-      TryUpdateBinary(package, wipe_cache, log_buffer, retry_count, max_temperature, device);
+      TryUpdateBinary(package, wipe_cache, log_buffer, retry_count, performance_mode, device,
+                      (overlap_verification && !previously_verified) ? &verification : nullptr);
   ui->SetEnableReboot(true);
   ui->Print("\n");
 
@@ -665,8 +861,13 @@ InstallResult InstallPackage(Package* package, const std::string_view package_id
   auto ui = device->GetUI();
   auto start = std::chrono::system_clock::now();
 
-  int start_temperature = GetMaxValueFromThermalZone();
-  int max_temperature = start_temperature;
+  // Boost cpufreq for the duration of the install; the previous state is restored on return.
+  PerformanceMode performance_mode;
+
+  // All battery/thermal reads below come from the background sampler, so none of them does
+  // sysfs I/O on the install path; the first snapshot() call blocks until a sample exists.
+  HealthMonitor::Get().ResetMaxTemperature();
+  int start_temperature = HealthMonitor::Get().snapshot().temperature;
 
   InstallResult result;
   std::vector<std::string> log_buffer;
@@ -684,7 +885,7 @@ InstallResult InstallPackage(Package* package, const std::string_view package_id
   } else {
     bool updater_wipe_cache = false;
     result = VerifyAndInstallPackage(package, &updater_wipe_cache, &log_buffer, retry_count,
-                                     &max_temperature, device);
+                                     &performance_mode, device);
     should_wipe_cache = should_wipe_cache || updater_wipe_cache;
   }
 
@@ -692,6 +893,13 @@ InstallResult InstallPackage(Package* package, const std::string_view package_id
   std::chrono::duration<double> duration = std::chrono::system_clock::now() - start;
   int time_total = static_cast<int>(duration.count());
 
+  // The install timer covers the updater run as well, so block-image update regressions show up
+  // here; the updater's own per-partition byte counts still arrive through last_install.
+  RecoveryMetrics::Get().RecordDuration(
+      "package_install", std::chrono::duration_cast<std::chrono::nanoseconds>(duration));
+  RecoveryMetrics::Get().IncrementCounter(
+      result == INSTALL_SUCCESS ? "package_install_success" : "package_install_failure");
+
   bool has_cache = volume_for_mount_point("/cache") != nullptr;
   // Skip logging the uncrypt_status on devices without /cache.
   if (has_cache) {
@@ -718,8 +926,8 @@ InstallResult InstallPackage(Package* package, const std::string_view package_id
     "retry: " + std::to_string(retry_count),
   };
 
-  int end_temperature = GetMaxValueFromThermalZone();
-  max_temperature = std::max(end_temperature, max_temperature);
+  int end_temperature = HealthMonitor::Get().snapshot().temperature;
+  int max_temperature = std::max(end_temperature, HealthMonitor::Get().max_temperature());
   if (start_temperature > 0) {
     log_buffer.push_back("temperature_start: " + std::to_string(start_temperature));
   }
@@ -749,14 +957,36 @@ InstallResult InstallPackage(Package* package, const std::string_view package_id
   return result;
 }
 
+static constexpr const char* CERTIFICATE_ZIP_FILE = "/system/etc/security/otacerts.zip";
+
+// Returns the shared future holding the parsed OTA keys, kicking off the load on a background
+// thread the first time it's called. The certificates in otacerts.zip can't change while recovery
+// is running, so one parse serves every verification in this boot.
+static std::shared_future<std::vector<Certificate>> GetOtaKeys() {
+  static std::mutex mutex;
+  static std::shared_future<std::vector<Certificate>> future;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  if (!future.valid()) {
+    future = std::async(std::launch::async, []() {
+      std::vector<Certificate> keys = LoadKeysFromZipfile(CERTIFICATE_ZIP_FILE);
+      LOG(INFO) << keys.size() << " key(s) loaded from " << CERTIFICATE_ZIP_FILE;
+      return keys;
+    }).share();
+  }
+  return future;
+}
+
+void PreloadOtaKeys() {
+  GetOtaKeys();
+}
+
 bool verify_package(Package* package, RecoveryUI* ui) {
-  static constexpr const char* CERTIFICATE_ZIP_FILE = "/system/etc/security/otacerts.zip";
-  std::vector<Certificate> loaded_keys = LoadKeysFromZipfile(CERTIFICATE_ZIP_FILE);
+  const std::vector<Certificate>& loaded_keys = GetOtaKeys().get();
   if (loaded_keys.empty()) {
     LOG(ERROR) << "Failed to load keys";
     return false;
   }
-  LOG(INFO) << loaded_keys.size() << " key(s) loaded from " << CERTIFICATE_ZIP_FILE;
 
   // Verify package.
   ui->Print("Verifying update package...\n");
@@ -764,6 +994,10 @@ bool verify_package(Package* package, RecoveryUI* ui) {
   int err = verify_file(package, loaded_keys);
   std::chrono::duration<double> duration = std::chrono::system_clock::now() - t0;
   ui->Print("Update package verification took %.1f s (result %d).\n", duration.count(), err);
+  RecoveryMetrics::Get().RecordDuration(
+      "package_verification", std::chrono::duration_cast<std::chrono::nanoseconds>(duration));
+  RecoveryMetrics::Get().IncrementCounter("package_verification_bytes",
+                                          static_cast<int64_t>(package->GetPackageSize()));
   if (err != VERIFY_SUCCESS) {
     LOG(ERROR) << "Signature verification failed";
     LOG(ERROR) << "error: " << kZipVerificationFailure;
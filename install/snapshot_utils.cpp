@@ -21,6 +21,7 @@
 
 #include "recovery_ui/device.h"
 #include "recovery_ui/ui.h"
+#include "recovery_utils/metrics.h"
 #include "recovery_utils/roots.h"
 
 using android::snapshot::CreateResult;
@@ -66,6 +67,11 @@ bool CreateSnapshotPartitions() {
     return true;
   }
 
+  // The device-mapper setup for every snapshot partition happens inside this libsnapshot call, so
+  // a dynamic super with many partitions can stall here for seconds before any install or mount
+  // proceeds. Time it so regressions (and wins from libsnapshot-side parallel mapping) show up in
+  // the metrics file.
+  ScopedMetricTimer timer("snapshot_create_devices");
   auto ret = sm->RecoveryCreateSnapshotDevices();
   if (ret == CreateResult::ERROR) {
     return false;
@@ -22,6 +22,7 @@
 #include <sys/ioctl.h>
 
 #include <functional>
+#include <future>
 #include <vector>
 
 #include <android-base/file.h>
@@ -32,6 +33,8 @@
 
 #include "bootloader_message/bootloader_message.h"
 #include "install/snapshot_utils.h"
+#include "otautil/performance_mode.h"
+#include "otautil/sysutil.h"
 #include "recovery_ui/ui.h"
 #include "recovery_utils/logging.h"
 #include "recovery_utils/roots.h"
@@ -58,14 +61,14 @@ static bool EraseVolume(const char* volume, RecoveryUI* ui, std::string_view new
     android::dm::DeviceMapper& dm = android::dm::DeviceMapper::Instance();
 
     map_logical_partitions();
-    // map_logical_partitions is non-blocking, so check for some limited time
-    // if it succeeded
-    for (int i = 0; i < 500; i++) {
-      if (vol->blk_device[0] == '/' ||
-          dm.GetState(vol->blk_device) == android::dm::DmDeviceState::ACTIVE)
-        break;
-      std::this_thread::sleep_for(std::chrono::milliseconds(1));
-    }
+    // map_logical_partitions is non-blocking, so wait for some limited time until it succeeds,
+    // waking on uevents as the dm devices get announced rather than polling.
+    WaitForDevice(
+        [&]() {
+          return vol->blk_device[0] == '/' ||
+                 dm.GetState(vol->blk_device) == android::dm::DmDeviceState::ACTIVE;
+        },
+        std::chrono::milliseconds(500));
 
     if (vol->blk_device[0] != '/' && !dm.GetDmDevicePathByName(vol->blk_device, &vol->blk_device)) {
       PLOG(ERROR) << "Failed to find dm device path for " << vol->blk_device;
@@ -100,7 +103,22 @@ static bool EraseVolume(const char* volume, RecoveryUI* ui, std::string_view new
     return false;
   }
 
-  int result = format_volume(volume, "", new_fstype);
+  // format_volume() reports coarse progress (interpolated from the mkfs tool's write position),
+  // so show a real bar instead of the spinner while it runs.
+  std::string last_phase;
+  FormatProgressCallback progress = [&](const std::string& phase, float fraction) {
+    if (phase != last_phase) {
+      last_phase = phase;
+      ui->Print(" - %s\n", phase.c_str());
+    }
+    ui->SetProgress(fraction);
+  };
+  ui->SetProgressType(RecoveryUI::DETERMINATE);
+  ui->ShowProgress(1.0, 0);
+
+  int result = format_volume(volume, "", new_fstype, progress);
+
+  ui->SetProgressType(RecoveryUI::INDETERMINATE);
 
   if (is_cache) {
     RestoreLogFilesAfterFormat(log_files);
@@ -125,6 +143,7 @@ bool WipeCache(RecoveryUI* ui, const std::function<bool()>& confirm_func,
   ui->SetBackground(RecoveryUI::ERASING);
   ui->SetProgressType(RecoveryUI::INDETERMINATE);
 
+  PerformanceMode performance_mode;
   bool success = EraseVolume("/cache", ui, new_fstype);
   ui->Print("Cache wipe %s.\n", success ? "complete" : "failed");
   return success;
@@ -132,6 +151,7 @@ bool WipeCache(RecoveryUI* ui, const std::function<bool()>& confirm_func,
 
 bool WipeData(Device* device, bool keep_memtag_mode, std::string_view data_fstype) {
   RecoveryUI* ui = device->GetUI();
+  PerformanceMode performance_mode;
   ui->Print("\n-- Wiping data %.*s...\n", static_cast<int>(data_fstype.size()), data_fstype.data());
   ui->SetBackground(RecoveryUI::ERASING);
   ui->SetProgressType(RecoveryUI::INDETERMINATE);
@@ -143,13 +163,21 @@ bool WipeData(Device* device, bool keep_memtag_mode, std::string_view data_fstyp
 
   bool success = device->PreWipeData();
   if (success) {
-    success &= EraseVolume(DATA_ROOT, ui, data_fstype);
-    bool has_cache = volume_for_mount_point("/cache") != nullptr;
-    if (has_cache) {
-      success &= EraseVolume(CACHE_ROOT, ui, data_fstype);
+    // The volumes are independent, so erase them concurrently; the small cache and metadata
+    // wipes finish in the shadow of the /data one.
+    std::vector<std::future<bool>> wipes;
+    wipes.push_back(std::async(std::launch::async,
+                               [&] { return EraseVolume(DATA_ROOT, ui, data_fstype); }));
+    if (volume_for_mount_point("/cache") != nullptr) {
+      wipes.push_back(std::async(std::launch::async,
+                                 [&] { return EraseVolume(CACHE_ROOT, ui, data_fstype); }));
     }
     if (volume_for_mount_point(METADATA_ROOT) != nullptr) {
-      success &= EraseVolume(METADATA_ROOT, ui, data_fstype);
+      wipes.push_back(std::async(std::launch::async,
+                                 [&] { return EraseVolume(METADATA_ROOT, ui, data_fstype); }));
+    }
+    for (auto& wipe : wipes) {
+      success &= wipe.get();
     }
   }
   if (keep_memtag_mode) {
@@ -176,6 +204,7 @@ bool WipeSystem(RecoveryUI* ui, const std::function<bool()>& confirm_func,
   }
 
   ui->Print("\n-- Wiping system...\n");
+  PerformanceMode performance_mode;
   bool success = EraseVolume(android::fs_mgr::GetSystemRoot().c_str(), ui, new_fstype);
   ui->Print("System wipe %s.\n", success ? "complete" : "failed");
   return success;
@@ -20,6 +20,10 @@
 #include <stdio.h>
 #include <string.h>
 
+#include <string>
+
+#include <android-base/stringprintf.h>
+
 #include "adb.h"
 #include "adb_io.h"
 
@@ -37,3 +41,25 @@ bool FuseAdbDataProvider::ReadBlockAlignedData(uint8_t* buffer, uint32_t fetch_s
 
   return true;
 }
+
+bool FuseAdbDataProvider::ReadBlocksAlignedData(uint8_t* buffer, uint32_t fetch_size,
+                                                uint32_t start_block, uint32_t block_count) const {
+  // The host serves the 8-byte block requests on this stream one at a time, in order, so all the
+  // requests can be written up front and the replies streamed back without a round trip per
+  // block. This keeps the link busy for the whole span.
+  std::string requests;
+  for (uint32_t i = 0; i < block_count; ++i) {
+    android::base::StringAppendF(&requests, "%08u", start_block + i);
+  }
+  if (!WriteFdExactly(fd_, requests.data(), requests.size())) {
+    fprintf(stderr, "failed to write to adb host: %s\n", strerror(errno));
+    return false;
+  }
+
+  if (!ReadFdExactly(fd_, buffer, fetch_size)) {
+    fprintf(stderr, "failed to read from adb host: %s\n", strerror(errno));
+    return false;
+  }
+
+  return true;
+}
@@ -29,6 +29,9 @@ class FuseAdbDataProvider : public FuseDataProvider {
   bool ReadBlockAlignedData(uint8_t* buffer, uint32_t fetch_size,
                             uint32_t start_block) const override;
 
+  bool ReadBlocksAlignedData(uint8_t* buffer, uint32_t fetch_size, uint32_t start_block,
+                             uint32_t block_count) const override;
+
   bool Valid() const override {
     return fd_ != -1;
   }
@@ -110,16 +110,22 @@ static MinadbdErrorCode RunAdbFuseSideload(int sfd, const std::string& args,
 
   LOG(INFO) << "sideload-host file size " << file_size << ", block size " << block_size;
 
-  if (!WriteCommandToFd(MinadbdCommand::kInstall, minadbd_socket)) {
-    return kMinadbdSocketIOError;
-  }
-
+  // Announce the install command only once the FUSE is mounted, so recovery finds the package
+  // path on its first open instead of polling for the mount to appear.
+  bool command_sent = false;
   auto adb_data_reader = std::make_unique<FuseAdbDataProvider>(sfd, file_size, block_size);
-  if (int result = run_fuse_sideload(std::move(adb_data_reader), sideload_mount_point.c_str());
+  if (int result = run_fuse_sideload(std::move(adb_data_reader), sideload_mount_point.c_str(),
+                                     [&command_sent]() {
+                                       command_sent =
+                                           WriteCommandToFd(MinadbdCommand::kInstall, minadbd_socket);
+                                     });
       result != 0) {
     LOG(ERROR) << "Failed to start fuse";
     return kMinadbdFuseStartError;
   }
+  if (!command_sent) {
+    return kMinadbdSocketIOError;
+  }
 
   if (!WaitForCommandStatus(minadbd_socket, status)) {
     return kMinadbdMessageFormatError;
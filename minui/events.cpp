@@ -28,8 +28,10 @@
 #include <unistd.h>
 
 #include <functional>
+#include <future>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include <android-base/properties.h>
 #include <android-base/strings.h>
@@ -50,6 +52,10 @@ constexpr size_t BITS_TO_LONGS(size_t bits) {
 struct FdInfo {
   android::base::unique_fd fd;
   ev_callback cb;
+  // The device's event capability bits (EVIOCGBIT(0, ...)), captured when it was probed. evdev
+  // capabilities are fixed for the lifetime of the node, so the iterate/sync helpers read these
+  // instead of re-querying every device on every call. All zero for non-evdev fds.
+  unsigned long ev_bits[BITS_TO_LONGS(EV_MAX)];  // NOLINT
 };
 
 static bool g_allow_touch_inputs = true;
@@ -69,19 +75,11 @@ static bool should_skip_ev_rel() {
   return prop;
 }
 
-static bool test_bit(size_t bit, unsigned long* array) { // NOLINT
+static bool test_bit(size_t bit, const unsigned long* array) { // NOLINT
   return (array[bit / BITS_PER_LONG] & (1UL << (bit % BITS_PER_LONG))) != 0;
 }
 
-static bool should_add_input_device(int fd, bool allow_touch_inputs) {
-  // Use unsigned long to match ioctl's parameter type.
-  unsigned long ev_bits[BITS_TO_LONGS(EV_MAX)];  // NOLINT
-
-  // Read the evbits of the input device.
-  if (ioctl(fd, EVIOCGBIT(0, sizeof(ev_bits)), ev_bits) == -1) {
-    return false;
-  }
-
+static bool should_add_input_device(const unsigned long* ev_bits, bool allow_touch_inputs) {
   // We assume that only EV_ABS, EV_KEY, EV_REL, and EV_SW event types are ever needed.
   // EV_ABS is only allowed if allow_touch_inputs is set.
   // EV_REL can be explicitly disallowed. This is needed to skip sensor inputs on some devices.
@@ -139,7 +137,9 @@ static int inotify_cb(int fd, __unused uint32_t epevents) {
       break;
     }
 
-    if (!should_add_input_device(dfd, g_allow_touch_inputs)) {
+    unsigned long ev_bits[BITS_TO_LONGS(EV_MAX)] = {};  // NOLINT
+    if (ioctl(dfd, EVIOCGBIT(0, sizeof(ev_bits)), ev_bits) == -1 ||
+        !should_add_input_device(ev_bits, g_allow_touch_inputs)) {
       continue;
     }
 
@@ -172,27 +172,52 @@ int ev_init(ev_callback input_cb, bool allow_touch_inputs) {
     return -1;
   }
 
-  bool epoll_ctl_failed = false;
   dirent* de;
+  std::vector<std::string> names;
   while ((de = readdir(dir.get())) != nullptr) {
     if (strncmp(de->d_name, "event", 5)) continue;
-    android::base::unique_fd fd(openat(dirfd(dir.get()), de->d_name, O_RDONLY | O_CLOEXEC));
-    if (fd == -1) continue;
+    names.emplace_back(de->d_name);
+  }
 
-    if (!should_add_input_device(fd, allow_touch_inputs)) {
+  // Probe the nodes concurrently: both the open() and the capability query can block in the
+  // driver, and boards routinely expose dozens of event nodes. Registration happens below on
+  // this thread, in directory order, once all probes have joined.
+  struct ProbedDevice {
+    android::base::unique_fd fd;
+    unsigned long ev_bits[BITS_TO_LONGS(EV_MAX)] = {};  // NOLINT
+    bool usable = false;
+  };
+  std::vector<ProbedDevice> probed(names.size());
+  {
+    std::vector<std::future<void>> probes;
+    for (size_t i = 0; i < names.size(); ++i) {
+      probes.emplace_back(std::async(std::launch::async, [&names, &probed, &dir, i]() {
+        ProbedDevice& dev = probed[i];
+        dev.fd.reset(openat(dirfd(dir.get()), names[i].c_str(), O_RDONLY | O_CLOEXEC));
+        if (dev.fd == -1) return;
+        dev.usable = ioctl(dev.fd, EVIOCGBIT(0, sizeof(dev.ev_bits)), dev.ev_bits) != -1;
+      }));
+    }
+    // The futures' destructors join the probes.
+  }
+
+  bool epoll_ctl_failed = false;
+  for (auto& dev : probed) {
+    if (!dev.usable || !should_add_input_device(dev.ev_bits, allow_touch_inputs)) {
       continue;
     }
 
     epoll_event ev;
     ev.events = EPOLLIN | EPOLLWAKEUP;
     ev.data.ptr = &ev_fdinfo[g_ev_count];
-    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, dev.fd, &ev) == -1) {
       epoll_ctl_failed = true;
       continue;
     }
 
-    ev_fdinfo[g_ev_count].fd.reset(fd.release());
+    ev_fdinfo[g_ev_count].fd.reset(dev.fd.release());
     ev_fdinfo[g_ev_count].cb = input_cb;
+    memcpy(ev_fdinfo[g_ev_count].ev_bits, dev.ev_bits, sizeof(dev.ev_bits));
     g_ev_count++;
     g_ev_dev_count++;
     if (g_ev_dev_count == MAX_DEVICES) break;
@@ -227,6 +252,7 @@ int ev_add_fd(android::base::unique_fd&& fd, ev_callback cb) {
   if (!ret) {
     ev_fdinfo[g_ev_count].fd.reset(fd.release());
     ev_fdinfo[g_ev_count].cb = std::move(cb);
+    memset(ev_fdinfo[g_ev_count].ev_bits, 0, sizeof(ev_fdinfo[g_ev_count].ev_bits));
     g_ev_count++;
     g_ev_misc_count++;
   }
@@ -263,10 +289,17 @@ void ev_dispatch(void) {
 }
 
 int ev_get_input(int fd, uint32_t epevents, input_event* ev) {
+  int count = ev_get_input_events(fd, epevents, ev, 1);
+  return (count == 1) ? 0 : -1;
+}
+
+int ev_get_input_events(int fd, uint32_t epevents, input_event* evs, size_t max_events) {
   if (epevents & EPOLLIN) {
-    ssize_t r = TEMP_FAILURE_RETRY(read(fd, ev, sizeof(*ev)));
-    if (r == sizeof(*ev)) {
-      return 0;
+    // evdev reads return as many whole events as fit the buffer, so one read drains a flood of
+    // queued events in a single wake instead of one epoll round trip per event.
+    ssize_t r = TEMP_FAILURE_RETRY(read(fd, evs, max_events * sizeof(evs[0])));
+    if (r > 0 && r % sizeof(evs[0]) == 0) {
+      return r / sizeof(evs[0]);
     }
   }
   if (epevents & EPOLLHUP) {
@@ -278,19 +311,13 @@ int ev_get_input(int fd, uint32_t epevents, input_event* ev) {
 
 int ev_sync_sw_state(const ev_set_sw_callback& set_sw_cb) {
   // Use unsigned long to match ioctl's parameter type.
-  unsigned long ev_bits[BITS_TO_LONGS(EV_MAX)];  // NOLINT
   unsigned long sw_bits[BITS_TO_LONGS(SW_MAX)];  // NOLINT
 
   for (size_t i = 0; i < g_ev_dev_count; ++i) {
-    memset(ev_bits, 0, sizeof(ev_bits));
-    memset(sw_bits, 0, sizeof(sw_bits));
-
-    if (ioctl(ev_fdinfo[i].fd, EVIOCGBIT(0, sizeof(ev_bits)), ev_bits) == -1) {
-      continue;
-    }
-    if (!test_bit(EV_SW, ev_bits)) {
+    if (!test_bit(EV_SW, ev_fdinfo[i].ev_bits)) {
       continue;
     }
+    memset(sw_bits, 0, sizeof(sw_bits));
     if (ioctl(ev_fdinfo[i].fd, EVIOCGSW(sizeof(sw_bits)), sw_bits) == -1) {
       continue;
     }
@@ -307,19 +334,13 @@ int ev_sync_sw_state(const ev_set_sw_callback& set_sw_cb) {
 
 int ev_sync_key_state(const ev_set_key_callback& set_key_cb) {
   // Use unsigned long to match ioctl's parameter type.
-  unsigned long ev_bits[BITS_TO_LONGS(EV_MAX)];    // NOLINT
   unsigned long key_bits[BITS_TO_LONGS(KEY_MAX)];  // NOLINT
 
   for (size_t i = 0; i < g_ev_dev_count; ++i) {
-    memset(ev_bits, 0, sizeof(ev_bits));
-    memset(key_bits, 0, sizeof(key_bits));
-
-    if (ioctl(ev_fdinfo[i].fd, EVIOCGBIT(0, sizeof(ev_bits)), ev_bits) == -1) {
-      continue;
-    }
-    if (!test_bit(EV_KEY, ev_bits)) {
+    if (!test_bit(EV_KEY, ev_fdinfo[i].ev_bits)) {
       continue;
     }
+    memset(key_bits, 0, sizeof(key_bits));
     if (ioctl(ev_fdinfo[i].fd, EVIOCGKEY(sizeof(key_bits)), key_bits) == -1) {
       continue;
     }
@@ -336,21 +357,15 @@ int ev_sync_key_state(const ev_set_key_callback& set_key_cb) {
 
 void ev_iterate_available_keys(const std::function<void(int)>& key_detected) {
   // Use unsigned long to match ioctl's parameter type.
-  unsigned long ev_bits[BITS_TO_LONGS(EV_MAX)];    // NOLINT
   unsigned long key_bits[BITS_TO_LONGS(KEY_MAX)];  // NOLINT
 
   for (size_t i = 0; i < g_ev_dev_count; ++i) {
-    memset(ev_bits, 0, sizeof(ev_bits));
-    memset(key_bits, 0, sizeof(key_bits));
-
     // Does this device even have keys?
-    if (ioctl(ev_fdinfo[i].fd, EVIOCGBIT(0, sizeof(ev_bits)), ev_bits) == -1) {
-      continue;
-    }
-    if (!test_bit(EV_KEY, ev_bits)) {
+    if (!test_bit(EV_KEY, ev_fdinfo[i].ev_bits)) {
       continue;
     }
 
+    memset(key_bits, 0, sizeof(key_bits));
     if (ioctl(ev_fdinfo[i].fd, EVIOCGBIT(EV_KEY, KEY_MAX), key_bits) == -1) {
       continue;
     }
@@ -366,15 +381,11 @@ void ev_iterate_available_keys(const std::function<void(int)>& key_detected) {
 void ev_iterate_touch_inputs(const std::function<void(int)>& touch_device_detected,
                              const std::function<void(int)>& key_detected) {
   for (size_t i = 0; i < g_ev_dev_count; ++i) {
-    // Use unsigned long to match ioctl's parameter type.
-    unsigned long ev_bits[BITS_TO_LONGS(EV_MAX)] = {};  // NOLINT
-    if (ioctl(ev_fdinfo[i].fd, EVIOCGBIT(0, sizeof(ev_bits)), ev_bits) == -1) {
-      continue;
-    }
-    if (!test_bit(EV_ABS, ev_bits)) {
+    if (!test_bit(EV_ABS, ev_fdinfo[i].ev_bits)) {
       continue;
     }
 
+    // Use unsigned long to match ioctl's parameter type.
     unsigned long key_bits[BITS_TO_LONGS(KEY_MAX)] = {};  // NOLINT
     if (ioctl(ev_fdinfo[i].fd, EVIOCGBIT(EV_ABS, KEY_MAX), key_bits) == -1) {
       continue;
@@ -21,7 +21,17 @@
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <list>
 #include <memory>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include <android-base/properties.h>
 
@@ -38,17 +48,113 @@ static int overscan_offset_y = 0;
 
 static uint32_t gr_current = ~0;
 
-// gr_draw is owned by backends.
+// The backend's current back buffer; owned by backends.
+static GRSurface* gr_framebuffer = nullptr;
+// The surface the drawing primitives write into. Normally gr_framebuffer; gr_render_target()
+// points it at a client-owned surface instead.
 static GRSurface* gr_draw = nullptr;
 static GRRotation rotation = GRRotation::NONE;
 static GRRotation touch_rotation = GRRotation::NONE;
+
+// With a rotated panel the drawing primitives normally step pixel-by-pixel through the
+// rotation-aware helpers below. When the pre-rotated backbuffer is enabled (the default for
+// rotated panels; ro.minui.prerotated_backbuffer=false goes back to per-call rotation), drawing
+// instead happens unrotated into this logical-orientation buffer — so every row-based vector
+// kernel applies — and gr_flip() folds the rotation into one tiled copy to the framebuffer.
+static std::unique_ptr<GRSurface> prerotated_buffer;
+// What the drawing primitives apply: equal to |rotation|, or NONE while the pre-rotated
+// backbuffer is in use (the rotation then happens at flip time).
+static GRRotation draw_rotation = GRRotation::NONE;
+
+// The surface drawing calls should treat as the screen: the pre-rotated backbuffer if enabled,
+// the backend's framebuffer otherwise.
+static GRSurface* canonical_draw_target();
 static PixelFormat pixel_format = PixelFormat::UNKNOWN;
 // The graphics backend list that provides fallback options for the default backend selection.
 // For example, it will fist try DRM, then try FBDEV if DRM is unavailable.
 constexpr auto default_backends = { GraphicsBackend::DRM, GraphicsBackend::FBDEV };
 
+// Bounding box of everything drawn since the last flip, in physical framebuffer coordinates.
+// Backends that copy pixels on flip can skip the untouched part of the surface.
+static GRRect dirty_region = { 0, 0, 0, 0 };
+// What the previous flip drew; with a double-buffered backend the surface we draw into next was
+// displayed two flips ago, so it's stale over the previous frame's damage as well.
+static GRRect previous_dirty_region = { 0, 0, 0, 0 };
+
+// Optional per-row clip, set up by gr_set_clip_circle(): for each row, the [first, second) span
+// that may be drawn. Rows wholly outside the clip carry an empty span. Round wear panels use
+// this to skip the corner spans the display can't show. Only the unrotated (row-contiguous)
+// drawing paths consult it; wear devices don't rotate.
+static std::vector<std::pair<int, int>> row_clip;
+
+// The clip applies to the screen, not to client-owned offscreen targets.
+static bool clip_active() {
+  return !row_clip.empty() && gr_draw == canonical_draw_target();
+}
+
+// Intersects [*x1, *x2) with the clip span of row |y|. Returns false if nothing of the row
+// remains.
+static bool clip_row(int y, int* x1, int* x2) {
+  if (!clip_active()) return true;
+  if (y < 0 || y >= static_cast<int>(row_clip.size())) return false;
+  *x1 = std::max(*x1, row_clip[y].first);
+  *x2 = std::min(*x2, row_clip[y].second);
+  return *x1 < *x2;
+}
+
+static bool rect_empty(const GRRect& r) {
+  return r.left >= r.right || r.top >= r.bottom;
+}
+
+static GRRect rect_union(const GRRect& a, const GRRect& b) {
+  if (rect_empty(a)) return b;
+  if (rect_empty(b)) return a;
+  return { std::min(a.left, b.left), std::min(a.top, b.top), std::max(a.right, b.right),
+           std::max(a.bottom, b.bottom) };
+}
+
+// Maps a logical point to physical framebuffer coordinates, mirroring how PixelAt() addresses
+// pixels under the current rotation.
+static void physical_point(int x, int y, int* px, int* py) {
+  switch (draw_rotation) {
+    case GRRotation::RIGHT:
+      *px = gr_draw->width - y;
+      *py = x;
+      break;
+    case GRRotation::DOWN:
+      *px = gr_draw->width - 1 - x;
+      *py = gr_draw->height - 1 - y;
+      break;
+    case GRRotation::LEFT:
+      *px = y;
+      *py = gr_draw->height - 1 - x;
+      break;
+    default:  // GRRotation::NONE
+      *px = x;
+      *py = y;
+      break;
+  }
+}
+
+// Grows the dirty bounding box to cover the logical rectangle [x1, x2) x [y1, y2).
+static void mark_dirty(int x1, int y1, int x2, int y2) {
+  if (x1 >= x2 || y1 >= y2) return;
+  // Offscreen render targets don't contribute to framebuffer damage; the client's blit back into
+  // the framebuffer marks the real dirty region.
+  if (gr_draw != canonical_draw_target()) return;
+
+  int ax, ay, bx, by;
+  physical_point(x1, y1, &ax, &ay);
+  physical_point(x2 - 1, y2 - 1, &bx, &by);
+
+  GRRect damage = { std::max(0, std::min(ax, bx)), std::max(0, std::min(ay, by)),
+                    std::min(static_cast<int>(gr_draw->width), std::max(ax, bx) + 1),
+                    std::min(static_cast<int>(gr_draw->height), std::max(ay, by) + 1) };
+  dirty_region = rect_union(dirty_region, damage);
+}
+
 static bool outside(int x, int y) {
-  auto swapped = (rotation == GRRotation::LEFT || rotation == GRRotation::RIGHT);
+  auto swapped = (draw_rotation == GRRotation::LEFT || draw_rotation == GRRotation::RIGHT);
   return x < 0 || x >= (swapped ? gr_draw->height : gr_draw->width) || y < 0 ||
          y >= (swapped ? gr_draw->width : gr_draw->height);
 }
@@ -70,7 +176,15 @@ int gr_measure(const GRFont* font, const char* s) {
     return -1;
   }
 
-  return font->char_width * strlen(s);
+  int width = 0;
+  for (const char* p = s; *p; ++p) {
+    unsigned char ch = *p;
+    if (ch < ' ' || ch > '~') {
+      ch = '?';
+    }
+    width += font->advances[ch - ' '];
+  }
+  return width;
 }
 
 int gr_font_size(const GRFont* font, int* x, int* y) {
@@ -106,16 +220,18 @@ static inline uint32_t pixel_blend_rgba(uint8_t alpha, uint32_t pix) {
   if (alpha == 0) return pix;
   uint32_t pix_r = pix & 0xff00;
   uint32_t pix_g = pix & 0xff0000;
-  uint32_t pix_b = pix & 0xff000000;
+  // The blue channel must be blended on the byte value; the in-place product would overflow
+  // 32 bits.
+  uint32_t pix_b = pix >> 24;
   uint32_t cur_r = gr_current & 0xff00;
   uint32_t cur_g = gr_current & 0xff0000;
-  uint32_t cur_b = gr_current & 0xff000000;
+  uint32_t cur_b = gr_current >> 24;
 
   uint32_t out_r = (pix_r * (255 - alpha) + cur_r * alpha) / 255;
   uint32_t out_g = (pix_g * (255 - alpha) + cur_g * alpha) / 255;
   uint32_t out_b = (pix_b * (255 - alpha) + cur_b * alpha) / 255;
 
-  return (gr_current & 0xff) | (out_r & 0xff00) | (out_g & 0xff0000) | (out_b & 0xff000000);
+  return (gr_current & 0xff) | (out_r & 0xff00) | (out_g & 0xff0000) | ((out_b & 0xff) << 24);
 }
 
 static inline uint32_t pixel_blend(uint8_t alpha, uint32_t pix) {
@@ -143,13 +259,69 @@ static inline uint8_t get_alpha(uint32_t pix) {
   return static_cast<uint8_t>((pix & (gr_current & get_alphamask())) >> get_alpha_shift());
 }
 
+// Fills |count| contiguous pixels with gr_current, no blending. The trivial loop is kept in a
+// dedicated kernel so the full-screen fills vectorize instead of going through the generic
+// rotation-aware pointer stepping.
+static void FillRow(uint32_t* px, int count) {
+#if defined(__ARM_NEON)
+  uint32x4_t color = vdupq_n_u32(gr_current);
+  for (; count >= 4; count -= 4, px += 4) {
+    vst1q_u32(px, color);
+  }
+#endif
+  for (; count > 0; --count) {
+    *px++ = gr_current;
+  }
+}
+
+// The pixel layout is fixed once gr_init() reads ro.minui.pixel_format, and the only thing the
+// blend path cares about is where alpha lives: the low byte for RGBA, the high byte for every
+// other supported format. The blend kernels below are templates instantiated per layout and
+// selected once at init through function pointers, so their per-pixel loops compile to
+// straight-line code with the blend inlined instead of re-testing the format on every pixel.
+
+// Blends gr_current with constant |alpha| onto |count| contiguous pixels. Matches pixel_blend()
+// bit for bit: each color byte becomes (pix * (255 - alpha) + cur * alpha) / 255 and the alpha
+// byte is taken from gr_current, which is what a per-byte blend produces when the alpha lane's
+// factor is pinned to 255.
+template <uint32_t (*blend)(uint8_t, uint32_t), uint8_t alpha_shift>
+static void BlendConstRowImpl(uint32_t* px, int count, uint8_t alpha) {
+#if defined(__ARM_NEON)
+  uint32_t factor_word = alpha * 0x01010101u;
+  factor_word |= 0xffu << alpha_shift;
+
+  uint8x16_t vfactor = vreinterpretq_u8_u32(vdupq_n_u32(factor_word));
+  uint8x16_t vinv = vsubq_u8(vdupq_n_u8(255), vfactor);
+  uint8x16_t vcur = vreinterpretq_u8_u32(vdupq_n_u32(gr_current));
+  uint16x8_t one = vdupq_n_u16(1);
+
+  for (; count >= 4; count -= 4, px += 4) {
+    uint8x16_t vpix = vld1q_u8(reinterpret_cast<uint8_t*>(px));
+    // t = pix * (255 - alpha) + cur * alpha, then the exact /255: (t + (t >> 8) + 1) >> 8.
+    uint16x8_t lo = vmull_u8(vget_low_u8(vpix), vget_low_u8(vinv));
+    lo = vmlal_u8(lo, vget_low_u8(vcur), vget_low_u8(vfactor));
+    lo = vaddq_u16(vsraq_n_u16(lo, lo, 8), one);
+    uint16x8_t hi = vmull_u8(vget_high_u8(vpix), vget_high_u8(vinv));
+    hi = vmlal_u8(hi, vget_high_u8(vcur), vget_high_u8(vfactor));
+    hi = vaddq_u16(vsraq_n_u16(hi, hi, 8), one);
+    vst1q_u8(reinterpret_cast<uint8_t*>(px), vcombine_u8(vshrn_n_u16(lo, 8), vshrn_n_u16(hi, 8)));
+  }
+#endif
+  for (; count > 0; --count, ++px) {
+    *px = blend(alpha, *px);
+  }
+}
+
+static void (*BlendConstRow)(uint32_t* px, int count,
+                             uint8_t alpha) = BlendConstRowImpl<pixel_blend_argb, 24>;
+
 // Increments pixel pointer right, with current rotation.
 static void incr_x(uint32_t** p, int row_pixels) {
-  if (rotation == GRRotation::LEFT) {
+  if (draw_rotation == GRRotation::LEFT) {
     *p = *p - row_pixels;
-  } else if (rotation == GRRotation::RIGHT) {
+  } else if (draw_rotation == GRRotation::RIGHT) {
     *p = *p + row_pixels;
-  } else if (rotation == GRRotation::DOWN) {
+  } else if (draw_rotation == GRRotation::DOWN) {
     *p = *p - 1;
   } else {  // GRRotation::NONE
     *p = *p + 1;
@@ -158,11 +330,11 @@ static void incr_x(uint32_t** p, int row_pixels) {
 
 // Increments pixel pointer down, with current rotation.
 static void incr_y(uint32_t** p, int row_pixels) {
-  if (rotation == GRRotation::LEFT) {
+  if (draw_rotation == GRRotation::LEFT) {
     *p = *p + 1;
-  } else if (rotation == GRRotation::RIGHT) {
+  } else if (draw_rotation == GRRotation::RIGHT) {
     *p = *p - 1;
-  } else if (rotation == GRRotation::DOWN) {
+  } else if (draw_rotation == GRRotation::DOWN) {
     *p = *p - row_pixels;
   } else {  // GRRotation::NONE
     *p = *p + row_pixels;
@@ -171,7 +343,7 @@ static void incr_y(uint32_t** p, int row_pixels) {
 
 // Returns pixel pointer at given coordinates with rotation adjustment.
 static uint32_t* PixelAt(GRSurface* surface, int x, int y, int row_pixels) {
-  switch (rotation) {
+  switch (draw_rotation) {
     case GRRotation::NONE:
       return reinterpret_cast<uint32_t*>(surface->data()) + y * row_pixels + x;
     case GRRotation::RIGHT:
@@ -183,27 +355,104 @@ static uint32_t* PixelAt(GRSurface* surface, int x, int y, int row_pixels) {
       return reinterpret_cast<uint32_t*>(surface->data()) + (surface->height - 1 - x) * row_pixels +
              y;
     default:
-      printf("invalid rotation %d", static_cast<int>(rotation));
+      printf("invalid rotation %d", static_cast<int>(draw_rotation));
   }
   return nullptr;
 }
 
-static void TextBlend(const uint8_t* src_p, int src_row_bytes, uint32_t* dst_p, int dst_row_pixels,
-                      int width, int height) {
-  uint8_t alpha_current = get_alpha(gr_current);
+template <uint32_t (*blend)(uint8_t, uint32_t), uint8_t alpha_shift>
+static void TextBlendImpl(const uint8_t* src_p, int src_row_bytes, uint32_t* dst_p,
+                          int dst_row_pixels, int width, int height) {
+  uint8_t alpha_current = static_cast<uint8_t>((gr_current >> alpha_shift) & 0xff);
   for (int j = 0; j < height; ++j) {
     const uint8_t* sx = src_p;
     uint32_t* px = dst_p;
     for (int i = 0; i < width; ++i, incr_x(&px, dst_row_pixels)) {
       uint8_t a = *sx++;
       if (alpha_current < 255) a = (static_cast<uint32_t>(a) * alpha_current) / 255;
-      *px = pixel_blend(a, *px);
+      *px = blend(a, *px);
     }
     src_p += src_row_bytes;
     incr_y(&dst_p, dst_row_pixels);
   }
 }
 
+static void (*TextBlend)(const uint8_t* src_p, int src_row_bytes, uint32_t* dst_p,
+                         int dst_row_pixels, int width,
+                         int height) = TextBlendImpl<pixel_blend_argb, 24>;
+
+// Applies the row clip to a text blend. With no clip active this is one contiguous blend; with a
+// clip, each row blends only the span inside it. (|x|, |y|) is where the block lands on screen.
+static void TextBlendClipped(const uint8_t* src_p, int src_row_bytes, uint32_t* dst_p,
+                             int dst_row_pixels, int width, int height, int x, int y) {
+  if (!clip_active()) {
+    TextBlend(src_p, src_row_bytes, dst_p, dst_row_pixels, width, height);
+    return;
+  }
+  for (int j = 0; j < height; ++j) {
+    int cx1 = x, cx2 = x + width;
+    if (clip_row(y + j, &cx1, &cx2)) {
+      TextBlend(src_p + j * src_row_bytes + (cx1 - x), src_row_bytes,
+                dst_p + j * dst_row_pixels + (cx1 - x), dst_row_pixels, cx2 - cx1, 1);
+    }
+  }
+}
+
+// Cache of composed glyph runs, keyed by font, boldness and text. An entry holds the run's alpha
+// coverage (1 byte per pixel, glyph cells side by side), so redrawing a line that was rendered
+// before - menu redraws draw the same strings every frame - costs one contiguous blend instead of
+// per-character gathers from the font texture. Entries are kept in LRU order.
+static constexpr size_t kGlyphRunCacheEntries = 64;
+
+struct GlyphRun {
+  std::string key;
+  std::unique_ptr<GRSurface> mask;
+};
+
+static std::list<GlyphRun> glyph_run_cache;
+
+// Returns the alpha mask for |s| rendered with |font|, composing (and caching) it on first use.
+// Returns nullptr if the mask can't be allocated.
+static const GRSurface* GlyphRunFor(const GRFont* font, const char* s, bool bold) {
+  std::string key = std::to_string(reinterpret_cast<uintptr_t>(font)) + (bold ? "/b/" : "/r/") + s;
+  for (auto it = glyph_run_cache.begin(); it != glyph_run_cache.end(); ++it) {
+    if (it->key == key) {
+      glyph_run_cache.splice(glyph_run_cache.begin(), glyph_run_cache, it);
+      return it->mask.get();
+    }
+  }
+
+  size_t len = strlen(s);
+  int run_width = gr_measure(font, s);
+  if (run_width <= 0) return nullptr;
+  auto mask = GRSurface::Create(run_width, font->char_height, run_width, 1);
+  if (!mask) return nullptr;
+
+  int pen = 0;
+  for (size_t i = 0; i < len; ++i) {
+    unsigned char ch = s[i];
+    if (ch < ' ' || ch > '~') {
+      ch = '?';
+    }
+    // A glyph's ink always fits within its advance, so copying |advance| columns can't clip it
+    // or step on the neighboring glyph.
+    int advance = font->advances[ch - ' '];
+    const uint8_t* src_p = font->texture->data() + ((ch - ' ') * font->char_width) +
+                           (bold ? font->char_height * font->texture->row_bytes : 0);
+    uint8_t* dst_p = mask->data() + pen;
+    for (int j = 0; j < font->char_height; ++j) {
+      memcpy(dst_p + j * mask->row_bytes, src_p + j * font->texture->row_bytes, advance);
+    }
+    pen += advance;
+  }
+
+  glyph_run_cache.push_front({ std::move(key), std::move(mask) });
+  if (glyph_run_cache.size() > kGlyphRunCacheEntries) {
+    glyph_run_cache.pop_back();
+  }
+  return glyph_run_cache.front().mask.get();
+}
+
 void gr_text(const GRFont* font, int x, int y, const char* s, bool bold) {
   if (!font || !font->texture || (gr_current & get_alphamask()) == 0) return;
 
@@ -217,24 +466,54 @@ void gr_text(const GRFont* font, int x, int y, const char* s, bool bold) {
   x += overscan_offset_x;
   y += overscan_offset_y;
 
+  // Count the glyphs that fit, with the same clipping the per-glyph path applies.
+  size_t visible = 0;
+  int visible_width = 0;
+  for (int cx = x; s[visible];) {
+    unsigned char ch = s[visible];
+    if (ch < ' ' || ch > '~') {
+      ch = '?';
+    }
+    int advance = font->advances[ch - ' '];
+    if (outside(cx, y) || outside(cx + advance - 1, y + font->char_height - 1)) break;
+    ++visible;
+    cx += advance;
+    visible_width = cx - x;
+  }
+  if (visible == 0) return;
+
+  // A cached run covers the full string; a clipped draw blends just its prefix.
+  if (const GRSurface* run = GlyphRunFor(font, s, bold)) {
+    int row_pixels = gr_draw->row_bytes / gr_draw->pixel_bytes;
+    TextBlendClipped(run->data(), run->row_bytes, PixelAt(gr_draw, x, y, row_pixels), row_pixels,
+                     visible_width, font->char_height, x, y);
+    mark_dirty(x, y, x + visible_width, y + font->char_height);
+    return;
+  }
+
+  // Mask allocation failed; draw straight from the font texture.
+  int start_x = x;
   unsigned char ch;
   while ((ch = *s++)) {
-    if (outside(x, y) || outside(x + font->char_width - 1, y + font->char_height - 1)) break;
-
     if (ch < ' ' || ch > '~') {
       ch = '?';
     }
 
+    int advance = font->advances[ch - ' '];
+    if (outside(x, y) || outside(x + advance - 1, y + font->char_height - 1)) break;
+
     int row_pixels = gr_draw->row_bytes / gr_draw->pixel_bytes;
     const uint8_t* src_p = font->texture->data() + ((ch - ' ') * font->char_width) +
                            (bold ? font->char_height * font->texture->row_bytes : 0);
     uint32_t* dst_p = PixelAt(gr_draw, x, y, row_pixels);
 
-    TextBlend(src_p, font->texture->row_bytes, dst_p, row_pixels, font->char_width,
-              font->char_height);
+    TextBlendClipped(src_p, font->texture->row_bytes, dst_p, row_pixels, advance,
+                     font->char_height, x, y);
 
-    x += font->char_width;
+    x += advance;
   }
+
+  mark_dirty(start_x, y, x, y + font->char_height);
 }
 
 void gr_texticon(int x, int y, const GRSurface* icon) {
@@ -253,7 +532,8 @@ void gr_texticon(int x, int y, const GRSurface* icon) {
   int row_pixels = gr_draw->row_bytes / gr_draw->pixel_bytes;
   const uint8_t* src_p = icon->data();
   uint32_t* dst_p = PixelAt(gr_draw, x, y, row_pixels);
-  TextBlend(src_p, icon->row_bytes, dst_p, row_pixels, icon->width, icon->height);
+  TextBlendClipped(src_p, icon->row_bytes, dst_p, row_pixels, icon->width, icon->height, x, y);
+  mark_dirty(x, y, x + icon->width, y + icon->height);
 }
 
 void gr_color(unsigned char r, unsigned char g, unsigned char b, unsigned char a) {
@@ -269,21 +549,24 @@ void gr_color(unsigned char r, unsigned char g, unsigned char b, unsigned char a
 }
 
 void gr_clear() {
-  if ((gr_current & 0xff) == ((gr_current >> 8) & 0xff) &&
+  if (!clip_active() && (gr_current & 0xff) == ((gr_current >> 8) & 0xff) &&
       (gr_current & 0xff) == ((gr_current >> 16) & 0xff) &&
       (gr_current & 0xff) == ((gr_current >> 24) & 0xff) &&
       gr_draw->row_bytes == gr_draw->width * gr_draw->pixel_bytes) {
     memset(gr_draw->data(), gr_current & 0xff, gr_draw->height * gr_draw->row_bytes);
   } else {
     uint32_t* px = reinterpret_cast<uint32_t*>(gr_draw->data());
-    int row_diff = gr_draw->row_bytes / gr_draw->pixel_bytes - gr_draw->width;
-    for (int y = 0; y < gr_draw->height; ++y) {
-      for (int x = 0; x < gr_draw->width; ++x) {
-        *px++ = gr_current;
+    int row_pixels = gr_draw->row_bytes / gr_draw->pixel_bytes;
+    for (int y = 0; y < gr_draw->height; ++y, px += row_pixels) {
+      int cx1 = 0, cx2 = gr_draw->width;
+      if (clip_row(y, &cx1, &cx2)) {
+        FillRow(px + cx1, cx2 - cx1);
       }
-      px += row_diff;
     }
   }
+  if (gr_draw == canonical_draw_target()) {
+    dirty_region = { 0, 0, static_cast<int>(gr_draw->width), static_cast<int>(gr_draw->height) };
+  }
 }
 
 void gr_fill(int x1, int y1, int x2, int y2) {
@@ -298,15 +581,31 @@ void gr_fill(int x1, int y1, int x2, int y2) {
   int row_pixels = gr_draw->row_bytes / gr_draw->pixel_bytes;
   uint32_t* p = PixelAt(gr_draw, x1, y1, row_pixels);
   uint8_t alpha = get_alpha(gr_current);
-  if (alpha > 0) {
-    for (int y = y1; y < y2; ++y) {
-      uint32_t* px = p;
-      for (int x = x1; x < x2; ++x) {
-        *px = pixel_blend(alpha, *px);
-        incr_x(&px, row_pixels);
+  if (alpha == 0) return;
+
+  mark_dirty(x1, y1, x2, y2);
+
+  if (draw_rotation == GRRotation::NONE) {
+    // Unrotated rows are contiguous, so each row can go through the vector kernels.
+    for (int y = y1; y < y2; ++y, p += row_pixels) {
+      int cx1 = x1, cx2 = x2;
+      if (!clip_row(y, &cx1, &cx2)) continue;
+      if (alpha == 255) {
+        FillRow(p + (cx1 - x1), cx2 - cx1);
+      } else {
+        BlendConstRow(p + (cx1 - x1), cx2 - cx1, alpha);
       }
-      incr_y(&p, row_pixels);
     }
+    return;
+  }
+
+  for (int y = y1; y < y2; ++y) {
+    uint32_t* px = p;
+    for (int x = x1; x < x2; ++x) {
+      *px = pixel_blend(alpha, *px);
+      incr_x(&px, row_pixels);
+    }
+    incr_y(&p, row_pixels);
   }
 }
 
@@ -323,7 +622,9 @@ void gr_blit(const GRSurface* source, int sx, int sy, int w, int h, int dx, int
 
   if (outside(dx, dy) || outside(dx + w - 1, dy + h - 1)) return;
 
-  if (rotation != GRRotation::NONE) {
+  mark_dirty(dx, dy, dx + w, dy + h);
+
+  if (draw_rotation != GRRotation::NONE) {
     int src_row_pixels = source->row_bytes / source->pixel_bytes;
     int row_pixels = gr_draw->row_bytes / gr_draw->pixel_bytes;
     const uint32_t* src_py =
@@ -345,7 +646,11 @@ void gr_blit(const GRSurface* source, int sx, int sy, int w, int h, int dx, int
     uint8_t* dst_p = gr_draw->data() + dy * gr_draw->row_bytes + dx * gr_draw->pixel_bytes;
 
     for (int i = 0; i < h; ++i) {
-      memcpy(dst_p, src_p, w * source->pixel_bytes);
+      int cx1 = dx, cx2 = dx + w;
+      if (clip_row(dy + i, &cx1, &cx2)) {
+        memcpy(dst_p + (cx1 - dx) * source->pixel_bytes, src_p + (cx1 - dx) * source->pixel_bytes,
+               (cx2 - cx1) * source->pixel_bytes);
+      }
       src_p += source->row_bytes;
       dst_p += gr_draw->row_bytes;
     }
@@ -384,13 +689,224 @@ int gr_init_font(const char* name, GRFont** dest) {
   font->char_width = font->texture->width / 96;
   font->char_height = font->texture->height / 2;
 
+  // By default every glyph advances a full cell, preserving the fixed-width rendering. With
+  // ro.minui.proportional_text each advance is derived once here from the glyph's ink width
+  // (across both the regular and bold rows), so proportional layout needs no per-draw
+  // measurement. The cell fonts carry no kerning data, so advances are the whole story.
+  bool proportional = android::base::GetBoolProperty("ro.minui.proportional_text", false);
+  for (int i = 0; i < 96; ++i) {
+    font->advances[i] = font->char_width;
+    if (!proportional) continue;
+
+    int ink = 0;
+    for (size_t row = 0; row < font->texture->height; ++row) {
+      const uint8_t* cell = font->texture->data() + row * font->texture->row_bytes +
+                            i * font->char_width;
+      for (int col = font->char_width - 1; col >= ink; --col) {
+        if (cell[col] != 0) {
+          ink = col + 1;
+          break;
+        }
+      }
+    }
+    // Blank cells (the space) keep the full cell advance; inked glyphs get one pixel of side
+    // bearing.
+    if (ink > 0) {
+      font->advances[i] = std::min(font->char_width, ink + 1);
+    }
+  }
+
   *dest = font;
 
   return 0;
 }
 
+static GRSurface* canonical_draw_target() {
+  return prerotated_buffer ? prerotated_buffer.get() : gr_framebuffer;
+}
+
+// Tile edge for the rotate copies below: big enough that the vector kernels get full runs,
+// small enough that a tile's worth of source rows stays in L1 while the transposed writes
+// stream out.
+constexpr int kRotateTile = 32;
+
+// The three flush kernels copy a logical rectangle from the pre-rotated backbuffer into the
+// physical framebuffer, applying the panel rotation. They iterate so the framebuffer writes are
+// always sequential (that side is often uncached), with the strided reads confined to one tile.
+// On NEON the RIGHT/LEFT cases run a 4x4 in-register transpose, so both the loads and the
+// stores are full vectors.
+
+// RIGHT: logical (x, y) -> physical (W - 1 - y, x).
+static void FlushRight(const uint32_t* src, int ss, uint32_t* dst, int ds, int W,
+                       const GRRect& r) {
+  for (int ty = r.top; ty < r.bottom; ty += kRotateTile) {
+    int yend = std::min(ty + kRotateTile, r.bottom);
+    for (int tx = r.left; tx < r.right; tx += kRotateTile) {
+      int xend = std::min(tx + kRotateTile, r.right);
+      int x = tx;
+#if defined(__ARM_NEON)
+      for (; x + 4 <= xend; x += 4) {
+        int y = ty;
+        for (; y + 4 <= yend; y += 4) {
+          // Rows loaded bottom-up so the transposed columns come out in descending-y order,
+          // which is ascending memory order in the destination rows.
+          uint32x4_t q0 = vld1q_u32(src + (y + 3) * ss + x);
+          uint32x4_t q1 = vld1q_u32(src + (y + 2) * ss + x);
+          uint32x4_t q2 = vld1q_u32(src + (y + 1) * ss + x);
+          uint32x4_t q3 = vld1q_u32(src + y * ss + x);
+          uint32x4x2_t t01 = vtrnq_u32(q0, q1);
+          uint32x4x2_t t23 = vtrnq_u32(q2, q3);
+          uint32_t* d = dst + x * ds + (W - 4 - y);
+          vst1q_u32(d, vcombine_u32(vget_low_u32(t01.val[0]), vget_low_u32(t23.val[0])));
+          vst1q_u32(d + ds, vcombine_u32(vget_low_u32(t01.val[1]), vget_low_u32(t23.val[1])));
+          vst1q_u32(d + 2 * ds, vcombine_u32(vget_high_u32(t01.val[0]), vget_high_u32(t23.val[0])));
+          vst1q_u32(d + 3 * ds, vcombine_u32(vget_high_u32(t01.val[1]), vget_high_u32(t23.val[1])));
+        }
+        for (; y < yend; ++y) {
+          for (int i = 0; i < 4; ++i) {
+            dst[(x + i) * ds + (W - 1 - y)] = src[y * ss + (x + i)];
+          }
+        }
+      }
+#endif
+      for (; x < xend; ++x) {
+        uint32_t* d = dst + x * ds + (W - yend);
+        const uint32_t* s = src + (yend - 1) * ss + x;
+        for (int y = yend - 1; y >= ty; --y, ++d, s -= ss) {
+          *d = *s;
+        }
+      }
+    }
+  }
+}
+
+// LEFT: logical (x, y) -> physical (y, H - 1 - x).
+static void FlushLeft(const uint32_t* src, int ss, uint32_t* dst, int ds, int H, const GRRect& r) {
+  for (int ty = r.top; ty < r.bottom; ty += kRotateTile) {
+    int yend = std::min(ty + kRotateTile, r.bottom);
+    for (int tx = r.left; tx < r.right; tx += kRotateTile) {
+      int xend = std::min(tx + kRotateTile, r.right);
+      int x = tx;
+#if defined(__ARM_NEON)
+      for (; x + 4 <= xend; x += 4) {
+        int y = ty;
+        for (; y + 4 <= yend; y += 4) {
+          uint32x4_t q0 = vld1q_u32(src + y * ss + x);
+          uint32x4_t q1 = vld1q_u32(src + (y + 1) * ss + x);
+          uint32x4_t q2 = vld1q_u32(src + (y + 2) * ss + x);
+          uint32x4_t q3 = vld1q_u32(src + (y + 3) * ss + x);
+          uint32x4x2_t t01 = vtrnq_u32(q0, q1);
+          uint32x4x2_t t23 = vtrnq_u32(q2, q3);
+          uint32_t* d = dst + (H - 1 - x) * ds + y;
+          vst1q_u32(d, vcombine_u32(vget_low_u32(t01.val[0]), vget_low_u32(t23.val[0])));
+          vst1q_u32(d - ds, vcombine_u32(vget_low_u32(t01.val[1]), vget_low_u32(t23.val[1])));
+          vst1q_u32(d - 2 * ds, vcombine_u32(vget_high_u32(t01.val[0]), vget_high_u32(t23.val[0])));
+          vst1q_u32(d - 3 * ds, vcombine_u32(vget_high_u32(t01.val[1]), vget_high_u32(t23.val[1])));
+        }
+        for (; y < yend; ++y) {
+          for (int i = 0; i < 4; ++i) {
+            dst[(H - 1 - (x + i)) * ds + y] = src[y * ss + (x + i)];
+          }
+        }
+      }
+#endif
+      for (; x < xend; ++x) {
+        uint32_t* d = dst + (H - 1 - x) * ds + ty;
+        const uint32_t* s = src + ty * ss + x;
+        for (int y = ty; y < yend; ++y, ++d, s += ss) {
+          *d = *s;
+        }
+      }
+    }
+  }
+}
+
+// DOWN: logical (x, y) -> physical (W - 1 - x, H - 1 - y). Rows map to reversed rows, so no
+// transpose is needed, only a per-row reversal.
+static void FlushDown(const uint32_t* src, int ss, uint32_t* dst, int ds, int W, int H,
+                      const GRRect& r) {
+  for (int y = r.top; y < r.bottom; ++y) {
+    const uint32_t* s = src + y * ss;
+    uint32_t* d = dst + (H - 1 - y) * ds;
+    int x = r.left;
+#if defined(__ARM_NEON)
+    for (; x + 4 <= r.right; x += 4) {
+      uint32x4_t v = vrev64q_u32(vld1q_u32(s + x));
+      vst1q_u32(d + (W - 4 - x), vcombine_u32(vget_high_u32(v), vget_low_u32(v)));
+    }
+#endif
+    for (; x < r.right; ++x) {
+      d[W - 1 - x] = s[x];
+    }
+  }
+}
+
+// Maps a logical-orientation rect to physical framebuffer coordinates under |rotation|.
+static GRRect logical_to_physical(const GRRect& r) {
+  int W = gr_framebuffer->width;
+  int H = gr_framebuffer->height;
+  switch (rotation) {
+    case GRRotation::RIGHT:
+      return { W - r.bottom, r.left, W - r.top, r.right };
+    case GRRotation::DOWN:
+      return { W - r.right, H - r.bottom, W - r.left, H - r.top };
+    case GRRotation::LEFT:
+      return { r.top, H - r.right, r.bottom, H - r.left };
+    default:
+      return r;
+  }
+}
+
+// Rotates the given logical rect of the pre-rotated backbuffer into the framebuffer.
+static void prerotated_flush(const GRRect& r) {
+  const uint32_t* src = reinterpret_cast<const uint32_t*>(prerotated_buffer->data());
+  int ss = prerotated_buffer->row_bytes / prerotated_buffer->pixel_bytes;
+  uint32_t* dst = reinterpret_cast<uint32_t*>(gr_framebuffer->data());
+  int ds = gr_framebuffer->row_bytes / gr_framebuffer->pixel_bytes;
+  int W = gr_framebuffer->width;
+  int H = gr_framebuffer->height;
+
+  GRRect clipped = { std::max(r.left, 0), std::max(r.top, 0),
+                     std::min(r.right, static_cast<int>(prerotated_buffer->width)),
+                     std::min(r.bottom, static_cast<int>(prerotated_buffer->height)) };
+  if (rect_empty(clipped)) return;
+
+  switch (rotation) {
+    case GRRotation::RIGHT:
+      FlushRight(src, ss, dst, ds, W, clipped);
+      break;
+    case GRRotation::LEFT:
+      FlushLeft(src, ss, dst, ds, H, clipped);
+      break;
+    case GRRotation::DOWN:
+      FlushDown(src, ss, dst, ds, W, H, clipped);
+      break;
+    default:  // Shouldn't happen; the buffer only exists for rotated panels.
+      break;
+  }
+}
+
 void gr_flip() {
-  gr_draw = gr_backend->Flip();
+  // The hint handed to the backend must also cover the previous frame: with a double-buffered
+  // backend the surface being retired only matches the screen outside the last two frames' damage.
+  GRRect dirty = rect_union(dirty_region, previous_dirty_region);
+  previous_dirty_region = dirty_region;
+  dirty_region = { 0, 0, 0, 0 };
+  bool targeted = gr_draw != canonical_draw_target();
+  if (prerotated_buffer) {
+    // The dirty rects are tracked in logical coordinates while pre-rotation is on. The same
+    // two-frame union drives the copy: the backend's current back buffer was displayed two
+    // flips ago, so that is what must be repainted.
+    prerotated_flush(dirty);
+    gr_framebuffer = gr_backend->Flip(logical_to_physical(dirty));
+    return;
+  }
+  gr_framebuffer = gr_backend->Flip(dirty);
+  if (!targeted) gr_draw = gr_framebuffer;
+}
+
+void gr_render_target(GRSurface* target) {
+  gr_draw = target ? target : canonical_draw_target();
 }
 
 std::unique_ptr<MinuiBackend> create_backend(GraphicsBackend backend) {
@@ -427,6 +943,16 @@ int gr_init(std::initializer_list<GraphicsBackend> backends) {
     pixel_format = PixelFormat::UNKNOWN;
   }
 
+  // Bind the blend kernels for the layout picked above; everything but RGBA keeps alpha in the
+  // high byte, which is also what the kernels default to before gr_init() runs.
+  if (pixel_format == PixelFormat::RGBA) {
+    TextBlend = TextBlendImpl<pixel_blend_rgba, 0>;
+    BlendConstRow = BlendConstRowImpl<pixel_blend_rgba, 0>;
+  } else {
+    TextBlend = TextBlendImpl<pixel_blend_argb, 24>;
+    BlendConstRow = BlendConstRowImpl<pixel_blend_argb, 24>;
+  }
+
   int ret = gr_init_font("font", &gr_font);
   if (ret != 0) {
     printf("Failed to init font: %d, continuing graphic backend initialization without font file\n",
@@ -445,7 +971,7 @@ int gr_init(std::initializer_list<GraphicsBackend> backends) {
       printf("gr_init: minui_backend %d is a nullptr\n", backend);
       continue;
     }
-    gr_draw = minui_backend->Init();
+    gr_draw = gr_framebuffer = minui_backend->Init();
     if (gr_draw) break;
   }
 
@@ -497,7 +1023,32 @@ int gr_init(std::initializer_list<GraphicsBackend> backends) {
   return 0;
 }
 
+void gr_init_offscreen(GRSurface* surface, PixelFormat format) {
+  pixel_format = format;
+  if (pixel_format == PixelFormat::RGBA) {
+    TextBlend = TextBlendImpl<pixel_blend_rgba, 0>;
+    BlendConstRow = BlendConstRowImpl<pixel_blend_rgba, 0>;
+  } else {
+    TextBlend = TextBlendImpl<pixel_blend_argb, 24>;
+    BlendConstRow = BlendConstRowImpl<pixel_blend_argb, 24>;
+  }
+
+  gr_draw = gr_framebuffer = surface;
+  gr_backend = nullptr;
+  prerotated_buffer.reset();
+  rotation = GRRotation::NONE;
+  draw_rotation = GRRotation::NONE;
+  touch_rotation = GRRotation::NONE;
+  overscan_offset_x = 0;
+  overscan_offset_y = 0;
+  row_clip.clear();
+  dirty_region = { 0, 0, 0, 0 };
+  previous_dirty_region = { 0, 0, 0, 0 };
+}
+
 void gr_exit() {
+  prerotated_buffer.reset();
+  row_clip.clear();
   delete gr_backend;
   gr_backend = nullptr;
 
@@ -507,24 +1058,24 @@ void gr_exit() {
 
 int gr_fb_width() {
   return (rotation == GRRotation::LEFT || rotation == GRRotation::RIGHT)
-             ? gr_draw->height - 2 * overscan_offset_y
-             : gr_draw->width - 2 * overscan_offset_x;
+             ? gr_framebuffer->height - 2 * overscan_offset_y
+             : gr_framebuffer->width - 2 * overscan_offset_x;
 }
 
 int gr_fb_height() {
   return (rotation == GRRotation::LEFT || rotation == GRRotation::RIGHT)
-             ? gr_draw->width - 2 * overscan_offset_x
-             : gr_draw->height - 2 * overscan_offset_y;
+             ? gr_framebuffer->width - 2 * overscan_offset_x
+             : gr_framebuffer->height - 2 * overscan_offset_y;
 }
 
 int gr_fb_width_real() {
-  return (rotation == GRRotation::LEFT || rotation == GRRotation::RIGHT) ? gr_draw->height
-                                                                         : gr_draw->width;
+  return (rotation == GRRotation::LEFT || rotation == GRRotation::RIGHT) ? gr_framebuffer->height
+                                                                         : gr_framebuffer->width;
 }
 
 int gr_fb_height_real() {
-  return (rotation == GRRotation::LEFT || rotation == GRRotation::RIGHT) ? gr_draw->width
-                                                                         : gr_draw->height;
+  return (rotation == GRRotation::LEFT || rotation == GRRotation::RIGHT) ? gr_framebuffer->width
+                                                                         : gr_framebuffer->height;
 }
 
 int gr_overscan_offset_x() {
@@ -549,6 +1100,28 @@ void gr_fb_blank(bool blank, int index) {
 
 void gr_rotate(GRRotation rot) {
   rotation = rot;
+  draw_rotation = rot;
+  bool targeted = gr_draw != canonical_draw_target();
+  prerotated_buffer.reset();
+
+  if (rot != GRRotation::NONE && gr_backend != nullptr &&
+      android::base::GetBoolProperty("ro.minui.prerotated_backbuffer", true)) {
+    bool swapped = (rot == GRRotation::LEFT || rot == GRRotation::RIGHT);
+    size_t width = swapped ? gr_framebuffer->height : gr_framebuffer->width;
+    size_t height = swapped ? gr_framebuffer->width : gr_framebuffer->height;
+    prerotated_buffer =
+        GRSurface::Create(width, height, width * gr_framebuffer->pixel_bytes,
+                          gr_framebuffer->pixel_bytes);
+    if (prerotated_buffer) {
+      draw_rotation = GRRotation::NONE;
+      // Everything on screen must be recomposed into the new buffer before the next flip.
+      dirty_region = { 0, 0, static_cast<int>(width), static_cast<int>(height) };
+      previous_dirty_region = dirty_region;
+    }
+  }
+  if (!targeted) {
+    gr_draw = canonical_draw_target();
+  }
 }
 
 void gr_rotate_touch(GRRotation rot) {
@@ -562,3 +1135,20 @@ GRRotation gr_get_rotation() {
 bool gr_has_multiple_connectors() {
   return gr_backend->HasMultipleConnectors();
 }
+
+void gr_set_clip_circle(int cx, int cy, int radius) {
+  const GRSurface* target = canonical_draw_target();
+  row_clip.assign(target->height, { 0, 0 });
+  for (int y = 0; y < static_cast<int>(target->height); ++y) {
+    int dy = y - cy;
+    if (abs(dy) > radius) continue;
+    int half = static_cast<int>(
+        sqrt(static_cast<double>(radius) * radius - static_cast<double>(dy) * dy));
+    row_clip[y] = { std::max(0, cx - half),
+                    std::min(static_cast<int>(target->width), cx + half + 1) };
+  }
+}
+
+void gr_reset_clip() {
+  row_clip.clear();
+}
@@ -19,6 +19,15 @@
 
 #include "minui/minui.h"
 
+// An axis-aligned rectangle in physical framebuffer coordinates (i.e. after rotation). The right
+// and bottom edges are exclusive; a rectangle without area means nothing was drawn.
+struct GRRect {
+  int left;
+  int top;
+  int right;
+  int bottom;
+};
+
 class MinuiBackend {
  public:
   enum DrmConnector {
@@ -34,6 +43,13 @@ class MinuiBackend {
   // be displayed, and returns a new drawing surface.
   virtual GRSurface* Flip() = 0;
 
+  // Same as Flip(), with |dirty| bounding everything drawn since the surface was last displayed.
+  // Backends that push pixels manually may limit the update to the dirty region; the default
+  // ignores the hint and pushes the whole surface.
+  virtual GRSurface* Flip(const GRRect& /* dirty */) {
+    return Flip();
+  }
+
   // Blank (or unblank) the default screen.
   virtual void Blank(bool) = 0;
 
@@ -47,4 +63,10 @@ class MinuiBackend {
   virtual ~MinuiBackend() = default;
 };
 
+// Points the drawing routines at |surface| with the given pixel format, without initializing a
+// display backend; gr_flip() and gr_fb_blank() must not be called afterwards. For tests and
+// benchmarks that drive gr_fill()/gr_blit()/gr_text() headlessly. Resets rotation, overscan and
+// dirty-region state so the drawing state doesn't depend on device properties.
+void gr_init_offscreen(GRSurface* surface, PixelFormat format);
+
 #endif  // _GRAPHICS_H_
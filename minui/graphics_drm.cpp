@@ -191,6 +191,9 @@ void MinuiBackendDrm::Blank(bool blank, DrmConnector index) {
     return;
   }
 
+  // Changing the crtc while a flip is in flight is undefined; let it land first.
+  WaitForPendingFlip();
+
   if (blank) {
     DrmDisableCrtc(drm_fd, drmInterface->monitor_crtc);
   } else {
@@ -422,24 +425,10 @@ static void page_flip_complete(__unused int fd,
   *static_cast<bool*>(user_data) = false;
 }
 
-GRSurface* MinuiBackendDrm::Flip() {
-  GRSurface* surface = NULL;
-  DrmInterface* current_drm = &drm[active_display];
-  bool ongoing_flip = true;
-
-  if (!current_drm->monitor_connector) {
-    fprintf(stderr, "Unsupported. active_display = %d\n", active_display);
-    return nullptr;
-  }
-
-  if (drmModePageFlip(drm_fd, current_drm->monitor_crtc->crtc_id,
-                      current_drm->GRSurfaceDrms[current_drm->current_buffer]->fb_id,
-                      DRM_MODE_PAGE_FLIP_EVENT, &ongoing_flip) != 0) {
-    fprintf(stderr, "Failed to drmModePageFlip, active_display=%d", active_display);
-    return nullptr;
-  }
-
-  while (ongoing_flip) {
+// Drains the drm fd until the completion event of the last submitted page flip has been handled
+// (or an error makes further waiting pointless).
+void MinuiBackendDrm::WaitForPendingFlip() {
+  while (flip_pending_) {
     struct pollfd fds = {
       .fd = drm_fd,
       .events = POLLIN
@@ -447,6 +436,7 @@ GRSurface* MinuiBackendDrm::Flip() {
 
     if (poll(&fds, 1, -1) == -1 || !(fds.revents & POLLIN)) {
       perror("Failed to poll() on drm fd");
+      flip_pending_ = false;
       break;
     }
 
@@ -457,16 +447,62 @@ GRSurface* MinuiBackendDrm::Flip() {
 
     if (drmHandleEvent(drm_fd, &evctx) != 0) {
       perror("Failed to drmHandleEvent");
+      flip_pending_ = false;
       break;
     }
   }
+}
 
+GRSurface* MinuiBackendDrm::Flip() {
+  DrmInterface* current_drm = &drm[active_display];
+
+  if (!current_drm->monitor_connector) {
+    fprintf(stderr, "Unsupported. active_display = %d\n", active_display);
+    return nullptr;
+  }
+
+  // Only one page flip may be queued per crtc; wait out the previous one. By the time the caller
+  // has rendered the next frame this has normally long signaled, so the wait is free.
+  WaitForPendingFlip();
+
+  if (drmModePageFlip(drm_fd, current_drm->monitor_crtc->crtc_id,
+                      current_drm->GRSurfaceDrms[current_drm->current_buffer]->fb_id,
+                      DRM_MODE_PAGE_FLIP_EVENT, &flip_pending_) != 0) {
+    fprintf(stderr, "Failed to drmModePageFlip, active_display=%d", active_display);
+    return nullptr;
+  }
+  flip_pending_ = true;
+
+  // Don't wait for the flip to latch; hand the retired buffer back right away so the caller can
+  // prepare the next frame while the new one scans out.
   current_drm->current_buffer = 1 - current_drm->current_buffer;
-  surface = current_drm->GRSurfaceDrms[current_drm->current_buffer].get();
+  return current_drm->GRSurfaceDrms[current_drm->current_buffer].get();
+}
+
+GRSurface* MinuiBackendDrm::Flip(const GRRect& dirty) {
+  GRSurface* surface = Flip();
+
+  // Pass the damage along for drivers that upload the buffer manually (e.g. command-mode DSI
+  // panels), so they only retransmit the dirty region. Drivers that scan out the full buffer
+  // return ENOSYS/EINVAL, which is fine to ignore.
+  if (surface && dirty.left < dirty.right && dirty.top < dirty.bottom) {
+    DrmInterface* current_drm = &drm[active_display];
+    drmModeClip clip = {
+      .x1 = static_cast<unsigned short>(dirty.left),
+      .y1 = static_cast<unsigned short>(dirty.top),
+      .x2 = static_cast<unsigned short>(dirty.right),
+      .y2 = static_cast<unsigned short>(dirty.bottom),
+    };
+    // Flip() has already advanced current_buffer; the buffer just handed to the display is the
+    // other one.
+    drmModeDirtyFB(drm_fd, current_drm->GRSurfaceDrms[1 - current_drm->current_buffer]->fb_id,
+                   &clip, 1);
+  }
   return surface;
 }
 
 MinuiBackendDrm::~MinuiBackendDrm() {
+  WaitForPendingFlip();
   for (int i = 0; i < DRM_MAX; i++) {
     if (drm[i].monitor_connector) {
       DrmDisableCrtc(drm_fd, drm[i].monitor_crtc);
@@ -58,11 +58,13 @@ class MinuiBackendDrm : public MinuiBackend {
 
   GRSurface* Init() override;
   GRSurface* Flip() override;
+  GRSurface* Flip(const GRRect& dirty) override;
   void Blank(bool) override;
   void Blank(bool blank, DrmConnector index) override;
   bool HasMultipleConnectors() override;
 
  private:
+  void WaitForPendingFlip();
   void DrmDisableCrtc(int drm_fd, drmModeCrtc* crtc);
   bool DrmEnableCrtc(int drm_fd, drmModeCrtc* crtc, const std::unique_ptr<GRSurfaceDrm>& surface,
                      uint32_t* conntcors);
@@ -79,4 +81,7 @@ class MinuiBackendDrm : public MinuiBackend {
 
   int drm_fd{ -1 };
   DrmConnector active_display = DRM_MAIN;
+  // True while a submitted page flip hasn't signaled its completion event yet. Cleared by the
+  // page flip handler from WaitForPendingFlip().
+  bool flip_pending_{ false };
 };
@@ -26,12 +26,18 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <memory>
 
 #include <android-base/unique_fd.h>
 
 #include "minui/minui.h"
 
+// Not all kernel headers ship the vsync wait; the ioctl number is part of the fbdev ABI.
+#ifndef FBIO_WAITFORVSYNC
+#define FBIO_WAITFORVSYNC _IOW('F', 0x20, __u32)
+#endif
+
 std::unique_ptr<GRSurfaceFbdev> GRSurfaceFbdev::Create(size_t width, size_t height,
                                                        size_t row_bytes, size_t pixel_bytes) {
   // Cannot use std::make_unique to access non-public ctor.
@@ -62,6 +68,17 @@ void MinuiBackendFbdev::SetDisplayedFramebuffer(size_t n) {
   vi.yres_virtual = gr_framebuffer[0]->height * 2;
   vi.yoffset = n * gr_framebuffer[0]->height;
   vi.bits_per_pixel = gr_framebuffer[0]->pixel_bytes * 8;
+  // Panning only moves the scanout origin within the virtual display configured at Init() and
+  // latches at the next vblank, while FBIOPUT_VSCREENINFO may trigger a full mode set on every
+  // flip. Some drivers don't implement panning; fall back for good once it's been rejected.
+  if (pan_supported) {
+    if (ioctl(fb_fd, FBIOPAN_DISPLAY, &vi) == 0) {
+      displayed_buffer = n;
+      return;
+    }
+    perror("FBIOPAN_DISPLAY failed, falling back to FBIOPUT_VSCREENINFO");
+    pan_supported = false;
+  }
   if (ioctl(fb_fd, FBIOPUT_VSCREENINFO, &vi) < 0) {
     perror("active fb swap failed");
   }
@@ -140,6 +157,13 @@ next_fb:
   if (vi.yres * fi.line_length * 2 <= fi.smem_len) {
     double_buffered = true;
 
+    // Program the doubled virtual resolution once up front, so per-flip buffer switches can go
+    // through FBIOPAN_DISPLAY instead of reconfiguring the mode every frame.
+    vi.yres_virtual = vi.yres * 2;
+    if (ioctl(fd, FBIOPUT_VSCREENINFO, &vi) < 0) {
+      perror("failed to set up the double-buffered virtual display");
+    }
+
     gr_framebuffer[1]->buffer_ =
         gr_framebuffer[0]->buffer_ + gr_framebuffer[0]->height * gr_framebuffer[0]->row_bytes;
   } else {
@@ -163,14 +187,35 @@ next_fb:
 }
 
 GRSurface* MinuiBackendFbdev::Flip() {
+  return Flip({ 0, 0, static_cast<int>(gr_draw->width), static_cast<int>(gr_draw->height) });
+}
+
+GRSurface* MinuiBackendFbdev::Flip(const GRRect& dirty) {
   if (double_buffered) {
     // Change gr_draw to point to the buffer currently displayed, then flip the driver so we're
     // displaying the other buffer instead.
     gr_draw = gr_framebuffer[displayed_buffer].get();
     SetDisplayedFramebuffer(1 - displayed_buffer);
+    // Wait out the vblank that latches the pan: until then the buffer handed back for drawing is
+    // still being scanned out, and writing into it would tear. Drivers without vsync support
+    // keep the old free-running behavior.
+    if (vsync_supported) {
+      int arg = 0;
+      if (ioctl(fb_fd, FBIO_WAITFORVSYNC, &arg) < 0) {
+        perror("FBIO_WAITFORVSYNC failed, continuing without vsync pacing");
+        vsync_supported = false;
+      }
+    }
   } else {
-    // Copy from the in-memory surface to the framebuffer.
-    memcpy(gr_framebuffer[0]->buffer_, gr_draw->buffer_, gr_draw->height * gr_draw->row_bytes);
+    // Copy from the in-memory surface to the framebuffer. Rows outside the dirty region already
+    // match the framebuffer, so only the damaged row span needs to be pushed.
+    int top = std::max(0, dirty.top);
+    int bottom = std::min(static_cast<int>(gr_draw->height), dirty.bottom);
+    if (top < bottom) {
+      size_t offset = top * gr_draw->row_bytes;
+      memcpy(gr_framebuffer[0]->buffer_ + offset, gr_draw->buffer_ + offset,
+             (bottom - top) * gr_draw->row_bytes);
+    }
   }
   return gr_draw;
 }
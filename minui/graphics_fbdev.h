@@ -55,6 +55,7 @@ class MinuiBackendFbdev : public MinuiBackend {
 
   GRSurface* Init() override;
   GRSurface* Flip() override;
+  GRSurface* Flip(const GRRect& dirty) override;
   void Blank(bool) override;
   void Blank(bool blank, DrmConnector index) override;
   bool HasMultipleConnectors() override;
@@ -66,6 +67,11 @@ class MinuiBackendFbdev : public MinuiBackend {
   // Points to the current surface (i.e. one of the two gr_framebuffer's).
   GRSurfaceFbdev* gr_draw{ nullptr };
   bool double_buffered;
+  // Whether the driver accepts FBIOPAN_DISPLAY for buffer switches; cleared on the first
+  // rejection, after which flips fall back to FBIOPUT_VSCREENINFO.
+  bool pan_supported{ true };
+  // Whether the driver accepts FBIO_WAITFORVSYNC; cleared on the first rejection.
+  bool vsync_supported{ true };
   std::vector<uint8_t> memory_buffer;
   size_t displayed_buffer{ 0 };
   fb_var_screeninfo vi;
@@ -48,6 +48,19 @@ class GRSurface {
   // Clones the current GRSurface instance (i.e. an image).
   std::unique_ptr<GRSurface> Clone() const;
 
+  // Returns a non-owning view aliasing this surface's pixels, for sharing an immutable surface
+  // without copying it. The view must not outlive the surface it aliases.
+  std::unique_ptr<GRSurface> CreateAliasView() const;
+
+  // Slices |strip| into |frame_count| frame surfaces without copying any pixels. The strip
+  // interlaces its frames by row (row y belongs to frame y % frame_count), so frame f is simply a
+  // view whose first row sits f rows into the strip and whose rows are frame_count * row_bytes
+  // apart. The first view adopts the strip's pixel buffer; the remaining views alias it and must
+  // not be used after the first view has been freed. Returns an empty vector on error (e.g. the
+  // strip's height is not a multiple of frame_count).
+  static std::vector<std::unique_ptr<GRSurface>> CreateFrameViews(std::unique_ptr<GRSurface> strip,
+                                                                  int frame_count);
+
   virtual uint8_t* data() {
     return data_.get();
   }
@@ -70,10 +83,16 @@ class GRSurface {
       : width(width), height(height), row_bytes(row_bytes), pixel_bytes(pixel_bytes) {}
 
  private:
-  // The deleter for data_, whose data is allocated via aligned_alloc(3).
+  // Returns a buffer of the given size to minui's surface pool (see resources.cpp), where it can
+  // be recycled by a later Create() of the same size. A zero size marks a non-owning view (see
+  // CreateFrameViews()) and releases nothing.
+  static void ReleaseData(uint8_t* data, size_t size);
+
+  // The deleter for data_, which hands the buffer back to the surface pool.
   struct DataDeleter {
+    size_t size;
     void operator()(uint8_t* data) {
-      free(data);
+      GRSurface::ReleaseData(data, size);
     }
   };
 
@@ -87,6 +106,11 @@ struct GRFont {
   GRSurface* texture;
   int char_width;
   int char_height;
+  // Horizontal advance of each printable ASCII glyph, indexed by (ch - ' '). Computed once when
+  // the font is loaded: every entry equals char_width for the traditional cell rendering, or the
+  // glyph's ink width plus a side bearing when ro.minui.proportional_text is set. Text layout is
+  // a table lookup per glyph either way.
+  int advances[96];
 };
 
 enum class GRRotation : int {
@@ -133,6 +157,12 @@ int gr_overscan_offset_y();
 GRRotation gr_touch_rotation();
 
 void gr_flip();
+
+// Redirects all drawing calls to |target| instead of the framebuffer; pass nullptr to draw to the
+// framebuffer again. |target| must match the framebuffer's pixel format, and is not presented by
+// gr_flip() -- a client rendering offscreen blits its target into the framebuffer before flipping.
+void gr_render_target(GRSurface* target);
+
 void gr_fb_blank(bool blank);
 void gr_fb_blank(bool blank, int index);
 bool gr_has_multiple_connectors();
@@ -142,6 +172,14 @@ void gr_clear();
 void gr_color(unsigned char r, unsigned char g, unsigned char b, unsigned char a);
 void gr_fill(int x1, int y1, int x2, int y2);
 
+// Restricts drawing to a circle of |radius| pixels centered at (|cx|, |cy|), in the same
+// coordinates the drawing calls use. Every row is clipped to the circle's chord, so fills, blits
+// and text never compose the corner spans a round display can't show. The clip only applies to
+// the screen (not offscreen render targets) and only on unrotated drawing paths.
+void gr_set_clip_circle(int cx, int cy, int radius);
+// Removes the clip set by gr_set_clip_circle().
+void gr_reset_clip();
+
 void gr_texticon(int x, int y, const GRSurface* icon);
 
 const GRFont* gr_sys_font();
@@ -195,6 +233,9 @@ int ev_sync_sw_state(const ev_set_sw_callback& set_sw_cb);
 int ev_wait(int timeout);
 
 int ev_get_input(int fd, uint32_t epevents, input_event* ev);
+// Reads up to |max_events| pending events from |fd| in one go. Returns the number of events read,
+// or -1 on failure.
+int ev_get_input_events(int fd, uint32_t epevents, input_event* evs, size_t max_events);
 void ev_dispatch();
 int ev_get_epollfd();
 
@@ -220,7 +261,9 @@ int res_create_display_surface(const char* name, GRSurface** pSurface);
 // Load an array of display surfaces from a single PNG image.  The PNG
 // should have a 'Frames' text chunk whose value is the number of
 // frames this image represents.  The pixel data itself is interlaced
-// by row.
+// by row.  The returned frames are views into one shared decoded
+// buffer, owned by the first frame; free them together, first frame
+// last.
 int res_create_multi_display_surface(const char* name, int* frames, int* fps,
                                      GRSurface*** pSurface);
 
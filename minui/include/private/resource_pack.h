@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+// On-disk format of a minui resource pack ("resources.pak" under the resource dir), generated at
+// build time by the respack host tool. The pack bundles the decoded pixel rows of the PNGs it was
+// given, so loading a resource costs one row transform instead of a libpng inflate; the file is
+// mapped once and shared by all lookups.
+//
+// Layout: a ResourcePackHeader, followed by |entry_count| ResourcePackEntry records, followed by
+// the pixel payloads. All integers are little-endian. A payload holds |height| rows of
+// |width| * |channels| bytes each, exactly as libpng hands them out after the expansions
+// PngHandler applies (8-bit gray, RGB or RGBA), with no display pixel format baked in; multi-frame
+// images keep their interleaved row layout.
+
+constexpr uint32_t kResourcePackMagic = 0x3150524d;  // "MRP1"
+constexpr uint32_t kResourcePackVersion = 1;
+
+struct ResourcePackHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t entry_count;
+  uint32_t reserved;
+};
+
+struct ResourcePackEntry {
+  // Resource name as passed to res_create_*(), NUL-terminated.
+  char name[56];
+  uint32_t channels;  // 1 (gray), 3 (RGB) or 4 (RGBA)
+  uint32_t width;
+  uint32_t height;    // total rows; a multi-frame image keeps all frames interleaved
+  uint32_t frames;    // from the "Frames" text chunk, 1 if absent
+  uint32_t fps;       // from the "FPS" text chunk, 20 if absent
+  uint64_t offset;    // payload offset in bytes from the start of the file
+  uint64_t size;      // payload size in bytes: height * width * channels
+};
@@ -85,3 +85,6 @@ class PngHandler {
 
 // Overrides the default resource dir, for testing purpose.
 void res_set_resource_dir(const std::string&);
+
+// Returns the current resource dir.
+std::string res_get_resource_dir();
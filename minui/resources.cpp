@@ -24,22 +24,151 @@
 #include <string.h>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 
 #include <limits>
 #include <memory>
+#include <mutex>
 #include <regex>
+#include <unordered_map>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <android-base/strings.h>
+#include <android-base/unique_fd.h>
 #include <png.h>
 
 #include "minui/minui.h"
+#include "private/resource_pack.h"
 
 static std::string g_resource_dir{ "/res/images" };
 
+// Lazily maps "resources.pak" under the resource dir, if present. Resources found in the pack
+// skip the libpng decode entirely; anything else falls back to the individual .png files.
+class ResourcePack {
+ public:
+  // Returns the named entry and points |data| at its pixel rows, or nullptr if no valid pack is
+  // mapped or the entry is missing.
+  const ResourcePackEntry* Find(const std::string& name, const uint8_t** data) {
+    if (!EnsureMapped()) return nullptr;
+    for (uint32_t i = 0; i < header_->entry_count; ++i) {
+      if (name == entries_[i].name) {
+        *data = static_cast<const uint8_t*>(addr_) + entries_[i].offset;
+        return &entries_[i];
+      }
+    }
+    return nullptr;
+  }
+
+  // Drops the mapping so the next lookup reopens the pack, e.g. after the resource dir changes.
+  void Reset() {
+    Unmap();
+    attempted_ = false;
+  }
+
+ private:
+  bool EnsureMapped() {
+    // A missing or invalid pack is remembered, so the common no-pack case costs one open() total.
+    if (attempted_) return header_ != nullptr;
+    attempted_ = true;
+
+    std::string path = g_resource_dir + "/resources.pak";
+    android::base::unique_fd fd(open(path.c_str(), O_RDONLY | O_CLOEXEC));
+    if (fd == -1) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) == -1 || static_cast<size_t>(st.st_size) < sizeof(ResourcePackHeader)) {
+      return false;
+    }
+    length_ = st.st_size;
+    addr_ = mmap(nullptr, length_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr_ == MAP_FAILED) {
+      addr_ = nullptr;
+      return false;
+    }
+
+    const auto* header = static_cast<const ResourcePackHeader*>(addr_);
+    const auto* entries = reinterpret_cast<const ResourcePackEntry*>(header + 1);
+    if (header->magic != kResourcePackMagic || header->version != kResourcePackVersion ||
+        header->entry_count > (length_ - sizeof(ResourcePackHeader)) / sizeof(ResourcePackEntry)) {
+      fprintf(stderr, "Ignoring invalid resource pack %s\n", path.c_str());
+      Unmap();
+      return false;
+    }
+    for (uint32_t i = 0; i < header->entry_count; ++i) {
+      const ResourcePackEntry& entry = entries[i];
+      if (memchr(entry.name, '\0', sizeof(entry.name)) == nullptr ||
+          (entry.channels != 1 && entry.channels != 3 && entry.channels != 4) ||
+          entry.size != static_cast<uint64_t>(entry.height) * entry.width * entry.channels ||
+          entry.offset > length_ || entry.size > length_ - entry.offset) {
+        fprintf(stderr, "Ignoring resource pack %s with invalid entry %u\n", path.c_str(), i);
+        Unmap();
+        return false;
+      }
+    }
+
+    header_ = header;
+    entries_ = entries;
+    return true;
+  }
+
+  void Unmap() {
+    if (addr_) munmap(addr_, length_);
+    addr_ = nullptr;
+    length_ = 0;
+    header_ = nullptr;
+    entries_ = nullptr;
+  }
+
+  bool attempted_{ false };
+  void* addr_{ nullptr };
+  size_t length_{ 0 };
+  const ResourcePackHeader* header_{ nullptr };
+  const ResourcePackEntry* entries_{ nullptr };
+};
+
+static ResourcePack g_resource_pack;
+
+// Free list of retired surface buffers, bucketed by their (alignment-rounded) size. Drawing code
+// creates and frees glyph- and frame-sized surfaces continuously, almost always in a handful of
+// recurring sizes, so recycling the buffers keeps the draw loop out of the allocator. The pool is
+// capped; buffers beyond the cap are simply freed.
+static constexpr size_t kSurfacePoolMaxBytes = 8 << 20;
+static std::mutex g_surface_pool_mutex;
+static std::unordered_map<size_t, std::vector<uint8_t*>> g_surface_pool;
+static size_t g_surface_pool_bytes = 0;
+
+static uint8_t* AcquireSurfaceData(size_t size) {
+  {
+    std::lock_guard<std::mutex> lg(g_surface_pool_mutex);
+    auto it = g_surface_pool.find(size);
+    if (it != g_surface_pool.end() && !it->second.empty()) {
+      uint8_t* data = it->second.back();
+      it->second.pop_back();
+      g_surface_pool_bytes -= size;
+      return data;
+    }
+  }
+  return static_cast<uint8_t*>(aligned_alloc(GRSurface::kSurfaceDataAlignment, size));
+}
+
+void GRSurface::ReleaseData(uint8_t* data, size_t size) {
+  // Views carry a zero size and don't own their bytes; the surface they alias does.
+  if (data == nullptr || size == 0) return;
+  {
+    std::lock_guard<std::mutex> lg(g_surface_pool_mutex);
+    if (g_surface_pool_bytes + size <= kSurfacePoolMaxBytes) {
+      g_surface_pool[size].push_back(data);
+      g_surface_pool_bytes += size;
+      return;
+    }
+  }
+  free(data);
+}
+
 std::unique_ptr<GRSurface> GRSurface::Create(size_t width, size_t height, size_t row_bytes,
                                              size_t pixel_bytes) {
   if (width == 0 || row_bytes == 0 || height == 0 || pixel_bytes == 0) return nullptr;
@@ -50,8 +179,8 @@ std::unique_ptr<GRSurface> GRSurface::Create(size_t width, size_t height, size_t
   size_t data_size = row_bytes * height;
   result->data_size_ =
       (data_size + kSurfaceDataAlignment - 1) / kSurfaceDataAlignment * kSurfaceDataAlignment;
-  result->data_.reset(
-      static_cast<uint8_t*>(aligned_alloc(kSurfaceDataAlignment, result->data_size_)));
+  result->data_ = std::unique_ptr<uint8_t, DataDeleter>(AcquireSurfaceData(result->data_size_),
+                                                        DataDeleter{ result->data_size_ });
   if (!result->data_) return nullptr;
   return result;
 }
@@ -63,79 +192,36 @@ std::unique_ptr<GRSurface> GRSurface::Clone() const {
   return result;
 }
 
-PngHandler::PngHandler(const std::string& name) {
-  std::string res_path = g_resource_dir + "/" + name + ".png";
-  png_fp_.reset(fopen(res_path.c_str(), "rbe"));
-  // Try to read from |name| if the resource path does not work.
-  if (!png_fp_) {
-    png_fp_.reset(fopen(name.c_str(), "rbe"));
-  }
-  if (!png_fp_) {
-    error_code_ = -1;
-    return;
-  }
-
-  uint8_t header[8];
-  size_t bytesRead = fread(header, 1, sizeof(header), png_fp_.get());
-  if (bytesRead != sizeof(header)) {
-    error_code_ = -2;
-    return;
-  }
-
-  if (png_sig_cmp(header, 0, sizeof(header))) {
-    error_code_ = -3;
-    return;
-  }
-
-  png_ptr_ = png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
-  if (!png_ptr_) {
-    error_code_ = -4;
-    return;
-  }
-
-  info_ptr_ = png_create_info_struct(png_ptr_);
-  if (!info_ptr_) {
-    error_code_ = -5;
-    return;
-  }
-
-  if (setjmp(png_jmpbuf(png_ptr_))) {
-    error_code_ = -6;
-    return;
-  }
-
-  png_init_io(png_ptr_, png_fp_.get());
-  png_set_sig_bytes(png_ptr_, sizeof(header));
-  png_read_info(png_ptr_, info_ptr_);
-
-  png_get_IHDR(png_ptr_, info_ptr_, &width_, &height_, &bit_depth_, &color_type_, nullptr, nullptr,
-               nullptr);
-
-  channels_ = png_get_channels(png_ptr_, info_ptr_);
-
-  if (bit_depth_ == 8 && channels_ == 3 && color_type_ == PNG_COLOR_TYPE_RGB) {
-    // 8-bit RGB images: great, nothing to do.
-  } else if (bit_depth_ <= 8 && channels_ == 1 && color_type_ == PNG_COLOR_TYPE_GRAY) {
-    // 1-, 2-, 4-, or 8-bit gray images: expand to 8-bit gray.
-    png_set_expand_gray_1_2_4_to_8(png_ptr_);
-  } else if (bit_depth_ <= 8 && channels_ == 1 && color_type_ == PNG_COLOR_TYPE_PALETTE) {
-    // paletted images: expand to 8-bit RGB.  Note that we DON'T
-    // currently expand the tRNS chunk (if any) to an alpha
-    // channel, because minui doesn't support alpha channels in
-    // general.
-    png_set_palette_to_rgb(png_ptr_);
-    channels_ = 3;
-  } else {
-    fprintf(stderr, "minui doesn't support PNG depth %d channels %d color_type %d\n", bit_depth_,
-            channels_, color_type_);
-    error_code_ = -7;
-  }
+std::unique_ptr<GRSurface> GRSurface::CreateAliasView() const {
+  auto view = std::unique_ptr<GRSurface>(new GRSurface(width, height, row_bytes, pixel_bytes));
+  // The zero deleter size marks the view as non-owning (see ReleaseData()).
+  view->data_ =
+      std::unique_ptr<uint8_t, DataDeleter>(const_cast<uint8_t*>(data()), DataDeleter{ 0 });
+  view->data_size_ = data_size_;
+  return view;
 }
 
-PngHandler::~PngHandler() {
-  if (png_ptr_) {
-    png_destroy_read_struct(&png_ptr_, &info_ptr_, nullptr);
-  }
+std::vector<std::unique_ptr<GRSurface>> GRSurface::CreateFrameViews(
+    std::unique_ptr<GRSurface> strip, int frame_count) {
+  std::vector<std::unique_ptr<GRSurface>> views;
+  if (!strip || frame_count <= 0 || strip->height % frame_count != 0) return views;
+
+  size_t frame_height = strip->height / frame_count;
+  size_t frame_row_bytes = strip->row_bytes * frame_count;
+  views.reserve(frame_count);
+  for (int i = 0; i < frame_count; ++i) {
+    auto view = std::unique_ptr<GRSurface>(
+        new GRSurface(strip->width, frame_height, frame_row_bytes, strip->pixel_bytes));
+    view->data_ =
+        std::unique_ptr<uint8_t, DataDeleter>(strip->data() + i * strip->row_bytes, DataDeleter{ 0 });
+    view->data_size_ = 0;
+    views.push_back(std::move(view));
+  }
+  // The first view's rows start at the strip's base address, so it can adopt the whole
+  // allocation; freeing it returns the shared buffer to the pool.
+  views[0]->data_ = std::move(strip->data_);
+  views[0]->data_size_ = strip->data_size_;
+  return views;
 }
 
 // "display" surfaces are transformed into the framebuffer's required pixel format (currently only
@@ -208,9 +294,68 @@ static void TransformRgbToDraw(const uint8_t* input_row, uint8_t* output_row, in
   }
 }
 
+// Like TransformRgbToDraw(), but for canonical rows from a resource pack, which carry no display
+// pixel format: the bgr/alpha-position swizzles that libpng applies for us at decode time happen
+// here instead.
+static void TransformCanonicalToDraw(const uint8_t* input_row, uint8_t* output_row, int channels,
+                                     int width) {
+  PixelFormat pixel_format = gr_pixel_format();
+  bool bgr = pixel_format == PixelFormat::ARGB || pixel_format == PixelFormat::BGRA ||
+             pixel_format == PixelFormat::BGRX;
+  bool alpha_first = pixel_format == PixelFormat::RGBA;
+
+  const uint8_t* ip = input_row;
+  uint8_t* op = output_row;
+  for (int x = 0; x < width; ++x) {
+    uint8_t r, g, b;
+    uint8_t a = 0xff;
+    switch (channels) {
+      case 1:
+        r = g = b = *ip++;
+        break;
+      case 3:
+        r = *ip++;
+        g = *ip++;
+        b = *ip++;
+        break;
+      default:
+        r = *ip++;
+        g = *ip++;
+        b = *ip++;
+        a = *ip++;
+        break;
+    }
+    if (bgr) std::swap(r, b);
+    if (alpha_first) {
+      *op++ = a;
+      *op++ = r;
+      *op++ = g;
+      *op++ = b;
+    } else {
+      *op++ = r;
+      *op++ = g;
+      *op++ = b;
+      *op++ = a;
+    }
+  }
+}
+
 int res_create_display_surface(const char* name, GRSurface** pSurface) {
   *pSurface = nullptr;
 
+  const uint8_t* data;
+  if (const ResourcePackEntry* entry = g_resource_pack.Find(name, &data)) {
+    auto surface = GRSurface::Create(entry->width, entry->height, entry->width * 4, 4);
+    if (!surface) return -8;
+    size_t in_row_bytes = entry->width * entry->channels;
+    for (uint32_t y = 0; y < entry->height; ++y) {
+      TransformCanonicalToDraw(data + y * in_row_bytes, surface->data() + y * surface->row_bytes,
+                               entry->channels, entry->width);
+    }
+    *pSurface = surface.release();
+    return 0;
+  }
+
   PngHandler png_handler(name);
   if (!png_handler) return png_handler.error_code();
 
@@ -248,6 +393,40 @@ int res_create_multi_display_surface(const char* name, int* frames, int* fps,
   *pSurface = nullptr;
   *frames = -1;
 
+  const uint8_t* data;
+  if (const ResourcePackEntry* entry = g_resource_pack.Find(name, &data);
+      entry != nullptr && entry->frames > 0 && entry->fps > 0 &&
+      entry->height % entry->frames == 0) {
+    GRSurface** surface = static_cast<GRSurface**>(calloc(entry->frames, sizeof(GRSurface*)));
+    if (!surface) return -8;
+
+    // Transform the interlaced strip into a single buffer and hand out strided views of it, so
+    // each frame's pixels exist exactly once rather than being copied into per-frame surfaces.
+    auto strip = GRSurface::Create(entry->width, entry->height, entry->width * 4, 4);
+    if (!strip) {
+      free(surface);
+      return -8;
+    }
+    size_t in_row_bytes = entry->width * entry->channels;
+    for (uint32_t y = 0; y < entry->height; ++y) {
+      TransformCanonicalToDraw(data + y * in_row_bytes, strip->data() + y * strip->row_bytes,
+                               entry->channels, entry->width);
+    }
+    auto views = GRSurface::CreateFrameViews(std::move(strip), entry->frames);
+    if (views.empty()) {
+      free(surface);
+      return -8;
+    }
+    for (uint32_t i = 0; i < entry->frames; ++i) {
+      surface[i] = views[i].release();
+    }
+
+    *frames = entry->frames;
+    *fps = entry->fps;
+    *pSurface = surface;
+    return 0;
+  }
+
   PngHandler png_handler(name);
   if (!png_handler) return png_handler.error_code();
 
@@ -290,14 +469,6 @@ int res_create_multi_display_surface(const char* name, int* frames, int* fps,
     result = -8;
     goto exit;
   }
-  for (int i = 0; i < *frames; ++i) {
-    auto created_surface = GRSurface::Create(width, height / *frames, width * 4, 4);
-    if (!created_surface) {
-      result = -8;
-      goto exit;
-    }
-    surface[i] = created_surface.release();
-  }
 
   if (gr_pixel_format() == PixelFormat::ARGB || gr_pixel_format() == PixelFormat::BGRA ||
       gr_pixel_format() == PixelFormat::BGRX) {
@@ -306,12 +477,30 @@ int res_create_multi_display_surface(const char* name, int* frames, int* fps,
     png_set_swap_alpha(png_ptr);
   }
 
-  for (png_uint_32 y = 0; y < height; ++y) {
+  {
+    // Decode the interlaced strip into a single buffer in row order, then hand out strided views
+    // of it, so each frame's pixels exist exactly once rather than being copied into per-frame
+    // surfaces.
+    auto strip = GRSurface::Create(width, height, width * 4, 4);
+    if (!strip) {
+      result = -8;
+      goto exit;
+    }
     std::vector<uint8_t> p_row(width * 4);
-    png_read_row(png_ptr, p_row.data(), nullptr);
-    int frame = y % *frames;
-    uint8_t* out_row = surface[frame]->data() + (y / *frames) * surface[frame]->row_bytes;
-    TransformRgbToDraw(p_row.data(), out_row, png_handler.channels(), width);
+    for (png_uint_32 y = 0; y < height; ++y) {
+      png_read_row(png_ptr, p_row.data(), nullptr);
+      TransformRgbToDraw(p_row.data(), strip->data() + y * strip->row_bytes,
+                         png_handler.channels(), width);
+    }
+
+    auto views = GRSurface::CreateFrameViews(std::move(strip), *frames);
+    if (views.empty()) {
+      result = -8;
+      goto exit;
+    }
+    for (int i = 0; i < *frames; ++i) {
+      surface[i] = views[i].release();
+    }
   }
 
   *pSurface = surface;
@@ -331,6 +520,18 @@ exit:
 int res_create_alpha_surface(const char* name, GRSurface** pSurface) {
   *pSurface = nullptr;
 
+  const uint8_t* data;
+  if (const ResourcePackEntry* entry = g_resource_pack.Find(name, &data);
+      entry != nullptr && entry->channels == 1) {
+    auto surface = GRSurface::Create(entry->width, entry->height, entry->width, 1);
+    if (!surface) return -8;
+    for (uint32_t y = 0; y < entry->height; ++y) {
+      memcpy(surface->data() + y * surface->row_bytes, data + y * entry->width, entry->width);
+    }
+    *pSurface = surface.release();
+    return 0;
+  }
+
   PngHandler png_handler(name);
   if (!png_handler) return png_handler.error_code();
 
@@ -359,6 +560,11 @@ int res_create_alpha_surface(const char* name, GRSurface** pSurface) {
 
 void res_set_resource_dir(const std::string& dirname) {
   g_resource_dir = dirname;
+  g_resource_pack.Reset();
+}
+
+std::string res_get_resource_dir() {
+  return g_resource_dir;
 }
 
 // This function tests if a locale string stored in PNG (prefix) matches
@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// respack packs decoded PNG resources into a single mmap-able "resources.pak" that minui loads
+// in place of the individual files, replacing one libpng inflate per resource at recovery
+// startup with a single mmap. Localized images (installing_text etc.) carry per-locale metadata
+// rows and should not be packed; minui falls back to the .png for anything not in the pack.
+//
+// Usage: respack -o resources.pak image1.png [image2.png ...]
+//
+// Each image is stored under its basename without the .png extension, which is the name
+// res_create_*() looks up.
+
+#include <getopt.h>
+#include <libgen.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include <png.h>
+
+#include "private/resource_pack.h"
+#include "private/resources.h"
+
+// PngHandler resolves names against the resource dir before trying them as plain paths; the
+// packer always passes paths, so there is no resource dir here.
+std::string res_get_resource_dir() {
+  return "";
+}
+
+static void Usage(const char* argv0) {
+  fprintf(stderr, "usage: %s -o output.pak image1.png [image2.png ...]\n", argv0);
+}
+
+int main(int argc, char** argv) {
+  std::string output_path;
+  int opt;
+  while ((opt = getopt(argc, argv, "o:h")) != -1) {
+    switch (opt) {
+      case 'o':
+        output_path = optarg;
+        break;
+      default:
+        Usage(argv[0]);
+        return 2;
+    }
+  }
+  if (output_path.empty() || optind == argc) {
+    Usage(argv[0]);
+    return 2;
+  }
+
+  std::vector<ResourcePackEntry> entries;
+  std::vector<std::vector<uint8_t>> payloads;
+
+  for (int i = optind; i < argc; ++i) {
+    std::string path = argv[i];
+    std::string base = basename(&path[0]);
+    if (base.size() > 4 && base.compare(base.size() - 4, 4, ".png") == 0) {
+      base.resize(base.size() - 4);
+    }
+
+    ResourcePackEntry entry = {};
+    if (base.size() >= sizeof(entry.name)) {
+      fprintf(stderr, "resource name too long: %s\n", base.c_str());
+      return 1;
+    }
+    strcpy(entry.name, base.c_str());
+
+    PngHandler png_handler(argv[i]);
+    if (!png_handler) {
+      fprintf(stderr, "failed to read %s: %d\n", argv[i], png_handler.error_code());
+      return 1;
+    }
+
+    entry.channels = png_handler.channels();
+    entry.width = png_handler.width();
+    entry.height = png_handler.height();
+    entry.frames = 1;
+    entry.fps = 20;
+
+    png_textp text;
+    int num_text;
+    if (png_get_text(png_handler.png_ptr(), png_handler.info_ptr(), &text, &num_text)) {
+      for (int t = 0; t < num_text; ++t) {
+        if (text[t].key && strcmp(text[t].key, "Frames") == 0 && text[t].text) {
+          entry.frames = atoi(text[t].text);
+        } else if (text[t].key && strcmp(text[t].key, "FPS") == 0 && text[t].text) {
+          entry.fps = atoi(text[t].text);
+        }
+      }
+    }
+    if (entry.frames == 0 || entry.height % entry.frames != 0) {
+      fprintf(stderr, "bad frame count %u for %s (height %u)\n", entry.frames, argv[i],
+              entry.height);
+      return 1;
+    }
+
+    size_t row_bytes = entry.width * entry.channels;
+    std::vector<uint8_t> payload(static_cast<size_t>(entry.height) * row_bytes);
+    for (uint32_t y = 0; y < entry.height; ++y) {
+      png_read_row(png_handler.png_ptr(), payload.data() + y * row_bytes, nullptr);
+    }
+    entry.size = payload.size();
+
+    entries.push_back(entry);
+    payloads.push_back(std::move(payload));
+  }
+
+  uint64_t offset = sizeof(ResourcePackHeader) + entries.size() * sizeof(ResourcePackEntry);
+  for (size_t i = 0; i < entries.size(); ++i) {
+    entries[i].offset = offset;
+    offset += entries[i].size;
+  }
+
+  FILE* fp = fopen(output_path.c_str(), "wbe");
+  if (!fp) {
+    fprintf(stderr, "failed to open %s\n", output_path.c_str());
+    return 1;
+  }
+
+  ResourcePackHeader header = {};
+  header.magic = kResourcePackMagic;
+  header.version = kResourcePackVersion;
+  header.entry_count = entries.size();
+
+  bool ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+            fwrite(entries.data(), sizeof(ResourcePackEntry), entries.size(), fp) == entries.size();
+  for (size_t i = 0; ok && i < payloads.size(); ++i) {
+    ok = fwrite(payloads[i].data(), 1, payloads[i].size(), fp) == payloads[i].size();
+  }
+  if (fclose(fp) != 0 || !ok) {
+    fprintf(stderr, "failed to write %s\n", output_path.c_str());
+    return 1;
+  }
+
+  printf("packed %zu resources into %s\n", entries.size(), output_path.c_str());
+  return 0;
+}
@@ -16,6 +16,11 @@
 
 #include "private/asn1_decoder.h"
 
+// Cost model: the walk is O(structure), not O(bytes). Primitive contents (OCTET STRINGs, OIDs)
+// are never copied or scanned — asn1_*_get() hands out pointers into the caller's buffer, and
+// skip_bytes()/asn1_sequence_next() advance the cursor with pointer arithmetic. Only tag and
+// length octets are actually read, a handful per TLV node.
+
 int asn1_context::peek_byte() const {
   if (length_ == 0) {
     return -1;
@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "otautil/cpu_topology.h"
+
+#include <sched.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <utility>
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/parseint.h>
+#include <android-base/stringprintf.h>
+#include <android-base/strings.h>
+
+static bool ReadCpuCapacity(int cpu, uint64_t* capacity) {
+  std::string path =
+      android::base::StringPrintf("/sys/devices/system/cpu/cpu%d/cpu_capacity", cpu);
+  std::string content;
+  if (!android::base::ReadFileToString(path, &content)) {
+    return false;
+  }
+  return android::base::ParseUint(android::base::Trim(content), capacity);
+}
+
+static CpuTopology BuildCpuTopology() {
+  CpuTopology topology;
+  long cpu_count = sysconf(_SC_NPROCESSORS_CONF);
+  if (cpu_count < 1) {
+    cpu_count = 1;
+  }
+
+  // Any CPU without a readable capacity makes the whole classification untrustworthy, so fall
+  // back to treating the system as homogeneous rather than guessing at the missing cores.
+  std::vector<std::pair<int, uint64_t>> capacities;
+  for (int cpu = 0; cpu < cpu_count; cpu++) {
+    uint64_t capacity;
+    if (!ReadCpuCapacity(cpu, &capacity)) {
+      capacities.clear();
+      break;
+    }
+    capacities.emplace_back(cpu, capacity);
+  }
+
+  if (!capacities.empty()) {
+    auto [min_it, max_it] = std::minmax_element(
+        capacities.begin(), capacities.end(),
+        [](const auto& a, const auto& b) { return a.second < b.second; });
+    if (min_it->second != max_it->second) {
+      uint64_t min_capacity = min_it->second;
+      for (const auto& [cpu, capacity] : capacities) {
+        (capacity == min_capacity ? topology.efficiency_cpus : topology.performance_cpus)
+            .push_back(cpu);
+      }
+      LOG(INFO) << "cpu topology: " << topology.performance_cpus.size() << " performance, "
+                << topology.efficiency_cpus.size() << " efficiency cores";
+      return topology;
+    }
+  }
+
+  for (int cpu = 0; cpu < cpu_count; cpu++) {
+    topology.performance_cpus.push_back(cpu);
+  }
+  return topology;
+}
+
+const CpuTopology& GetCpuTopology() {
+  static const CpuTopology topology = BuildCpuTopology();
+  return topology;
+}
+
+static bool PinToCpus(const std::vector<int>& cpus) {
+  if (cpus.empty()) {
+    return false;
+  }
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (int cpu : cpus) {
+    CPU_SET(cpu, &set);
+  }
+  // A pid of 0 applies the mask to the calling thread only.
+  if (sched_setaffinity(0, sizeof(set), &set) == -1) {
+    PLOG(WARNING) << "sched_setaffinity failed";
+    return false;
+  }
+  return true;
+}
+
+bool PinToPerformanceCores() {
+  const CpuTopology& topology = GetCpuTopology();
+  return !topology.efficiency_cpus.empty() && PinToCpus(topology.performance_cpus);
+}
+
+bool PinToEfficiencyCores() {
+  return PinToCpus(GetCpuTopology().efficiency_cpus);
+}
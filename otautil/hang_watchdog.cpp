@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "otautil/hang_watchdog.h"
+
+#include <dirent.h>
+#include <unistd.h>
+
+#include <memory>
+#include <utility>
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/parseint.h>
+#include <android-base/stringprintf.h>
+#include <android-base/strings.h>
+
+HangWatchdog::HangWatchdog(std::string what, std::chrono::seconds timeout,
+                           std::function<void()> on_hang)
+    : what_(std::move(what)), timeout_(timeout), on_hang_(std::move(on_hang)) {
+  if (timeout_ > std::chrono::seconds::zero()) {
+    thread_ = std::thread(&HangWatchdog::Loop, this);
+  }
+}
+
+HangWatchdog::~HangWatchdog() {
+  if (thread_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    cv_.notify_one();
+    thread_.join();
+  }
+}
+
+void HangWatchdog::Pet() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    generation_++;
+  }
+  cv_.notify_one();
+}
+
+void HangWatchdog::Loop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stop_) {
+    uint64_t seen = generation_;
+    if (!cv_.wait_for(lock, timeout_, [this, seen] { return stop_ || generation_ != seen; })) {
+      LOG(ERROR) << what_ << ": no progress for " << timeout_.count()
+                 << " seconds, dumping thread and I/O state";
+      lock.unlock();
+      DumpProcessState(getpid(), what_);
+      if (on_hang_) {
+        on_hang_();
+      }
+      return;
+    }
+  }
+}
+
+// Extracts the single-character thread state from a /proc stat line. The comm field may contain
+// spaces and parentheses, so parse from the last ')'.
+static std::string ThreadStateFromStat(const std::string& stat) {
+  size_t pos = stat.rfind(')');
+  if (pos == std::string::npos || pos + 2 >= stat.size()) {
+    return "?";
+  }
+  return stat.substr(pos + 2, 1);
+}
+
+void HangWatchdog::DumpProcessState(pid_t pid, const std::string& what) {
+  std::string task_dir = android::base::StringPrintf("/proc/%d/task", pid);
+  std::unique_ptr<DIR, decltype(&closedir)> dir(opendir(task_dir.c_str()), closedir);
+  if (!dir) {
+    PLOG(ERROR) << "Failed to open " << task_dir;
+    return;
+  }
+
+  dirent* de;
+  while ((de = readdir(dir.get())) != nullptr) {
+    int tid;
+    if (!android::base::ParseInt(de->d_name, &tid)) {
+      continue;
+    }
+    std::string tid_dir = task_dir + "/" + de->d_name;
+
+    std::string comm;
+    android::base::ReadFileToString(tid_dir + "/comm", &comm);
+    std::string stat;
+    android::base::ReadFileToString(tid_dir + "/stat", &stat);
+    std::string wchan;
+    android::base::ReadFileToString(tid_dir + "/wchan", &wchan);
+    LOG(ERROR) << what << ": tid " << tid << " (" << android::base::Trim(comm) << ") state "
+               << ThreadStateFromStat(stat) << " wchan " << wchan;
+
+    // The kernel stack pinpoints where a D-state thread is stuck in the driver. The file needs
+    // CONFIG_STACKTRACE and root; both hold in recovery, but skip quietly if not.
+    std::string stack;
+    if (android::base::ReadFileToString(tid_dir + "/stack", &stack)) {
+      for (const auto& frame : android::base::Split(android::base::Trim(stack), "\n")) {
+        LOG(ERROR) << what << ":   " << frame;
+      }
+    }
+  }
+
+  std::string io;
+  if (android::base::ReadFileToString(android::base::StringPrintf("/proc/%d/io", pid), &io)) {
+    for (const auto& line : android::base::Split(android::base::Trim(io), "\n")) {
+      LOG(ERROR) << what << ": io " << line;
+    }
+  }
+}
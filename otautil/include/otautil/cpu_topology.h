@@ -0,0 +1,42 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <vector>
+
+// The CPU ids of the system, split by scheduler capacity. On big.LITTLE devices the efficiency
+// list holds the lowest-capacity cluster and the performance list everything else (mid cores
+// count as performance: they run patch and hash work fine, it is only the little cluster that
+// CPU-bound workers must stay off). On homogeneous systems, or when cpu_capacity is not exposed,
+// every CPU is reported as performance and the efficiency list is empty.
+struct CpuTopology {
+  std::vector<int> performance_cpus;
+  std::vector<int> efficiency_cpus;
+};
+
+// Returns the topology, parsed once from /sys/devices/system/cpu/cpu<N>/cpu_capacity.
+const CpuTopology& GetCpuTopology();
+
+// Pins the calling thread to the performance cluster. Returns false without touching affinity on
+// homogeneous systems — pinning to "all CPUs" would only discard any mask the caller inherited —
+// or when the affinity call is rejected.
+bool PinToPerformanceCores();
+
+// Pins the calling thread to the efficiency cluster, for threads that mostly wait on I/O and
+// should not occupy a performance core while the real work is CPU-bound. Returns false on
+// homogeneous systems or when the affinity call is rejected.
+bool PinToEfficiencyCores();
@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <sys/types.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Detects a wedged install. A write(2) stuck in a dying flash controller never returns and never
+// logs; recovery just sits at a frozen progress bar until the user pulls the battery mid-write.
+// The watchdog turns that into a diagnosed, recoverable failure: if the guarded operation stops
+// reporting progress for the configured timeout, every thread's state, wait channel and kernel
+// stack plus the process I/O counters go to the log, and the caller's hang handler runs.
+class HangWatchdog {
+ public:
+  // Starts the watchdog thread. |what| names the guarded operation in the logs. If Pet() is not
+  // called for |timeout|, the watchdog dumps this process's state, invokes |on_hang| (may be
+  // null) and stops watching. A zero timeout disables the watchdog entirely.
+  HangWatchdog(std::string what, std::chrono::seconds timeout, std::function<void()> on_hang);
+  ~HangWatchdog();
+
+  HangWatchdog(const HangWatchdog&) = delete;
+  HangWatchdog& operator=(const HangWatchdog&) = delete;
+
+  // Reports progress, rearming the timeout. Cheap enough to call per command.
+  void Pet();
+
+  // Logs state, wchan and kernel stack of every thread of |pid|, plus its /proc I/O counters.
+  // Best effort; used by the watchdog on its own process and by recovery on the updater process
+  // it supervises. Kernel stacks are what identify a thread blocked in the driver — a userspace
+  // unwind of a D-state thread would show the write(2) call and nothing actionable.
+  static void DumpProcessState(pid_t pid, const std::string& what);
+
+ private:
+  void Loop();
+
+  std::string what_;
+  std::chrono::seconds timeout_;
+  std::function<void()> on_hang_;
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  uint64_t generation_ = 0;
+  bool stop_ = false;
+  std::thread thread_;
+};
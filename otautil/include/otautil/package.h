@@ -24,6 +24,7 @@
 #include <string>
 #include <vector>
 
+#include <android-base/unique_fd.h>
 #include <ziparchive/zip_archive.h>
 
 #include "otautil/verifier.h"
@@ -53,10 +54,27 @@ class Package : public VerifierInterface {
   // Opens the package as a zip file and returns the ZipArchiveHandle.
   virtual ZipArchiveHandle GetZipArchiveHandle() = 0;
 
+  // Returns an fd through which another process (e.g. the forked updater) can read the package
+  // without reopening and re-reading its path, or an invalid fd when reopening the path is just
+  // as cheap (a file-backed mapping whose pages are already in the page cache). The returned fd
+  // is inheritable across exec.
+  virtual android::base::unique_fd CreateShareableFd() const {
+    return android::base::unique_fd();
+  }
+
   // Updates the progress in fraction during package verification.
   void SetProgress(float progress) override;
 
+  // Registers a callback invoked with every buffer served by ReadFullyAtOffset, e.g. to feed a
+  // StreamingVerifier so package bytes are hashed as the installer consumes them.
+  void SetReadObserver(std::function<void(const uint8_t*, uint64_t, uint64_t)> observer) {
+    read_observer_ = std::move(observer);
+  }
+
  protected:
   // An optional function to update the progress.
   std::function<void(float)> set_progress_;
+
+  // An optional observer of the data served by ReadFullyAtOffset.
+  std::function<void(const uint8_t*, uint64_t, uint64_t)> read_observer_;
 };
@@ -41,6 +41,13 @@ class Paths {
     cache_temp_source_ = temp_source;
   }
 
+  std::string compiled_script_cache_file() const {
+    return compiled_script_cache_file_;
+  }
+  void set_compiled_script_cache_file(const std::string& cache_file) {
+    compiled_script_cache_file_ = cache_file;
+  }
+
   std::string last_command_file() const {
     return last_command_file_;
   }
@@ -96,6 +103,10 @@ class Paths {
   // the cached file contains the bits we want and use it as the source instead.
   std::string cache_temp_source_;
 
+  // Path to the compiled updater-script cache, so a retried install can skip re-parsing the
+  // script. May be empty to disable the cache.
+  std::string compiled_script_cache_file_;
+
   // Path to the last command file.
   std::string last_command_file_;
 
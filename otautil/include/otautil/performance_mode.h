@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+// Scoped cpufreq boost for long-running work (package installs, wipes). Recovery inherits
+// whatever cpufreq state the kernel boots into, which is often a conservative governor; while an
+// instance is alive, every cpufreq policy's scaling_governor is switched to the governor named by
+// ro.recovery.perf.governor ("performance" by default, empty to disable), and any extra sysfs
+// knobs listed in ro.recovery.perf.sysfs (comma-separated path=value pairs) are applied. The
+// previous values are restored on destruction. All writes are best effort: a missing or
+// read-only node is logged and skipped.
+//
+// The boost can be dropped temporarily under thermal pressure: Suspend() restores the previous
+// values and Resume() reapplies the boost, so a hot install slows down instead of tripping a
+// thermal abort.
+class PerformanceMode {
+ public:
+  PerformanceMode();
+  ~PerformanceMode();
+
+  PerformanceMode(const PerformanceMode&) = delete;
+  PerformanceMode& operator=(const PerformanceMode&) = delete;
+
+  // Temporarily restores the pre-boost values; a no-op when already suspended.
+  void Suspend();
+  // Reapplies the boost after a Suspend(); a no-op when not suspended.
+  void Resume();
+
+ private:
+  struct Node {
+    std::string path;
+    std::string previous;
+    std::string boosted;
+  };
+
+  // Writes |value| to |path|, remembering the old content for Suspend() and the destructor.
+  void ApplyNode(const std::string& path, const std::string& value);
+
+  // Nodes to restore, in application order.
+  std::vector<Node> saved_nodes_;
+  bool suspended_ = false;
+};
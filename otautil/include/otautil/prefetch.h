@@ -0,0 +1,34 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+// Best-effort page cache warming for recovery's predictable flows. Each flow has a small
+// manifest of the files its next stage is known to read (helper binaries, otacerts.zip, the
+// log directory); starting a prefetch issues POSIX_FADV_WILLNEED for them from a background
+// worker, so the cold-start reads overlap the confirmation dialogs instead of the work itself.
+
+enum class PrefetchFlow {
+  kApplyUpdate,  // otacerts.zip, minadbd for sideload
+  kWipe,         // mkfs helpers for the data/cache/system wipes
+  kViewLogs,     // /cache/recovery log files
+};
+
+// Starts warming the given flow's manifest on a background worker and returns immediately.
+// Missing files are skipped silently (manifests cover several configurations); if a previous
+// prefetch is still in flight the call is dropped rather than queued, since by then the page
+// cache is already being filled with the right data or the files are being read for real.
+void StartPrefetch(PrefetchFlow flow);
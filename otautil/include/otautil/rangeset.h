@@ -20,6 +20,7 @@
 
 #include <optional>
 #include <string>
+#include <string_view>
 #include <utility>
 #include <vector>
 
@@ -32,8 +33,9 @@ class RangeSet {
   explicit RangeSet(std::vector<Range>&& pairs);
 
   // Parses the given string into a RangeSet. Returns the parsed RangeSet, or an empty RangeSet on
-  // errors.
-  static RangeSet Parse(const std::string& range_text);
+  // errors. Takes a view so that callers iterating a large transfer list can pass slices of the
+  // mapped blob without materializing a string per range.
+  static RangeSet Parse(std::string_view range_text);
 
   // Appends the given Range to the current RangeSet.
   bool PushBack(Range range);
@@ -161,8 +163,16 @@ class SortedRangeSet : public RangeSet {
 
   using RangeSet::Overlaps;
 
+  // Checks whether the file segment [start, start + len) overlaps this set. Binary searches the
+  // sorted ranges, so it stays cheap on whole-transfer-list sized sets.
   bool Overlaps(size_t start, size_t len) const;
 
+  // Returns the set of blocks contained in both this set and |other|.
+  SortedRangeSet Intersect(const SortedRangeSet& other) const;
+
+  // Returns the set of blocks contained in this set but not in |other|.
+  SortedRangeSet Subtract(const SortedRangeSet& other) const;
+
   // Given an offset of the file, checks if the corresponding block (by considering the file as
   // 0-based continuous block ranges) is covered by the SortedRangeSet. If so, returns the offset
   // within this SortedRangeSet.
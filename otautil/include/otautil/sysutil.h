@@ -18,6 +18,8 @@
 
 #include <sys/types.h>
 
+#include <chrono>
+#include <functional>
 #include <string>
 #include <string_view>
 #include <vector>
@@ -78,6 +80,18 @@ class BlockMapData {
  */
 class MemMapping {
  public:
+  // Access-pattern hints for the mapped data, forwarded to madvise(2). kHugePage asks the kernel
+  // to back the map with transparent huge pages where the kernel supports that for file-backed
+  // maps. All hints are advisory; failures are logged and otherwise ignored.
+  enum class AccessPattern {
+    kNormal,
+    kRandom,
+    kSequential,
+    kWillNeed,
+    kDontNeed,
+    kHugePage,
+  };
+
   ~MemMapping();
   // Map a file into a private, read-only memory segment. If 'filename' begins with an '@'
   // character, it is a map of blocks to be mapped, otherwise it is treated as an ordinary file.
@@ -86,6 +100,11 @@ class MemMapping {
     return ranges_.size();
   };
 
+  // Applies the hint to the whole map, or to the byte window [offset, offset + window_length),
+  // rounded out to page boundaries and clamped to the map.
+  void Advise(AccessPattern pattern) const;
+  void Advise(AccessPattern pattern, size_t offset, size_t window_length) const;
+
   unsigned char* addr;  // start of data
   size_t length;        // length of data
 
@@ -112,3 +131,12 @@ bool Shutdown(std::string_view target);
 // vector, plus an additional nullptr at the end. This is a helper function that facilitates
 // calling C functions (such as getopt(3)) that expect an array of C-strings.
 std::vector<char*> StringVectorToNullTerminatedArray(const std::vector<std::string>& args);
+
+// Waits until |present| returns true, sleeping on a netlink uevent socket so the wait unblocks
+// the moment the kernel announces a new device instead of at the next polling interval. Falls
+// back to interval polling when the uevent socket isn't available (insufficient privileges, or a
+// non-Linux host). Returns false if |timeout| expires with |present| still false.
+bool WaitForDevice(const std::function<bool()>& present, std::chrono::milliseconds timeout);
+
+// Waits for the device node at |path| to exist, as above.
+bool WaitForBlockDevice(const std::string& path, std::chrono::milliseconds timeout);
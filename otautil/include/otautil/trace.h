@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+
+// Lightweight in-process tracepoints for the install hot paths. There's no logcat or atrace under
+// recovery, so when a field install takes 25 minutes this is the only way to get a timeline of
+// where those minutes went. Tracing is off unless the flag file exists when InitTracing() runs;
+// a disabled tracepoint costs one relaxed atomic load, so the tracepoints stay compiled in on all
+// build types. Events are buffered per thread without locking on the record path and written out
+// by DumpTrace() as a Chrome trace event JSON file (loadable in chrome://tracing and Perfetto).
+
+// Creating this file (e.g. over adb) before starting the install enables tracing for every
+// process that calls InitTracing() afterwards.
+constexpr const char* kTraceFlagFile = "/cache/recovery/enable_tracing";
+
+// Latches the flag file into the process-wide enabled state. Idempotent; returns whether tracing
+// is enabled. Each traced process calls this once, before its first tracepoint.
+bool InitTracing();
+
+// Writes all buffered events to /cache/recovery/trace-<pid>.json. The pid suffix keeps the
+// updater, the FUSE provider process and recovery itself from clobbering each other's timelines.
+// No-op when tracing is disabled or nothing was recorded.
+void DumpTrace();
+
+// Records the wall time between construction and destruction as one complete trace event on the
+// calling thread. |name| ends up inside a JSON string literal, so keep it free of quotes and
+// backslashes; the names used here are short fixed identifiers or transfer-list command names.
+class ScopedTrace {
+ public:
+  explicit ScopedTrace(std::string name);
+  ~ScopedTrace();
+
+  ScopedTrace(const ScopedTrace&) = delete;
+  ScopedTrace& operator=(const ScopedTrace&) = delete;
+
+ private:
+  std::string name_;
+  uint64_t start_us_ = 0;  // 0 when tracing was disabled at construction
+};
@@ -82,6 +82,42 @@ class VerifierInterface {
 //  VERIFY_FAILURE (if any error is encountered or no key matches the signature).
 int verify_file(VerifierInterface* package, const std::vector<Certificate>& keys);
 
+// Verifies the whole-file signature incrementally while the package is being consumed, so the
+// install doesn't pay for a separate end-to-end verification scan. Feed every buffer served to
+// the consumer to Observe(); bytes that pass the sequential hash cursor in order are digested on
+// the fly, and Finalize() reads whatever was skipped before checking the signature. Intended for
+// transports that serve the package through VerifierInterface::ReadFullyAtOffset (see
+// Package::SetReadObserver); the caller must not commit any destructive work until Finalize()
+// has returned VERIFY_SUCCESS.
+class StreamingVerifier {
+ public:
+  StreamingVerifier(VerifierInterface* package, const std::vector<Certificate>& keys);
+
+  // Parses the signature footer and EOCD and sets up the hash contexts. Returns false if the
+  // package has no well-formed signature; no bytes of the payload are read.
+  bool Initialize();
+
+  // Records that |size| bytes at |offset| have been served to the consumer.
+  void Observe(const uint8_t* buffer, uint64_t size, uint64_t offset);
+
+  // Hashes any part of the signed region the consumer never read, then checks the signature.
+  // Returns VERIFY_SUCCESS or VERIFY_FAILURE.
+  int Finalize();
+
+ private:
+  VerifierInterface* package_;
+  const std::vector<Certificate>& keys_;
+
+  bool initialized_ = false;
+  uint64_t signed_len_ = 0;
+  uint64_t hashed_so_far_ = 0;  // sequential hash cursor within the signed region
+  std::vector<uint8_t> sig_der_;
+  bool need_sha1_ = false;
+  bool need_sha256_ = false;
+  SHA_CTX sha1_ctx_;
+  SHA256_CTX sha256_ctx_;
+};
+
 // Checks that the RSA key has a modulus of 2048 or 4096 bits long, and public exponent is 3 or
 // 65537.
 bool CheckRSAKey(const std::unique_ptr<RSA, RSADeleter>& rsa);
@@ -16,9 +16,16 @@
 
 #include "otautil/package.h"
 
+#include <fcntl.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <limits>
+#include <list>
+#include <utility>
+
 #include <android-base/file.h>
 #include <android-base/logging.h>
 #include <android-base/stringprintf.h>
@@ -58,6 +65,8 @@ class MemoryPackage : public Package {
 
   ZipArchiveHandle GetZipArchiveHandle() override;
 
+  android::base::unique_fd CreateShareableFd() const override;
+
   bool UpdateHashAtOffset(const std::vector<HasherUpdateCallback>& hashers, uint64_t start,
                           uint64_t length) override;
 
@@ -106,23 +115,49 @@ class FilePackage : public Package {
 
   ZipArchiveHandle GetZipArchiveHandle() override;
 
+  android::base::unique_fd CreateShareableFd() const override;
+
   bool UpdateHashAtOffset(const std::vector<HasherUpdateCallback>& hashers, uint64_t start,
                           uint64_t length) override;
 
  private:
+  // Small reads (zip central directory walk, entry headers) are served from an internal LRU cache
+  // of aligned blocks, so repeated seeks into the same region don't each hit the medium; this
+  // matters on FAT-formatted sdcards where the seek traffic dominates. Reads of a cache block or
+  // more bypass the cache — the bulk payload reads are sequential and caching them would only
+  // evict the directory blocks.
+  static constexpr uint64_t kCacheBlockSize = 128 * 1024;
+  static constexpr size_t kCacheBlockCount = 32;  // 4 MiB budget
+
+  // Returns the cached block containing |block_index|, reading it from the package on a miss.
+  // Returns nullptr on read failure.
+  const std::vector<uint8_t>* GetCachedBlock(uint64_t block_index);
+
   android::base::unique_fd fd_;  // The underlying fd to the open package.
   uint64_t package_size_;
   std::string path_;  // The physical path to the package.
 
   ZipArchiveHandle zip_handle_;
+
+  // Cached blocks in LRU order (most recent first), with an index for lookup.
+  std::list<std::pair<uint64_t, std::vector<uint8_t>>> cached_blocks_;
+  std::map<uint64_t, decltype(cached_blocks_)::iterator> cached_block_index_;
+  uint64_t last_block_read_ = std::numeric_limits<uint64_t>::max();
+  uint64_t cache_hits_ = 0;
+  uint64_t cache_misses_ = 0;
 };
 
 std::unique_ptr<Package> Package::CreateMemoryPackage(
     const std::string& path, const std::function<void(float)>& set_progress) {
   std::unique_ptr<MemMapping> mmap = std::make_unique<MemMapping>();
   if (!mmap->MapFile(path)) {
-    LOG(ERROR) << "failed to map file";
-    return nullptr;
+    // Mapping can fail on 32-bit builds once the package outgrows the addressable window, even
+    // though the zip itself is fine: libziparchive parses zip64 archives through OpenArchiveFd()
+    // just as well as through OpenArchiveFromMemory(). Fall back to the file-backed package,
+    // which reads through the fd in bounded chunks and has no size ceiling, rather than making
+    // the caller repack the OTA to fit.
+    LOG(WARNING) << "Failed to map " << path << "; falling back to a file-backed package";
+    return CreateFilePackage(path, set_progress);
   }
 
   return std::make_unique<MemoryPackage>(path, std::move(mmap), set_progress);
@@ -180,6 +215,9 @@ bool MemoryPackage::ReadFullyAtOffset(uint8_t* buffer, uint64_t byte_count, uint
     return false;
   }
   memcpy(buffer, addr_ + offset, byte_count);
+  if (read_observer_) {
+    read_observer_(buffer, byte_count, offset);
+  }
   return true;
 }
 
@@ -212,6 +250,27 @@ ZipArchiveHandle MemoryPackage::GetZipArchiveHandle() {
   return zip_handle_;
 }
 
+android::base::unique_fd MemoryPackage::CreateShareableFd() const {
+  // A file-backed mapping leaves its pages in the page cache, so reopening the path costs the
+  // receiver next to nothing; there's no fd worth sharing.
+  if (package_content_.empty()) {
+    return android::base::unique_fd();
+  }
+
+  // Content-only packages have no path to reopen. Hand the verified bytes over in a memfd, a
+  // RAM-to-RAM copy that never touches storage.
+  android::base::unique_fd memfd(memfd_create("ota_package", 0));
+  if (memfd == -1) {
+    PLOG(WARNING) << "Failed to create memfd for package handoff";
+    return android::base::unique_fd();
+  }
+  if (!android::base::WriteFully(memfd, addr_, package_size_)) {
+    PLOG(WARNING) << "Failed to write package content to memfd";
+    return android::base::unique_fd();
+  }
+  return memfd;
+}
+
 FilePackage::FilePackage(android::base::unique_fd&& fd, uint64_t file_size, const std::string& path,
                          const std::function<void(float)>& set_progress)
     : fd_(std::move(fd)), package_size_(file_size), path_(path), zip_handle_(nullptr) {
@@ -219,11 +278,49 @@ FilePackage::FilePackage(android::base::unique_fd&& fd, uint64_t file_size, cons
 }
 
 FilePackage::~FilePackage() {
+  if (cache_hits_ + cache_misses_ > 0) {
+    LOG(INFO) << "package block cache: " << cache_hits_ << " hits, " << cache_misses_
+              << " misses";
+  }
   if (zip_handle_) {
     CloseArchive(zip_handle_);
   }
 }
 
+const std::vector<uint8_t>* FilePackage::GetCachedBlock(uint64_t block_index) {
+  if (auto it = cached_block_index_.find(block_index); it != cached_block_index_.end()) {
+    cache_hits_++;
+    cached_blocks_.splice(cached_blocks_.begin(), cached_blocks_, it->second);
+    return &it->second->second;
+  }
+  cache_misses_++;
+
+  uint64_t block_offset = block_index * kCacheBlockSize;
+  uint64_t block_size = std::min(kCacheBlockSize, package_size_ - block_offset);
+  std::vector<uint8_t> block(block_size);
+  if (!android::base::ReadFullyAtOffset(fd_.get(), block.data(), block_size, block_offset)) {
+    PLOG(ERROR) << "Failed to read " << block_size << " bytes data at offset " << block_offset;
+    return nullptr;
+  }
+
+  // On a sequential walk (the central directory scan), ask the kernel to start fetching the next
+  // block while the caller parses this one.
+  if (block_index == last_block_read_ + 1 &&
+      (block_index + 1) * kCacheBlockSize < package_size_) {
+    posix_fadvise64(fd_.get(), (block_index + 1) * kCacheBlockSize, kCacheBlockSize,
+                    POSIX_FADV_WILLNEED);
+  }
+  last_block_read_ = block_index;
+
+  cached_blocks_.emplace_front(block_index, std::move(block));
+  cached_block_index_[block_index] = cached_blocks_.begin();
+  if (cached_blocks_.size() > kCacheBlockCount) {
+    cached_block_index_.erase(cached_blocks_.back().first);
+    cached_blocks_.pop_back();
+  }
+  return &cached_blocks_.front().second;
+}
+
 bool FilePackage::ReadFullyAtOffset(uint8_t* buffer, uint64_t byte_count, uint64_t offset) {
   if (byte_count > package_size_ || offset > package_size_ - byte_count) {
     LOG(ERROR) << "Out of bound read, offset: " << offset << ", size: " << byte_count
@@ -231,11 +328,30 @@ bool FilePackage::ReadFullyAtOffset(uint8_t* buffer, uint64_t byte_count, uint64
     return false;
   }
 
-  if (!android::base::ReadFullyAtOffset(fd_.get(), buffer, byte_count, offset)) {
-    PLOG(ERROR) << "Failed to read " << byte_count << " bytes data at offset " << offset;
-    return false;
+  if (byte_count >= kCacheBlockSize) {
+    // Bulk payload read; bypass the block cache.
+    if (!android::base::ReadFullyAtOffset(fd_.get(), buffer, byte_count, offset)) {
+      PLOG(ERROR) << "Failed to read " << byte_count << " bytes data at offset " << offset;
+      return false;
+    }
+  } else {
+    uint64_t copied = 0;
+    while (copied < byte_count) {
+      uint64_t pos = offset + copied;
+      const std::vector<uint8_t>* block = GetCachedBlock(pos / kCacheBlockSize);
+      if (block == nullptr) {
+        return false;
+      }
+      uint64_t block_offset = pos % kCacheBlockSize;
+      uint64_t chunk = std::min<uint64_t>(byte_count - copied, block->size() - block_offset);
+      memcpy(buffer + copied, block->data() + block_offset, chunk);
+      copied += chunk;
+    }
   }
 
+  if (read_observer_) {
+    read_observer_(buffer, byte_count, offset);
+  }
   return true;
 }
 
@@ -276,3 +392,14 @@ ZipArchiveHandle FilePackage::GetZipArchiveHandle() {
 
   return zip_handle_;
 }
+
+android::base::unique_fd FilePackage::CreateShareableFd() const {
+  // The dup shares the open file description, so on a FUSE-backed sideload the receiver's reads
+  // go through the same provider session (and its block cache) instead of pulling the package
+  // over USB from scratch.
+  android::base::unique_fd fd(dup(fd_.get()));
+  if (fd == -1) {
+    PLOG(WARNING) << "Failed to dup package fd";
+  }
+  return fd;
+}
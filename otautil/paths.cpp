@@ -18,6 +18,7 @@
 
 constexpr const char kDefaultCacheLogDirectory[] = "/cache/recovery";
 constexpr const char kDefaultCacheTempSource[] = "/cache/saved.file";
+constexpr const char kDefaultCompiledScriptCacheFile[] = "/cache/recovery/compiled_script";
 constexpr const char kDefaultLastCommandFile[] = "/cache/recovery/last_command";
 constexpr const char kDefaultResourceDirectory[] = "/res/images";
 constexpr const char kDefaultStashDirectoryBase[] = "/cache/recovery";
@@ -33,6 +34,7 @@ Paths& Paths::Get() {
 Paths::Paths()
     : cache_log_directory_(kDefaultCacheLogDirectory),
       cache_temp_source_(kDefaultCacheTempSource),
+      compiled_script_cache_file_(kDefaultCompiledScriptCacheFile),
       last_command_file_(kDefaultLastCommandFile),
       resource_dir_(kDefaultResourceDirectory),
       stash_directory_base_(kDefaultStashDirectoryBase),
@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "otautil/performance_mode.h"
+
+#include <dirent.h>
+
+#include <memory>
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/properties.h>
+#include <android-base/strings.h>
+
+static constexpr const char* kCpufreqDir = "/sys/devices/system/cpu/cpufreq";
+
+void PerformanceMode::ApplyNode(const std::string& path, const std::string& value) {
+  std::string old_value;
+  if (!android::base::ReadFileToString(path, &old_value)) {
+    PLOG(WARNING) << "Failed to read " << path;
+    return;
+  }
+  old_value = android::base::Trim(old_value);
+  if (old_value == value) {
+    return;
+  }
+  if (!android::base::WriteStringToFile(value, path)) {
+    PLOG(WARNING) << "Failed to write " << value << " to " << path;
+    return;
+  }
+  LOG(INFO) << "Set " << path << " to " << value << " (was " << old_value << ")";
+  saved_nodes_.push_back({ path, old_value, value });
+}
+
+void PerformanceMode::Suspend() {
+  if (suspended_) {
+    return;
+  }
+  suspended_ = true;
+  LOG(WARNING) << "Suspending the cpufreq boost";
+  for (auto it = saved_nodes_.rbegin(); it != saved_nodes_.rend(); ++it) {
+    if (!android::base::WriteStringToFile(it->previous, it->path)) {
+      PLOG(WARNING) << "Failed to restore " << it->path << " to " << it->previous;
+    }
+  }
+}
+
+void PerformanceMode::Resume() {
+  if (!suspended_) {
+    return;
+  }
+  suspended_ = false;
+  LOG(INFO) << "Reapplying the cpufreq boost";
+  for (const auto& node : saved_nodes_) {
+    if (!android::base::WriteStringToFile(node.boosted, node.path)) {
+      PLOG(WARNING) << "Failed to set " << node.path << " to " << node.boosted;
+    }
+  }
+}
+
+PerformanceMode::PerformanceMode() {
+  std::string governor = android::base::GetProperty("ro.recovery.perf.governor", "performance");
+  if (!governor.empty()) {
+    std::unique_ptr<DIR, decltype(&closedir)> dir(opendir(kCpufreqDir), closedir);
+    if (dir) {
+      dirent* de;
+      while ((de = readdir(dir.get())) != nullptr) {
+        if (!android::base::StartsWith(de->d_name, "policy")) continue;
+        ApplyNode(std::string(kCpufreqDir) + "/" + de->d_name + "/scaling_governor", governor);
+      }
+    }
+  }
+
+  // Device-specific knobs, e.g. disabling a thermal-aware scheduler or raising a bus clock vote.
+  std::string extra_nodes = android::base::GetProperty("ro.recovery.perf.sysfs", "");
+  for (const auto& entry : android::base::Split(extra_nodes, ",")) {
+    if (entry.empty()) continue;
+    auto separator = entry.find('=');
+    if (separator == std::string::npos) {
+      LOG(WARNING) << "Skipping malformed ro.recovery.perf.sysfs entry: " << entry;
+      continue;
+    }
+    ApplyNode(entry.substr(0, separator), entry.substr(separator + 1));
+  }
+}
+
+PerformanceMode::~PerformanceMode() {
+  if (suspended_) {
+    // The pre-boost values are already in place.
+    return;
+  }
+  // Restore in reverse in case the same node was listed twice.
+  for (auto it = saved_nodes_.rbegin(); it != saved_nodes_.rend(); ++it) {
+    if (!android::base::WriteStringToFile(it->previous, it->path)) {
+      PLOG(WARNING) << "Failed to restore " << it->path << " to " << it->previous;
+    }
+  }
+}
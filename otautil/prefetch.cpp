@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "otautil/prefetch.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <android-base/logging.h>
+#include <android-base/unique_fd.h>
+
+// A single oversized file (a stale sideload package, a huge log) must not evict the rest of the
+// manifest, so each file's advice is capped.
+static constexpr off_t kMaxPrefetchPerFile = 16 * 1024 * 1024;
+
+// Entries ending in '/' name a directory whose regular files are warmed (non-recursive).
+static std::vector<std::string> ManifestForFlow(PrefetchFlow flow) {
+  switch (flow) {
+    case PrefetchFlow::kApplyUpdate:
+      return {
+        "/system/etc/security/otacerts.zip",
+        "/system/bin/minadbd",
+      };
+    case PrefetchFlow::kWipe:
+      return {
+        "/system/bin/mke2fs",
+        "/system/bin/e2fsdroid",
+        "/system/bin/make_f2fs",
+        "/system/bin/sload_f2fs",
+      };
+    case PrefetchFlow::kViewLogs:
+      return {
+        "/cache/recovery/",
+      };
+  }
+  return {};
+}
+
+static void PrefetchFile(const std::string& path) {
+  android::base::unique_fd fd(open(path.c_str(), O_RDONLY | O_CLOEXEC));
+  if (fd == -1) {
+    return;
+  }
+  struct stat sb;
+  if (fstat(fd.get(), &sb) == -1 || !S_ISREG(sb.st_mode)) {
+    return;
+  }
+  off_t length = std::min(sb.st_size, kMaxPrefetchPerFile);
+  if (length == 0) {
+    return;
+  }
+  if (posix_fadvise(fd.get(), 0, length, POSIX_FADV_WILLNEED) != 0) {
+    PLOG(WARNING) << "Failed to fadvise " << path;
+  }
+}
+
+static void PrefetchManifest(std::vector<std::string> manifest) {
+  for (const auto& entry : manifest) {
+    if (entry.back() != '/') {
+      PrefetchFile(entry);
+      continue;
+    }
+    std::unique_ptr<DIR, decltype(&closedir)> dir(opendir(entry.c_str()), closedir);
+    if (!dir) {
+      continue;
+    }
+    while (struct dirent* de = readdir(dir.get())) {
+      if (de->d_name[0] == '.') continue;
+      PrefetchFile(entry + de->d_name);
+    }
+  }
+}
+
+void StartPrefetch(PrefetchFlow flow) {
+  // Serialized through a single slot, like the deferred fuse teardown: at most one worker, and
+  // a new flow while one is still advising is simply dropped.
+  static std::future<void> worker;
+  if (worker.valid() && worker.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+    return;
+  }
+  worker = std::async(std::launch::async, &PrefetchManifest, ManifestForFlow(flow));
+}
@@ -20,7 +20,9 @@
 #include <stddef.h>
 
 #include <algorithm>
+#include <charconv>
 #include <string>
+#include <string_view>
 #include <utility>
 #include <vector>
 
@@ -44,15 +46,33 @@ RangeSet::RangeSet(std::vector<Range>&& pairs) {
   }
 }
 
-RangeSet RangeSet::Parse(const std::string& range_text) {
-  std::vector<std::string> pieces = android::base::Split(range_text, ",");
+// Parses one comma-delimited field without materializing a temporary string; Parse() runs once
+// per command on transfer lists with hundreds of thousands of lines.
+static bool ParseRangeField(std::string_view text, size_t* value) {
+  auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), *value);
+  return ec == std::errc() && ptr == text.data() + text.size() &&
+         *value <= static_cast<size_t>(INT_MAX);
+}
+
+RangeSet RangeSet::Parse(std::string_view range_text) {
+  std::vector<std::string_view> pieces;
+  size_t begin = 0;
+  while (begin <= range_text.size()) {
+    size_t end = range_text.find(',', begin);
+    if (end == std::string_view::npos) {
+      pieces.push_back(range_text.substr(begin));
+      break;
+    }
+    pieces.push_back(range_text.substr(begin, end - begin));
+    begin = end + 1;
+  }
   if (pieces.size() < 3) {
     LOG(ERROR) << "Invalid range text: " << range_text;
     return {};
   }
 
   size_t num;
-  if (!android::base::ParseUint(pieces[0], &num, static_cast<size_t>(INT_MAX))) {
+  if (!ParseRangeField(pieces[0], &num)) {
     LOG(ERROR) << "Failed to parse the number of tokens: " << range_text;
     return {};
   }
@@ -73,8 +93,7 @@ RangeSet RangeSet::Parse(const std::string& range_text) {
   for (size_t i = 0; i < num; i += 2) {
     size_t first;
     size_t second;
-    if (!android::base::ParseUint(pieces[i + 1], &first, static_cast<size_t>(INT_MAX)) ||
-        !android::base::ParseUint(pieces[i + 2], &second, static_cast<size_t>(INT_MAX))) {
+    if (!ParseRangeField(pieces[i + 1], &first) || !ParseRangeField(pieces[i + 2], &second)) {
       return {};
     }
     pairs.emplace_back(first, second);
@@ -173,13 +192,36 @@ size_t RangeSet::GetBlockNumber(size_t idx) const {
 // RangeSet has half-closed half-open bounds. For example, "3,5" contains blocks 3 and 4. So "3,5"
 // and "5,7" are not overlapped.
 bool RangeSet::Overlaps(const RangeSet& other) const {
-  for (const auto& [begin, end] : ranges_) {
-    for (const auto& [other_begin, other_end] : other.ranges_) {
-      // [begin, end) vs [other_begin, other_end)
-      if (!(other_begin >= end || begin >= other_end)) {
-        return true;
+  // For the small sets that make up individual transfer commands, the nested scan is cheapest.
+  // Whole-transfer-list sets can hold thousands of ranges, where the pairwise comparison turns
+  // quadratic; sort both sides once and sweep them in lockstep instead.
+  if (ranges_.size() * other.ranges_.size() <= 64) {
+    for (const auto& [begin, end] : ranges_) {
+      for (const auto& [other_begin, other_end] : other.ranges_) {
+        // [begin, end) vs [other_begin, other_end)
+        if (!(other_begin >= end || begin >= other_end)) {
+          return true;
+        }
       }
     }
+    return false;
+  }
+
+  std::vector<Range> lhs(ranges_);
+  std::vector<Range> rhs(other.ranges_);
+  std::sort(lhs.begin(), lhs.end());
+  std::sort(rhs.begin(), rhs.end());
+
+  size_t i = 0;
+  size_t j = 0;
+  while (i < lhs.size() && j < rhs.size()) {
+    if (lhs[i].second <= rhs[j].first) {
+      i++;
+    } else if (rhs[j].second <= lhs[i].first) {
+      j++;
+    } else {
+      return true;
+    }
   }
   return false;
 }
@@ -279,8 +321,59 @@ void SortedRangeSet::Insert(size_t start, size_t len) {
 }
 
 bool SortedRangeSet::Overlaps(size_t start, size_t len) const {
-  RangeSet rs({ { start / kBlockSize, (start + len - 1) / kBlockSize + 1 } });
-  return Overlaps(rs);
+  size_t query_start = start / kBlockSize;
+  size_t query_end = (start + len - 1) / kBlockSize + 1;
+
+  // The ranges are sorted and mutually exclusive, so both the starts and the ends are in
+  // ascending order; binary search for the first range that ends past the query start.
+  auto it = std::upper_bound(
+      ranges_.begin(), ranges_.end(), query_start,
+      [](size_t value, const Range& range) { return value < range.second; });
+  return it != ranges_.end() && it->first < query_end;
+}
+
+SortedRangeSet SortedRangeSet::Intersect(const SortedRangeSet& other) const {
+  SortedRangeSet result;
+  size_t i = 0;
+  size_t j = 0;
+  while (i < ranges_.size() && j < other.ranges_.size()) {
+    size_t begin = std::max(ranges_[i].first, other.ranges_[j].first);
+    size_t end = std::min(ranges_[i].second, other.ranges_[j].second);
+    if (begin < end) {
+      result.PushBack({ begin, end });
+    }
+    // Advance whichever range finishes first.
+    if (ranges_[i].second <= other.ranges_[j].second) {
+      i++;
+    } else {
+      j++;
+    }
+  }
+  return result;
+}
+
+SortedRangeSet SortedRangeSet::Subtract(const SortedRangeSet& other) const {
+  SortedRangeSet result;
+  size_t j = 0;
+  for (const auto& [begin, end] : ranges_) {
+    size_t current = begin;
+    // Skip the subtrahend ranges that lie entirely before this range.
+    while (j < other.ranges_.size() && other.ranges_[j].second <= current) {
+      j++;
+    }
+    size_t k = j;
+    while (k < other.ranges_.size() && other.ranges_[k].first < end) {
+      if (current < other.ranges_[k].first) {
+        result.PushBack({ current, other.ranges_[k].first });
+      }
+      current = std::max(current, other.ranges_[k].second);
+      k++;
+    }
+    if (current < end) {
+      result.PushBack({ current, end });
+    }
+  }
+  return result;
 }
 
 // Given an offset of the file, checks if the corresponding block (by considering the file as
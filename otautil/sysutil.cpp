@@ -19,13 +19,24 @@
 #include <errno.h>  // TEMP_FAILURE_RETRY
 #include <fcntl.h>
 #include <inttypes.h>
+#include <stdint.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/netlink.h>
+#include <poll.h>
+#include <sys/socket.h>
+#endif
 
 #include <algorithm>
+#include <chrono>
+#include <functional>
 #include <limits>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include <android-base/file.h>
@@ -182,6 +193,50 @@ bool MemMapping::MapBlockFile(const std::string& filename) {
   return true;
 }
 
+static int AdviceForAccessPattern(MemMapping::AccessPattern pattern) {
+  switch (pattern) {
+    case MemMapping::AccessPattern::kNormal:
+      return MADV_NORMAL;
+    case MemMapping::AccessPattern::kRandom:
+      return MADV_RANDOM;
+    case MemMapping::AccessPattern::kSequential:
+      return MADV_SEQUENTIAL;
+    case MemMapping::AccessPattern::kWillNeed:
+      return MADV_WILLNEED;
+    case MemMapping::AccessPattern::kDontNeed:
+      return MADV_DONTNEED;
+    case MemMapping::AccessPattern::kHugePage:
+#ifdef MADV_HUGEPAGE
+      return MADV_HUGEPAGE;
+#else
+      return -1;
+#endif
+  }
+  return -1;
+}
+
+void MemMapping::Advise(AccessPattern pattern) const {
+  Advise(pattern, 0, length);
+}
+
+void MemMapping::Advise(AccessPattern pattern, size_t offset, size_t window_length) const {
+  int advice = AdviceForAccessPattern(pattern);
+  if (advice == -1 || addr == nullptr || offset >= length || window_length == 0) {
+    return;
+  }
+  window_length = std::min(window_length, length - offset);
+
+  // madvise() wants a page-aligned address; round the window out to page boundaries. The end may
+  // round past 'length', which is fine since the underlying map is page-sized.
+  size_t page_mask = sysconf(_SC_PAGESIZE) - 1;
+  uintptr_t window_start = (reinterpret_cast<uintptr_t>(addr) + offset) & ~page_mask;
+  uintptr_t window_end =
+      (reinterpret_cast<uintptr_t>(addr) + offset + window_length + page_mask) & ~page_mask;
+  if (madvise(reinterpret_cast<void*>(window_start), window_end - window_start, advice) != 0) {
+    PLOG(WARNING) << "madvise(" << advice << ") failed";
+  }
+}
+
 bool MemMapping::MapFile(const std::string& fn) {
   if (fn.empty()) {
     LOG(ERROR) << "Empty filename";
@@ -245,3 +300,72 @@ std::vector<char*> StringVectorToNullTerminatedArray(const std::vector<std::stri
   result.push_back(nullptr);
   return result;
 }
+
+#ifdef __linux__
+static android::base::unique_fd OpenUeventSocket() {
+  android::base::unique_fd sock(socket(PF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK,
+                                       NETLINK_KOBJECT_UEVENT));
+  if (sock == -1) {
+    return {};
+  }
+  struct sockaddr_nl addr = {};
+  addr.nl_family = AF_NETLINK;
+  addr.nl_groups = 0xffffffff;
+  if (bind(sock, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0) {
+    return {};
+  }
+  return sock;
+}
+#endif
+
+bool WaitForDevice(const std::function<bool()>& present, std::chrono::milliseconds timeout) {
+  auto deadline = std::chrono::steady_clock::now() + timeout;
+#ifdef __linux__
+  // Subscribe before the first check, so a device announced between the check and the wait can't
+  // be missed.
+  if (android::base::unique_fd sock = OpenUeventSocket(); sock != -1) {
+    if (present()) {
+      return true;
+    }
+    while (true) {
+      auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+          deadline - std::chrono::steady_clock::now());
+      if (remaining.count() <= 0) {
+        return present();
+      }
+      struct pollfd pfd = { .fd = sock.get(), .events = POLLIN, .revents = 0 };
+      // Cap the wait so predicates that depend on more than device nodes (e.g. device-mapper
+      // state) still get re-checked periodically.
+      if (poll(&pfd, 1, std::min<int64_t>(remaining.count(), 500)) > 0) {
+        // Drain whatever is queued; the content doesn't matter, any event is a cue to re-check.
+        char buf[1024];
+        while (recv(sock, buf, sizeof(buf), 0) > 0) {
+        }
+      }
+      if (present()) {
+        return true;
+      }
+    }
+  }
+#endif
+  // No uevent socket (insufficient privileges, or not Linux): plain interval polling.
+  if (present()) {
+    return true;
+  }
+  while (std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    if (present()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool WaitForBlockDevice(const std::string& path, std::chrono::milliseconds timeout) {
+  return WaitForDevice(
+      [&path]() {
+        struct stat sb;
+        return stat(path.c_str(), &sb) == 0;
+      },
+      timeout);
+}
@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "otautil/trace.h"
+
+#include <inttypes.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/stringprintf.h>
+
+static std::atomic<bool> tracing_enabled{ false };
+
+static uint64_t MonotonicMicros() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+struct TraceEvent {
+  std::string name;
+  uint64_t start_us;
+  uint64_t duration_us;
+};
+
+// Per-thread event buffer. The owning thread appends without synchronization; the registry below
+// owns the buffers (and thus keeps them alive past thread exit), so DumpTrace() can walk every
+// thread's events after the workers have been joined.
+struct ThreadTraceBuffer {
+  pid_t tid;
+  std::vector<TraceEvent> events;
+};
+
+static std::mutex registry_mutex;
+static std::vector<std::unique_ptr<ThreadTraceBuffer>>& BufferRegistry() {
+  static auto* registry = new std::vector<std::unique_ptr<ThreadTraceBuffer>>;
+  return *registry;
+}
+
+static ThreadTraceBuffer* GetThreadBuffer() {
+  // The lock is only taken on a thread's first tracepoint; every later record is just a
+  // push_back on a thread-owned vector.
+  static thread_local ThreadTraceBuffer* buffer = []() {
+    auto owned = std::make_unique<ThreadTraceBuffer>();
+    owned->tid = static_cast<pid_t>(syscall(__NR_gettid));
+    ThreadTraceBuffer* raw = owned.get();
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    BufferRegistry().push_back(std::move(owned));
+    return raw;
+  }();
+  return buffer;
+}
+
+bool InitTracing() {
+  if (access(kTraceFlagFile, F_OK) == 0) {
+    tracing_enabled.store(true, std::memory_order_relaxed);
+  }
+  return tracing_enabled.load(std::memory_order_relaxed);
+}
+
+void DumpTrace() {
+  if (!tracing_enabled.load(std::memory_order_relaxed)) {
+    return;
+  }
+
+  std::string json = "[";
+  bool first = true;
+  {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    for (const auto& buffer : BufferRegistry()) {
+      for (const auto& event : buffer->events) {
+        if (!first) json += ",";
+        first = false;
+        json += android::base::StringPrintf(
+            "\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%" PRIu64
+            ",\"dur\":%" PRIu64 "}",
+            event.name.c_str(), getpid(), buffer->tid, event.start_us, event.duration_us);
+      }
+    }
+  }
+  if (first) {
+    return;
+  }
+  json += "\n]\n";
+
+  std::string path = android::base::StringPrintf("/cache/recovery/trace-%d.json", getpid());
+  if (!android::base::WriteStringToFile(json, path)) {
+    PLOG(ERROR) << "Failed to write trace to " << path;
+  } else {
+    LOG(INFO) << "Wrote trace to " << path;
+  }
+}
+
+ScopedTrace::ScopedTrace(std::string name) {
+  if (!tracing_enabled.load(std::memory_order_relaxed)) {
+    return;
+  }
+  name_ = std::move(name);
+  start_us_ = MonotonicMicros();
+}
+
+ScopedTrace::~ScopedTrace() {
+  if (start_us_ == 0) {
+    return;
+  }
+  uint64_t end_us = MonotonicMicros();
+  GetThreadBuffer()->events.push_back({ std::move(name_), start_us_, end_us - start_us_ });
+}
@@ -22,8 +22,11 @@
 #include <string.h>
 
 #include <algorithm>
+#include <atomic>
 #include <functional>
+#include <future>
 #include <memory>
+#include <utility>
 #include <vector>
 
 #include <android-base/logging.h>
@@ -110,10 +113,11 @@ static bool read_pkcs7(const uint8_t* pkcs7_der, size_t pkcs7_der_len,
   return true;
 }
 
-int verify_file(VerifierInterface* package, const std::vector<Certificate>& keys) {
-  CHECK(package);
-  package->SetProgress(0.0);
-
+// Locates the whole-file signature of |package| and extracts the DER signature block. On success,
+// sets |signed_len| to the number of bytes covered by the signature and returns true. Returns
+// false if the package lacks a well-formed signature footer or EOCD.
+static bool ParseSignedRegion(VerifierInterface* package, uint64_t* signed_len,
+                              std::vector<uint8_t>* sig_der) {
   // An archive with a whole-file signature will end in six bytes:
   //
   //   (2-byte signature start) $ff $ff (2-byte comment size)
@@ -127,18 +131,18 @@ int verify_file(VerifierInterface* package, const std::vector<Certificate>& keys
 
   if (length < FOOTER_SIZE) {
     LOG(ERROR) << "not big enough to contain footer";
-    return VERIFY_FAILURE;
+    return false;
   }
 
   uint8_t footer[FOOTER_SIZE];
   if (!package->ReadFullyAtOffset(footer, FOOTER_SIZE, length - FOOTER_SIZE)) {
     LOG(ERROR) << "Failed to read footer";
-    return VERIFY_FAILURE;
+    return false;
   }
 
   if (footer[2] != 0xff || footer[3] != 0xff) {
     LOG(ERROR) << "footer is wrong";
-    return VERIFY_FAILURE;
+    return false;
   }
 
   size_t comment_size = footer[4] + (footer[5] << 8);
@@ -149,12 +153,12 @@ int verify_file(VerifierInterface* package, const std::vector<Certificate>& keys
   if (signature_start > comment_size) {
     LOG(ERROR) << "signature start: " << signature_start
                << " is larger than comment size: " << comment_size;
-    return VERIFY_FAILURE;
+    return false;
   }
 
   if (signature_start <= FOOTER_SIZE) {
     LOG(ERROR) << "Signature start is in the footer";
-    return VERIFY_FAILURE;
+    return false;
   }
 
 #define EOCD_HEADER_SIZE 22
@@ -164,24 +168,24 @@ int verify_file(VerifierInterface* package, const std::vector<Certificate>& keys
 
   if (length < eocd_size) {
     LOG(ERROR) << "not big enough to contain EOCD";
-    return VERIFY_FAILURE;
+    return false;
   }
 
   // Determine how much of the file is covered by the signature. This is everything except the
   // signature data and length, which includes all of the EOCD except for the comment length field
   // (2 bytes) and the comment data.
-  uint64_t signed_len = length - eocd_size + EOCD_HEADER_SIZE - 2;
+  *signed_len = length - eocd_size + EOCD_HEADER_SIZE - 2;
 
-  uint8_t eocd[eocd_size];
-  if (!package->ReadFullyAtOffset(eocd, eocd_size, length - eocd_size)) {
+  std::vector<uint8_t> eocd(eocd_size);
+  if (!package->ReadFullyAtOffset(eocd.data(), eocd_size, length - eocd_size)) {
     LOG(ERROR) << "Failed to read EOCD of " << eocd_size << " bytes";
-    return VERIFY_FAILURE;
+    return false;
   }
 
   // If this is really is the EOCD record, it will begin with the magic number $50 $4b $05 $06.
   if (eocd[0] != 0x50 || eocd[1] != 0x4b || eocd[2] != 0x05 || eocd[3] != 0x06) {
     LOG(ERROR) << "signature length doesn't match EOCD marker";
-    return VERIFY_FAILURE;
+    return false;
   }
 
   for (size_t i = 4; i < eocd_size - 3; ++i) {
@@ -190,9 +194,114 @@ int verify_file(VerifierInterface* package, const std::vector<Certificate>& keys
       // find the later (wrong) one, which could be exploitable. Fail the verification if this
       // sequence occurs anywhere after the real one.
       LOG(ERROR) << "EOCD marker occurs after start of EOCD";
-      return VERIFY_FAILURE;
+      return false;
+    }
+  }
+
+  const uint8_t* signature = eocd.data() + eocd_size - signature_start;
+  size_t signature_size = signature_start - FOOTER_SIZE;
+
+  LOG(INFO) << "signature (offset: " << std::hex << (length - signature_start)
+            << ", length: " << signature_size << "): " << print_hex(signature, signature_size);
+
+  if (!read_pkcs7(signature, signature_size, sig_der)) {
+    LOG(ERROR) << "Could not find signature DER block";
+    return false;
+  }
+
+  return true;
+}
+
+// Checks the extracted DER signature block against each of |keys|, given the digests over the
+// signed region. Returns VERIFY_SUCCESS if any key matches.
+static int VerifySignature(const uint8_t* sha1, const uint8_t* sha256,
+                           const std::vector<uint8_t>& sig_der,
+                           const std::vector<Certificate>& keys) {
+  // Check to make sure at least one of the keys matches the signature. Since any key can match,
+  // all of them have to be tried before declaring a failure — but the candidates are independent,
+  // so try them concurrently instead of paying one full signature operation per loaded key on
+  // multi-key devices. The first match sets |verified| and the keys still queued behind it skip
+  // their crypto. (The extracted block carries only the raw signature octets, no signer info, so
+  // there is no key hint to index by.)
+  std::atomic<bool> verified{ false };
+
+  auto try_key = [&](size_t i) {
+    if (verified.load()) {
+      return false;  // Another key already matched; the overall result is decided.
+    }
+
+    const auto& key = keys[i];
+    const uint8_t* hash;
+    int hash_nid;
+    switch (key.hash_len) {
+      case SHA_DIGEST_LENGTH:
+        hash = sha1;
+        hash_nid = NID_sha1;
+        break;
+      case SHA256_DIGEST_LENGTH:
+        hash = sha256;
+        hash_nid = NID_sha256;
+        break;
+      default:
+        return false;
+    }
+
+    // The 6 bytes is the "(signature_start) $ff $ff (comment_size)" that the signing tool appends
+    // after the signature itself.
+    if (key.key_type == Certificate::KEY_TYPE_RSA) {
+      if (!RSA_verify(hash_nid, hash, key.hash_len, sig_der.data(), sig_der.size(),
+                      key.rsa.get())) {
+        LOG(INFO) << "failed to verify against RSA key " << i;
+        return false;
+      }
+
+      LOG(INFO) << "whole-file signature verified against RSA key " << i;
+    } else if (key.key_type == Certificate::KEY_TYPE_EC && key.hash_len == SHA256_DIGEST_LENGTH) {
+      if (!ECDSA_verify(0, hash, key.hash_len, sig_der.data(), sig_der.size(), key.ec.get())) {
+        LOG(INFO) << "failed to verify against EC key " << i;
+        return false;
+      }
+
+      LOG(INFO) << "whole-file signature verified against EC key " << i;
+    } else {
+      LOG(INFO) << "Unknown key type " << key.key_type;
+      return false;
+    }
+
+    verified.store(true);
+    return true;
+  };
+
+  bool any_verified = false;
+  if (keys.size() == 1) {
+    any_verified = try_key(0);
+  } else {
+    std::vector<std::future<bool>> candidates;
+    candidates.reserve(keys.size());
+    for (size_t i = 0; i < keys.size(); i++) {
+      candidates.emplace_back(std::async(std::launch::async, try_key, i));
+    }
+    for (auto& candidate : candidates) {
+      any_verified = candidate.get() || any_verified;
     }
   }
+  if (any_verified) {
+    return VERIFY_SUCCESS;
+  }
+
+  LOG(ERROR) << "failed to verify whole-file signature";
+  return VERIFY_FAILURE;
+}
+
+int verify_file(VerifierInterface* package, const std::vector<Certificate>& keys) {
+  CHECK(package);
+  package->SetProgress(0.0);
+
+  uint64_t signed_len;
+  std::vector<uint8_t> sig_der;
+  if (!ParseSignedRegion(package, &signed_len, &sig_der)) {
+    return VERIFY_FAILURE;
+  }
 
   bool need_sha1 = false;
   bool need_sha256 = false;
@@ -222,90 +331,158 @@ int verify_file(VerifierInterface* package, const std::vector<Certificate>& keys
         std::bind(&SHA256_Update, &sha256_ctx, std::placeholders::_1, std::placeholders::_2));
   }
 
+  // The signature covers flat SHA-1/SHA-256 digests, so each hash must consume the bytes in
+  // order. What we can overlap is everything around it: the next chunk is read on a separate
+  // thread while the current one is being digested, and when both digests are needed each chunk
+  // is fed to the two hash contexts concurrently. On slow media this hides most of the hashing
+  // time behind the I/O, and vice versa on fast media.
+
+  // On a Nexus 5X, experiment showed 16MiB beat 1MiB by 6% faster for a 1196MiB full OTA and
+  // 60% for an 89MiB incremental OTA. http://b/28135231.
+  constexpr uint64_t kHashChunkSize = 16 * MiB;
+
+  std::vector<uint8_t> current_chunk(std::min<uint64_t>(signed_len, kHashChunkSize));
+  std::vector<uint8_t> next_chunk(current_chunk.size());
+
   double frac = -1.0;
   uint64_t so_far = 0;
-  while (so_far < signed_len) {
-    // On a Nexus 5X, experiment showed 16MiB beat 1MiB by 6% faster for a 1196MiB full OTA and
-    // 60% for an 89MiB incremental OTA. http://b/28135231.
-    uint64_t read_size = std::min<uint64_t>(signed_len - so_far, 16 * MiB);
-    package->UpdateHashAtOffset(hashers, so_far, read_size);
-    so_far += read_size;
+  uint64_t read_size = std::min<uint64_t>(signed_len, kHashChunkSize);
+  bool read_failed = signed_len > 0 && !package->ReadFullyAtOffset(current_chunk.data(), read_size,
+                                                                   0);
+  while (!read_failed && so_far < signed_len) {
+    uint64_t chunk_size = read_size;
+    uint64_t next_offset = so_far + chunk_size;
+
+    std::future<bool> next_read;
+    if (next_offset < signed_len) {
+      read_size = std::min<uint64_t>(signed_len - next_offset, kHashChunkSize);
+      next_read = std::async(std::launch::async, [&package, &next_chunk, read_size, next_offset] {
+        return package->ReadFullyAtOffset(next_chunk.data(), read_size, next_offset);
+      });
+    }
+
+    if (hashers.size() > 1) {
+      std::vector<std::future<void>> updates;
+      for (const auto& hasher : hashers) {
+        updates.emplace_back(std::async(std::launch::async, [&hasher, &current_chunk, chunk_size] {
+          hasher(current_chunk.data(), chunk_size);
+        }));
+      }
+      for (auto& update : updates) {
+        update.wait();
+      }
+    } else if (!hashers.empty()) {
+      hashers[0](current_chunk.data(), chunk_size);
+    }
+
+    if (next_read.valid()) {
+      read_failed = !next_read.get();
+      std::swap(current_chunk, next_chunk);
+    }
+    so_far += chunk_size;
 
     double f = so_far / static_cast<double>(signed_len);
-    if (f > frac + 0.02 || read_size == so_far) {
+    if (f > frac + 0.02 || chunk_size == so_far) {
       package->SetProgress(f);
       frac = f;
     }
   }
+  if (read_failed) {
+    LOG(ERROR) << "Failed to read package for hashing";
+    return VERIFY_FAILURE;
+  }
 
   uint8_t sha1[SHA_DIGEST_LENGTH];
   SHA1_Final(sha1, &sha1_ctx);
   uint8_t sha256[SHA256_DIGEST_LENGTH];
   SHA256_Final(sha256, &sha256_ctx);
 
-  const uint8_t* signature = eocd + eocd_size - signature_start;
-  size_t signature_size = signature_start - FOOTER_SIZE;
+  int result = VerifySignature(sha1, sha256, sig_der, keys);
+  if (result != VERIFY_SUCCESS) {
+    if (need_sha1) {
+      LOG(INFO) << "SHA-1 digest: " << print_hex(sha1, SHA_DIGEST_LENGTH);
+    }
+    if (need_sha256) {
+      LOG(INFO) << "SHA-256 digest: " << print_hex(sha256, SHA256_DIGEST_LENGTH);
+    }
+  }
+  return result;
+}
 
-  LOG(INFO) << "signature (offset: " << std::hex << (length - signature_start)
-            << ", length: " << signature_size << "): " << print_hex(signature, signature_size);
+StreamingVerifier::StreamingVerifier(VerifierInterface* package,
+                                     const std::vector<Certificate>& keys)
+    : package_(package), keys_(keys) {}
 
-  std::vector<uint8_t> sig_der;
-  if (!read_pkcs7(signature, signature_size, &sig_der)) {
-    LOG(ERROR) << "Could not find signature DER block";
-    return VERIFY_FAILURE;
+bool StreamingVerifier::Initialize() {
+  CHECK(package_);
+  if (!ParseSignedRegion(package_, &signed_len_, &sig_der_)) {
+    return false;
   }
 
-  // Check to make sure at least one of the keys matches the signature. Since any key can match,
-  // we need to try each before determining a verification failure has happened.
-  for (size_t i = 0; i < keys.size(); i++) {
-    const auto& key = keys[i];
-    const uint8_t* hash;
-    int hash_nid;
+  for (const auto& key : keys_) {
     switch (key.hash_len) {
       case SHA_DIGEST_LENGTH:
-        hash = sha1;
-        hash_nid = NID_sha1;
+        need_sha1_ = true;
         break;
       case SHA256_DIGEST_LENGTH:
-        hash = sha256;
-        hash_nid = NID_sha256;
+        need_sha256_ = true;
         break;
-      default:
-        continue;
     }
+  }
+  SHA1_Init(&sha1_ctx_);
+  SHA256_Init(&sha256_ctx_);
+  initialized_ = true;
+  return true;
+}
 
-    // The 6 bytes is the "(signature_start) $ff $ff (comment_size)" that the signing tool appends
-    // after the signature itself.
-    if (key.key_type == Certificate::KEY_TYPE_RSA) {
-      if (!RSA_verify(hash_nid, hash, key.hash_len, sig_der.data(), sig_der.size(),
-                      key.rsa.get())) {
-        LOG(INFO) << "failed to verify against RSA key " << i;
-        continue;
-      }
+void StreamingVerifier::Observe(const uint8_t* buffer, uint64_t size, uint64_t offset) {
+  if (!initialized_ || hashed_so_far_ >= signed_len_) {
+    return;
+  }
+  // The whole-file digests must consume the signed region in order, so a sequential cursor
+  // follows the reads. A read overlapping the cursor advances it by hashing the unseen suffix;
+  // reads behind the cursor are re-reads, reads ahead of it leave a gap for Finalize() to fill.
+  if (offset > hashed_so_far_ || offset + size <= hashed_so_far_) {
+    return;
+  }
+  uint64_t skip = hashed_so_far_ - offset;
+  uint64_t len = std::min(size - skip, signed_len_ - hashed_so_far_);
+  if (need_sha1_) {
+    SHA1_Update(&sha1_ctx_, buffer + skip, len);
+  }
+  if (need_sha256_) {
+    SHA256_Update(&sha256_ctx_, buffer + skip, len);
+  }
+  hashed_so_far_ += len;
+}
 
-      LOG(INFO) << "whole-file signature verified against RSA key " << i;
-      return VERIFY_SUCCESS;
-    } else if (key.key_type == Certificate::KEY_TYPE_EC && key.hash_len == SHA256_DIGEST_LENGTH) {
-      if (!ECDSA_verify(0, hash, key.hash_len, sig_der.data(), sig_der.size(), key.ec.get())) {
-        LOG(INFO) << "failed to verify against EC key " << i;
-        continue;
-      }
+int StreamingVerifier::Finalize() {
+  if (!initialized_) {
+    return VERIFY_FAILURE;
+  }
 
-      LOG(INFO) << "whole-file signature verified against EC key " << i;
-      return VERIFY_SUCCESS;
-    } else {
-      LOG(INFO) << "Unknown key type " << key.key_type;
+  // Hash whatever the consumer skipped over. When the package was consumed mostly sequentially,
+  // this is only the signed trailer past the last entry read.
+  std::vector<uint8_t> buffer(std::min<uint64_t>(signed_len_ - hashed_so_far_, 16 * MiB));
+  while (hashed_so_far_ < signed_len_) {
+    uint64_t offset = hashed_so_far_;
+    uint64_t read_size = std::min<uint64_t>(signed_len_ - offset, buffer.size());
+    if (!package_->ReadFullyAtOffset(buffer.data(), read_size, offset)) {
+      LOG(ERROR) << "Failed to read package remainder for hashing";
+      return VERIFY_FAILURE;
+    }
+    // If this verifier is also registered as the package's read observer, the read above has
+    // advanced the cursor already; only hash the buffer directly if it hasn't.
+    if (hashed_so_far_ == offset) {
+      Observe(buffer.data(), read_size, offset);
     }
   }
 
-  if (need_sha1) {
-    LOG(INFO) << "SHA-1 digest: " << print_hex(sha1, SHA_DIGEST_LENGTH);
-  }
-  if (need_sha256) {
-    LOG(INFO) << "SHA-256 digest: " << print_hex(sha256, SHA256_DIGEST_LENGTH);
-  }
-  LOG(ERROR) << "failed to verify whole-file signature";
-  return VERIFY_FAILURE;
+  uint8_t sha1[SHA_DIGEST_LENGTH];
+  SHA1_Final(sha1, &sha1_ctx_);
+  uint8_t sha256[SHA256_DIGEST_LENGTH];
+  SHA256_Final(sha256, &sha256_ctx_);
+  return VerifySignature(sha1, sha256, sig_der_, keys_);
 }
 
 static std::vector<Certificate> IterateZipEntriesAndSearchForKeys(const ZipArchiveHandle& handle) {
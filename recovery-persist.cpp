@@ -30,12 +30,14 @@
 //    --force-persist  ignore /cache mount, always rotate in the contents.
 //
 
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
 #include <array>
+#include <map>
 #include <string>
 
 #include <android-base/file.h>
@@ -49,6 +51,8 @@
 constexpr const char* LAST_LOG_FILE = "/data/misc/recovery/last_log";
 constexpr const char* LAST_PMSG_FILE = "/sys/fs/pstore/pmsg-ramoops-0";
 constexpr const char* LAST_KMSG_FILE = "/data/misc/recovery/last_kmsg";
+constexpr const char* LAST_METRICS_FILE = "/data/misc/recovery/last_metrics";
+constexpr const char* LAST_METRICS_FILE_IN_CACHE = "/cache/recovery/last_metrics";
 constexpr const char* LAST_CONSOLE_FILE = "/sys/fs/pstore/console-ramoops-0";
 constexpr const char* ALT_LAST_CONSOLE_FILE = "/sys/fs/pstore/console-ramoops";
 
@@ -84,6 +88,12 @@ static bool file_exists(const char* filename) {
 }
 
 static bool rotated = false;
+static bool dirty = false;
+
+// The files recovered from pmsg, keyed by destination path. They are collected here during the
+// pmsg pass and committed in one batch by persist_pending_logs(), so unchanged generations are
+// skipped and everything lands with a single directory fsync instead of per-file sync cycles.
+static std::map<std::string, std::string> pending_logs;
 
 ssize_t logsave(
         log_id_t /* logId */,
@@ -95,25 +105,46 @@ ssize_t logsave(
     std::string destination("/data/misc/");
     destination += filename;
 
-    std::string buffer(buf, len);
+    pending_logs[destination].assign(buf, len);
+
+    return len;
+}
 
-    {
-        std::string content;
-        android::base::ReadFileToString(destination, &content);
+static void persist_pending_logs() {
+    for (const auto& [destination, buffer] : pending_logs) {
+        {
+            std::string content;
+            android::base::ReadFileToString(destination, &content);
 
-        if (buffer.compare(content) == 0) {
-            return len;
+            if (buffer.compare(content) == 0) {
+                continue;
+            }
         }
-    }
 
-    // ToDo: Any others that match? Are we pulling in multiple
-    // already-rotated files? Algorithm thus far is KISS: one file,
-    // one rotation allowed.
+        // ToDo: Any others that match? Are we pulling in multiple
+        // already-rotated files? Algorithm thus far is KISS: one file,
+        // one rotation allowed.
+
+        if (!rotated) {
+            rotate_logs(LAST_LOG_FILE, LAST_KMSG_FILE);
+            rotated = true;
+        }
 
-    rotate_logs(LAST_LOG_FILE, LAST_KMSG_FILE);
-    rotated = true;
+        if (android::base::WriteStringToFile(buffer, destination)) {
+            dirty = true;
+        }
+    }
+}
 
-    return android::base::WriteStringToFile(buffer, destination.c_str());
+// Commits the rotation renames and the freshly written files with one fsync of the directory,
+// instead of syncing each small file as it lands. The old contents were only as durable as the
+// page cache anyway, so this strictly tightens the window.
+static void sync_recovery_dir() {
+    android::base::unique_fd dfd(
+        open("/data/misc/recovery", O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+    if (dfd == -1 || fsync(dfd.get()) == -1) {
+        PLOG(ERROR) << "Failed to fsync /data/misc/recovery";
+    }
 }
 
 size_t file_size(const char* path) {
@@ -204,6 +235,15 @@ int main(int argc, char **argv) {
         PLOG(ERROR) << "Failed to unlink " << LAST_INSTALL_FILE_IN_CACHE;
       }
 
+      // Forward the structured metrics file from the last recovery session, then remove the
+      // original so the session isn't reported twice.
+      if (file_exists(LAST_METRICS_FILE_IN_CACHE)) {
+        copy_file(LAST_METRICS_FILE_IN_CACHE, LAST_METRICS_FILE);
+        if (unlink(LAST_METRICS_FILE_IN_CACHE) == -1) {
+          PLOG(ERROR) << "Failed to unlink " << LAST_METRICS_FILE_IN_CACHE;
+        }
+      }
+
       // TBD: Future location to move content from /cache/recovery to /data/misc/recovery/
       // if --force-persist flag, then transfer pmsg data anyways
       if ((argc <= 1) || !argv[1] || strcmp(argv[1], "--force-persist")) {
@@ -219,6 +259,7 @@ int main(int argc, char **argv) {
     // Take last pmsg file contents and send it off to the logsave
     __android_log_pmsg_file_read(
         LOG_ID_SYSTEM, ANDROID_LOG_INFO, "recovery/", logsave, NULL);
+    persist_pending_logs();
 
     // For those device without /cache, the last_install file has been copied to
     // /data/misc/recovery from pmsg. Looks for the sideload history only.
@@ -238,5 +279,9 @@ int main(int argc, char **argv) {
       }
     }
 
+    if (rotated || dirty) {
+      sync_recovery_dir();
+    }
+
     return 0;
 }
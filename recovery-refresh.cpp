@@ -63,10 +63,16 @@ int main(int argc, char **argv) {
             logbasename, &doRotate);
     }
 
-    // Take action to refresh pmsg contents
+    // Take action to refresh pmsg contents. The chunks get buffered by
+    // logrotate() and written out in one pass below, so the multi-MB
+    // histories no longer replay one small pmsg write at a time.
     ret = __android_log_pmsg_file_read(
         LOG_ID_SYSTEM, ANDROID_LOG_INFO, filter,
         logrotate, &doRotate);
+    if (ret < 0) {
+        return ret;
+    }
 
+    ret = flush_pmsg_rotation();
     return (ret < 0) ? ret : 0;
 }
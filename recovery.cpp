@@ -26,7 +26,9 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <chrono>
 #include <functional>
+#include <future>
 #include <iterator>
 #include <memory>
 #include <regex>
@@ -55,10 +57,11 @@
 #include "otautil/error_code.h"
 #include "otautil/package.h"
 #include "otautil/paths.h"
+#include "otautil/prefetch.h"
 #include "otautil/sysutil.h"
 #include "recovery_ui/screen_ui.h"
 #include "recovery_ui/ui.h"
-#include "recovery_utils/battery_utils.h"
+#include "recovery_utils/health_monitor.h"
 #include "recovery_utils/logging.h"
 #include "recovery_utils/roots.h"
 #include "volclient.h"
@@ -127,6 +130,14 @@ static bool IsRoDebuggable() {
   return android::base::GetBoolProperty("ro.debuggable", false);
 }
 
+// Marks the session as one whose log should be saved, and starts rotating the previous session's
+// logs in the background so the rename pass is already done by the time copy_logs() runs on the
+// way out.
+static void SetSaveCurrentLog() {
+  save_current_log = true;
+  trigger_log_rotation();
+}
+
 // Clear the recovery command and prepare to boot a (hopefully working) system,
 // copy our log file to cache as well (for the system to read). This function is
 // idempotent: call it as many times as you like.
@@ -219,6 +230,10 @@ static InstallResult apply_update_menu(Device* device, Device::BuiltinAction* re
 
   InstallResult status = INSTALL_NONE;
 
+  // Bring up the minadbd service and switch the USB gadget to sideload in the background while
+  // the menu is shown, so "Apply from ADB" starts transferring immediately when selected.
+  PrewarmSideload();
+
   for (;;) {
     items.clear();
     items.push_back("Apply from ADB");
@@ -249,18 +264,24 @@ static InstallResult apply_update_menu(Device* device, Device::BuiltinAction* re
       break;
     }
     if (chosen == static_cast<size_t>(RecoveryUI::KeyError::INTERRUPTED)) {
+      DiscardSideloadPrewarm();
       return INSTALL_KEY_INTERRUPTED;
     }
 
     if (chosen == item_sideload) {
       status = ApplyFromAdb(device, false /* rescue_mode */, reboot_action);
-    } else if (chosen == item_virtiofs && InitializeVirtiofs()) {
-      status = ApplyFromVirtiofs(device);
     } else {
-      status = ApplyFromStorage(device, volumes[chosen - non_storage_items]);
+      // The user went with another source; undo the sideload pre-warm before installing.
+      DiscardSideloadPrewarm();
+      if (chosen == item_virtiofs && InitializeVirtiofs()) {
+        status = ApplyFromVirtiofs(device);
+      } else {
+        status = ApplyFromStorage(device, volumes[chosen - non_storage_items]);
+      }
     }
     break;
   }
+  DiscardSideloadPrewarm();
   return status;
 }
 
@@ -304,6 +325,20 @@ static InstallResult prompt_and_wipe_data(Device* device) {
   }
 }
 
+// Runs a long menu action on a worker thread, keeping the main thread draining the input queue
+// while the UI's own threads animate progress. Without this a cache or data wipe leaves the menu
+// dead for its whole duration, and every key pressed meanwhile replays into the menu once it
+// wakes up. The actions themselves aren't cancellable (interrupting a wipe halfway is worse than
+// waiting it out), so keys arriving during the action are simply discarded.
+static bool RunBlockingAction(RecoveryUI* ui, std::function<bool()>&& action) {
+  auto task = std::async(std::launch::async, std::move(action));
+  while (task.wait_for(std::chrono::milliseconds(100)) != std::future_status::ready) {
+    ui->FlushKeys();
+  }
+  ui->FlushKeys();
+  return task.get();
+}
+
 static void choose_recovery_file(Device* device) {
   std::vector<std::string> entries;
   if (HasCache()) {
@@ -316,6 +351,10 @@ static void choose_recovery_file(Device* device) {
 
         if (ensure_path_mounted(log_file) == 0 && access(log_file.c_str(), R_OK) == 0) {
           entries.push_back(std::move(log_file));
+        } else if (std::string compressed = log_file + ".zst";
+                   access(compressed.c_str(), R_OK) == 0) {
+          // Rotation compresses older generations in place; the UI decompresses transparently.
+          entries.push_back(std::move(compressed));
         }
       };
 
@@ -495,6 +534,25 @@ change_menu:
             ? Device::REBOOT
             : device->InvokeMenuItem(chosen_item);
 
+    // The flows below are predictable enough that their next stage's files can be warmed while
+    // the user is still looking at the confirmation dialogs.
+    switch (chosen_action) {
+      case Device::APPLY_UPDATE:
+      case Device::ENTER_RESCUE:
+        StartPrefetch(PrefetchFlow::kApplyUpdate);
+        break;
+      case Device::WIPE_DATA:
+      case Device::WIPE_CACHE:
+      case Device::WIPE_SYSTEM:
+        StartPrefetch(PrefetchFlow::kWipe);
+        break;
+      case Device::VIEW_RECOVERY_LOGS:
+        StartPrefetch(PrefetchFlow::kViewLogs);
+        break;
+      default:
+        break;
+    }
+
     switch (chosen_action) {
       case Device::MENU_BASE:
       case Device::MENU_WIPE:
@@ -530,40 +588,40 @@ change_menu:
         break;
 
       case Device::WIPE_DATA:
-        save_current_log = true;
+        SetSaveCurrentLog();
         if (ui->IsTextVisible()) {
           if (ask_to_wipe_data(device)) {
-            WipeData(device);
+            RunBlockingAction(ui, [device]() { return WipeData(device); });
           }
         } else {
-          WipeData(device);
+          RunBlockingAction(ui, [device]() { return WipeData(device); });
           return Device::NO_ACTION;
         }
         break;
 
       case Device::WIPE_CACHE: {
-        save_current_log = true;
-        std::function<bool()> confirm_func = [&device]() {
-          return yes_no(device, "Format cache?", "  THIS CAN NOT BE UNDONE!");
-        };
-        WipeCache(ui, ui->IsTextVisible() ? confirm_func : nullptr);
+        SetSaveCurrentLog();
+        // Confirm on this thread (the worker can't run an interactive menu), then hand the
+        // actual wipe to the worker.
+        if (!ui->IsTextVisible() || yes_no(device, "Format cache?", "  THIS CAN NOT BE UNDONE!")) {
+          RunBlockingAction(ui, [ui]() { return WipeCache(ui, nullptr); });
+        }
         if (!ui->IsTextVisible()) return Device::NO_ACTION;
         break;
       }
 
       case Device::WIPE_SYSTEM: {
-        save_current_log = true;
-        std::function<bool()> confirm_func = [&device]() {
-          return yes_no(device, "Format system?", "  THIS CAN NOT BE UNDONE!");
-        };
-        WipeSystem(ui, ui->IsTextVisible() ? confirm_func : nullptr);
+        SetSaveCurrentLog();
+        if (!ui->IsTextVisible() || yes_no(device, "Format system?", "  THIS CAN NOT BE UNDONE!")) {
+          RunBlockingAction(ui, [ui]() { return WipeSystem(ui, nullptr); });
+        }
         if (!ui->IsTextVisible()) return Device::NO_ACTION;
         break;
       }
 
       case Device::APPLY_UPDATE:
       case Device::ENTER_RESCUE: {
-        save_current_log = true;
+        SetSaveCurrentLog();
 
         update_in_progress = true;
         WriteUpdateInProgress();
@@ -634,6 +692,7 @@ change_menu:
           }
         } else {
           if (umount("/mnt/system") != -1) {
+            forget_mount_state("/mnt/system");
             ui->Print("Unmounted /mnt/system.\n");
             mounted = false;
           }
@@ -658,10 +717,12 @@ static bool IsBatteryOk(int* required_battery_level) {
   constexpr int BATTERY_OK_PERCENTAGE = 20;
   constexpr int BATTERY_WITH_CHARGER_OK_PERCENTAGE = 15;
 
-  auto battery_info = GetBatteryInfo();
+  // Reads the background sampler's snapshot; the first call blocks until one exists, later
+  // retries are served from cache.
+  auto health = HealthMonitor::Get().snapshot();
   *required_battery_level =
-      battery_info.charging ? BATTERY_WITH_CHARGER_OK_PERCENTAGE : BATTERY_OK_PERCENTAGE;
-  return battery_info.capacity >= *required_battery_level;
+      health.charging ? BATTERY_WITH_CHARGER_OK_PERCENTAGE : BATTERY_OK_PERCENTAGE;
+  return health.capacity >= *required_battery_level;
 }
 
 // Set the retry count to |retry_count| in BCB.
@@ -877,7 +938,7 @@ Device::BuiltinAction start_recovery(Device* device, const std::vector<std::stri
   if (update_package != nullptr) {
     // It's not entirely true that we will modify the flash. But we want
     // to log the update attempt since update_package is non-NULL.
-    save_current_log = true;
+    SetSaveCurrentLog();
 
     if (int required_battery_level = 0; retry_count == 0 && !IsBatteryOk(&required_battery_level)) {
       ui->Print("battery capacity is not enough for installing package: %d%% needed\n",
@@ -911,10 +972,11 @@ Device::BuiltinAction start_recovery(Device* device, const std::vector<std::stri
         status = InstallPackage(memory_package.get(), update_package, should_wipe_cache,
                                 retry_count, device);
       } else {
-        // We may fail to memory map the package on 32 bit builds for packages with 2GiB+ size.
-        // In such cases, we will try to install the package with fuse. This is not the default
-        // installation method because it introduces a layer of indirection from the kernel space.
-        LOG(WARNING) << "Failed to memory map package " << update_package
+        // CreateMemoryPackage() falls back to a file-backed package internally when the package
+        // is too large to map on 32 bit builds, so getting here means the package couldn't be
+        // opened at all. Try fuse as a last resort; it's not the default installation method
+        // because it introduces a layer of indirection from the kernel space.
+        LOG(WARNING) << "Failed to open package " << update_package
                      << "; falling back to install with fuse";
         status = InstallWithFuseFromPath(update_package, device);
       }
@@ -943,14 +1005,14 @@ Device::BuiltinAction start_recovery(Device* device, const std::vector<std::stri
       }
     }
   } else if (should_wipe_data) {
-    save_current_log = true;
+    SetSaveCurrentLog();
     CHECK(device->GetReason().has_value());
     if (!WipeData(device, should_keep_memtag_mode, data_fstype)) {
       status = INSTALL_ERROR;
     }
   } else if (should_prompt_and_wipe_data) {
     // Trigger the logging to capture the cause, even if user chooses to not wipe data.
-    save_current_log = true;
+    SetSaveCurrentLog();
 
     ui->ShowText(true);
     ui->SetBackground(RecoveryUI::ERROR);
@@ -959,7 +1021,7 @@ Device::BuiltinAction start_recovery(Device* device, const std::vector<std::stri
       ui->ShowText(false);
     }
   } else if (should_wipe_cache) {
-    save_current_log = true;
+    SetSaveCurrentLog();
     if (!WipeCache(ui, nullptr, data_fstype)) {
       status = INSTALL_ERROR;
     }
@@ -972,7 +1034,7 @@ Device::BuiltinAction start_recovery(Device* device, const std::vector<std::stri
     // mode. When 'sideload-auto-reboot' is used, text display will NOT be turned on by default. And
     // it will reboot after sideload finishes even if there are errors. This is to enable automated
     // testing.
-    save_current_log = true;
+    SetSaveCurrentLog();
     if (!sideload_auto_reboot) {
       ui->ShowText(true);
     }
@@ -984,7 +1046,7 @@ Device::BuiltinAction start_recovery(Device* device, const std::vector<std::stri
       ui->Print("Rebooting automatically.\n");
     }
   } else if (rescue) {
-    save_current_log = true;
+    SetSaveCurrentLog();
     status = ApplyFromAdb(device, true /* rescue_mode */, &next_action);
     ui->Print("\nInstall from ADB complete (status: %d).\n", status);
   } else if (!just_exit) {
@@ -32,7 +32,9 @@
 #include <unistd.h>
 
 #include <atomic>
+#include <chrono>
 #include <filesystem>
+#include <future>
 #include <string>
 #include <thread>
 #include <vector>
@@ -40,6 +42,7 @@
 #include <android-base/file.h>
 #include <android-base/logging.h>
 #include <android-base/properties.h>
+#include <android-base/stringprintf.h>
 #include <android-base/strings.h>
 #include <android-base/unique_fd.h>
 #include <bootloader_message/bootloader_message.h>
@@ -51,6 +54,7 @@
 #include <selinux/selinux.h>
 
 #include "fastboot/fastboot.h"
+#include "install/install.h"
 #include "install/wipe_data.h"
 #include "otautil/boot_state.h"
 #include "otautil/paths.h"
@@ -60,6 +64,7 @@
 #include "recovery_ui/stub_ui.h"
 #include "recovery_ui/ui.h"
 #include "recovery_utils/logging.h"
+#include "recovery_utils/metrics.h"
 #include "recovery_utils/roots.h"
 
 namespace fs = std::filesystem;
@@ -343,10 +348,75 @@ static void redirect_stdio(const char* filename) {
   }
 }
 
+// Wall-time budget per startup stage, in milliseconds. The budgets are deliberately loose — a
+// healthy device finishes each stage well under its line — so a tripped budget means a real
+// regression, not jitter. Overruns are always logged; on images that set
+// recovery.perf.assert_budgets (eng bench rigs), an overrun aborts so the regression can't land
+// silently.
+static constexpr struct {
+  const char* stage;
+  int64_t budget_ms;
+} kStartupBudgets[] = {
+  { "pmsg_rotate", 1000 },  { "log_redirect", 200 }, { "load_ui_ext", 1000 },
+  { "storage_join", 5000 }, { "locale", 500 },       { "ui_init", 3000 },
+  { "device_init", 2000 },
+};
+
+// Tracks main()'s fixed init sequence. Mark() closes the stage that just ran; Finish() emits a
+// one-line summary, records each stage (and the total) into the session metrics, and enforces the
+// budgets above.
+class StartupTimeline {
+ public:
+  StartupTimeline() : start_(std::chrono::steady_clock::now()), last_(start_) {}
+
+  void Mark(const char* stage) {
+    auto now = std::chrono::steady_clock::now();
+    stages_.emplace_back(stage, now - last_);
+    last_ = now;
+  }
+
+  void Finish() {
+    auto total = std::chrono::steady_clock::now() - start_;
+    std::string summary;
+    for (const auto& [stage, elapsed] : stages_) {
+      auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count();
+      summary += android::base::StringPrintf("%s=%" PRId64 "ms ", stage, static_cast<int64_t>(ms));
+      RecoveryMetrics::Get().RecordDuration(
+          std::string("startup.") + stage,
+          std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed));
+    }
+    RecoveryMetrics::Get().RecordDuration(
+        "recovery_startup", std::chrono::duration_cast<std::chrono::nanoseconds>(total));
+    LOG(INFO) << "startup timeline: " << summary << "total="
+              << std::chrono::duration_cast<std::chrono::milliseconds>(total).count() << "ms";
+
+    bool assert_budgets = android::base::GetBoolProperty("recovery.perf.assert_budgets", false);
+    for (const auto& [stage, elapsed] : stages_) {
+      for (const auto& budget : kStartupBudgets) {
+        if (strcmp(budget.stage, stage) != 0) continue;
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count();
+        if (ms > budget.budget_ms) {
+          LOG(ERROR) << "startup stage " << stage << " took " << ms << "ms, over its "
+                     << budget.budget_ms << "ms budget";
+          if (assert_budgets) {
+            LOG(FATAL) << "aborting: recovery.perf.assert_budgets is set";
+          }
+        }
+      }
+    }
+  }
+
+ private:
+  std::chrono::steady_clock::time_point start_;
+  std::chrono::steady_clock::time_point last_;
+  std::vector<std::pair<const char*, std::chrono::steady_clock::duration>> stages_;
+};
+
 int main(int argc, char** argv) {
   // We don't have logcat yet under recovery; so we'll print error on screen and log to stdout
   // (which is redirected to recovery.log) as we used to do.
   android::base::InitLogging(argv, &UiLogger);
+  StartupTimeline startup_timeline;
 
   // Take last pmsg contents and rewrite it to the current pmsg session.
   static constexpr const char filter[] = "recovery/";
@@ -356,6 +426,8 @@ int main(int argc, char** argv) {
   __android_log_pmsg_file_read(LOG_ID_SYSTEM, ANDROID_LOG_INFO, filter, logbasename, &do_rotate);
   // Take action to refresh pmsg contents
   __android_log_pmsg_file_read(LOG_ID_SYSTEM, ANDROID_LOG_INFO, filter, logrotate, &do_rotate);
+  flush_pmsg_rotation();
+  startup_timeline.Mark("pmsg_rotate");
 
   // Clear umask for packages that copy files out to /tmp and then over
   // to /system without properly setting all permissions (eg. gapps).
@@ -366,11 +438,48 @@ int main(int argc, char** argv) {
   // redirect_stdio should be called only in non-sideload mode. Otherwise we may have two logger
   // instances with different timestamps.
   redirect_stdio(Paths::Get().temporary_log_file().c_str());
+  startup_timeline.Mark("log_redirect");
 
-  load_volume_table();
-
+  // Loading the volume table and fetching the boot arguments is disk bound: a full fstab parse
+  // with a blkid probe per mount point, waiting for the misc device and possibly mounting /cache.
+  // None of it is needed to load the UI extension, so run it on a worker while we dlopen
+  // librecovery_ui_ext and construct the device, and join before parsing the arguments.
   std::string stage;
-  std::vector<std::string> args = get_args(argc, argv, &stage);
+  std::vector<std::string> args;
+  auto storage_setup = std::async(std::launch::async, [argc, argv, &args, &stage] {
+    load_volume_table();
+    args = get_args(argc, argv, &stage);
+  });
+
+  static constexpr const char* kDefaultLibRecoveryUIExt = "librecovery_ui_ext.so";
+  // Intentionally not calling dlclose(3) to avoid potential gotchas (e.g. `make_device` may have
+  // handed out pointers to code or static [or thread-local] data and doesn't collect them all back
+  // in on dlclose).
+  void* librecovery_ui_ext = dlopen(kDefaultLibRecoveryUIExt, RTLD_NOW);
+
+  using MakeDeviceType = decltype(&make_device);
+  MakeDeviceType make_device_func = nullptr;
+  if (librecovery_ui_ext == nullptr) {
+    printf("Failed to dlopen %s: %s\n", kDefaultLibRecoveryUIExt, dlerror());
+  } else {
+    reinterpret_cast<void*&>(make_device_func) = dlsym(librecovery_ui_ext, "make_device");
+    if (make_device_func == nullptr) {
+      printf("Failed to dlsym make_device: %s\n", dlerror());
+    }
+  }
+
+  Device* device;
+  if (make_device_func == nullptr) {
+    printf("Falling back to the default make_device() instead\n");
+    device = make_device();
+  } else {
+    printf("Loading make_device from %s\n", kDefaultLibRecoveryUIExt);
+    device = (*make_device_func)();
+  }
+  startup_timeline.Mark("load_ui_ext");
+
+  storage_setup.wait();
+  startup_timeline.Mark("storage_join");
   auto args_to_parse = StringVectorToNullTerminatedArray(args);
 
   static constexpr struct option OPTIONS[] = {
@@ -427,32 +536,7 @@ int main(int argc, char** argv) {
       locale = DEFAULT_LOCALE;
     }
   }
-
-  static constexpr const char* kDefaultLibRecoveryUIExt = "librecovery_ui_ext.so";
-  // Intentionally not calling dlclose(3) to avoid potential gotchas (e.g. `make_device` may have
-  // handed out pointers to code or static [or thread-local] data and doesn't collect them all back
-  // in on dlclose).
-  void* librecovery_ui_ext = dlopen(kDefaultLibRecoveryUIExt, RTLD_NOW);
-
-  using MakeDeviceType = decltype(&make_device);
-  MakeDeviceType make_device_func = nullptr;
-  if (librecovery_ui_ext == nullptr) {
-    printf("Failed to dlopen %s: %s\n", kDefaultLibRecoveryUIExt, dlerror());
-  } else {
-    reinterpret_cast<void*&>(make_device_func) = dlsym(librecovery_ui_ext, "make_device");
-    if (make_device_func == nullptr) {
-      printf("Failed to dlsym make_device: %s\n", dlerror());
-    }
-  }
-
-  Device* device;
-  if (make_device_func == nullptr) {
-    printf("Falling back to the default make_device() instead\n");
-    device = make_device();
-  } else {
-    printf("Loading make_device from %s\n", kDefaultLibRecoveryUIExt);
-    device = (*make_device_func)();
-  }
+  startup_timeline.Mark("locale");
 
   if (android::base::GetBoolProperty("ro.boot.quiescent", false)) {
     printf("Quiescent recovery mode.\n");
@@ -463,6 +547,7 @@ int main(int argc, char** argv) {
       device->ResetUI(new StubRecoveryUI());
     }
   }
+  startup_timeline.Mark("ui_init");
 
   BootState boot_state(reason, stage);  // recovery_main owns the state of boot.
   device->SetBootState(&boot_state);
@@ -517,6 +602,10 @@ int main(int argc, char** argv) {
   std::thread listener_thread(ListenRecoverySocket, ui, std::ref(action));
   listener_thread.detach();
 
+  // Parse the ota keys in the background while the user is still navigating the menu, so package
+  // verification doesn't wait on certificate loading.
+  PreloadOtaKeys();
+
   // Set up adb_keys and enable root before starting ADB.
   if (IsRoDebuggable() && !fastboot) {
     copy_userdata_files();
@@ -524,6 +613,11 @@ int main(int argc, char** argv) {
   }
 
   device->InitDevice();
+  startup_timeline.Mark("device_init");
+
+  // Everything between process entry and here — storage setup, UI bring-up, device init — is time
+  // the user stares at a blank screen, so it's worth tracking across releases.
+  startup_timeline.Finish();
 
   while (true) {
     // We start adbd in recovery for the device with userdebug build or a unlocked bootloader.
@@ -21,6 +21,9 @@
 #include <arpa/inet.h>
 #include <ifaddrs.h>
 #include <linux/if.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <poll.h>
 #include <string.h>
 #include <sys/ioctl.h>
 #include <sys/socket.h>
@@ -41,9 +44,17 @@ EthernetDevice::EthernetDevice(EthernetRecoveryUI* ui, std::string interface)
   }
 }
 
+EthernetDevice::~EthernetDevice() {
+  address_thread_stop_ = true;
+  if (address_thread_.joinable()) {
+    address_thread_.join();
+  }
+}
+
 void EthernetDevice::InitDevice() {
-  BringupInterface();
-  sleep(1);
+  // Bring the interface up and wait for address acquisition on a worker, instead of sleeping
+  // here with the menu held back. The title picks up the address lines once they land.
+  address_thread_ = std::thread(&EthernetDevice::WaitForAddress, this);
 }
 
 void EthernetDevice::PreRecovery() {
@@ -55,6 +66,48 @@ void EthernetDevice::PreFastboot() {
   SetTitleIPAddress(BringupInterface());
 }
 
+void EthernetDevice::WaitForAddress() {
+  if (!BringupInterface()) {
+    return;
+  }
+
+  // Subscribe to kernel address notifications before the first probe, so an address landing
+  // between the probe and the wait can't be missed.
+  android::base::unique_fd nl_sock(
+      socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC | SOCK_NONBLOCK, NETLINK_ROUTE));
+  if (nl_sock != -1) {
+    struct sockaddr_nl nl_addr = {};
+    nl_addr.nl_family = AF_NETLINK;
+    nl_addr.nl_groups = RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR;
+    if (bind(nl_sock, reinterpret_cast<struct sockaddr*>(&nl_addr), sizeof(nl_addr)) == -1) {
+      PLOG(ERROR) << "Failed to bind netlink address socket";
+      nl_sock.reset();
+    }
+  }
+
+  while (!address_thread_stop_) {
+    if (SetTitleIPAddress(true)) {
+      reinterpret_cast<EthernetRecoveryUI*>(GetUI())->Redraw();
+      return;
+    }
+
+    if (nl_sock == -1) {
+      // Netlink isn't available; fall back to a slow periodic re-probe.
+      sleep(1);
+      continue;
+    }
+
+    // Sleep until the kernel reports an address change; the timeout only serves the stop flag.
+    // The event payload doesn't matter, any address activity triggers a re-probe above.
+    struct pollfd pfd = { nl_sock.get(), POLLIN, 0 };
+    if (poll(&pfd, 1, 1000) > 0) {
+      char buf[4096];
+      while (recv(nl_sock, buf, sizeof(buf), 0) > 0) {
+      }
+    }
+  }
+}
+
 bool EthernetDevice::BringupInterface() {
   if (SetInterfaceFlags(IFF_UP, 0) < 0) {
     LOG(ERROR) << "Failed to bring up interface";
@@ -88,18 +141,25 @@ int EthernetDevice::SetInterfaceFlags(const unsigned set, const unsigned clr) {
   return 0;
 }
 
-void EthernetDevice::SetTitleIPAddress(const bool interface_up) {
+// Harvests the interface's addresses into the UI title. Returns whether the IPv6 link-local
+// address has been acquired, which is what the address worker waits for.
+bool EthernetDevice::SetTitleIPAddress(const bool interface_up) {
   auto recovery_ui = reinterpret_cast<EthernetRecoveryUI*>(GetUI());
 
   // Cached IP Addresses needs to be cleared anyways, no matter if errored or not
   recovery_ui->ClearIPAddresses();
 
-  if (!interface_up) return;
+  if (!interface_up) {
+    recovery_ui->RefreshTitle();
+    return false;
+  }
 
+  bool have_linklocal = false;
   struct ifaddrs* ifaddr;
   if (getifaddrs(&ifaddr) == -1) {
     PLOG(ERROR) << "Failed to get interface addresses";
-    return;
+    recovery_ui->RefreshTitle();
+    return false;
   }
 
   std::unique_ptr<struct ifaddrs, decltype(&freeifaddrs)> guard{ ifaddr, freeifaddrs };
@@ -127,7 +187,11 @@ void EthernetDevice::SetTitleIPAddress(const bool interface_up) {
                 INET6_ADDRSTRLEN);
       LOG(INFO) << "Our IPv6 link-local address is " << addrstr;
       recovery_ui->SetIPv6LinkLocalAddress(addrstr);
+      have_linklocal = true;
       continue;
     }
   }
+
+  recovery_ui->RefreshTitle();
+  return have_linklocal;
 }
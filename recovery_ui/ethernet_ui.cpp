@@ -19,26 +19,44 @@
 #include <android-base/logging.h>
 
 void EthernetRecoveryUI::SetTitle(const std::vector<std::string>& lines) {
-  ScreenRecoveryUI::SetTitle(lines);
-
-  // Append IP address, if any
-  for (auto it = ipv4_addresses_.begin(); it != ipv4_addresses_.end(); ++it) {
-    title_lines_.push_back("IPv4 address - " + *it);
+  {
+    std::lock_guard<std::mutex> lg(address_mutex_);
+    base_title_lines_ = lines;
   }
-  if (!ipv6_linklocal_address_.empty()) {
-    title_lines_.push_back("IPv6 link-local address - " + ipv6_linklocal_address_);
+  RefreshTitle();
+}
+
+void EthernetRecoveryUI::RefreshTitle() {
+  std::vector<std::string> lines;
+  {
+    std::lock_guard<std::mutex> lg(address_mutex_);
+    lines = base_title_lines_;
+
+    // Append IP address, if any
+    for (auto it = ipv4_addresses_.begin(); it != ipv4_addresses_.end(); ++it) {
+      lines.push_back("IPv4 address - " + *it);
+    }
+    if (!ipv6_linklocal_address_.empty()) {
+      lines.push_back("IPv6 link-local address - " + ipv6_linklocal_address_);
+    }
   }
+
+  std::lock_guard<std::mutex> lg(updateMutex);
+  ScreenRecoveryUI::SetTitle(lines);
 }
 
 void EthernetRecoveryUI::AddIPv4Address(const std::string& address) {
+  std::lock_guard<std::mutex> lg(address_mutex_);
   ipv4_addresses_.push_back(address);
 }
 
 void EthernetRecoveryUI::ClearIPAddresses() {
+  std::lock_guard<std::mutex> lg(address_mutex_);
   ipv4_addresses_.clear();
   ipv6_linklocal_address_.clear();
 }
 
 void EthernetRecoveryUI::SetIPv6LinkLocalAddress(const std::string& address) {
+  std::lock_guard<std::mutex> lg(address_mutex_);
   ipv6_linklocal_address_ = address;
 }
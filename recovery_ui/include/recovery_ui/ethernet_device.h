@@ -19,6 +19,10 @@
 
 #include "device.h"
 
+#include <atomic>
+#include <string>
+#include <thread>
+
 #include <android-base/unique_fd.h>
 
 // Forward declaration to avoid including "ethernet_ui.h".
@@ -28,6 +32,7 @@ class EthernetDevice : public Device {
  public:
   explicit EthernetDevice(EthernetRecoveryUI* ui);
   explicit EthernetDevice(EthernetRecoveryUI* ui, std::string interface);
+  ~EthernetDevice() override;
 
   void InitDevice() override;
   void PreRecovery() override;
@@ -36,10 +41,16 @@ class EthernetDevice : public Device {
  private:
   bool BringupInterface();
   int SetInterfaceFlags(const unsigned set, const unsigned clr);
-  void SetTitleIPAddress(const bool interface_up);
+  bool SetTitleIPAddress(const bool interface_up);
+  void WaitForAddress();
 
   android::base::unique_fd ctl_sock_;
   std::string interface_;
+
+  // Worker that brings the interface up and waits for address acquisition, so device init
+  // doesn't block menu display.
+  std::thread address_thread_;
+  std::atomic<bool> address_thread_stop_{ false };
 };
 
 #endif  // _ETHERNET_RECOVERY_DEVICE_H
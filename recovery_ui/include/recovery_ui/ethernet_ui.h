@@ -17,6 +17,8 @@
 #ifndef RECOVERY_ETHERNET_UI_H
 #define RECOVERY_ETHERNET_UI_H
 
+#include <mutex>
+
 #include "screen_ui.h"
 
 class EthernetRecoveryUI : public ScreenRecoveryUI {
@@ -24,12 +26,20 @@ class EthernetRecoveryUI : public ScreenRecoveryUI {
   EthernetRecoveryUI() {}
   void SetTitle(const std::vector<std::string>& lines) override;
 
-  // For EthernetDevice
+  // For EthernetDevice. Safe to call from its address worker thread; the title
+  // gains/loses address lines on the next RefreshTitle().
   void AddIPv4Address(const std::string& address);
   void ClearIPAddresses();
   void SetIPv6LinkLocalAddress(const std::string& address = "");
 
+  // Reapplies the current title with the cached address lines appended.
+  void RefreshTitle();
+
  private:
+  // Guards the base title and cached addresses against concurrent updates from
+  // the address worker.
+  std::mutex address_mutex_;
+  std::vector<std::string> base_title_lines_;
   std::vector<std::string> ipv4_addresses_;
   std::string ipv6_linklocal_address_;
 };
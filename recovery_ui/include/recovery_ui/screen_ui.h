@@ -20,7 +20,9 @@
 #include <stdio.h>
 
 #include <atomic>
+#include <condition_variable>
 #include <functional>
+#include <map>
 #include <memory>
 #include <string>
 #include <thread>
@@ -161,7 +163,7 @@ class TextMenu : public Menu {
   //                                 /cache/recovery/last_log.2
   //                                 ...
   const std::vector<std::string>& text_headers() const;
-  std::string TextItem(size_t index) const;
+  const std::string& TextItem(size_t index) const;
 
   // Checks if the menu items fit vertically on the screen. Returns true and set the
   // |cur_selection_str| if the items exceed the screen limit.
@@ -201,7 +203,9 @@ class TextMenu : public Menu {
 class GraphicMenu : public Menu {
  public:
   // Constructs a Menu instance with the given |headers|, |items| and properties. Sets the initial
-  // selection to |initial_selection|. |headers| and |items| will be made local copies.
+  // selection to |initial_selection|. |headers| and |items| are borrowed as non-owning views and
+  // must outlive the menu; they stay owned by the caller (in practice the preloaded resource
+  // bundle in ScreenRecoveryUI).
   GraphicMenu(const GRSurface* graphic_headers, const std::vector<const GRSurface*>& graphic_items,
               size_t initial_selection, const DrawInterface& draw_funcs);
 
@@ -230,7 +234,8 @@ class GraphicMenu : public Menu {
                                      const GRSurface* surface);
 
  private:
-  // Menu headers and items in graphic icons. These are the copies owned by the class instance.
+  // Menu headers and items in graphic icons. These are zero-copy views over the caller's
+  // surfaces, so opening a menu doesn't copy any pixels.
   std::unique_ptr<GRSurface> graphic_headers_;
   std::vector<std::unique_ptr<GRSurface>> graphic_items_;
 };
@@ -277,6 +282,16 @@ class MenuDrawFunctions : public DrawInterface {
   int DrawWrappedTextLines(int x, int y, const std::vector<std::string>& lines) const override;
 
  private:
+  // Computed line breaks, keyed by the source line. Menu headers are immutable but get redrawn
+  // every frame, and the character-by-character wrap scan costs more than blending the cached
+  // glyph runs. The column count is stored with each entry so a width change (e.g. after a
+  // rotation) recomputes the layout.
+  struct WrapLayout {
+    size_t text_cols;
+    std::vector<std::string> sublines;
+  };
+  mutable std::map<std::string, WrapLayout> wrap_cache_;
+
   const DrawInterface& wrappee_;
 };
 
@@ -397,14 +412,30 @@ class ScreenRecoveryUI : public RecoveryUI, public DrawInterface {
   virtual void draw_foreground_locked();
   virtual void draw_screen_locked();
   virtual void draw_menu_and_text_buffer_locked(const std::vector<std::string>& help_message);
+  virtual void draw_text_buffer_locked(int top_y, bool incremental);
+  // Mark the screen dirty and wake the render thread; the whole-screen variant also forces a
+  // full recompose. Should only be called with updateMutex locked. Drawing and flipping happen
+  // on the render thread, so these return without waiting on the display.
   virtual void update_screen_locked();
   virtual void update_progress_locked();
 
+  // Composes the next frame, on the render thread with updateMutex locked. The default does a
+  // full recompose when requested (or while the text overlay is showing) and repaints only the
+  // progress bar and overlays otherwise; WearRecoveryUI recomposes everything every frame.
+  virtual void ComposeLocked(bool full_redraw);
+
+  // Presents the drawn frame. The default flips the framebuffer; subclasses that draw to an
+  // intermediate surface (e.g. VrRecoveryUI) compose it to the framebuffer here first. Called on
+  // the render thread without updateMutex held, so a slow flip never delays state updates.
+  virtual void Flip();
+
   const GRSurface* GetCurrentFrame() const;
   const GRSurface* GetCurrentText() const;
 
   void BattMonitorThreadLoop();
-  void ProgressThreadLoop();
+  void RenderThreadLoop();
+  void AnimationDecodeThreadLoop(std::vector<std::string> intro_frame_names,
+                                 std::vector<std::string> loop_frame_names);
 
   virtual void ShowFile(FILE*);
   virtual void PrintV(const char*, bool, va_list);
@@ -490,14 +521,31 @@ class ScreenRecoveryUI : public RecoveryUI, public DrawInterface {
   float progressScopeStart, progressScopeSize, progress;
   double progressScopeTime, progressScopeDuration;
 
+  // Set when SetProgress() advances the bar; RenderThreadLoop() coalesces a burst of updates
+  // into at most one redraw per tick instead of flipping on the caller's thread.
+  bool progress_changed_;
+
   // true when both graphics pages are the same (except for the progress bar).
   bool pagesIdentical;
 
   size_t text_cols_, text_rows_;
 
-  // Log text overlay, displayed when a magic key is pressed.
+  // Log text overlay, displayed when a magic key is pressed. The backing store is a ring of
+  // text_total_rows_ lines (well beyond what fits on screen) so older output stays available;
+  // only the rows that are visible get drawn. text_rows_used_ counts the lines holding data, and
+  // text_scroll_ is how far the viewport has been scrolled up from the newest line.
   char** text_;
   size_t text_col_, text_row_;
+  size_t text_total_rows_;
+  size_t text_rows_used_;
+  size_t text_scroll_;
+
+  // Snapshots of the visible log rows drawn by the last two menu-less text frames, bottom row
+  // first. On a double-buffered backend the surface being drawn into holds the frame before
+  // last, so an incremental repaint may only skip a row that matches both snapshots.
+  std::vector<std::string> last_text_rows_[2];
+  // Number of consecutive frames recorded into last_text_rows_; incremental repaint needs two.
+  int text_frames_recorded_;
 
   bool show_text;
   bool show_text_ever;  // has show_text ever been true?
@@ -510,8 +558,14 @@ class ScreenRecoveryUI : public RecoveryUI, public DrawInterface {
   // An alternate text screen, swapped with 'text_' when we're viewing a log file.
   char** file_viewer_text_;
 
-  std::thread progress_thread_;
-  std::atomic<bool> progress_thread_stopped_{ false };
+  // Owns all drawing and flipping; everyone else only mutates UI state under updateMutex and
+  // marks the screen dirty.
+  std::thread render_thread_;
+  std::atomic<bool> render_thread_stopped_{ false };
+
+  // Decodes the animation frames behind the draw cursor, so Init() only pays for the first one.
+  std::thread animation_thread_;
+  std::atomic<bool> animation_thread_stopped_{ false };
 
   int stage, max_stage;
 
@@ -526,6 +580,13 @@ class ScreenRecoveryUI : public RecoveryUI, public DrawInterface {
 
   std::mutex updateMutex;
 
+  // Render-thread handoff: update_screen_locked()/update_progress_locked() set these under
+  // updateMutex and signal; the render thread clears them, composes under the lock and flips
+  // outside it.
+  std::condition_variable redraw_cond_;
+  bool redraw_requested_ = false;
+  bool full_redraw_requested_ = false;
+
   std::thread batt_monitor_thread_;
   std::atomic<bool> batt_monitor_thread_stopped_{ false };
   int32_t batt_capacity_;
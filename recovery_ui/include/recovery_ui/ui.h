@@ -28,6 +28,8 @@
 #include <thread>
 #include <vector>
 
+#include <android-base/unique_fd.h>
+
 class Device;
 
 static constexpr const char* DEFAULT_LOCALE = "en-US";
@@ -312,6 +314,7 @@ class RecoveryUI {
  protected:
   void EnqueueKey(int key_code);
   void EnqueueTouch(const Point& pos);
+  void EnqueueEvent(const InputEvent& event);
 
   // The normal and dimmed brightness percentages (default: 50 and 25, which means 50% and 25% of
   // the max_brightness). Because the absolute values may vary across devices. These two values can
@@ -349,19 +352,25 @@ class RecoveryUI {
   void OnTouchTrack();
   void OnTouchRelease();
   int OnInputEvent(int fd, uint32_t epevents);
+  void ProcessInputEvent(int fd, const input_event& ev);
   void ProcessKey(int key_code, int updown);
   void TimeKey(int key_code, int count);
 
   bool InitScreensaver();
   void SetScreensaverState(ScreensaverState state);
+  void BrightnessWorker();
 
   virtual int SetSwCallback(int code, int value) = 0;
 
-  // Key event input queue
+  // Key event input queue, a ring buffer guarded by |event_queue_mutex|. Events are produced
+  // from several threads (the input thread, volume scan workers via KEY_REFRESH, CancelWaitKey),
+  // so a single-producer lock-free queue doesn't fit; instead the critical sections are kept to
+  // a couple of index updates.
   std::mutex event_queue_mutex;
   std::condition_variable event_queue_cond;
   bool key_interrupted_;
   InputEvent event_queue[256];
+  int event_queue_head;
   int event_queue_len;
 
   // key press events
@@ -396,6 +405,9 @@ class RecoveryUI {
   bool touch_saw_x_;
   bool touch_saw_y_;
   bool touch_reported_;
+  // Set while a batch of drained events contains movement; the tracking callback fires once per
+  // batch with the final position.
+  bool touch_track_pending_{ false };
   Point touch_pos_;
   Point touch_start_;
   Point touch_track_;
@@ -413,6 +425,17 @@ class RecoveryUI {
   // brightness_dimmed_ respectively.
   unsigned int brightness_normal_value_;
   unsigned int brightness_dimmed_value_;
+
+  // Brightness changes are applied by a dedicated worker, which ramps toward
+  // |brightness_target_value_| through the sysfs fd held open since InitScreensaver(); state
+  // transitions then never block input handling on sysfs, and fades come for free.
+  android::base::unique_fd brightness_fd_;
+  std::thread brightness_thread_;
+  std::mutex brightness_mutex_;
+  std::condition_variable brightness_cond_;
+  unsigned int brightness_target_value_{ 0 };
+  unsigned int brightness_current_value_{ 0 };
+  bool brightness_thread_stopped_{ false };
 };
 
 #endif  // RECOVERY_UI_H
@@ -17,14 +17,18 @@
 #ifndef RECOVERY_VR_UI_H
 #define RECOVERY_VR_UI_H
 
+#include <memory>
 #include <string>
 
+#include "minui/minui.h"
 #include "screen_ui.h"
 
 class VrRecoveryUI : public ScreenRecoveryUI {
  public:
   VrRecoveryUI();
 
+  bool Init(const std::string& locale) override;
+
  protected:
   // Pixel offsets to move drawing functions to visible range.
   // Can vary per device depending on screen size and lens distortion.
@@ -33,13 +37,13 @@ class VrRecoveryUI : public ScreenRecoveryUI {
   int ScreenWidth() const override;
   int ScreenHeight() const override;
 
-  void DrawSurface(const GRSurface* surface, int sx, int sy, int w, int h, int dx,
-                   int dy) const override;
-  int DrawHorizontalRule(int y) const override;
-  void DrawHighlightBar(int x, int y, int width, int height) const override;
-  void DrawFill(int x, int y, int w, int h) const override;
-  void DrawTextIcon(int x, int y, const GRSurface* surface) const override;
-  int DrawTextLine(int x, int y, const std::string& line, bool bold) const override;
+  // Composes the single rendered eye buffer into both halves of the framebuffer, then flips.
+  void Flip() override;
+
+ private:
+  // Offscreen buffer the base class renders into once per frame. The two eyes only differ in
+  // their viewport, so Flip() blits this per eye instead of drawing every primitive twice.
+  std::unique_ptr<GRSurface> eye_buffer_;
 };
 
 #endif  // RECOVERY_VR_UI_H
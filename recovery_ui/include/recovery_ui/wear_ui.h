@@ -52,7 +52,7 @@ class WearRecoveryUI : public ScreenRecoveryUI {
 
   int GetTextBaseline() const override;
 
-  void update_progress_locked() override;
+  void ComposeLocked(bool full_redraw) override;
 
   void LoadAnimation() override;
 
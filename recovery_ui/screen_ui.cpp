@@ -23,6 +23,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/types.h>
@@ -40,10 +41,12 @@
 #include <aidl/android/hardware/health/BatteryStatus.h>
 
 #include <android-base/chrono_utils.h>
+#include <android-base/file.h>
 #include <android-base/logging.h>
 #include <android-base/properties.h>
 #include <android-base/stringprintf.h>
 #include <android-base/strings.h>
+#include <zstd.h>
 
 #include <health/utils.h>
 #include <healthd/BatteryMonitor.h>
@@ -94,7 +97,7 @@ const std::vector<std::string>& TextMenu::text_headers() const {
   return text_headers_;
 }
 
-std::string TextMenu::TextItem(size_t index) const {
+const std::string& TextMenu::TextItem(size_t index) const {
   CHECK_LT(index, text_items_.size());
 
   return text_items_[index];
@@ -192,6 +195,8 @@ int TextMenu::DrawItems(int x, int y, int screen_width, bool long_press) const {
 
   int item_container_offset = offset; // store it for drawing scrollbar on most top
 
+  // Each item line's composed glyph run is cached inside gr_text(), so redrawing on a selection
+  // change blends the pre-rendered masks instead of re-rasterizing every glyph.
   for (size_t i = MenuStart(); i < MenuEnd(); ++i) {
     if (i == selection()) {
       // Draw the highlight bar.
@@ -209,8 +214,9 @@ int TextMenu::DrawItems(int x, int y, int screen_width, bool long_press) const {
   }
   offset += draw_funcs_.DrawHorizontalRule(y + offset);
 
-  std::string unused;
-  if (ItemsOverflow(&unused)) {
+  // Only the overflow predicate matters here; don't compose the "Current item" string that
+  // ItemsOverflow() would build just to throw it away on every redraw.
+  if (ItemsCount() > max_display_items_) {
     int container_height = max_display_items_ * (2 * padding + char_height_);
     int bar_height = container_height / (text_items_.size() - max_display_items_ + 1);
     int start_y = y + item_container_offset + bar_height * menu_start_;
@@ -225,10 +231,10 @@ GraphicMenu::GraphicMenu(const GRSurface* graphic_headers,
                          const std::vector<const GRSurface*>& graphic_items,
                          size_t initial_selection, const DrawInterface& draw_funcs)
     : Menu(initial_selection, draw_funcs) {
-  graphic_headers_ = graphic_headers->Clone();
+  graphic_headers_ = graphic_headers->CreateAliasView();
   graphic_items_.reserve(graphic_items.size());
   for (const auto& item : graphic_items) {
-    graphic_items_.emplace_back(item->Clone());
+    graphic_items_.emplace_back(item->CreateAliasView());
   }
 }
 
@@ -344,6 +350,31 @@ int MenuDrawFunctions::DrawTextLines(int x, int y, const std::vector<std::string
   return offset;
 }
 
+// Breaks |line| into pieces of at most |text_cols| columns, preferring to split at a space.
+static std::vector<std::string> WrapLine(const std::string& line, size_t text_cols) {
+  std::vector<std::string> pieces;
+  size_t next_start = 0;
+  while (next_start < line.size()) {
+    std::string sub = line.substr(next_start, text_cols + 1);
+    if (sub.size() <= text_cols) {
+      next_start += sub.size();
+    } else {
+      // Line too long and must be wrapped to text_cols columns.
+      size_t last_space = sub.find_last_of(" \t\n");
+      if (last_space == std::string::npos) {
+        // No space found, just draw as much as we can.
+        sub.resize(text_cols);
+        next_start += text_cols;
+      } else {
+        sub.resize(last_space);
+        next_start += last_space + 1;
+      }
+    }
+    pieces.push_back(std::move(sub));
+  }
+  return pieces;
+}
+
 int MenuDrawFunctions::DrawWrappedTextLines(int x, int y, const std::vector<std::string>& lines) const {
   const int padding = MenuItemPadding() / 2;
 
@@ -351,23 +382,12 @@ int MenuDrawFunctions::DrawWrappedTextLines(int x, int y, const std::vector<std:
   size_t text_cols = (gr_fb_width() - x * 2) / MenuCharWidth();
   int offset = 0;
   for (const auto& line : lines) {
-    size_t next_start = 0;
-    while (next_start < line.size()) {
-      std::string sub = line.substr(next_start, text_cols + 1);
-      if (sub.size() <= text_cols) {
-        next_start += sub.size();
-      } else {
-        // Line too long and must be wrapped to text_cols columns.
-        size_t last_space = sub.find_last_of(" \t\n");
-        if (last_space == std::string::npos) {
-          // No space found, just draw as much as we can.
-          sub.resize(text_cols);
-          next_start += text_cols;
-        } else {
-          sub.resize(last_space);
-          next_start += last_space + 1;
-        }
-      }
+    auto [entry, inserted] = wrap_cache_.try_emplace(line);
+    if (inserted || entry->second.text_cols != text_cols) {
+      entry->second.text_cols = text_cols;
+      entry->second.sublines = WrapLine(line, text_cols);
+    }
+    for (const auto& sub : entry->second.sublines) {
       offset += DrawTextLine(x, y + offset, sub, false) - (2 * MenuItemPadding() - padding);
     }
   }
@@ -381,6 +401,12 @@ constexpr int kDefaultMarginHeight = 0;
 constexpr int kDefaultMarginWidth = 0;
 constexpr int kDefaultAnimationFps = 30;
 
+// Tick interval of RenderThreadLoop() when no animation is playing and nothing has changed.
+constexpr double kIdleTickInterval = 0.1;
+
+// Number of lines of scrollback kept for the text log and the file viewer.
+constexpr size_t kScrollbackRows = 2048;
+
 ScreenRecoveryUI::ScreenRecoveryUI()
     : margin_width_(
           android::base::GetIntProperty("ro.recovery.ui.margin_width", kDefaultMarginWidth)),
@@ -398,12 +424,17 @@ ScreenRecoveryUI::ScreenRecoveryUI()
       progressScopeStart(0),
       progressScopeSize(0),
       progress(0),
+      progress_changed_(false),
       pagesIdentical(false),
       text_cols_(0),
       text_rows_(0),
       text_(nullptr),
       text_col_(0),
       text_row_(0),
+      text_total_rows_(0),
+      text_rows_used_(0),
+      text_scroll_(0),
+      text_frames_recorded_(0),
       show_text(false),
       show_text_ever(false),
       file_viewer_text_(nullptr),
@@ -421,9 +452,15 @@ ScreenRecoveryUI::~ScreenRecoveryUI() {
     batt_monitor_thread_.join();
   }
 
-  progress_thread_stopped_ = true;
-  if (progress_thread_.joinable()) {
-    progress_thread_.join();
+  render_thread_stopped_ = true;
+  redraw_cond_.notify_all();
+  if (render_thread_.joinable()) {
+    render_thread_.join();
+  }
+
+  animation_thread_stopped_ = true;
+  if (animation_thread_.joinable()) {
+    animation_thread_.join();
   }
   // No-op if gr_init() (via Init()) was not called or had failed.
   gr_exit();
@@ -677,7 +714,8 @@ void ScreenRecoveryUI::SelectAndShowBackgroundText(const std::vector<std::string
     text_y += gr_get_height(p.second.get());
   }
   // Update the whole screen.
-  gr_flip();
+  text_frames_recorded_ = 0;
+  Flip();
 }
 
 void ScreenRecoveryUI::CheckBackgroundTextImages() {
@@ -816,11 +854,21 @@ std::vector<std::string> ScreenRecoveryUI::GetMenuHelpMessage() const {
 // locked.
 void ScreenRecoveryUI::draw_screen_locked() {
   if (!show_text) {
+    text_frames_recorded_ = 0;
     draw_background_locked();
     draw_foreground_locked();
     return;
   }
 
+  // While ui_print output streams with no menu on screen, the frame is just the log grid on
+  // black and successive frames differ by a row or two. Repaint only the changed rows in that
+  // case so the dirty region handed to gr_flip() stays small; anything else falls back to a full
+  // clear and redraw.
+  if (!menu_ && text_frames_recorded_ >= 2) {
+    draw_text_buffer_locked(margin_height_, true /* incremental */);
+    return;
+  }
+
   gr_color(0, 0, 0, 255);
   gr_clear();
 
@@ -866,17 +914,56 @@ void ScreenRecoveryUI::draw_menu_and_text_buffer_locked(
     }
   }
 
-  // Display from the bottom up, until we hit the top of the screen, the bottom of the menu, or
-  // we've displayed the entire text buffer.
+  draw_text_buffer_locked(y, false /* incremental */);
+}
+
+// Draws the text buffer from the bottom up, until we hit the given top offset (the top of the
+// screen or the bottom of the menu), or we've displayed the entire text buffer. In incremental
+// mode the screen hasn't been cleared: rows matching what the last two frames drew are left
+// alone, and only the changed rows get blacked out and repainted. Frames without a menu are
+// snapshotted so the next one can diff against them; a menu on screen resets the history since
+// those frames depend on more than the text rows. Should only be called with updateMutex locked.
+void ScreenRecoveryUI::draw_text_buffer_locked(int top_y, bool incremental) {
   SetColor(UIElement::LOG);
-  int row = text_row_;
+  int row = (text_row_ + text_total_rows_ - text_scroll_) % text_total_rows_;
   size_t count = 0;
-  for (int ty = ScreenHeight() - margin_height_ - char_height_; ty >= y && count < text_rows_;
-       ty -= char_height_, ++count) {
-    DrawTextLine(margin_width_, ty, text_[row], false);
+  std::vector<std::string> drawn_rows;
+  int ty = ScreenHeight() - margin_height_ - char_height_;
+  for (; ty >= top_y && count < text_rows_used_ - text_scroll_; ty -= char_height_, ++count) {
+    std::string line(text_[row]);
+    bool unchanged = incremental && count < last_text_rows_[0].size() &&
+                     count < last_text_rows_[1].size() && line == last_text_rows_[0][count] &&
+                     line == last_text_rows_[1][count];
+    if (!unchanged) {
+      if (incremental) {
+        gr_color(0, 0, 0, 255);
+        gr_fill(0, ty, ScreenWidth(), ty + char_height_);
+        SetColor(UIElement::LOG);
+      }
+      DrawTextLine(margin_width_, ty, line, false);
+    }
+    drawn_rows.push_back(std::move(line));
     --row;
-    if (row < 0) row = text_rows_ - 1;
+    if (row < 0) row = text_total_rows_ - 1;
+  }
+
+  if (menu_) {
+    text_frames_recorded_ = 0;
+    return;
   }
+
+  if (incremental) {
+    // Rows the previous frames drew beyond the current count have gone stale; black them out.
+    size_t stale_rows = std::max(last_text_rows_[0].size(), last_text_rows_[1].size());
+    for (; ty >= top_y && count < stale_rows; ty -= char_height_, ++count) {
+      gr_color(0, 0, 0, 255);
+      gr_fill(0, ty, ScreenWidth(), ty + char_height_);
+    }
+  }
+
+  last_text_rows_[1] = std::move(last_text_rows_[0]);
+  last_text_rows_[0] = std::move(drawn_rows);
+  if (text_frames_recorded_ < 2) ++text_frames_recorded_;
 }
 
 // Draws the battery capacity on the screen. Should only be called with updateMutex locked.
@@ -936,22 +1023,33 @@ void ScreenRecoveryUI::draw_battery_capacity_locked() {
 }
 
 // Redraw everything on the screen and flip the screen (make it visible).
-// Should only be called with updateMutex locked.
-void ScreenRecoveryUI::update_screen_locked() {
-  draw_screen_locked();
+void ScreenRecoveryUI::Flip() {
   gr_flip();
 }
 
-// Updates only the progress bar, if possible, otherwise redraws the screen.
-// Should only be called with updateMutex locked.
+// Should only be called with updateMutex locked. The actual drawing happens on the render
+// thread; this only marks the screen dirty, so the caller never waits on a flip.
+void ScreenRecoveryUI::update_screen_locked() {
+  redraw_requested_ = true;
+  full_redraw_requested_ = true;
+  redraw_cond_.notify_one();
+}
+
+// Requests a progress-level redraw (the render thread repaints only the progress bar and
+// overlays if the background pages still match). Should only be called with updateMutex locked.
 void ScreenRecoveryUI::update_progress_locked() {
-  if (show_text || !pagesIdentical) {
+  redraw_requested_ = true;
+  redraw_cond_.notify_one();
+}
+
+// Composes the next frame. Runs on the render thread with updateMutex locked.
+void ScreenRecoveryUI::ComposeLocked(bool full_redraw) {
+  if (full_redraw || show_text || !pagesIdentical) {
     draw_screen_locked();  // Must redraw the whole screen
     pagesIdentical = true;
   } else {
     draw_foreground_locked();  // Draw only the progress bar and overlays
   }
-  gr_flip();
 }
 
 void ScreenRecoveryUI::BattMonitorThreadLoop() {
@@ -1015,29 +1113,42 @@ void ScreenRecoveryUI::BattMonitorThreadLoop() {
   }
 }
 
-void ScreenRecoveryUI::ProgressThreadLoop() {
-  double interval = 1.0 / animation_fps_;
-  while (!progress_thread_stopped_) {
+void ScreenRecoveryUI::RenderThreadLoop() {
+  // Setting ro.recovery.ui.animation_fps to 0 (or less) disables the loop animation: the icon
+  // stays on its first frame and this thread only ticks to move the progress bar, which frees up
+  // CPU for the install itself on slow SoCs.
+  double interval = animation_fps_ > 0 ? 1.0 / animation_fps_ : 1.0 / kDefaultAnimationFps;
+  while (!render_thread_stopped_) {
     double start = now();
     bool redraw = false;
+    bool animating = false;
     {
       std::lock_guard<std::mutex> lg(updateMutex);
 
       // update the installation animation, if active
       // skip this if we have a text overlay (too expensive to update)
-      if ((current_icon_ == INSTALLING_UPDATE || current_icon_ == ERASING) && !show_text) {
+      animating = animation_fps_ > 0 &&
+                  (current_icon_ == INSTALLING_UPDATE || current_icon_ == ERASING) && !show_text;
+      if (animating) {
+        bool next_intro_done = intro_done_;
+        size_t next_frame;
         if (!intro_done_) {
           if (current_frame_ == intro_frames_.size() - 1) {
-            intro_done_ = true;
-            current_frame_ = 0;
+            next_intro_done = true;
+            next_frame = 0;
           } else {
-            ++current_frame_;
+            next_frame = current_frame_ + 1;
           }
         } else {
-          current_frame_ = (current_frame_ + 1) % loop_frames_.size();
+          next_frame = (current_frame_ + 1) % loop_frames_.size();
         }
 
-        redraw = true;
+        // Hold the cursor on the current frame until the decode thread has delivered the next one.
+        if ((next_intro_done ? loop_frames_ : intro_frames_)[next_frame] != nullptr) {
+          intro_done_ = next_intro_done;
+          current_frame_ = next_frame;
+          redraw = true;
+        }
       }
 
       // move the progress bar forward on timed intervals, if configured
@@ -1047,19 +1158,50 @@ void ScreenRecoveryUI::ProgressThreadLoop() {
         float p = 1.0 * elapsed / duration;
         if (p > 1.0) p = 1.0;
         if (p > progress) {
+          // Only redraw once the bar has grown by at least a rendered pixel.
+          int width = gr_get_width(progress_bar_empty_.get());
+          float scale = width * progressScopeSize;
+          if ((int)(progress * scale) != (int)(p * scale)) {
+            redraw = true;
+          }
           progress = p;
-          redraw = true;
         }
       }
 
-      if (redraw) update_progress_locked();
+      // pick up progress reported via SetProgress() since the last tick
+      if (progress_changed_) {
+        progress_changed_ = false;
+        redraw = true;
+      }
+
+      // pick up redraws requested by state changes since the last tick
+      if (redraw_requested_) {
+        redraw = true;
+      }
+      if (redraw) {
+        ComposeLocked(full_redraw_requested_);
+        redraw_requested_ = false;
+        full_redraw_requested_ = false;
+      }
     }
+    // Flip outside the lock: the page flip is where the display latency lives, and state
+    // updates from Print()/SetProgress() must not wait on it.
+    if (redraw) Flip();
 
     double end = now();
-    // minimum of 20ms delay between frames
-    double delay = interval - (end - start);
+    // minimum of 20ms delay between frames; run at the full animation rate only while the
+    // animation is playing or progress is actually moving, and idle otherwise
+    double tick = (animating || redraw) ? interval : kIdleTickInterval;
+    double delay = tick - (end - start);
     if (delay < 0.02) delay = 0.02;
-    usleep(static_cast<useconds_t>(delay * 1000000));
+    // The first 20ms are unconditional, so a burst of requests coalesces into one frame; the
+    // rest of an idle tick is cut short as soon as someone marks the screen dirty.
+    usleep(20000);
+    if (delay > 0.02) {
+      std::unique_lock<std::mutex> lk(updateMutex);
+      redraw_cond_.wait_for(lk, std::chrono::duration<double>(delay - 0.02),
+                            [this] { return render_thread_stopped_.load() || redraw_requested_; });
+    }
   }
 }
 
@@ -1169,10 +1311,12 @@ bool ScreenRecoveryUI::Init(const std::string& locale) {
   // Are we the large variant of our base layout?
   if (gr_fb_height() > PixelsFromDp(800)) ++layout_;
 
-  text_ = Alloc2d(text_rows_, text_cols_ + 1);
-  file_viewer_text_ = Alloc2d(text_rows_, text_cols_ + 1);
+  text_total_rows_ = std::max(kScrollbackRows, text_rows_);
+  text_ = Alloc2d(text_total_rows_, text_cols_ + 1);
+  file_viewer_text_ = Alloc2d(text_total_rows_, text_cols_ + 1);
 
   text_col_ = text_row_ = 0;
+  text_rows_used_ = 1;
 
   // Set up the locale info.
   SetLocale(locale);
@@ -1184,9 +1328,10 @@ bool ScreenRecoveryUI::Init(const std::string& locale) {
   stage_marker_empty_ = LoadBitmap("stage_empty");
   stage_marker_fill_ = LoadBitmap("stage_fill");
 
-  erasing_text_ = LoadLocalizedBitmap("erasing_text");
-  no_command_text_ = LoadLocalizedBitmap("no_command_text");
-  error_text_ = LoadLocalizedBitmap("error_text");
+  // The localized background texts are decoded on demand: each strip costs a scan of the whole
+  // packed png for the current locale, and a device going straight into an unattended update
+  // never shows most of them. SetBackground() loads the string for the screen it switches to,
+  // and the wipe-data menu texts load when the menu is first shown.
 
   back_icon_ = LoadBitmap("ic_back");
   back_icon_sel_ = LoadBitmap("ic_back_sel");
@@ -1202,8 +1347,6 @@ bool ScreenRecoveryUI::Init(const std::string& locale) {
   // "installing security update". It will be set after Init() according to the commands in BCB.
   installing_text_.reset();
 
-  LoadWipeDataMenuText();
-
   LoadAnimation();
 
   is_battery_less = android::base::GetBoolProperty("ro.recovery.batteryless", false);
@@ -1211,8 +1354,9 @@ bool ScreenRecoveryUI::Init(const std::string& locale) {
     // Keep the battery capacity updated.
     batt_monitor_thread_ = std::thread(&ScreenRecoveryUI::BattMonitorThreadLoop, this);
 
-  // Keep the progress bar updated, even when the process is otherwise busy.
-  progress_thread_ = std::thread(&ScreenRecoveryUI::ProgressThreadLoop, this);
+  // All drawing and flipping happen on the render thread; it also keeps the progress bar and
+  // the installing animation moving while the process is otherwise busy.
+  render_thread_ = std::thread(&ScreenRecoveryUI::RenderThreadLoop, this);
 
   // set the callback for hall sensor event
   (void)ev_sync_sw_state([this](auto&& a, auto&& b) { return this->SetSwCallback(a, b);});
@@ -1251,20 +1395,67 @@ void ScreenRecoveryUI::LoadAnimation() {
   std::sort(intro_frame_names.begin(), intro_frame_names.end());
   std::sort(loop_frame_names.begin(), loop_frame_names.end());
 
+  if (animation_thread_.joinable()) {
+    animation_thread_stopped_ = true;
+    animation_thread_.join();
+  }
+  animation_thread_stopped_ = false;
+
+  // Decode only the first frame of each part up front, so the UI can paint right away; the rest
+  // are filled in behind the draw cursor by the decode thread. RenderThreadLoop() holds the
+  // cursor rather than stepping onto a frame that hasn't been delivered yet.
   intro_frames_.clear();
-  intro_frames_.reserve(intro_frames);
-  for (const auto& frame_name : intro_frame_names) {
-    intro_frames_.emplace_back(LoadBitmap(frame_name));
+  intro_frames_.resize(intro_frames);
+  if (intro_frames > 0) {
+    intro_frames_[0] = LoadBitmap(intro_frame_names[0]);
   }
 
   loop_frames_.clear();
-  loop_frames_.reserve(loop_frames);
-  for (const auto& frame_name : loop_frame_names) {
-    loop_frames_.emplace_back(LoadBitmap(frame_name));
-  }
+  loop_frames_.resize(loop_frames);
+  loop_frames_[0] = LoadBitmap(loop_frame_names[0]);
+
+  // With the animation disabled the draw cursor never leaves frame 0, so don't spend cycles
+  // decoding frames that will never be shown.
+  if (animation_fps_ <= 0) return;
+
+  animation_thread_ = std::thread(&ScreenRecoveryUI::AnimationDecodeThreadLoop, this,
+                                  std::move(intro_frame_names), std::move(loop_frame_names));
+}
+
+void ScreenRecoveryUI::AnimationDecodeThreadLoop(std::vector<std::string> intro_frame_names,
+                                                 std::vector<std::string> loop_frame_names) {
+  auto decode_into = [this](std::vector<std::unique_ptr<GRSurface>>& frames,
+                            const std::vector<std::string>& names) {
+    for (size_t i = 1; i < names.size(); ++i) {
+      if (animation_thread_stopped_) return;
+      // Decode outside the lock; only the hand-off into the vector needs it.
+      auto frame = LoadBitmap(names[i]);
+      std::lock_guard<std::mutex> lg(updateMutex);
+      frames[i] = std::move(frame);
+    }
+  };
+  decode_into(intro_frames_, intro_frame_names);
+  decode_into(loop_frames_, loop_frame_names);
 }
 
 void ScreenRecoveryUI::SetBackground(Icon icon) {
+  // The localized strip for each background is decoded on the first switch to that background
+  // rather than in Init(); decoding happens before taking the lock, and readers only look at the
+  // surface once current_icon_ has been updated under it.
+  switch (icon) {
+    case ERASING:
+      if (!erasing_text_) erasing_text_ = LoadLocalizedBitmap("erasing_text");
+      break;
+    case ERROR:
+      if (!error_text_) error_text_ = LoadLocalizedBitmap("error_text");
+      break;
+    case NO_COMMAND:
+      if (!no_command_text_) no_command_text_ = LoadLocalizedBitmap("no_command_text");
+      break;
+    default:
+      break;
+  }
+
   std::lock_guard<std::mutex> lg(updateMutex);
 
   current_icon_ = icon;
@@ -1303,7 +1494,9 @@ void ScreenRecoveryUI::SetProgress(float fraction) {
     float scale = width * progressScopeSize;
     if ((int)(progress * scale) != (int)(fraction * scale)) {
       progress = fraction;
-      update_progress_locked();
+      // Defer the redraw to RenderThreadLoop() so that a burst of updates costs at most one
+      // redraw per tick, and the caller isn't blocked on a flip.
+      progress_changed_ = true;
     }
   }
 }
@@ -1328,11 +1521,14 @@ void ScreenRecoveryUI::PrintV(const char* fmt, bool copy_to_stdout, va_list ap)
       if (*ptr == '\n' || text_col_ >= text_cols_) {
         text_[text_row_][text_col_] = '\0';
         text_col_ = 0;
-        text_row_ = (text_row_ + 1) % text_rows_;
+        text_row_ = (text_row_ + 1) % text_total_rows_;
+        if (text_rows_used_ < text_total_rows_) ++text_rows_used_;
       }
       if (*ptr != '\n') text_[text_row_][text_col_++] = *ptr;
     }
     text_[text_row_][text_col_] = '\0';
+    // New output pins the viewport back to the newest line.
+    text_scroll_ = 0;
     update_screen_locked();
   }
 }
@@ -1353,86 +1549,183 @@ void ScreenRecoveryUI::PrintOnScreenOnly(const char* fmt, ...) {
 
 void ScreenRecoveryUI::PutChar(char ch) {
   std::lock_guard<std::mutex> lg(updateMutex);
-  if (ch != '\n') text_[text_row_][text_col_++] = ch;
   if (ch == '\n' || text_col_ >= text_cols_) {
+    text_[text_row_][text_col_] = '\0';
     text_col_ = 0;
-    ++text_row_;
+    text_row_ = (text_row_ + 1) % text_total_rows_;
+    if (text_rows_used_ < text_total_rows_) ++text_rows_used_;
   }
+  if (ch != '\n') text_[text_row_][text_col_++] = ch;
+  text_[text_row_][text_col_] = '\0';
 }
 
 void ScreenRecoveryUI::ClearText() {
   std::lock_guard<std::mutex> lg(updateMutex);
   text_col_ = 0;
   text_row_ = 0;
-  for (size_t i = 0; i < text_rows_; ++i) {
+  text_rows_used_ = 1;
+  text_scroll_ = 0;
+  for (size_t i = 0; i < text_total_rows_; ++i) {
     memset(text_[i], 0, text_cols_ + 1);
   }
 }
 
 void ScreenRecoveryUI::ShowFile(FILE* fp) {
-  std::vector<off_t> offsets;
-  offsets.push_back(ftello(fp));
   ClearText();
 
+  // View the file through a read-only mapping instead of loading it: opening is O(1) in the file
+  // size, and the kernel pages log data in and out as the viewer touches it, so a multi-megabyte
+  // last_log costs no more RAM than the visible page.
   struct stat sb;
-  fstat(fileno(fp), &sb);
+  if (fstat(fileno(fp), &sb) != 0) {
+    Print("  Unable to stat log: %s\n", strerror(errno));
+    return;
+  }
+  size_t file_size = sb.st_size;
+  const char* data = nullptr;
+  if (file_size > 0) {
+    void* map = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fileno(fp), 0);
+    if (map == MAP_FAILED) {
+      Print("  Unable to map log: %s\n", strerror(errno));
+      return;
+    }
+    data = static_cast<const char*>(map);
+  }
+
+  // Starting offsets of the wrapped display lines discovered so far. Lines wrap exactly like
+  // PutChar(): at a newline, or silently at text_cols_ characters (a newline right at the wrap
+  // point is swallowed). The index grows only as the user pages forward, so a line is never
+  // wrapped twice and paging backward is a table lookup.
+  std::vector<size_t> line_starts{ 0 };
+  bool indexed_to_eof = (file_size == 0);
+
+  // Returns the length of the line starting at |start|, capped at the wrap width.
+  auto line_length = [&](size_t start) {
+    size_t len = 0;
+    while (len < text_cols_ && start + len < file_size && data[start + len] != '\n') {
+      ++len;
+    }
+    return len;
+  };
 
-  bool show_prompt = false;
+  // Extends the index until it knows at least |lines| line starts, or hits EOF.
+  auto index_through = [&](size_t lines) {
+    while (!indexed_to_eof && line_starts.size() < lines) {
+      size_t start = line_starts.back();
+      size_t next = start + line_length(start);
+      if (next < file_size && data[next] == '\n') {
+        ++next;
+      }
+      if (next >= file_size) {
+        indexed_to_eof = true;
+      } else {
+        line_starts.push_back(next);
+      }
+    }
+  };
+
+  size_t top_line = 0;
   while (true) {
-    if (show_prompt) {
-      PrintOnScreenOnly("--(%d%% of %d bytes)--",
-                        static_cast<int>(100 * (double(ftello(fp)) / double(sb.st_size))),
-                        static_cast<int>(sb.st_size));
-      Redraw();
-      while (show_prompt) {
-        show_prompt = false;
-        InputEvent evt = WaitInputEvent();
-        if (evt.type() == EventType::EXTRA) {
-          if (evt.key() == static_cast<int>(KeyError::INTERRUPTED)) {
-            return;
-          }
-        }
-        if (evt.type() != EventType::KEY) {
-          show_prompt = true;
-          continue;
-        }
-        if (evt.key() == KEY_POWER || evt.key() == KEY_ENTER || evt.key() == KEY_BACKSPACE ||
-            evt.key() == KEY_BACK || evt.key() == KEY_HOMEPAGE ||
-            evt.key() == KEY_ESC || evt.key() == KEY_LEFTMETA || evt.key() == KEY_RIGHTMETA) {
-          return;
-        } else if (evt.key() == KEY_UP || evt.key() == KEY_VOLUMEUP || evt.key() == KEY_SCROLLUP ||
-                   evt.key() == KEY_PAGEUP) {
-          if (offsets.size() <= 1) {
-            show_prompt = true;
-          } else {
-            offsets.pop_back();
-            fseek(fp, offsets.back(), SEEK_SET);
-          }
-        } else {
-          if (feof(fp)) {
-            return;
-          }
-          offsets.push_back(ftello(fp));
-        }
+    {
+      std::lock_guard<std::mutex> lg(updateMutex);
+      index_through(top_line + text_rows_);
+      size_t visible = std::min(text_rows_, line_starts.size() - top_line);
+      for (size_t i = 0; i < visible; ++i) {
+        size_t start = line_starts[top_line + i];
+        size_t len = line_length(start);
+        if (len > 0) memcpy(text_[i], data + start, len);
+        text_[i][len] = '\0';
+      }
+      // Point the ring state at the page so draw_text_buffer_locked() paints rows
+      // visible-1 .. 0 from the bottom up.
+      text_row_ = (visible == 0) ? 0 : visible - 1;
+      text_rows_used_ = std::max<size_t>(visible, 1);
+      text_col_ = 0;
+      text_scroll_ = 0;
+    }
+    Redraw();
+
+    InputEvent evt = WaitInputEvent();
+    if (evt.type() == EventType::EXTRA) {
+      if (evt.key() == static_cast<int>(KeyError::INTERRUPTED)) {
+        break;
       }
-      ClearText();
+    }
+    if (evt.type() != EventType::KEY) {
+      continue;
     }
 
-    int ch = getc(fp);
-    if (ch == EOF) {
-      while (text_row_ < text_rows_ - 1) PutChar('\n');
-      show_prompt = true;
+    if (evt.key() == KEY_POWER || evt.key() == KEY_ENTER || evt.key() == KEY_BACKSPACE ||
+        evt.key() == KEY_BACK || evt.key() == KEY_HOMEPAGE ||
+        evt.key() == KEY_ESC || evt.key() == KEY_LEFTMETA || evt.key() == KEY_RIGHTMETA) {
+      break;
+    } else if (evt.key() == KEY_UP || evt.key() == KEY_VOLUMEUP || evt.key() == KEY_SCROLLUP) {
+      if (top_line > 0) --top_line;
+    } else if (evt.key() == KEY_PAGEUP) {
+      top_line -= std::min(top_line, text_rows_);
+    } else if (evt.key() == KEY_DOWN || evt.key() == KEY_VOLUMEDOWN ||
+               evt.key() == KEY_SCROLLDOWN) {
+      index_through(top_line + text_rows_ + 1);
+      if (line_starts.size() > top_line + text_rows_) ++top_line;
     } else {
-      PutChar(ch);
-      if (text_col_ == 0 && text_row_ >= text_rows_ - 1) {
-        show_prompt = true;
+      // Any other key pages down; at the bottom it exits, like the old pager.
+      index_through(top_line + 2 * text_rows_);
+      if (line_starts.size() <= top_line + text_rows_) {
+        break;
       }
+      top_line = std::min(top_line + text_rows_, line_starts.size() - text_rows_);
     }
   }
+
+  if (data != nullptr) {
+    munmap(const_cast<char*>(data), file_size);
+  }
+}
+
+// Log rotation zstd-compresses the older generations under /cache/recovery (see
+// recovery_utils/logging.cpp). Inflates such a file into an unlinked tmpfile(3), so the mmap-based
+// pager in ShowFile(FILE*) can treat it like any plain log. Returns nullptr (with errno set) on
+// failure.
+static std::unique_ptr<FILE, decltype(&fclose)> DecompressLogFile(const std::string& filename) {
+  std::unique_ptr<FILE, decltype(&fclose)> fp(nullptr, fclose);
+
+  std::string compressed;
+  if (!android::base::ReadFileToString(filename, &compressed)) {
+    return fp;
+  }
+
+  unsigned long long content_size = ZSTD_getFrameContentSize(compressed.data(), compressed.size());
+  if (content_size == ZSTD_CONTENTSIZE_ERROR || content_size == ZSTD_CONTENTSIZE_UNKNOWN) {
+    errno = EINVAL;
+    return fp;
+  }
+
+  std::string content(content_size, '\0');
+  size_t decompressed_size =
+      ZSTD_decompress(content.data(), content.size(), compressed.data(), compressed.size());
+  if (ZSTD_isError(decompressed_size) || decompressed_size != content_size) {
+    errno = EINVAL;
+    return fp;
+  }
+
+  fp.reset(tmpfile());
+  if (!fp) {
+    return fp;
+  }
+  if (fwrite(content.data(), 1, content.size(), fp.get()) != content.size() ||
+      fseek(fp.get(), 0, SEEK_SET) != 0) {
+    fp.reset();
+  }
+  return fp;
 }
 
 void ScreenRecoveryUI::ShowFile(const std::string& filename) {
-  std::unique_ptr<FILE, decltype(&fclose)> fp(fopen(filename.c_str(), "re"), fclose);
+  std::unique_ptr<FILE, decltype(&fclose)> fp(nullptr, fclose);
+  if (android::base::EndsWith(filename, ".zst")) {
+    fp = DecompressLogFile(filename);
+  } else {
+    fp.reset(fopen(filename.c_str(), "re"));
+  }
   if (!fp) {
     Print("  Unable to open %s: %s\n", filename.c_str(), strerror(errno));
     return;
@@ -1441,6 +1734,7 @@ void ScreenRecoveryUI::ShowFile(const std::string& filename) {
   char** old_text = text_;
   size_t old_text_col = text_col_;
   size_t old_text_row = text_row_;
+  size_t old_text_rows_used = text_rows_used_;
 
   // Swap in the alternate screen and clear it.
   text_ = file_viewer_text_;
@@ -1451,6 +1745,8 @@ void ScreenRecoveryUI::ShowFile(const std::string& filename) {
   text_ = old_text;
   text_col_ = old_text_col;
   text_row_ = old_text_row;
+  text_rows_used_ = old_text_rows_used;
+  text_scroll_ = 0;
 }
 
 std::unique_ptr<Menu> ScreenRecoveryUI::CreateMenu(
@@ -1704,6 +2000,9 @@ size_t ScreenRecoveryUI::ShowPromptWipeDataMenu(const std::vector<std::string>&
 size_t ScreenRecoveryUI::ShowPromptWipeDataConfirmationMenu(
     const std::vector<std::string>& backup_headers, const std::vector<std::string>& backup_items,
     const std::function<int(int, bool)>& key_handler) {
+  if (!wipe_data_confirmation_text_) {
+    LoadWipeDataMenuText();
+  }
   auto confirmation_menu =
       CreateMenu(wipe_data_confirmation_text_.get(),
                  { cancel_wipe_data_text_.get(), factory_data_reset_text_.get() }, backup_headers,
@@ -1781,7 +2080,8 @@ int ScreenRecoveryUI::SetSwCallback(int code, int value) {
 
   /* turn on the screen */
   gr_fb_blank(false, value);
-  gr_flip();
+  text_frames_recorded_ = 0;
+  Flip();
 
   /* set the retation */
   std::string rotation_str;
@@ -28,6 +28,7 @@
 
 #include <chrono>
 #include <functional>
+#include <iterator>
 #include <string>
 #include <thread>
 
@@ -76,6 +77,7 @@ RecoveryUI::RecoveryUI()
       touch_high_threshold_(android::base::GetIntProperty("ro.recovery.ui.touch_high_threshold",
                                                           kDefaultTouchHighThreshold)),
       key_interrupted_(false),
+      event_queue_head(0),
       event_queue_len(0),
       key_last_down(-1),
       key_long_press(false),
@@ -102,6 +104,14 @@ RecoveryUI::~RecoveryUI() {
   if (input_thread_.joinable()) {
     input_thread_.join();
   }
+  {
+    std::lock_guard<std::mutex> lock(brightness_mutex_);
+    brightness_thread_stopped_ = true;
+  }
+  brightness_cond_.notify_one();
+  if (brightness_thread_.joinable()) {
+    brightness_thread_.join();
+  }
 }
 
 void RecoveryUI::OnTouchDeviceDetected(int fd) {
@@ -195,17 +205,69 @@ bool RecoveryUI::InitScreensaver() {
 
   brightness_normal_value_ = max_value * brightness_normal_ / 100.0;
   brightness_dimmed_value_ = max_value * brightness_dimmed_ / 100.0;
-  if (!android::base::WriteStringToFile(std::to_string(brightness_normal_value_),
-                                        brightness_file_)) {
+
+  // Hold the fd open for the life of the UI; every brightness change from here on is a small
+  // pwrite through it, performed by the worker below rather than whichever thread flips the
+  // screensaver state.
+  brightness_fd_.reset(open(brightness_file_.c_str(), O_WRONLY | O_CLOEXEC));
+  if (brightness_fd_ == -1) {
+    PLOG(WARNING) << "Failed to open " << brightness_file_;
+    return false;
+  }
+  std::string value = std::to_string(brightness_normal_value_);
+  if (TEMP_FAILURE_RETRY(pwrite(brightness_fd_, value.data(), value.size(), 0)) == -1) {
     PLOG(WARNING) << "Failed to set brightness";
     return false;
   }
+  brightness_current_value_ = brightness_normal_value_;
+  brightness_target_value_ = brightness_normal_value_;
+  brightness_thread_ = std::thread(&RecoveryUI::BrightnessWorker, this);
 
   LOG(INFO) << "Brightness: " << brightness_normal_value_ << " (" << brightness_normal_ << "%)";
   screensaver_state_ = ScreensaverState::NORMAL;
   return true;
 }
 
+void RecoveryUI::BrightnessWorker() {
+  // Fade duration ~128 ms: fast enough that a wake feels immediate, slow enough to read as a
+  // fade rather than a flicker.
+  constexpr int kFadeSteps = 8;
+  constexpr auto kFadeStepDelay = 16ms;
+
+  std::unique_lock<std::mutex> lock(brightness_mutex_);
+  while (true) {
+    brightness_cond_.wait(lock, [this] {
+      return brightness_thread_stopped_ || brightness_target_value_ != brightness_current_value_;
+    });
+    if (brightness_thread_stopped_) break;
+
+    unsigned int target = brightness_target_value_;
+    unsigned int start = brightness_current_value_;
+    int delta = static_cast<int>(target) - static_cast<int>(start);
+    for (int step = 1; step <= kFadeSteps; ++step) {
+      unsigned int level = start + delta * step / kFadeSteps;
+      lock.unlock();
+      std::string value = std::to_string(level);
+      if (TEMP_FAILURE_RETRY(pwrite(brightness_fd_, value.data(), value.size(), 0)) == -1) {
+        PLOG(WARNING) << "Failed to set brightness to " << level;
+      }
+      lock.lock();
+      brightness_current_value_ = level;
+      if (brightness_thread_stopped_ || brightness_target_value_ != target) {
+        break;  // A new target arrived mid-fade; restart the ramp from wherever we are.
+      }
+      if (step < kFadeSteps) {
+        brightness_cond_.wait_for(lock, kFadeStepDelay, [this, target] {
+          return brightness_thread_stopped_ || brightness_target_value_ != target;
+        });
+        if (brightness_thread_stopped_ || brightness_target_value_ != target) {
+          break;
+        }
+      }
+    }
+  }
+}
+
 bool RecoveryUI::Init(const std::string& /* locale */) {
   ev_init(std::bind(&RecoveryUI::OnInputEvent, this, std::placeholders::_1, std::placeholders::_2),
           touch_screen_allowed_);
@@ -312,11 +374,27 @@ void RecoveryUI::OnTouchRelease() {
 }
 
 int RecoveryUI::OnInputEvent(int fd, uint32_t epevents) {
-  struct input_event ev;
-  if (ev_get_input(fd, epevents, &ev) == -1) {
+  // Drain everything the device has queued in one read. Touch panels can flood hundreds of move
+  // events per second; handling them one per epoll wake starves the draw thread. Tracking
+  // callbacks are coalesced so the batch delivers a single OnTouchTrack() for the final position,
+  // while presses, releases and key events keep their ordering.
+  struct input_event evs[64];
+  int count = ev_get_input_events(fd, epevents, evs, std::size(evs));
+  if (count <= 0) {
     return -1;
   }
 
+  for (int i = 0; i < count; ++i) {
+    ProcessInputEvent(fd, evs[i]);
+  }
+  if (touch_track_pending_) {
+    touch_track_pending_ = false;
+    OnTouchTrack();
+  }
+  return 0;
+}
+
+void RecoveryUI::ProcessInputEvent(int fd, const input_event& ev) {
   // Touch inputs handling.
   //
   // Per the doc Multi-touch Protocol at below, there are two protocols.
@@ -343,12 +421,17 @@ int RecoveryUI::OnInputEvent(int fd, uint32_t epevents) {
           touch_saw_x_ = touch_saw_y_ = false;
         }
       } else if (touch_reported_ && !touch_finger_down_) {
+        // Deliver any coalesced movement before the lift, to keep the callback order.
+        if (touch_track_pending_) {
+          touch_track_pending_ = false;
+          OnTouchTrack();
+        }
         OnTouchRelease();
         touch_reported_ = false;
         touch_saw_x_ = touch_saw_y_ = false;
       }
     }
-    return 0;
+    return;
   }
 
   if (ev.type == EV_REL) {
@@ -378,7 +461,7 @@ int RecoveryUI::OnInputEvent(int fd, uint32_t epevents) {
       touch_slot_ = ev.value;
     }
     // Ignore other fingers.
-    if (touch_slot_ > 0) return 0;
+    if (touch_slot_ > 0) return;
 
     switch (ev.code) {
       case ABS_MT_POSITION_X:
@@ -386,7 +469,7 @@ int RecoveryUI::OnInputEvent(int fd, uint32_t epevents) {
         touch_saw_x_ = true;
         touch_pos_.x(ev.value * gr_fb_width_real() / (touch_max_.x() - touch_min_.x()));
         if (touch_reported_ && touch_saw_y_) {
-          OnTouchTrack();
+          touch_track_pending_ = true;
           touch_saw_x_ = touch_saw_y_ = false;
         }
         break;
@@ -396,7 +479,7 @@ int RecoveryUI::OnInputEvent(int fd, uint32_t epevents) {
         touch_saw_y_ = true;
         touch_pos_.y(ev.value * gr_fb_height_real() / (touch_max_.y() - touch_min_.y()));
         if (touch_reported_ && touch_saw_x_) {
-          OnTouchTrack();
+          touch_track_pending_ = true;
           touch_saw_x_ = touch_saw_y_ = false;
         }
         break;
@@ -406,7 +489,7 @@ int RecoveryUI::OnInputEvent(int fd, uint32_t epevents) {
         if (ev.value < 0) touch_finger_down_ = false;
         break;
     }
-    return 0;
+    return;
   }
 
   if (ev.type == EV_KEY && ev.code <= KEY_MAX) {
@@ -421,7 +504,7 @@ int RecoveryUI::OnInputEvent(int fd, uint32_t epevents) {
       // additional scrolling (because in ScreenRecoveryUI::ShowFile(), we consider keys other than
       // KEY_POWER and KEY_UP as KEY_DOWN).
       if (ev.code == BTN_TOUCH || ev.code == BTN_TOOL_FINGER) {
-        return 0;
+        return;
       }
     }
 
@@ -432,8 +515,6 @@ int RecoveryUI::OnInputEvent(int fd, uint32_t epevents) {
   if (ev.type == EV_SW) {
     SetSwCallback(ev.code, ev.value);
   }
-
-  return 0;
 }
 
 // Processes a key-up or -down event. A key is "registered" when it is pressed and then released,
@@ -503,59 +584,66 @@ void RecoveryUI::TimeKey(int key_code, int count) {
   if (long_press) KeyLongPress(key_code);
 }
 
-void RecoveryUI::EnqueueKey(int key_code) {
-  std::lock_guard<std::mutex> lg(event_queue_mutex);
-  const int queue_max = sizeof(event_queue) / sizeof(event_queue[0]);
-  if (event_queue_len < queue_max) {
-    InputEvent event(key_code);
-    event_queue[event_queue_len++] = event;
+// Appends an event to the ring buffer. The notify happens after the lock is dropped so the woken
+// consumer doesn't immediately block on the mutex we still hold.
+void RecoveryUI::EnqueueEvent(const InputEvent& event) {
+  constexpr int queue_max = sizeof(event_queue) / sizeof(event_queue[0]);
+  bool enqueued = false;
+  {
+    std::lock_guard<std::mutex> lg(event_queue_mutex);
+    if (event_queue_len < queue_max) {
+      event_queue[(event_queue_head + event_queue_len++) % queue_max] = event;
+      enqueued = true;
+    }
+  }
+  if (enqueued) {
     event_queue_cond.notify_one();
   }
 }
 
+void RecoveryUI::EnqueueKey(int key_code) {
+  EnqueueEvent(InputEvent(key_code));
+}
+
 void RecoveryUI::EnqueueTouch(const Point& pos) {
-  std::lock_guard<std::mutex> lg(event_queue_mutex);
-  const int queue_max = sizeof(event_queue) / sizeof(event_queue[0]);
-  if (event_queue_len < queue_max) {
-    InputEvent event(pos);
-    event_queue[event_queue_len++] = event;
-    event_queue_cond.notify_one();
-  }
+  EnqueueEvent(InputEvent(pos));
 }
 
 void RecoveryUI::SetScreensaverState(ScreensaverState state) {
+  if (brightness_fd_ == -1) {
+    // InitScreensaver() didn't complete; there's nothing to drive.
+    return;
+  }
+
+  unsigned int value;
   switch (state) {
     case ScreensaverState::NORMAL:
-      if (android::base::WriteStringToFile(std::to_string(brightness_normal_value_),
-                                           brightness_file_)) {
-        screensaver_state_ = ScreensaverState::NORMAL;
-        LOG(INFO) << "Brightness: " << brightness_normal_value_ << " (" << brightness_normal_
-                  << "%)";
-      } else {
-        LOG(WARNING) << "Unable to set brightness to normal";
-      }
+      value = brightness_normal_value_;
+      LOG(INFO) << "Brightness: " << brightness_normal_value_ << " (" << brightness_normal_
+                << "%)";
       break;
     case ScreensaverState::DIMMED:
-      if (android::base::WriteStringToFile(std::to_string(brightness_dimmed_value_),
-                                           brightness_file_)) {
-        LOG(INFO) << "Brightness: " << brightness_dimmed_value_ << " (" << brightness_dimmed_
-                  << "%)";
-        screensaver_state_ = ScreensaverState::DIMMED;
-      } else {
-        LOG(WARNING) << "Unable to set brightness to dim";
-      }
+      value = brightness_dimmed_value_;
+      LOG(INFO) << "Brightness: " << brightness_dimmed_value_ << " (" << brightness_dimmed_
+                << "%)";
       break;
     case ScreensaverState::OFF:
-      if (android::base::WriteStringToFile("0", brightness_file_)) {
-        LOG(INFO) << "Brightness: 0 (off)";
-        screensaver_state_ = ScreensaverState::OFF;
-      } else {
-        LOG(WARNING) << "Unable to set brightness to off";
-      }
+      value = 0;
+      LOG(INFO) << "Brightness: 0 (off)";
       break;
     default:
       LOG(ERROR) << "Invalid screensaver state";
+      return;
+  }
+
+  // Just retarget the worker's ramp; the sysfs writes (and the fade) happen off this thread, so
+  // waking the screen never stalls input handling.
+  {
+    std::lock_guard<std::mutex> lock(brightness_mutex_);
+    brightness_target_value_ = value;
   }
+  brightness_cond_.notify_one();
+  screensaver_state_ = state;
 }
 
 RecoveryUI::InputEvent RecoveryUI::WaitInputEvent() {
@@ -588,7 +676,9 @@ RecoveryUI::InputEvent RecoveryUI::WaitInputEvent() {
         // Drop the first key if it's changing from OFF to NORMAL.
         if (screensaver_state_ == ScreensaverState::OFF) {
           if (event_queue_len > 0) {
-            memcpy(&event_queue[0], &event_queue[1], sizeof(int) * --event_queue_len);
+            constexpr int queue_max = sizeof(event_queue) / sizeof(event_queue[0]);
+            event_queue_head = (event_queue_head + 1) % queue_max;
+            --event_queue_len;
           }
         }
 
@@ -600,8 +690,10 @@ RecoveryUI::InputEvent RecoveryUI::WaitInputEvent() {
 
   InputEvent event;
   if (event_queue_len > 0) {
-    event = event_queue[0];
-    memcpy(&event_queue[0], &event_queue[1], sizeof(InputEvent) * --event_queue_len);
+    constexpr int queue_max = sizeof(event_queue) / sizeof(event_queue[0]);
+    event = event_queue[event_queue_head];
+    event_queue_head = (event_queue_head + 1) % queue_max;
+    --event_queue_len;
   }
   return event;
 }
@@ -660,6 +752,7 @@ bool RecoveryUI::HasTouchScreen() const {
 
 void RecoveryUI::FlushKeys() {
   std::lock_guard<std::mutex> lg(event_queue_mutex);
+  event_queue_head = 0;
   event_queue_len = 0;
 }
 
@@ -26,6 +26,19 @@ VrRecoveryUI::VrRecoveryUI()
     : stereo_offset_(
           android::base::GetIntProperty("ro.recovery.ui.stereo_offset", kDefaultStereoOffset)) {}
 
+bool VrRecoveryUI::Init(const std::string& locale) {
+  if (!ScreenRecoveryUI::Init(locale)) return false;
+
+  // Both eyes show the same scene, so render it once into an offscreen buffer and let Flip()
+  // place it per eye. minui only supports 4-byte pixel formats.
+  size_t width = ScreenWidth();
+  size_t height = ScreenHeight();
+  eye_buffer_ = GRSurface::Create(width, height, width * 4, 4);
+  if (!eye_buffer_) return false;
+  gr_render_target(eye_buffer_.get());
+  return true;
+}
+
 int VrRecoveryUI::ScreenWidth() const {
   return gr_fb_width() / 2;
 }
@@ -34,39 +47,23 @@ int VrRecoveryUI::ScreenHeight() const {
   return gr_fb_height();
 }
 
-void VrRecoveryUI::DrawSurface(const GRSurface* surface, int sx, int sy, int w, int h, int dx,
-                               int dy) const {
-  gr_blit(surface, sx, sy, w, h, dx + stereo_offset_, dy);
-  gr_blit(surface, sx, sy, w, h, dx - stereo_offset_ + ScreenWidth(), dy);
-}
-
-void VrRecoveryUI::DrawTextIcon(int x, int y, const GRSurface* surface) const {
-  gr_texticon(x + stereo_offset_, y, surface);
-  gr_texticon(x - stereo_offset_ + ScreenWidth(), y, surface);
-}
-
-int VrRecoveryUI::DrawTextLine(int x, int y, const std::string& line, bool bold) const {
-  gr_text(gr_sys_font(), x + stereo_offset_, y, line.c_str(), bold);
-  gr_text(gr_sys_font(), x - stereo_offset_ + ScreenWidth(), y, line.c_str(), bold);
-  return char_height_ + 4;
-}
-
-int VrRecoveryUI::DrawHorizontalRule(int y) const {
-  y += 4;
-  gr_fill(margin_width_ + stereo_offset_, y, ScreenWidth() - margin_width_ + stereo_offset_, y + 2);
-  gr_fill(ScreenWidth() + margin_width_ - stereo_offset_, y,
-          gr_fb_width() - margin_width_ - stereo_offset_, y + 2);
-  return y + 4;
-}
-
-void VrRecoveryUI::DrawHighlightBar(int /* x */, int y, int /* width */, int height) const {
-  gr_fill(margin_width_ + stereo_offset_, y, ScreenWidth() - margin_width_ + stereo_offset_,
-          y + height);
-  gr_fill(ScreenWidth() + margin_width_ - stereo_offset_, y,
-          gr_fb_width() - margin_width_ - stereo_offset_, y + height);
-}
+void VrRecoveryUI::Flip() {
+  int w = ScreenWidth();
+  int h = ScreenHeight();
 
-void VrRecoveryUI::DrawFill(int x, int y, int w, int h) const {
-  gr_fill(x + stereo_offset_, y, w, h);
-  gr_fill(x - stereo_offset_ + ScreenWidth(), y, w, h);
+  gr_render_target(nullptr);
+  if (stereo_offset_ > 0) {
+    // The eye viewports are shifted inwards; blank the uncovered strips at the screen edges.
+    gr_color(0, 0, 0, 255);
+    gr_fill(0, 0, stereo_offset_, h);
+    gr_fill(2 * w - stereo_offset_, 0, 2 * w, h);
+  } else if (stereo_offset_ < 0) {
+    // Shifted outwards; the uncovered strip sits between the two viewports.
+    gr_color(0, 0, 0, 255);
+    gr_fill(w + stereo_offset_, 0, w - stereo_offset_, h);
+  }
+  gr_blit(eye_buffer_.get(), 0, 0, w, h, stereo_offset_, 0);
+  gr_blit(eye_buffer_.get(), 0, 0, w, h, w - stereo_offset_, 0);
+  gr_flip();
+  gr_render_target(eye_buffer_.get());
 }
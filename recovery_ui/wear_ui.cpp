@@ -19,6 +19,7 @@
 
 #include <string.h>
 
+#include <algorithm>
 #include <string>
 #include <vector>
 
@@ -86,6 +87,12 @@ bool WearRecoveryUI::Init(const std::string& locale) {
   if (wrist_orientation_enabled) {
     InitWristOrientation();
   }
+  if (result && is_screen_circle_) {
+    // A round panel never shows the corners -- about a fifth of the framebuffer -- so clip them
+    // out of every fill, blit and text blend.
+    gr_set_clip_circle(gr_fb_width() / 2, gr_fb_height() / 2,
+                       std::min(gr_fb_width(), gr_fb_height()) / 2);
+  }
   return result;
 }
 
@@ -246,9 +253,10 @@ size_t WearRecoveryUI::GetProgressFrameIndex(float fraction) const {
 }
 
 // TODO merge drawing routines with screen_ui
-void WearRecoveryUI::update_progress_locked() {
+void WearRecoveryUI::ComposeLocked(bool /* full_redraw */) {
+  // The watch layouts don't keep the background pages identical, so every frame is a full
+  // recompose; the render thread still flips outside the lock.
   draw_screen_locked();
-  gr_flip();
 }
 
 bool WearRecoveryUI::IsWearable() {
@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "recovery_utils/health_monitor.h"
+
+#include <chrono>
+#include <thread>
+
+#include <android-base/logging.h>
+#include <android-base/properties.h>
+
+#include "recovery_utils/battery_utils.h"
+#include "recovery_utils/thermalutil.h"
+
+// Thermal sampling period. Short enough that throttle pacing reacts within a command or two;
+// long enough that the per-zone sysfs reads are lost in the noise.
+static constexpr auto kSampleInterval = std::chrono::seconds(10);
+// Battery state moves slowly and GetBatteryInfo() logs on every call, so sample it once per this
+// many thermal passes.
+static constexpr int kBatterySamplePeriod = 6;
+// Once throttling starts, it only ends this far below the threshold, so the state doesn't flap
+// while the device hovers around it.
+static constexpr int kThrottleHysteresis = 5000;
+
+HealthMonitor& HealthMonitor::Get() {
+  static HealthMonitor monitor;
+  return monitor;
+}
+
+void HealthMonitor::Start() {
+  if (started_.exchange(true)) {
+    return;
+  }
+  throttle_threshold_ =
+      android::base::GetIntProperty("ro.recovery.thermal_throttle_mc", 0);
+  if (throttle_threshold_ > 0) {
+    LOG(INFO) << "thermal throttle threshold: " << throttle_threshold_;
+  }
+  // Recovery never outlives the sampler; it runs until reboot.
+  std::thread(&HealthMonitor::Loop, this).detach();
+}
+
+void HealthMonitor::Loop() {
+  int tick = 0;
+  while (true) {
+    if (tick++ % kBatterySamplePeriod == 0) {
+      BatteryInfo info = GetBatteryInfo();
+      charging_.store(info.charging);
+      capacity_.store(info.capacity);
+    }
+
+    int temperature = GetMaxValueFromThermalZone();
+    temperature_.store(temperature);
+    if (temperature > max_temperature_.load()) {
+      max_temperature_.store(temperature);
+    }
+
+    if (throttle_threshold_ > 0 && temperature > 0) {
+      bool throttling = throttle_requested_.load();
+      if (!throttling && temperature >= throttle_threshold_) {
+        LOG(WARNING) << "temperature " << temperature << " above throttle threshold "
+                     << throttle_threshold_;
+        throttle_requested_.store(true);
+      } else if (throttling && temperature < throttle_threshold_ - kThrottleHysteresis) {
+        LOG(INFO) << "temperature " << temperature << " back below throttle threshold";
+        throttle_requested_.store(false);
+      }
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      have_sample_ = true;
+    }
+    first_sample_cv_.notify_all();
+
+    std::this_thread::sleep_for(kSampleInterval);
+  }
+}
+
+HealthSnapshot HealthMonitor::snapshot() {
+  Start();
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    first_sample_cv_.wait(lock, [this] { return have_sample_; });
+  }
+  return HealthSnapshot{ charging_.load(), capacity_.load(), temperature_.load() };
+}
+
+int HealthMonitor::max_temperature() const {
+  return max_temperature_.load();
+}
+
+void HealthMonitor::ResetMaxTemperature() {
+  max_temperature_.store(temperature_.load());
+}
+
+bool HealthMonitor::ThrottleRequested() const {
+  return throttle_requested_.load();
+}
@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+// A battery/thermal reading, as of the sampler's last pass.
+struct HealthSnapshot {
+  bool charging = true;
+  int capacity = 100;    // percent; 100 when no battery is present, matching GetBatteryInfo()
+  int temperature = -1;  // max across thermal zones, as read by GetMaxValueFromThermalZone()
+};
+
+// Background sampler owning battery and thermal state. GetBatteryInfo() can block for seconds
+// (waiting for the health service, settling a fake capacity reading) and the thermal maximum
+// costs one sysfs read per zone; neither belongs on the path that handles updater pipe traffic.
+// The monitor samples both on its own thread, so install gating and the thermal checks read a
+// cached snapshot instead.
+//
+// When ro.recovery.thermal_throttle_mc is set, the monitor also tracks whether the device is hot
+// enough that install work should back off, with built-in hysteresis so the state doesn't
+// flap around the threshold. The property is in the units the device's thermal zones report
+// (normally millidegrees) and defaults to 0 (disabled), since zone scales vary across devices.
+class HealthMonitor {
+ public:
+  static HealthMonitor& Get();
+
+  // Starts the sampler thread; idempotent. snapshot() starts it on demand, so calling this
+  // directly is only useful to warm the cache before the first reader needs it.
+  void Start();
+
+  // The last sample. The very first call blocks until the sampler has completed a pass, so a
+  // gating decision is never made on placeholder values; after that reads are wait-free.
+  HealthSnapshot snapshot();
+
+  // Highest temperature seen since the last ResetMaxTemperature().
+  int max_temperature() const;
+  void ResetMaxTemperature();
+
+  // True while the device is above the throttle threshold. One atomic load, safe to poll from
+  // the updater communication loop.
+  bool ThrottleRequested() const;
+
+ private:
+  HealthMonitor() = default;
+
+  void Loop();
+
+  std::atomic<bool> started_{ false };
+  std::atomic<bool> charging_{ true };
+  std::atomic<int> capacity_{ 100 };
+  std::atomic<int> temperature_{ -1 };
+  std::atomic<int> max_temperature_{ -1 };
+  std::atomic<bool> throttle_requested_{ false };
+  int throttle_threshold_ = 0;
+
+  std::mutex mutex_;
+  std::condition_variable first_sample_cv_;
+  bool have_sample_ = false;
+};
@@ -41,14 +41,29 @@ void SetLoggingSehandle(selabel_handle* handle);
 ssize_t logbasename(log_id_t id, char prio, const char* filename, const char* buf, size_t len,
                     void* arg);
 
+// Buffers a pmsg content chunk for re-injection (under a rotated name when *arg is true). The
+// actual /dev/pmsg0 writes happen in flush_pmsg_rotation(); a pstore replay delivers multi-MB
+// histories in small chunks, and issuing one write per chunk is what used to make the refresh
+// pass crawl.
 ssize_t logrotate(log_id_t id, char prio, const char* filename, const char* buf, size_t len,
                   void* arg);
 
+// Writes everything logrotate() buffered back to /dev/pmsg0, one write per file instead of one
+// per chunk, stopping early once an internal byte budget or time cap is exhausted so the refresh
+// never competes long with boot-critical I/O. Returns the first write error, if any.
+ssize_t flush_pmsg_rotation();
+
 // Rename last_log -> last_log.1 -> last_log.2 -> ... -> last_log.$max.
 // Similarly rename last_kmsg -> last_kmsg.1 -> ... -> last_kmsg.$max.
 // Overwrite any existing last_log.$max and last_kmsg.$max.
 void rotate_logs(const char* last_log_file, const char* last_kmsg_file);
 
+// Starts rotating the previous session's logs on a background worker, so the rename pass has
+// already finished by the time copy_logs() needs the last_log/last_kmsg slots free. Safe to call
+// more than once; only the first call starts a worker. copy_logs() falls back to a synchronous
+// rotation if this was never called.
+void trigger_log_rotation();
+
 // In turn fflush(3)'s, fsync(3)'s and fclose(3)'s the given stream.
 void check_and_fclose(FILE* fp, const std::string& name);
 
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Structured performance metrics for a recovery session. Call sites record named counters, timers
+// and value histograms; copy_logs() serializes the aggregate into a compact binary file next to
+// the session logs, and recovery-persist forwards it to /data/misc/recovery on the next boot
+// (through pmsg on cacheless devices, straight from /cache otherwise). This gives install-speed
+// numbers a machine-readable channel instead of the free-text lines in last_log.
+
+enum class MetricType : uint8_t {
+  kCounter = 1,
+  kTimer = 2,
+  kHistogram = 3,
+};
+
+// One named metric. Which fields are meaningful depends on the type: a counter uses |value|; a
+// timer uses |value| (total elapsed nanoseconds) and |count| (number of samples); a histogram uses
+// |count|, |sum|, |min|, |max| and |buckets|, where a bucket key is floor(log2(sample)) — 0 for
+// non-positive samples — and the mapped value is the number of samples in that bucket.
+struct MetricRecord {
+  MetricType type;
+  std::string name;
+  int64_t value = 0;
+  int64_t count = 0;
+  int64_t sum = 0;
+  int64_t min = 0;
+  int64_t max = 0;
+  std::map<uint8_t, int64_t> buckets;
+};
+
+class RecoveryMetrics {
+ public:
+  RecoveryMetrics() = default;
+
+  // Returns the process-wide instance. All recording methods are safe to call from multiple
+  // threads; installs and wipes record from workers as well as the UI thread.
+  static RecoveryMetrics& Get();
+
+  void IncrementCounter(const std::string& name, int64_t delta = 1);
+  void RecordDuration(const std::string& name, std::chrono::nanoseconds elapsed);
+  void RecordValue(const std::string& name, int64_t value);
+
+  // Serializes everything recorded so far; returns an empty string when nothing has been
+  // recorded. The layout is versioned and documented in metrics.cpp.
+  std::string Serialize() const;
+
+  // Parses a blob produced by Serialize() — or several of them concatenated — back into records.
+  // Returns false on malformed input.
+  static bool Parse(const std::string& data, std::vector<MetricRecord>* records);
+
+ private:
+  // Returns the record for |name|, creating it with |type| on first use. Returns nullptr (and
+  // logs) when |name| was already recorded under a different type. Caller must hold |mutex_|.
+  MetricRecord* FindOrCreateLocked(const std::string& name, MetricType type);
+
+  mutable std::mutex mutex_;
+  std::map<std::string, MetricRecord> records_;
+};
+
+// Adds the wall time between construction and destruction to the named timer.
+class ScopedMetricTimer {
+ public:
+  explicit ScopedMetricTimer(std::string name);
+  ~ScopedMetricTimer();
+
+ private:
+  std::string name_;
+  std::chrono::steady_clock::time_point start_;
+};
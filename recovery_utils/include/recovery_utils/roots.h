@@ -16,6 +16,7 @@
 
 #pragma once
 
+#include <functional>
 #include <string>
 
 #include <fstab/fstab.h>
@@ -43,17 +44,28 @@ int ensure_path_unmounted(const std::string& path);
 // Returns 0 on success.
 int ensure_volume_unmounted(const std::string& blk_device);
 
+// Drops the cached mounted state for the given mount point. The ensure_path_* helpers remember
+// which mount points they saw mounted so repeat calls skip re-reading /proc/mounts; anything
+// that umounts behind their back must call this, or the next ensure_path_mounted() becomes a
+// silent no-op.
+void forget_mount_state(const std::string& mount_point);
+
 // Reformat the given volume (must be the mount point only, eg
 // "/cache"), no paths permitted.  Attempts to unmount the volume if
 // it is mounted.
 int format_volume(const std::string& volume);
 
+// Progress reporting for format_volume(). |phase| names the tool currently running (e.g.
+// "make_f2fs", "sload_f2fs"); |fraction| is a coarse 0..1 estimate over the whole format,
+// interpolated from the tool's write position while it runs. Invoked from the formatting thread.
+using FormatProgressCallback = std::function<void(const std::string& phase, float fraction)>;
+
 // Reformat the given volume (must be the mount point only, eg
 // "/cache"), no paths permitted.  Attempts to unmount the volume if
 // it is mounted.
 // Copies 'directory' to root of the newly formatted volume
 int format_volume(const std::string& volume, const std::string& directory,
-                  std::string_view new_fstype);
+                  std::string_view new_fstype, const FormatProgressCallback& progress = nullptr);
 
 // Ensure that all and only the volumes that packages expect to find
 // mounted (/tmp and /cache) are mounted.  Returns 0 on success.
@@ -22,10 +22,15 @@
 #include <string.h>
 #include <sys/klog.h>
 #include <sys/types.h>
+#include <unistd.h>
 
 #include <algorithm>
+#include <chrono>
+#include <future>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
 
 #include <android-base/file.h>
 #include <android-base/logging.h>
@@ -35,15 +40,18 @@
 #include <private/android_filesystem_config.h> /* for AID_SYSTEM */
 #include <private/android_logger.h>            /* private pmsg functions */
 #include <selinux/label.h>
+#include <zstd.h>
 
 #include "otautil/dirutil.h"
 #include "otautil/paths.h"
+#include "recovery_utils/metrics.h"
 #include "recovery_utils/roots.h"
 
 constexpr const char* LOG_FILE = "/cache/recovery/log";
 constexpr const char* LAST_INSTALL_FILE = "/cache/recovery/last_install";
 constexpr const char* LAST_KMSG_FILE = "/cache/recovery/last_kmsg";
 constexpr const char* LAST_LOG_FILE = "/cache/recovery/last_log";
+constexpr const char* LAST_METRICS_FILE = "/cache/recovery/last_metrics";
 
 constexpr const char* LAST_KMSG_FILTER = "recovery/last_kmsg";
 constexpr const char* LAST_LOG_FILTER = "recovery/last_log";
@@ -94,40 +102,120 @@ ssize_t logbasename(log_id_t /* id */, char /* prio */, const char* filename, co
   return len;
 }
 
+// Chunks buffered by logrotate(), one entry per destination file in arrival order. Consecutive
+// chunks of the same file get appended, so flush_pmsg_rotation() can hand liblog the whole file
+// in one call instead of one /dev/pmsg0 write per chunk.
+struct PmsgRotationEntry {
+  log_id_t id;
+  char prio;
+  std::string name;
+  std::string content;
+};
+static std::vector<PmsgRotationEntry> pmsg_rotation;
+
+// Caps for flush_pmsg_rotation(): more than this much replayed history has no consumer (pmsg
+// wraps anyway), and past the deadline we'd rather drop old logs than keep competing with
+// boot-critical I/O.
+static constexpr size_t kPmsgFlushByteBudget = 2 * 1024 * 1024;
+static constexpr std::chrono::milliseconds kPmsgFlushTimeCap(500);
+
 ssize_t logrotate(log_id_t id, char prio, const char* filename, const char* buf, size_t len,
                   void* arg) {
   bool* do_rotate = static_cast<bool*>(arg);
-  if (!*do_rotate) {
-    return __android_log_pmsg_file_write(id, prio, filename, buf, len);
-  }
-
   std::string name(filename);
-  size_t dot = name.find_last_of('.');
-  std::string sub = name.substr(0, dot);
 
-  if (std::string(LAST_KMSG_FILTER).find(sub) == std::string::npos &&
-      std::string(LAST_LOG_FILTER).find(sub) == std::string::npos) {
-    return __android_log_pmsg_file_write(id, prio, filename, buf, len);
+  if (*do_rotate) {
+    size_t dot = name.find_last_of('.');
+    std::string sub = name.substr(0, dot);
+
+    if (std::string(LAST_KMSG_FILTER).find(sub) != std::string::npos ||
+        std::string(LAST_LOG_FILTER).find(sub) != std::string::npos) {
+      // filename rotation
+      if (dot == std::string::npos) {
+        name += ".1";
+      } else {
+        std::string number = name.substr(dot + 1);
+        if (!isdigit(number[0])) {
+          name += ".1";
+        } else {
+          size_t i;
+          if (!android::base::ParseUint(number, &i)) {
+            LOG(ERROR) << "failed to parse uint in " << number;
+            return -1;
+          }
+          name = sub + "." + std::to_string(i + 1);
+        }
+      }
+    }
   }
 
-  // filename rotation
-  if (dot == std::string::npos) {
-    name += ".1";
+  if (!pmsg_rotation.empty() && pmsg_rotation.back().id == id &&
+      pmsg_rotation.back().prio == prio && pmsg_rotation.back().name == name) {
+    pmsg_rotation.back().content.append(buf, len);
   } else {
-    std::string number = name.substr(dot + 1);
-    if (!isdigit(number[0])) {
-      name += ".1";
-    } else {
-      size_t i;
-      if (!android::base::ParseUint(number, &i)) {
-        LOG(ERROR) << "failed to parse uint in " << number;
-        return -1;
+    pmsg_rotation.push_back({ id, prio, name, std::string(buf, len) });
+  }
+  return len;
+}
+
+ssize_t flush_pmsg_rotation() {
+  auto deadline = std::chrono::steady_clock::now() + kPmsgFlushTimeCap;
+  size_t written = 0;
+  ssize_t result = 0;
+
+  for (const auto& entry : pmsg_rotation) {
+    if (written >= kPmsgFlushByteBudget || std::chrono::steady_clock::now() >= deadline) {
+      LOG(WARNING) << "pmsg refresh budget exhausted after " << written << " bytes; dropping "
+                   << entry.name << " and later history";
+      break;
+    }
+    size_t to_write = std::min(entry.content.size(), kPmsgFlushByteBudget - written);
+    ssize_t rc =
+        __android_log_pmsg_file_write(entry.id, entry.prio, entry.name.c_str(),
+                                      entry.content.data(), to_write);
+    if (rc < 0) {
+      if (result == 0) {
+        result = rc;
       }
-      name = sub + "." + std::to_string(i + 1);
+    } else {
+      written += to_write;
     }
   }
 
-  return __android_log_pmsg_file_write(id, prio, name.c_str(), buf, len);
+  pmsg_rotation.clear();
+  return result;
+}
+
+// Replaces the plain-text log at |path| with a zstd-compressed |path|.zst. The original is only
+// unlinked once the compressed copy has been written, so a failure at any step just leaves the
+// generation uncompressed. No-op if |path| is gone or a compressed copy already exists.
+static void compress_old_log(const std::string& path) {
+  std::string compressed_path = path + ".zst";
+  if (access(path.c_str(), R_OK) != 0 || access(compressed_path.c_str(), F_OK) == 0) {
+    return;
+  }
+
+  std::string content;
+  if (!android::base::ReadFileToString(path, &content)) {
+    PLOG(WARNING) << "Failed to read " << path << " for compression";
+    return;
+  }
+
+  std::string compressed(ZSTD_compressBound(content.size()), '\0');
+  size_t compressed_size = ZSTD_compress(compressed.data(), compressed.size(), content.data(),
+                                         content.size(), ZSTD_CLEVEL_DEFAULT);
+  if (ZSTD_isError(compressed_size)) {
+    LOG(WARNING) << "Failed to compress " << path << ": " << ZSTD_getErrorName(compressed_size);
+    return;
+  }
+  compressed.resize(compressed_size);
+
+  if (!android::base::WriteStringToFile(compressed, compressed_path)) {
+    PLOG(WARNING) << "Failed to write " << compressed_path;
+    unlink(compressed_path.c_str());
+    return;
+  }
+  unlink(path.c_str());
 }
 
 // Rename last_log -> last_log.1 -> last_log.2 -> ... -> last_log.$max.
@@ -156,9 +244,42 @@ void rotate_logs(const char* last_log_file, const char* last_kmsg_file) {
     }
     std::string new_kmsg = android::base::StringPrintf("%s.%d", last_kmsg_file, i + 1);
     rename(old_kmsg.c_str(), new_kmsg.c_str());
+
+    // Shift the generations that an earlier pass already compressed.
+    if (i > 0) {
+      rename((old_log + ".zst").c_str(), (new_log + ".zst").c_str());
+      rename((old_kmsg + ".zst").c_str(), (new_kmsg + ".zst").c_str());
+    }
+  }
+
+  // Compress everything older than the generation the last session left behind. last_log(.1) and
+  // last_kmsg(.1) stay plain text, since recovery-persist and host tooling read those in place;
+  // the older generations are history only and compress ~10x, which both cuts /cache wear and
+  // lets KEEP_LOG_COUNT sessions fit in a fraction of the space. This runs on the
+  // trigger_log_rotation() worker, so the cost stays off the boot path.
+  for (int i = 2; i <= KEEP_LOG_COUNT; ++i) {
+    compress_old_log(android::base::StringPrintf("%s.%d", last_log_file, i));
+    compress_old_log(android::base::StringPrintf("%s.%d", last_kmsg_file, i));
   }
 }
 
+// Deferred rotation worker, guarded by |log_rotation_mutex| since copy_logs() may run on a wipe
+// worker thread (via RestoreLogFilesAfterFormat).
+static std::mutex log_rotation_mutex;
+static std::future<void> log_rotation;
+
+void trigger_log_rotation() {
+  std::lock_guard<std::mutex> lock(log_rotation_mutex);
+  if (log_rotation.valid()) {
+    return;
+  }
+  log_rotation = std::async(std::launch::async, [] {
+    ensure_path_mounted(LAST_LOG_FILE);
+    ensure_path_mounted(LAST_KMSG_FILE);
+    rotate_logs(LAST_LOG_FILE, LAST_KMSG_FILE);
+  });
+}
+
 // Writes content to the current pmsg session.
 static ssize_t __pmsg_write(const std::string& filename, const std::string& buf) {
   return __android_log_pmsg_file_write(LOG_ID_SYSTEM, ANDROID_LOG_INFO, filename.c_str(),
@@ -214,19 +335,39 @@ void copy_logs(bool save_current_log) {
   copy_log_file_to_pmsg(Paths::Get().temporary_log_file(), LAST_LOG_FILE);
   copy_log_file_to_pmsg(Paths::Get().temporary_install_file(), LAST_INSTALL_FILE);
 
+  // The session's structured metrics travel with the logs: the pmsg copy is what recovery-persist
+  // recovers on cacheless devices, the /cache copy below is what it forwards on devices with one.
+  std::string metrics = RecoveryMetrics::Get().Serialize();
+  if (!metrics.empty()) {
+    __pmsg_write(LAST_METRICS_FILE, metrics);
+  }
+
   // We can do nothing for now if there's no /cache partition.
   if (!HasCache()) {
     return;
   }
 
-  ensure_path_mounted(LAST_LOG_FILE);
-  ensure_path_mounted(LAST_KMSG_FILE);
-  rotate_logs(LAST_LOG_FILE, LAST_KMSG_FILE);
+  // Rotation normally starts in the background as soon as the session performs a loggable action;
+  // trigger it now in case it hasn't, then wait for the worker so the last_log/last_kmsg slots are
+  // free before we copy into them. The wait is a no-op once the worker has finished.
+  trigger_log_rotation();
+  {
+    std::lock_guard<std::mutex> lock(log_rotation_mutex);
+    log_rotation.wait();
+  }
 
   // Copy logs to cache so the system can find out what happened.
   copy_log_file(Paths::Get().temporary_log_file(), LOG_FILE, true);
   copy_log_file(Paths::Get().temporary_log_file(), LAST_LOG_FILE, false);
   copy_log_file(Paths::Get().temporary_install_file(), LAST_INSTALL_FILE, false);
+  if (!metrics.empty()) {
+    if (FILE* metrics_fp = fopen_path(LAST_METRICS_FILE, "we", logging_sehandle)) {
+      fwrite(metrics.data(), 1, metrics.size(), metrics_fp);
+      check_and_fclose(metrics_fp, LAST_METRICS_FILE);
+    } else {
+      PLOG(ERROR) << "Can't open " << LAST_METRICS_FILE;
+    }
+  }
   save_kernel_log(LAST_KMSG_FILE);
   chmod(LOG_FILE, 0600);
   chown(LOG_FILE, AID_SYSTEM, AID_SYSTEM);
@@ -235,6 +376,8 @@ void copy_logs(bool save_current_log) {
   chmod(LAST_LOG_FILE, 0640);
   chmod(LAST_INSTALL_FILE, 0644);
   chown(LAST_INSTALL_FILE, AID_SYSTEM, AID_SYSTEM);
+  chmod(LAST_METRICS_FILE, 0644);
+  chown(LAST_METRICS_FILE, AID_SYSTEM, AID_SYSTEM);
   sync();
 }
 
@@ -0,0 +1,243 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "recovery_utils/metrics.h"
+
+#include <algorithm>
+
+#include <android-base/logging.h>
+
+// Serialized layout, all integers little-endian so the blob parses the same on any host:
+//
+//   u32 magic "RMET"
+//   u8  version (currently 1)
+//   u32 record count
+//
+// followed by that many records, each:
+//
+//   u8 type, u8 name length, name bytes
+//   counter:   i64 value
+//   timer:     i64 total nanoseconds, i64 sample count
+//   histogram: i64 count, i64 sum, i64 min, i64 max,
+//              u8 bucket count, then (u8 bucket index, i64 count) per non-empty bucket
+//
+// New fields must bump the version; Parse() rejects versions it doesn't know rather than guessing
+// at field boundaries.
+
+static constexpr uint32_t kMetricsMagic = 0x54454d52;  // "RMET"
+static constexpr uint8_t kMetricsVersion = 1;
+
+static void AppendU8(std::string* out, uint8_t value) {
+  out->push_back(static_cast<char>(value));
+}
+
+static void AppendU32(std::string* out, uint32_t value) {
+  for (int i = 0; i < 4; i++) {
+    out->push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+  }
+}
+
+static void AppendI64(std::string* out, int64_t value) {
+  auto bits = static_cast<uint64_t>(value);
+  for (int i = 0; i < 8; i++) {
+    out->push_back(static_cast<char>((bits >> (8 * i)) & 0xff));
+  }
+}
+
+static bool ReadU8(const std::string& data, size_t* pos, uint8_t* value) {
+  if (*pos + 1 > data.size()) return false;
+  *value = static_cast<uint8_t>(data[(*pos)++]);
+  return true;
+}
+
+static bool ReadU32(const std::string& data, size_t* pos, uint32_t* value) {
+  if (*pos + 4 > data.size()) return false;
+  *value = 0;
+  for (int i = 0; i < 4; i++) {
+    *value |= static_cast<uint32_t>(static_cast<uint8_t>(data[(*pos)++])) << (8 * i);
+  }
+  return true;
+}
+
+static bool ReadI64(const std::string& data, size_t* pos, int64_t* value) {
+  if (*pos + 8 > data.size()) return false;
+  uint64_t bits = 0;
+  for (int i = 0; i < 8; i++) {
+    bits |= static_cast<uint64_t>(static_cast<uint8_t>(data[(*pos)++])) << (8 * i);
+  }
+  *value = static_cast<int64_t>(bits);
+  return true;
+}
+
+RecoveryMetrics& RecoveryMetrics::Get() {
+  static RecoveryMetrics metrics;
+  return metrics;
+}
+
+MetricRecord* RecoveryMetrics::FindOrCreateLocked(const std::string& name, MetricType type) {
+  auto [it, inserted] = records_.try_emplace(name);
+  if (inserted) {
+    it->second.type = type;
+    it->second.name = name;
+  } else if (it->second.type != type) {
+    LOG(ERROR) << "Metric \"" << name << "\" recorded with conflicting types; dropping sample";
+    return nullptr;
+  }
+  return &it->second;
+}
+
+void RecoveryMetrics::IncrementCounter(const std::string& name, int64_t delta) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (MetricRecord* record = FindOrCreateLocked(name, MetricType::kCounter)) {
+    record->value += delta;
+  }
+}
+
+void RecoveryMetrics::RecordDuration(const std::string& name, std::chrono::nanoseconds elapsed) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (MetricRecord* record = FindOrCreateLocked(name, MetricType::kTimer)) {
+    record->value += elapsed.count();
+    record->count++;
+  }
+}
+
+void RecoveryMetrics::RecordValue(const std::string& name, int64_t value) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  MetricRecord* record = FindOrCreateLocked(name, MetricType::kHistogram);
+  if (record == nullptr) {
+    return;
+  }
+  if (record->count == 0) {
+    record->min = record->max = value;
+  } else {
+    record->min = std::min(record->min, value);
+    record->max = std::max(record->max, value);
+  }
+  record->count++;
+  record->sum += value;
+  uint8_t bucket = value > 0 ? static_cast<uint8_t>(63 - __builtin_clzll(value)) : 0;
+  record->buckets[bucket]++;
+}
+
+std::string RecoveryMetrics::Serialize() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (records_.empty()) {
+    return "";
+  }
+
+  std::string out;
+  AppendU32(&out, kMetricsMagic);
+  AppendU8(&out, kMetricsVersion);
+  AppendU32(&out, static_cast<uint32_t>(records_.size()));
+  for (const auto& [name, record] : records_) {
+    AppendU8(&out, static_cast<uint8_t>(record.type));
+    // Names longer than a byte's worth would only bloat the blob; truncation is fine for a
+    // diagnostics channel and keeps the length field fixed size.
+    size_t name_length = std::min<size_t>(name.size(), 255);
+    AppendU8(&out, static_cast<uint8_t>(name_length));
+    out.append(name, 0, name_length);
+    switch (record.type) {
+      case MetricType::kCounter:
+        AppendI64(&out, record.value);
+        break;
+      case MetricType::kTimer:
+        AppendI64(&out, record.value);
+        AppendI64(&out, record.count);
+        break;
+      case MetricType::kHistogram:
+        AppendI64(&out, record.count);
+        AppendI64(&out, record.sum);
+        AppendI64(&out, record.min);
+        AppendI64(&out, record.max);
+        AppendU8(&out, static_cast<uint8_t>(record.buckets.size()));
+        for (const auto& [bucket, count] : record.buckets) {
+          AppendU8(&out, bucket);
+          AppendI64(&out, count);
+        }
+        break;
+    }
+  }
+  return out;
+}
+
+bool RecoveryMetrics::Parse(const std::string& data, std::vector<MetricRecord>* records) {
+  size_t pos = 0;
+  while (pos < data.size()) {
+    uint32_t magic;
+    uint8_t version;
+    uint32_t record_count;
+    if (!ReadU32(data, &pos, &magic) || magic != kMetricsMagic ||
+        !ReadU8(data, &pos, &version) || version != kMetricsVersion ||
+        !ReadU32(data, &pos, &record_count)) {
+      return false;
+    }
+
+    for (uint32_t i = 0; i < record_count; i++) {
+      MetricRecord record;
+      uint8_t type;
+      uint8_t name_length;
+      if (!ReadU8(data, &pos, &type) || !ReadU8(data, &pos, &name_length) ||
+          pos + name_length > data.size()) {
+        return false;
+      }
+      record.name = data.substr(pos, name_length);
+      pos += name_length;
+
+      switch (static_cast<MetricType>(type)) {
+        case MetricType::kCounter:
+          record.type = MetricType::kCounter;
+          if (!ReadI64(data, &pos, &record.value)) return false;
+          break;
+        case MetricType::kTimer:
+          record.type = MetricType::kTimer;
+          if (!ReadI64(data, &pos, &record.value) || !ReadI64(data, &pos, &record.count)) {
+            return false;
+          }
+          break;
+        case MetricType::kHistogram: {
+          record.type = MetricType::kHistogram;
+          uint8_t bucket_count;
+          if (!ReadI64(data, &pos, &record.count) || !ReadI64(data, &pos, &record.sum) ||
+              !ReadI64(data, &pos, &record.min) || !ReadI64(data, &pos, &record.max) ||
+              !ReadU8(data, &pos, &bucket_count)) {
+            return false;
+          }
+          for (uint8_t b = 0; b < bucket_count; b++) {
+            uint8_t bucket;
+            int64_t count;
+            if (!ReadU8(data, &pos, &bucket) || !ReadI64(data, &pos, &count)) return false;
+            record.buckets[bucket] = count;
+          }
+          break;
+        }
+        default:
+          return false;
+      }
+      records->push_back(std::move(record));
+    }
+  }
+  return true;
+}
+
+ScopedMetricTimer::ScopedMetricTimer(std::string name)
+    : name_(std::move(name)), start_(std::chrono::steady_clock::now()) {}
+
+ScopedMetricTimer::~ScopedMetricTimer() {
+  RecoveryMetrics::Get().RecordDuration(
+      name_,
+      std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() -
+                                                           start_));
+}
@@ -17,22 +17,32 @@
 #include "recovery_utils/roots.h"
 
 #include <fcntl.h>
+#include <linux/fs.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/ioctl.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <unistd.h>
 #include <sys/mount.h>
 
+#include <algorithm>
+#include <functional>
 #include <iostream>
+#include <mutex>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
+#include <android-base/file.h>
 #include <android-base/logging.h>
+#include <android-base/parseint.h>
 #include <android-base/properties.h>
 #include <android-base/stringprintf.h>
+#include <android-base/strings.h>
 #include <android-base/unique_fd.h>
 #include <blkid/blkid.h>
 #include <ext4_utils/ext4_utils.h>
@@ -42,6 +52,7 @@
 #include <fs_mgr_dm_linear.h>
 
 #include "otautil/sysutil.h"
+#include "recovery_utils/metrics.h"
 
 using android::fs_mgr::Fstab;
 using android::fs_mgr::FstabEntry;
@@ -61,6 +72,19 @@ static void write_fstab_entry(const FstabEntry& entry, FILE* file) {
 
 static Fstab fstab;
 
+// Maps each mount point to its first fstab entry (matching GetEntryForMountPoint(), which also
+// returns the first). The fstab doesn't change after load_volume_table(), so the stored indices
+// stay valid; rebuilding on load keeps them honest.
+static std::unordered_map<std::string, size_t> mount_point_index;
+
+// Mount points this process mounted (or found mounted) through the helpers below.
+// EnsurePathMounted() re-reads /proc/mounts on every call, and flows re-check /cache many times
+// over (logging, install, wipe), so a hit here skips that parse. The cache is only truthful
+// while every mount and umount goes through this API; the one direct umount() caller
+// (the "Mount /system" menu toggle) invalidates via forget_mount_state().
+static std::unordered_set<std::string> mounted_points;
+static std::mutex mounted_points_mutex;
+
 constexpr const char* CACHE_ROOT = "/cache";
 
 FstabEntry* fstab_entry_for_mount_point_detect_fs(const std::string& path) {
@@ -95,6 +119,15 @@ void load_volume_table() {
       .length = 0,
   });
 
+  mount_point_index.clear();
+  for (size_t i = 0; i < fstab.size(); ++i) {
+    mount_point_index.emplace(fstab[i].mount_point, i);
+  }
+  {
+    std::lock_guard<std::mutex> lg(mounted_points_mutex);
+    mounted_points.clear();
+  }
+
   Fstab fake_fstab;
   std::cout << "recovery filesystem table" << std::endl << "=========================" << std::endl;
   for (size_t i = 0; i < fstab.size(); ++i) {
@@ -127,23 +160,80 @@ void load_volume_table() {
 }
 
 Volume* volume_for_mount_point(const std::string& mount_point) {
-  return android::fs_mgr::GetEntryForMountPoint(&fstab, mount_point);
+  auto it = mount_point_index.find(mount_point);
+  return it != mount_point_index.end() ? &fstab[it->second] : nullptr;
+}
+
+// Resolves a path to its volume by longest mount-point prefix, through the hash index: try the
+// whole path, then keep stripping the last component. Costs one lookup per path component
+// instead of a substring scan of the whole fstab.
+static FstabEntry* volume_for_path(const std::string& path) {
+  if (path.empty() || path[0] != '/') {
+    return nullptr;
+  }
+  std::string prefix = path;
+  while (true) {
+    auto it = mount_point_index.find(prefix);
+    if (it != mount_point_index.end()) {
+      return &fstab[it->second];
+    }
+    if (prefix == "/") {
+      return nullptr;
+    }
+    size_t slash = prefix.find_last_of('/');
+    prefix = (slash == 0) ? "/" : prefix.substr(0, slash);
+  }
 }
 
 // Mount the volume specified by path at the given mount_point.
 int ensure_path_mounted_at(const std::string& path, const std::string& mount_point) {
-  return android::fs_mgr::EnsurePathMounted(&fstab, path, mount_point) ? 0 : -1;
+  {
+    std::lock_guard<std::mutex> lg(mounted_points_mutex);
+    if (mounted_points.count(mount_point)) {
+      return 0;
+    }
+  }
+  if (!android::fs_mgr::EnsurePathMounted(&fstab, path, mount_point)) {
+    return -1;
+  }
+  std::lock_guard<std::mutex> lg(mounted_points_mutex);
+  mounted_points.insert(mount_point);
+  return 0;
 }
 
 int ensure_path_mounted(const std::string& path) {
   // Mount at the default mount point.
-  return android::fs_mgr::EnsurePathMounted(&fstab, path) ? 0 : -1;
+  FstabEntry* v = volume_for_path(path);
+  if (v != nullptr) {
+    std::lock_guard<std::mutex> lg(mounted_points_mutex);
+    if (mounted_points.count(v->mount_point)) {
+      return 0;
+    }
+  }
+  if (!android::fs_mgr::EnsurePathMounted(&fstab, path)) {
+    return -1;
+  }
+  if (v != nullptr) {
+    std::lock_guard<std::mutex> lg(mounted_points_mutex);
+    mounted_points.insert(v->mount_point);
+  }
+  return 0;
 }
 
 int ensure_path_unmounted(const std::string& path) {
+  // Drop the cache entry up front: even a failed unmount attempt leaves the state uncertain,
+  // and a spurious miss only costs one /proc/mounts parse.
+  if (FstabEntry* v = volume_for_path(path)) {
+    forget_mount_state(v->mount_point);
+  }
   return android::fs_mgr::EnsurePathUnmounted(&fstab, path) ? 0 : -1;
 }
 
+void forget_mount_state(const std::string& mount_point) {
+  std::lock_guard<std::mutex> lg(mounted_points_mutex);
+  mounted_points.erase(mount_point);
+}
+
 int ensure_volume_unmounted(const std::string& blk_device) {
   android::fs_mgr::Fstab mounted_fstab;
   if (!android::fs_mgr::ReadFstabFromFile("/proc/mounts", &mounted_fstab)) {
@@ -154,6 +244,7 @@ int ensure_volume_unmounted(const std::string& blk_device) {
   /* find any entries with the volume */
   for (auto& entry : mounted_fstab) {
     if (entry.blk_device == blk_device) {
+      forget_mount_state(entry.mount_point);
       int result = umount(entry.mount_point.c_str());
       if (result == -1) {
         LOG(ERROR) << "Failed to unmount " << blk_device << " from " << entry.mount_point << ": "
@@ -165,7 +256,12 @@ int ensure_volume_unmounted(const std::string& blk_device) {
   return 0;
 }
 
-static int exec_cmd(const std::vector<std::string>& args) {
+// Runs the command and waits for it. When |progress| is set, the child's cumulative write volume
+// is sampled from /proc/<pid>/io a few times a second and reported through the callback while it
+// runs. The mkfs tools don't emit machine-readable progress when their output isn't a tty, but
+// how much they have written is a faithful proxy for how far along they are.
+static int exec_cmd(const std::vector<std::string>& args,
+                    const std::function<void(int64_t)>& progress = nullptr) {
   CHECK(!args.empty());
   auto argv = StringVectorToNullTerminatedArray(args);
 
@@ -176,13 +272,56 @@ static int exec_cmd(const std::vector<std::string>& args) {
   }
 
   int status;
-  waitpid(child, &status, 0);
+  if (progress) {
+    std::string io_path = android::base::StringPrintf("/proc/%d/io", child);
+    pid_t waited;
+    while ((waited = waitpid(child, &status, WNOHANG)) == 0) {
+      std::string io;
+      if (android::base::ReadFileToString(io_path, &io)) {
+        for (const auto& line : android::base::Split(io, "\n")) {
+          int64_t written;
+          if (android::base::StartsWith(line, "write_bytes: ") &&
+              android::base::ParseInt(line.substr(strlen("write_bytes: ")), &written)) {
+            progress(written);
+            break;
+          }
+        }
+      }
+      usleep(200 * 1000);
+    }
+    if (waited == -1) {
+      PLOG(ERROR) << "waitpid for " << args[0] << " failed";
+      return -1;
+    }
+  } else {
+    waitpid(child, &status, 0);
+  }
   if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
     LOG(ERROR) << args[0] << " failed with status " << WEXITSTATUS(status);
   }
   return WEXITSTATUS(status);
 }
 
+// Discards the whole device instead of overwriting it from userspace. On flash-backed storage a
+// full-range discard completes in seconds where the overwrite takes minutes; BLKSECDISCARD is
+// preferred since it guarantees the erase reaches the medium, with BLKDISCARD as the next best.
+// Returns false if the device supports neither, in which case the caller falls back to writing.
+static bool discard_block_device(int fd, int64_t size) {
+  uint64_t range[2] = { 0, static_cast<uint64_t>(size) };
+  if (ioctl(fd, BLKSECDISCARD, &range) == 0) {
+    LOG(INFO) << "discard_block_device: secure-discarded " << size << " bytes";
+    return true;
+  }
+  range[0] = 0;
+  range[1] = static_cast<uint64_t>(size);
+  if (ioctl(fd, BLKDISCARD, &range) == 0) {
+    LOG(INFO) << "discard_block_device: discarded " << size << " bytes";
+    return true;
+  }
+  PLOG(WARNING) << "discard_block_device: discard not supported, falling back to overwrite";
+  return false;
+}
+
 static int64_t get_file_size(int fd, uint64_t reserve_len) {
   struct stat buf;
   int ret = fstat(fd, &buf);
@@ -207,7 +346,7 @@ static int64_t get_file_size(int fd, uint64_t reserve_len) {
 }
 
 int format_volume(const std::string& volume, const std::string& directory,
-                  std::string_view new_fstype) {
+                  std::string_view new_fstype, const FormatProgressCallback& progress) {
   const FstabEntry* v = android::fs_mgr::GetEntryForPath(&fstab, volume);
   if (v == nullptr) {
     LOG(ERROR) << "unknown volume \"" << volume << "\"";
@@ -230,6 +369,11 @@ int format_volume(const std::string& volume, const std::string& directory,
     return -1;
   }
 
+  // Past the argument checks this always touches the block device, so every exit from here on
+  // counts as a format attempt. Wipes format several volumes back to back; the timer accumulates
+  // across them.
+  ScopedMetricTimer format_timer("format_volume");
+
   bool needs_casefold = false;
 
   if (volume == "/data") {
@@ -266,13 +410,40 @@ int format_volume(const std::string& volume, const std::string& directory,
       return -1;
     }
     int64_t device_size = get_file_size(fd.get(), 0);
-    if (device_size > 0 && !wipe_block_device(fd.get(), device_size)) {
+    if (device_size > 0 &&
+        (discard_block_device(fd.get(), device_size) || !wipe_block_device(fd.get(), device_size))) {
       LOG(INFO) << "format_volume: wipe metadata encrypted " << v->blk_device << " with size "
                 << device_size;
       return 0;
     }
   }
 
+  int64_t device_size = length;
+  if (device_size == 0) {
+    android::base::unique_fd fd(open(v->blk_device.c_str(), O_RDONLY));
+    if (fd != -1) {
+      device_size = get_file_size(fd.get(), 0);
+    }
+  }
+
+  // Converts a tool's write position (sampled by exec_cmd) into an overall fraction. With discard
+  // and lazy initialization mkfs writes only metadata -- bitmaps, checkpoints, the non-deferred
+  // inode table blocks -- which lands around 1/64 of the device, so that is the expected write
+  // volume. The populate tools write the directory contents, whose size isn't known here, so they
+  // only advance the bar to their base fraction.
+  auto phase_progress = [&](const char* phase, float base,
+                            float span) -> std::function<void(int64_t)> {
+    if (!progress) {
+      return nullptr;
+    }
+    progress(phase, base);
+    int64_t expected = std::max<int64_t>(device_size / 64, 16 * 1024 * 1024);
+    return [&progress, phase = std::string(phase), base, span, expected](int64_t written) {
+      progress(phase, base + span * std::min(1.0f, static_cast<float>(written) / expected));
+    };
+  };
+  const float mkfs_span = directory.empty() ? 1.0f : 0.8f;
+
   if ((v->fs_type == "ext4" && new_fstype.empty()) || new_fstype == "ext4") {
     LOG(INFO) << "Formatting " << v->blk_device << " as ext4";
     static constexpr int kBlockSize = 4096;
@@ -300,22 +471,28 @@ int format_volume(const std::string& volume, const std::string& directory,
     if (v->logical_blk_size != 0 && v->logical_blk_size < 8192) {
       raid_stride = 8192 / kBlockSize;
     }
+    // mke2fs only keeps the last -E it sees, so all extended options go into one argument.
+    // Discard is requested explicitly, and inode table and journal initialization are deferred
+    // to the kernel's lazy-init thread: on flash parts whose discard doesn't report zeroed data,
+    // mke2fs would otherwise write out every inode table block up front.
+    std::string ext_opts = "discard,lazy_itable_init=1,lazy_journal_init=1";
     if (v->erase_blk_size != 0 && v->logical_blk_size != 0) {
-      mke2fs_args.push_back("-E");
-      mke2fs_args.push_back(
-          android::base::StringPrintf("stride=%d,stripe-width=%d", raid_stride, raid_stripe_width));
+      ext_opts += android::base::StringPrintf(",stride=%d,stripe-width=%d", raid_stride,
+                                              raid_stripe_width);
     }
+    mke2fs_args.push_back("-E");
+    mke2fs_args.push_back(ext_opts);
     mke2fs_args.push_back(v->blk_device);
     if (length != 0) {
       mke2fs_args.push_back(std::to_string(length / kBlockSize));
     }
 
-    int result = exec_cmd(mke2fs_args);
+    int result = exec_cmd(mke2fs_args, phase_progress("mke2fs", 0.0f, mkfs_span));
     if (result == 0 && !directory.empty()) {
       std::vector<std::string> e2fsdroid_args = {
         "/system/bin/e2fsdroid", "-e", "-f", directory, "-a", volume, v->blk_device,
       };
-      result = exec_cmd(e2fsdroid_args);
+      result = exec_cmd(e2fsdroid_args, phase_progress("e2fsdroid", mkfs_span, 1.0f - mkfs_span));
     }
 
     if (result != 0) {
@@ -354,7 +531,7 @@ int format_volume(const std::string& volume, const std::string& directory,
     make_f2fs_cmd.push_back(std::to_string(length / kSectorSize));
   }
 
-  if (exec_cmd(make_f2fs_cmd) != 0) {
+  if (exec_cmd(make_f2fs_cmd, phase_progress("make_f2fs", 0.0f, mkfs_span)) != 0) {
     PLOG(ERROR) << "format_volume: Failed to make_f2fs on " << v->blk_device;
     return -1;
   }
@@ -362,7 +539,7 @@ int format_volume(const std::string& volume, const std::string& directory,
     std::vector<std::string> sload_f2fs_cmd = {
       "/system/bin/sload_f2fs", "-f", directory, "-t", volume, v->blk_device,
     };
-    if (exec_cmd(sload_f2fs_cmd) != 0) {
+    if (exec_cmd(sload_f2fs_cmd, phase_progress("sload_f2fs", mkfs_span, 1.0f - mkfs_span)) != 0) {
       PLOG(ERROR) << "format_volume: Failed to sload_f2fs on " << v->blk_device;
       return -1;
     }
@@ -0,0 +1,265 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Throughput benchmarks for the applypatch and block-update hot paths, so bspatch / image patch /
+// hashing / block I/O regressions show up per release instead of in the field. Fixtures are a few
+// MiB of pseudo-random data — large enough to report a stable MB/s, small enough to run on a
+// device in seconds; absolute OTA sizes only scale the same per-byte costs measured here.
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/unique_fd.h>
+#include <benchmark/benchmark.h>
+#include <bsdiff/bsdiff.h>
+#include <openssl/sha.h>
+#include <ziparchive/zip_archive.h>
+#include <ziparchive/zip_writer.h>
+
+#include "applypatch/applypatch.h"
+#include "applypatch/imgpatch.h"
+#include "edify/expr.h"
+#include "otautil/rangeset.h"
+
+static constexpr size_t kFixtureSize = 4 * 1024 * 1024;
+static constexpr size_t kBlockSize = 4096;
+
+static std::vector<uint8_t> MakeRandomData(size_t size, uint32_t seed) {
+  std::vector<uint8_t> data(size);
+  std::minstd_rand rng(seed);
+  for (auto& byte : data) {
+    byte = static_cast<uint8_t>(rng());
+  }
+  return data;
+}
+
+// Returns a target derived from |source| with a sprinkling of edits, so the bsdiff patch has a
+// realistic mix of copy and diff entries rather than degenerating to a pure copy.
+static std::vector<uint8_t> MakeEditedCopy(const std::vector<uint8_t>& source) {
+  std::vector<uint8_t> target(source);
+  std::minstd_rand rng(0x5ca1ab1e);
+  for (size_t offset = 0; offset + 256 <= target.size(); offset += 64 * 1024) {
+    for (size_t i = 0; i < 256; i++) {
+      target[offset + i] = static_cast<uint8_t>(rng());
+    }
+  }
+  return target;
+}
+
+static Value MakeBSDiffPatch(const std::vector<uint8_t>& source,
+                             const std::vector<uint8_t>& target) {
+  TemporaryFile patch_file;
+  CHECK_EQ(0, bsdiff::bsdiff(source.data(), source.size(), target.data(), target.size(),
+                             patch_file.path, nullptr));
+  std::string patch_data;
+  CHECK(android::base::ReadFileToString(patch_file.path, &patch_data));
+  return Value(Value::Type::BLOB, std::move(patch_data));
+}
+
+static void BM_ApplyBSDiffPatch(benchmark::State& state) {
+  std::vector<uint8_t> source = MakeRandomData(kFixtureSize, 0xdeadbeef);
+  std::vector<uint8_t> target = MakeEditedCopy(source);
+  Value patch = MakeBSDiffPatch(source, target);
+
+  for (auto _ : state) {
+    size_t sunk = 0;
+    auto sink = [&sunk](const unsigned char* data, size_t len) {
+      benchmark::DoNotOptimize(data);
+      sunk += len;
+      return len;
+    };
+    CHECK_EQ(0, ApplyBSDiffPatch(source.data(), source.size(), patch, 0, sink));
+    CHECK_EQ(target.size(), sunk);
+  }
+  state.SetBytesProcessed(state.iterations() * target.size());
+}
+BENCHMARK(BM_ApplyBSDiffPatch);
+
+static void BM_ApplyImagePatch(benchmark::State& state) {
+  // A single-chunk raw image patch; this exercises the patch parsing and sink path without the
+  // bsdiff cost measured separately above.
+  std::vector<uint8_t> target = MakeRandomData(kFixtureSize, 0xfeedface);
+  std::string patch_data("IMGDIFF2", 8);
+  auto append_le32 = [&patch_data](uint32_t value) {
+    patch_data.append(reinterpret_cast<const char*>(&value), sizeof(value));
+  };
+  append_le32(1);  // num_chunks
+  append_le32(3);  // CHUNK_RAW
+  append_le32(target.size());
+  patch_data.append(reinterpret_cast<const char*>(target.data()), target.size());
+  Value patch(Value::Type::BLOB, std::move(patch_data));
+
+  std::vector<uint8_t> source = MakeRandomData(kFixtureSize, 0xdeadbeef);
+  for (auto _ : state) {
+    size_t sunk = 0;
+    auto sink = [&sunk](const unsigned char* data, size_t len) {
+      benchmark::DoNotOptimize(data);
+      sunk += len;
+      return len;
+    };
+    CHECK_EQ(0, ApplyImagePatch(source.data(), source.size(), patch, sink, nullptr));
+    CHECK_EQ(target.size(), sunk);
+  }
+  state.SetBytesProcessed(state.iterations() * target.size());
+}
+BENCHMARK(BM_ApplyImagePatch);
+
+// The hash side of VerifyBlocks: one SHA-1 pass over a buffer of blocks.
+static void BM_Sha1Blocks(benchmark::State& state) {
+  std::vector<uint8_t> buffer = MakeRandomData(kFixtureSize, 0xcafef00d);
+  for (auto _ : state) {
+    uint8_t digest[SHA_DIGEST_LENGTH];
+    SHA1(buffer.data(), buffer.size(), digest);
+    benchmark::DoNotOptimize(digest);
+  }
+  state.SetBytesProcessed(state.iterations() * buffer.size());
+}
+BENCHMARK(BM_Sha1Blocks);
+
+// Positioned block-sized I/O against a temporary file, the pattern ReadBlocks/WriteBlocks issue
+// against the block device. Running against a file keeps the benchmark hermetic; attach a loop
+// device to the same path to measure real media.
+static void BM_BlockReadWrite(benchmark::State& state) {
+  TemporaryFile temp_file;
+  android::base::unique_fd fd(open(temp_file.path, O_RDWR));
+  CHECK_NE(-1, fd.get());
+  std::vector<uint8_t> buffer = MakeRandomData(kFixtureSize, 0x8badf00d);
+
+  for (auto _ : state) {
+    for (size_t offset = 0; offset < buffer.size(); offset += kBlockSize) {
+      CHECK(android::base::WriteFullyAtOffset(fd, buffer.data() + offset, kBlockSize, offset));
+    }
+    for (size_t offset = 0; offset < buffer.size(); offset += kBlockSize) {
+      CHECK(android::base::ReadFullyAtOffset(fd, buffer.data() + offset, kBlockSize, offset));
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * buffer.size() * 2);
+}
+BENCHMARK(BM_BlockReadWrite);
+
+// Builds a single-entry zip holding |payload| and returns the raw archive bytes. |flags| selects
+// stored vs. deflated, which is the knob the extraction benchmarks below turn.
+static std::string MakeZipArchive(const std::vector<uint8_t>& payload, int flags) {
+  TemporaryFile zip_file;
+  FILE* file_ptr = fdopen(zip_file.release(), "wb");
+  ZipWriter writer(file_ptr);
+  CHECK_EQ(0, writer.StartEntry("payload.bin", flags));
+  CHECK_EQ(0, writer.WriteBytes(payload.data(), payload.size()));
+  CHECK_EQ(0, writer.FinishEntry());
+  CHECK_EQ(0, writer.Finish());
+  CHECK_EQ(0, fclose(file_ptr));
+
+  std::string archive;
+  CHECK(android::base::ReadFileToString(zip_file.path, &archive));
+  return archive;
+}
+
+static void ZipExtractEntry(benchmark::State& state, int flags) {
+  std::vector<uint8_t> payload = MakeRandomData(kFixtureSize, 0x1badb002);
+  std::string archive = MakeZipArchive(payload, flags);
+
+  ZipArchiveHandle handle;
+  CHECK_EQ(0, OpenArchiveFromMemory(archive.data(), archive.size(), "payload.zip", &handle));
+  ZipEntry64 entry;
+  CHECK_EQ(0, FindEntry(handle, "payload.bin", &entry));
+
+  std::vector<uint8_t> extracted(payload.size());
+  for (auto _ : state) {
+    CHECK_EQ(0, ExtractToMemory(handle, &entry, extracted.data(), extracted.size()));
+    benchmark::DoNotOptimize(extracted.data());
+  }
+  state.SetBytesProcessed(state.iterations() * payload.size());
+  CloseArchive(handle);
+}
+
+// Extraction of a stored entry is a copy plus the mandatory CRC-32 check, so this isolates the
+// checksum cost of package extraction from the inflate cost measured below.
+static void BM_ZipExtractStored(benchmark::State& state) {
+  ZipExtractEntry(state, 0);
+}
+BENCHMARK(BM_ZipExtractStored);
+
+static void BM_ZipExtractDeflated(benchmark::State& state) {
+  ZipExtractEntry(state, ZipWriter::kCompress);
+}
+BENCHMARK(BM_ZipExtractDeflated);
+
+static void BM_RangeSetParse(benchmark::State& state) {
+  // A transfer-list-sized range string: 512 disjoint ranges.
+  std::string range_text = "1024";
+  for (size_t i = 0; i < 512; i++) {
+    range_text += "," + std::to_string(i * 10) + "," + std::to_string(i * 10 + 5);
+  }
+  for (auto _ : state) {
+    RangeSet ranges = RangeSet::Parse(range_text);
+    benchmark::DoNotOptimize(ranges);
+  }
+}
+BENCHMARK(BM_RangeSetParse);
+
+// A synthetic updater-script of the size a full OTA ships: a few thousand statements of builtin
+// calls. Used by both the parse and the compiled-cache load benchmarks below.
+static std::string MakeEdifyScript(size_t statements) {
+  std::string script;
+  for (size_t i = 0; i < statements; i++) {
+    script += "assert(concat(\"fixture_\", \"" + std::to_string(i) + "\"));\n";
+  }
+  script += "\"done\"";
+  return script;
+}
+
+static void BM_EdifyParse(benchmark::State& state) {
+  RegisterBuiltins();
+  std::string script = MakeEdifyScript(5000);
+  for (auto _ : state) {
+    std::unique_ptr<Expr> root;
+    int error_count = 0;
+    CHECK_EQ(0, ParseString(script, &root, &error_count));
+    CHECK_EQ(0, error_count);
+    benchmark::DoNotOptimize(root);
+  }
+  state.SetBytesProcessed(state.iterations() * script.size());
+}
+BENCHMARK(BM_EdifyParse);
+
+static void BM_EdifyLoadCompiled(benchmark::State& state) {
+  RegisterBuiltins();
+  std::string script = MakeEdifyScript(5000);
+  std::unique_ptr<Expr> root;
+  int error_count = 0;
+  CHECK_EQ(0, ParseString(script, &root, &error_count));
+  TemporaryFile cache_file;
+  CHECK(SaveCompiledScript(script, root.get(), cache_file.path));
+
+  for (auto _ : state) {
+    std::unique_ptr<Expr> loaded = LoadCompiledScript(script, cache_file.path);
+    CHECK(loaded != nullptr);
+    benchmark::DoNotOptimize(loaded);
+  }
+  state.SetBytesProcessed(state.iterations() * script.size());
+}
+BENCHMARK(BM_EdifyLoadCompiled);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,481 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Device-side throughput measurement for block_image_update(). Each phase drives the updater with
+// a transfer list dominated by one command type (move / bsdiff / new / stash) against a loop
+// device backed by a temporary file, so the numbers include the block-layer path the updater takes
+// on a real device, not just the VFS shortcut a plain file would measure. Wall-clock MB/s and the
+// /proc/self/io storage counters are logged and recorded for every phase.
+//
+// Sustainable MB/s varies by an order of magnitude across devices and storage, so the phases
+// assert a floor only when the lab owning a device model sets RECOVERY_PERF_MIN_MB_PER_S_<PHASE>
+// (MOVE, BSDIFF, NEW, STASH, MIXED). RECOVERY_PERF_IMAGE_MB scales the image; the 64 MiB default
+// keeps a presubmit run short, while the 1-4 GB a full OTA rewrites only scales the same per-byte
+// costs measured here.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/loop.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/parsedouble.h>
+#include <android-base/parseint.h>
+#include <android-base/stringprintf.h>
+#include <android-base/strings.h>
+#include <android-base/unique_fd.h>
+#include <brotli/encode.h>
+#include <bsdiff/bsdiff.h>
+#include <gtest/gtest.h>
+#include <openssl/sha.h>
+#include <ziparchive/zip_writer.h>
+
+#include "edify/expr.h"
+#include "otautil/paths.h"
+#include "otautil/print_sha1.h"
+#include "updater/blockimg.h"
+#include "updater/install.h"
+#include "updater/updater.h"
+#include "updater/updater_runtime.h"
+
+using PackageEntries = std::unordered_map<std::string, std::string>;
+
+static constexpr size_t kBlockSize = 4096;
+
+// Transfer lists shipped by real OTAs break the image into commands of a few MiB; 512 blocks keeps
+// the command count proportional to the image size so per-command overhead is part of the measure.
+static constexpr size_t kChunkBlocks = 512;
+
+static constexpr size_t kDefaultImageMb = 64;
+
+static size_t ImageMb() {
+  size_t image_mb = kDefaultImageMb;
+  if (const char* env = getenv("RECOVERY_PERF_IMAGE_MB"); env != nullptr) {
+    CHECK(android::base::ParseUint(env, &image_mb)) << "Invalid RECOVERY_PERF_IMAGE_MB: " << env;
+  }
+  return image_mb;
+}
+
+static std::string MakeRandomData(size_t size, uint32_t seed) {
+  std::string data(size, '\0');
+  std::minstd_rand rng(seed);
+  for (auto& byte : data) {
+    byte = static_cast<char>(rng());
+  }
+  return data;
+}
+
+// Returns a copy of |source| with a sprinkling of edits, so bsdiff emits a realistic mix of copy
+// and diff entries instead of degenerating to a pure copy.
+static std::string MakeEditedCopy(const std::string& source) {
+  std::string target(source);
+  std::minstd_rand rng(0x5ca1ab1e);
+  for (size_t offset = 0; offset + 256 <= target.size(); offset += 64 * 1024) {
+    for (size_t i = 0; i < 256; i++) {
+      target[offset + i] = static_cast<char>(rng());
+    }
+  }
+  return target;
+}
+
+static std::string GetSha1(std::string_view content) {
+  uint8_t digest[SHA_DIGEST_LENGTH];
+  SHA1(reinterpret_cast<const uint8_t*>(content.data()), content.size(), digest);
+  return print_sha1(digest);
+}
+
+static std::string MakeBsdiffPatch(const std::string& source, const std::string& target) {
+  TemporaryFile patch_file;
+  CHECK_EQ(0, bsdiff::bsdiff(reinterpret_cast<const uint8_t*>(source.data()), source.size(),
+                             reinterpret_cast<const uint8_t*>(target.data()), target.size(),
+                             patch_file.path, nullptr));
+  std::string patch;
+  CHECK(android::base::ReadFileToString(patch_file.path, &patch));
+  return patch;
+}
+
+// Real OTAs ship new data brotli-compressed, so the new-data phase measures decode plus write. The
+// fixture is incompressible random data, which makes the encoder quality irrelevant to the decode
+// cost; the lowest quality just keeps fixture generation fast.
+static std::string BrotliCompress(const std::string& data) {
+  size_t encoded_size = BrotliEncoderMaxCompressedSize(data.size());
+  std::string encoded(encoded_size, '\0');
+  CHECK(BrotliEncoderCompress(1, BROTLI_DEFAULT_WINDOW, BROTLI_DEFAULT_MODE, data.size(),
+                              reinterpret_cast<const uint8_t*>(data.data()), &encoded_size,
+                              reinterpret_cast<uint8_t*>(encoded.data())));
+  encoded.resize(encoded_size);
+  return encoded;
+}
+
+static std::string RangeStr(size_t start, size_t end) {
+  return android::base::StringPrintf("2,%zu,%zu", start, end);
+}
+
+static void BuildUpdatePackage(const PackageEntries& entries, int fd) {
+  FILE* zip_file_ptr = fdopen(fd, "wb");
+  ZipWriter zip_writer(zip_file_ptr);
+
+  for (const auto& entry : entries) {
+    // All the entries are written as STORED.
+    ASSERT_EQ(0, zip_writer.StartEntry(entry.first.c_str(), 0));
+    if (!entry.second.empty()) {
+      ASSERT_EQ(0, zip_writer.WriteBytes(entry.second.data(), entry.second.size()));
+    }
+    ASSERT_EQ(0, zip_writer.FinishEntry());
+  }
+
+  ASSERT_EQ(0, zip_writer.Finish());
+  ASSERT_EQ(0, fclose(zip_file_ptr));
+}
+
+// Reads the storage byte counters this process has accumulated. The loop-device traffic the phases
+// generate is attributed to this process, so the before/after delta is the iostat-style capture
+// for an update run.
+static bool ReadProcessIo(size_t* read_bytes, size_t* write_bytes) {
+  std::string contents;
+  if (!android::base::ReadFileToString("/proc/self/io", &contents)) {
+    return false;
+  }
+  for (const auto& line : android::base::Split(contents, "\n")) {
+    std::string_view view(line);
+    if (android::base::ConsumePrefix(&view, "read_bytes: ")) {
+      android::base::ParseUint(std::string(view), read_bytes);
+    } else if (android::base::ConsumePrefix(&view, "write_bytes: ")) {
+      android::base::ParseUint(std::string(view), write_bytes);
+    }
+  }
+  return true;
+}
+
+// Attaches |backing_path| to a free loop device and returns the device path, or an empty string
+// when loop devices are unavailable so the caller can fall back to the backing file itself.
+static std::string AttachLoopDevice(const std::string& backing_path,
+                                    android::base::unique_fd* loop_fd) {
+  android::base::unique_fd control(open("/dev/loop-control", O_RDWR | O_CLOEXEC));
+  if (control == -1) {
+    return "";
+  }
+  int device_number = ioctl(control.get(), LOOP_CTL_GET_FREE);
+  if (device_number < 0) {
+    return "";
+  }
+  // Loop devices live under /dev/block on Android and directly under /dev elsewhere.
+  std::string device_path = "/dev/block/loop" + std::to_string(device_number);
+  android::base::unique_fd device_fd(open(device_path.c_str(), O_RDWR | O_CLOEXEC));
+  if (device_fd == -1) {
+    device_path = "/dev/loop" + std::to_string(device_number);
+    device_fd.reset(open(device_path.c_str(), O_RDWR | O_CLOEXEC));
+  }
+  if (device_fd == -1) {
+    return "";
+  }
+  android::base::unique_fd backing_fd(open(backing_path.c_str(), O_RDWR | O_CLOEXEC));
+  if (backing_fd == -1) {
+    return "";
+  }
+  if (ioctl(device_fd.get(), LOOP_SET_FD, backing_fd.get()) == -1) {
+    return "";
+  }
+  *loop_fd = std::move(device_fd);
+  return device_path;
+}
+
+// Asserts a throughput floor only when RECOVERY_PERF_MIN_MB_PER_S_<phase> is set; without a
+// device-model-specific floor the phase records its numbers and always passes.
+static void CheckThroughputFloor(const char* phase, double mb_per_s) {
+  std::string env_name = std::string("RECOVERY_PERF_MIN_MB_PER_S_") + phase;
+  const char* floor_env = getenv(env_name.c_str());
+  if (floor_env == nullptr) {
+    return;
+  }
+  double floor;
+  ASSERT_TRUE(android::base::ParseDouble(floor_env, &floor, 0.0))
+      << "Invalid " << env_name << ": " << floor_env;
+  EXPECT_GE(mb_per_s, floor) << phase << " throughput " << mb_per_s
+                             << " MB/s is below the configured floor of " << floor << " MB/s";
+}
+
+class BlockImgPerfTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    RegisterBuiltins();
+    RegisterInstallFunctions();
+    RegisterBlockImageFunctions();
+
+    // Each test is run in a separate process (isolated mode). Shared temporary files won't cause
+    // conflicts.
+    Paths::Get().set_cache_temp_source(temp_saved_source_.path);
+    Paths::Get().set_compiled_script_cache_file(temp_compiled_script_.path);
+    Paths::Get().set_last_command_file(temp_last_command_.path);
+    Paths::Get().set_stash_directory_base(temp_stash_base_.path);
+
+    image_blocks_ = ImageMb() * 1024 * 1024 / kBlockSize;
+    ASSERT_GE(image_blocks_, 2 * kChunkBlocks);
+    image_ = MakeRandomData(image_blocks_ * kBlockSize, 0xbeefbeef);
+    ASSERT_TRUE(android::base::WriteStringToFile(image_, backing_file_.path));
+
+    device_path_ = AttachLoopDevice(backing_file_.path, &loop_fd_);
+    if (device_path_.empty()) {
+      LOG(WARNING) << "Failed to set up a loop device: " << strerror(errno)
+                   << "; measuring against the backing file directly";
+      device_path_ = backing_file_.path;
+    }
+  }
+
+  void TearDown() override {
+    if (loop_fd_ != -1) {
+      ioctl(loop_fd_.get(), LOOP_CLR_FD, 0);
+    }
+  }
+
+  std::string BlockRangeSha1(size_t start_block, size_t block_count) const {
+    return GetSha1(
+        std::string_view(image_).substr(start_block * kBlockSize, block_count * kBlockSize));
+  }
+
+  static std::vector<std::string> TransferListHeader(size_t total_blocks, size_t stash_entries,
+                                                     size_t stash_blocks) {
+    return { "4", std::to_string(total_blocks), std::to_string(stash_entries),
+             std::to_string(stash_blocks) };
+  }
+
+  // Runs block_image_update() with the given package entries against the device under test, and
+  // returns the wall-clock MB/s over |payload_bytes| (the bytes the transfer list writes).
+  double RunTimedUpdate(PackageEntries entries, size_t payload_bytes) {
+    CHECK(entries.find("transfer_list") != entries.end());
+    std::string new_data =
+        entries.find("new_data.br") != entries.end() ? "new_data.br" : "new_data";
+    std::string script = R"(block_image_update(")" + device_path_ +
+                         R"(", package_extract_file("transfer_list"), ")" + new_data +
+                         R"(", "patch_data"))";
+    entries.emplace(Updater::SCRIPT_NAME, script);
+
+    TemporaryFile zip_file;
+    BuildUpdatePackage(entries, zip_file.release());
+
+    TemporaryFile temp_pipe;
+    CHECK(updater_.Init(temp_pipe.release(), zip_file.path, false));
+
+    size_t read_before = 0;
+    size_t write_before = 0;
+    bool have_io = ReadProcessIo(&read_before, &write_before);
+    auto start = std::chrono::steady_clock::now();
+    bool status = updater_.RunUpdate();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    size_t read_after = read_before;
+    size_t write_after = write_before;
+    have_io = have_io && ReadProcessIo(&read_after, &write_after);
+
+    EXPECT_TRUE(status);
+    EXPECT_EQ("t", updater_.GetResult());
+
+    double payload_mb = payload_bytes / (1024.0 * 1024.0);
+    double mb_per_s = payload_mb / elapsed.count();
+    const char* test_name = ::testing::UnitTest::GetInstance()->current_test_info()->name();
+    printf("%s: %.1f MiB in %.2f s -> %.1f MB/s", test_name, payload_mb, elapsed.count(),
+           mb_per_s);
+    if (have_io) {
+      printf(" (storage read %.1f MiB, write %.1f MiB)",
+             (read_after - read_before) / (1024.0 * 1024.0),
+             (write_after - write_before) / (1024.0 * 1024.0));
+    }
+    printf("\n");
+    RecordProperty("mb_per_s", android::base::StringPrintf("%.1f", mb_per_s));
+    return mb_per_s;
+  }
+
+  std::string image_;
+  size_t image_blocks_;
+  std::string device_path_;
+
+  Updater updater_{ std::make_unique<UpdaterRuntime>(nullptr) };
+
+ private:
+  TemporaryFile backing_file_;
+  android::base::unique_fd loop_fd_;
+  TemporaryFile temp_saved_source_;
+  TemporaryDir temp_stash_base_;
+  TemporaryFile temp_compiled_script_;
+  TemporaryFile temp_last_command_;
+};
+
+// Moves the upper half of the image onto the lower half, one chunk per command.
+TEST_F(BlockImgPerfTest, move_throughput) {
+  size_t half = image_blocks_ / 2;
+  std::vector<std::string> transfer_list = TransferListHeader(half, 0, 0);
+  for (size_t start = 0; start < half; start += kChunkBlocks) {
+    size_t count = std::min(kChunkBlocks, half - start);
+    size_t src_start = half + start;
+    std::string hash = BlockRangeSha1(src_start, count);
+    transfer_list.push_back(android::base::StringPrintf(
+        "move %s %s %zu %s", hash.c_str(), RangeStr(start, start + count).c_str(), count,
+        RangeStr(src_start, src_start + count).c_str()));
+  }
+
+  PackageEntries entries{
+    { "new_data", "" },
+    { "patch_data", "" },
+    { "transfer_list", android::base::Join(transfer_list, "\n") },
+  };
+  double mb_per_s = RunTimedUpdate(std::move(entries), half * kBlockSize);
+  CheckThroughputFloor("MOVE", mb_per_s);
+
+  // Sanity-check that the writes actually landed on the device under test.
+  std::string updated;
+  ASSERT_TRUE(android::base::ReadFileToString(device_path_, &updated));
+  ASSERT_EQ(image_.substr(half * kBlockSize), updated.substr(0, half * kBlockSize));
+}
+
+// Rewrites every chunk in place with a bsdiff patch derived from a lightly edited copy.
+TEST_F(BlockImgPerfTest, bsdiff_throughput) {
+  std::vector<std::string> transfer_list = TransferListHeader(image_blocks_, 0, 0);
+  std::string patch_data;
+  for (size_t start = 0; start < image_blocks_; start += kChunkBlocks) {
+    size_t count = std::min(kChunkBlocks, image_blocks_ - start);
+    std::string source = image_.substr(start * kBlockSize, count * kBlockSize);
+    std::string target = MakeEditedCopy(source);
+    std::string patch = MakeBsdiffPatch(source, target);
+    transfer_list.push_back(android::base::StringPrintf(
+        "bsdiff %zu %zu %s %s %s %zu %s", patch_data.size(), patch.size(),
+        GetSha1(source).c_str(), GetSha1(target).c_str(), RangeStr(start, start + count).c_str(),
+        count, RangeStr(start, start + count).c_str()));
+    patch_data += patch;
+  }
+
+  PackageEntries entries{
+    { "new_data", "" },
+    { "patch_data", std::move(patch_data) },
+    { "transfer_list", android::base::Join(transfer_list, "\n") },
+  };
+  double mb_per_s = RunTimedUpdate(std::move(entries), image_blocks_ * kBlockSize);
+  CheckThroughputFloor("BSDIFF", mb_per_s);
+}
+
+// Rewrites the whole image from brotli-compressed new data, the way a full OTA does.
+TEST_F(BlockImgPerfTest, new_data_throughput) {
+  std::vector<std::string> transfer_list = TransferListHeader(image_blocks_, 0, 0);
+  for (size_t start = 0; start < image_blocks_; start += kChunkBlocks) {
+    size_t count = std::min(kChunkBlocks, image_blocks_ - start);
+    transfer_list.push_back("new " + RangeStr(start, start + count));
+  }
+
+  PackageEntries entries{
+    { "new_data.br", BrotliCompress(MakeRandomData(image_blocks_ * kBlockSize, 0xfeedface)) },
+    { "patch_data", "" },
+    { "transfer_list", android::base::Join(transfer_list, "\n") },
+  };
+  double mb_per_s = RunTimedUpdate(std::move(entries), image_blocks_ * kBlockSize);
+  CheckThroughputFloor("NEW", mb_per_s);
+}
+
+// Round-trips the upper half of the image through the stash directory: every chunk is stashed,
+// written to the lower half from the stash, and freed.
+TEST_F(BlockImgPerfTest, stash_throughput) {
+  size_t half = image_blocks_ / 2;
+  std::vector<std::string> transfer_list = TransferListHeader(half, 1, kChunkBlocks);
+  for (size_t start = 0; start < half; start += kChunkBlocks) {
+    size_t count = std::min(kChunkBlocks, half - start);
+    size_t src_start = half + start;
+    std::string hash = BlockRangeSha1(src_start, count);
+    transfer_list.push_back("stash " + hash + " " +
+                            RangeStr(src_start, src_start + count));
+    transfer_list.push_back(android::base::StringPrintf(
+        "move %s %s %zu - %s:2,0,%zu", hash.c_str(), RangeStr(start, start + count).c_str(),
+        count, hash.c_str(), count));
+    transfer_list.push_back("free " + hash);
+  }
+
+  PackageEntries entries{
+    { "new_data", "" },
+    { "patch_data", "" },
+    { "transfer_list", android::base::Join(transfer_list, "\n") },
+  };
+  double mb_per_s = RunTimedUpdate(std::move(entries), half * kBlockSize);
+  CheckThroughputFloor("STASH", mb_per_s);
+}
+
+// Interleaves all four command types over the lower half of the image, the shape of a real
+// incremental OTA's transfer list.
+TEST_F(BlockImgPerfTest, mixed_commands_throughput) {
+  size_t half = image_blocks_ / 2;
+  std::vector<std::string> transfer_list = TransferListHeader(half, 1, kChunkBlocks);
+  std::string new_data;
+  std::string patch_data;
+  size_t chunk_index = 0;
+  for (size_t start = 0; start < half; start += kChunkBlocks, chunk_index++) {
+    size_t count = std::min(kChunkBlocks, half - start);
+    size_t src_start = half + start;
+    std::string tgt_range = RangeStr(start, start + count);
+    switch (chunk_index % 4) {
+      case 0: {
+        std::string hash = BlockRangeSha1(src_start, count);
+        transfer_list.push_back(android::base::StringPrintf(
+            "move %s %s %zu %s", hash.c_str(), tgt_range.c_str(), count,
+            RangeStr(src_start, src_start + count).c_str()));
+        break;
+      }
+      case 1: {
+        std::string source = image_.substr(start * kBlockSize, count * kBlockSize);
+        std::string target = MakeEditedCopy(source);
+        std::string patch = MakeBsdiffPatch(source, target);
+        transfer_list.push_back(android::base::StringPrintf(
+            "bsdiff %zu %zu %s %s %s %zu %s", patch_data.size(), patch.size(),
+            GetSha1(source).c_str(), GetSha1(target).c_str(), tgt_range.c_str(), count,
+            tgt_range.c_str()));
+        patch_data += patch;
+        break;
+      }
+      case 2: {
+        new_data += MakeRandomData(count * kBlockSize, 0x1badb002 + chunk_index);
+        transfer_list.push_back("new " + tgt_range);
+        break;
+      }
+      case 3: {
+        std::string hash = BlockRangeSha1(src_start, count);
+        transfer_list.push_back("stash " + hash + " " +
+                                RangeStr(src_start, src_start + count));
+        transfer_list.push_back(android::base::StringPrintf(
+            "move %s %s %zu - %s:2,0,%zu", hash.c_str(), tgt_range.c_str(), count, hash.c_str(),
+            count));
+        transfer_list.push_back("free " + hash);
+        break;
+      }
+    }
+  }
+
+  PackageEntries entries{
+    { "new_data.br", BrotliCompress(new_data) },
+    { "patch_data", std::move(patch_data) },
+    { "transfer_list", android::base::Join(transfer_list, "\n") },
+  };
+  double mb_per_s = RunTimedUpdate(std::move(entries), half * kBlockSize);
+  CheckThroughputFloor("MIXED", mb_per_s);
+}
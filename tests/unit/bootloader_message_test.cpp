@@ -49,6 +49,29 @@ TEST(BootloaderMessageTest, read_and_write_bootloader_message) {
             std::string(reinterpret_cast<const char*>(&boot_verify), sizeof(boot_verify)));
 }
 
+TEST(BootloaderMessageTest, set_misc_device_for_test_invalidates_cache) {
+  TemporaryFile first_misc;
+  TemporaryFile second_misc;
+
+  std::string err;
+  SetMiscBlockDeviceForTest(first_misc.path);
+  ASSERT_TRUE(write_bootloader_message({ "--first" }, &err)) << "Failed to write BCB: " << err;
+
+  // Redirecting to another device must drop the cached path; later accesses go to the new one.
+  SetMiscBlockDeviceForTest(second_misc.path);
+  ASSERT_TRUE(write_bootloader_message({ "--second" }, &err)) << "Failed to write BCB: " << err;
+
+  bootloader_message boot;
+  ASSERT_TRUE(read_bootloader_message_from(&boot, first_misc.path, &err))
+      << "Failed to read BCB: " << err;
+  ASSERT_NE(std::string::npos, std::string(boot.recovery).find("--first"));
+  ASSERT_TRUE(read_bootloader_message_from(&boot, second_misc.path, &err))
+      << "Failed to read BCB: " << err;
+  ASSERT_NE(std::string::npos, std::string(boot.recovery).find("--second"));
+
+  SetMiscBlockDeviceForTest("");
+}
+
 TEST(BootloaderMessageTest, update_bootloader_message_in_struct) {
   // Write the options to BCB.
   std::vector<std::string> options = { "option1", "option2" };
@@ -17,6 +17,7 @@
 #include <memory>
 #include <string>
 
+#include <android-base/file.h>
 #include <gtest/gtest.h>
 
 #include "edify/expr.h"
@@ -144,10 +145,49 @@ TEST_F(EdifyTest, comparison) {
     expect("greater_than_int(3, x)", "");
 }
 
+TEST_F(EdifyTest, parallel) {
+    // joins the branch results in argument order, regardless of completion order.
+    expect("parallel()", "");
+    expect("parallel(a)", "a");
+    expect("parallel(a, b, c)", "abc");
+    expect("parallel(concat(a, b), c)", "abc");
+
+    // a failing branch fails the whole expression and propagates its error message.
+    const char* script = "parallel(a, abort(\"branch failed\"), c)";
+    std::unique_ptr<Expr> expr;
+    int error_count = 0;
+    EXPECT_EQ(0, ParseString(script, &expr, &error_count));
+    EXPECT_EQ(0, error_count);
+    State state(script, nullptr);
+    std::string result;
+    EXPECT_FALSE(Evaluate(&state, expr, &result));
+    EXPECT_EQ("branch failed", state.errmsg);
+}
+
 TEST_F(EdifyTest, big_string) {
   expect(std::string(8192, 's'), std::string(8192, 's').c_str());
 }
 
+static int g_pure_call_count = 0;
+static Value* CountingEchoFn(const char* /* name */, State* state,
+                             const std::vector<std::unique_ptr<Expr>>& argv) {
+  std::vector<std::string> args;
+  if (!ReadArgs(state, argv, &args)) {
+    return nullptr;
+  }
+  ++g_pure_call_count;
+  return StringValue(args[0]);
+}
+
+TEST_F(EdifyTest, pure_function_memoization) {
+  RegisterPureFunction("test_pure_echo", CountingEchoFn);
+  g_pure_call_count = 0;
+  // Repeated calls with the same argument are served from the memo table; a new argument value
+  // still reaches the implementation.
+  expect("test_pure_echo(a) + test_pure_echo(a) + test_pure_echo(b)", "aab");
+  EXPECT_EQ(2, g_pure_call_count);
+}
+
 TEST_F(EdifyTest, unknown_function) {
   const char* script1 = "unknown_function()";
   std::unique_ptr<Expr> expr;
@@ -165,3 +205,31 @@ TEST_F(EdifyTest, unknown_function) {
   EXPECT_EQ(1, ParseString(script3, &expr, &error_count));
   EXPECT_EQ(1, error_count);
 }
+
+TEST_F(EdifyTest, compiled_script_cache) {
+  const std::string script = "concat(a, concat(b, c)); if t then yes else no endif";
+  std::unique_ptr<Expr> root;
+  int error_count = 0;
+  ASSERT_EQ(0, ParseString(script, &root, &error_count));
+  ASSERT_EQ(0, error_count);
+
+  TemporaryFile cache_file;
+  ASSERT_TRUE(SaveCompiledScript(script, root.get(), cache_file.path));
+
+  // The loaded tree evaluates to the same result as the parsed one.
+  std::unique_ptr<Expr> loaded = LoadCompiledScript(script, cache_file.path);
+  ASSERT_TRUE(loaded);
+  State state(script, nullptr);
+  std::string result;
+  ASSERT_TRUE(Evaluate(&state, loaded, &result));
+  EXPECT_EQ("yes", result);
+
+  // A cache written for a different script must be rejected.
+  EXPECT_EQ(nullptr, LoadCompiledScript("some_other_script", cache_file.path));
+
+  // So must a truncated cache file.
+  std::string blob;
+  ASSERT_TRUE(android::base::ReadFileToString(cache_file.path, &blob));
+  ASSERT_TRUE(android::base::WriteStringToFile(blob.substr(0, blob.size() / 2), cache_file.path));
+  EXPECT_EQ(nullptr, LoadCompiledScript(script, cache_file.path));
+}
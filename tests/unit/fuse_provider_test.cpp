@@ -102,3 +102,33 @@ TEST(FuseBlockMapTest, ReadBlockAlignedData_large_fuse_block) {
   std::string expected = content.substr(16384, 4096) + content.substr(24576, 15904);
   ASSERT_EQ(std::vector<uint8_t>(expected.begin(), expected.end()), result);
 }
+
+TEST(FuseBlockMapTest, ReadBlocksAlignedData_spans_ranges) {
+  std::string content;
+  for (char c = 0; c < 10; c++) {
+    content += std::string(4096, c);
+  }
+
+  TemporaryFile temp_file;
+  ASSERT_TRUE(android::base::WriteStringToFile(content, temp_file.path));
+
+  std::vector<std::string> lines = {
+    temp_file.path, "30000 4096", "2", "0 3", "5 10",
+  };
+  TemporaryFile block_map;
+  ASSERT_TRUE(android::base::WriteStringToFile(android::base::Join(lines, '\n'), block_map.path));
+
+  auto block_map_data = FuseBlockDataProvider::CreateFromBlockMap(block_map.path, 4096);
+  ASSERT_TRUE(block_map_data);
+
+  // A span crossing the range boundary, with a partial last block: file blocks 1-6 map to source
+  // blocks 1, 2, 5-8, and the final 1424 bytes come from source block 8.
+  std::vector<uint8_t> result(21904);
+  ASSERT_TRUE(block_map_data->ReadBlocksAlignedData(result.data(), 21904, 1, 6));
+  std::string expected = content.substr(4096, 8192) + content.substr(20480, 13712);
+  ASSERT_EQ(std::vector<uint8_t>(expected.begin(), expected.end()), result);
+
+  // A span running past the end of the file fails the bounds check up front.
+  result.resize(30000);
+  ASSERT_FALSE(block_map_data->ReadBlocksAlignedData(result.data(), 30000, 1, 8));
+}
@@ -0,0 +1,38 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agree to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <android-base/properties.h>
+#include <gtest/gtest.h>
+
+#include "recovery_utils/health_monitor.h"
+
+TEST(HealthMonitorTest, SnapshotReportsSaneValues) {
+  // The first snapshot() blocks until the sampler has completed a pass.
+  auto snapshot = HealthMonitor::Get().snapshot();
+  // 0 <= capacity <= 100
+  ASSERT_LE(0, snapshot.capacity);
+  ASSERT_LE(snapshot.capacity, 100);
+  // The running maximum includes the current sample.
+  ASSERT_GE(HealthMonitor::Get().max_temperature(), snapshot.temperature);
+}
+
+TEST(HealthMonitorTest, ThrottleDisabledWithoutThreshold) {
+  if (android::base::GetIntProperty("ro.recovery.thermal_throttle_mc", 0) > 0) {
+    GTEST_SKIP() << "device configures a throttle threshold";
+  }
+  // Without ro.recovery.thermal_throttle_mc the throttle state never engages.
+  ASSERT_FALSE(HealthMonitor::Get().ThrottleRequested());
+}
@@ -150,6 +150,46 @@ TEST(InstallTest, SetUpNonAbUpdateCommands) {
   CloseArchive(zip);
 }
 
+TEST(InstallTest, SetUpNonAbUpdateCommands_CachedExtraction) {
+  TemporaryFile temp_file;
+  static constexpr const char* UPDATE_BINARY_NAME = "META-INF/com/google/android/update-binary";
+  static constexpr const char* UPDATE_BINARY_BODY = "update binary body";
+  BuildZipArchive({ { UPDATE_BINARY_NAME, UPDATE_BINARY_BODY } }, temp_file.release(),
+                  kCompressStored);
+
+  ZipArchiveHandle zip;
+  ASSERT_EQ(0, OpenArchive(temp_file.path, &zip));
+  int status_fd = 10;
+  // Unlike the tests above, use the real package path so the cache token can bind to it.
+  std::string package = temp_file.path;
+  TemporaryDir td;
+  std::string binary_path = std::string(td.path) + "/update_binary";
+  Paths::Get().set_temporary_update_binary(binary_path);
+  std::vector<std::string> cmd;
+  ASSERT_TRUE(SetUpNonAbUpdateCommands(package, zip, 0, status_fd, &cmd));
+  struct stat sb;
+  ASSERT_EQ(0, stat(binary_path.c_str(), &sb));
+  ASSERT_EQ(strlen(UPDATE_BINARY_BODY), static_cast<size_t>(sb.st_size));
+  ino_t extracted_inode = sb.st_ino;
+
+  // A second setup for the same package reuses the cached copy instead of re-extracting.
+  cmd.clear();
+  ASSERT_TRUE(SetUpNonAbUpdateCommands(package, zip, 1, status_fd, &cmd));
+  sb = {};
+  ASSERT_EQ(0, stat(binary_path.c_str(), &sb));
+  ASSERT_EQ(extracted_inode, sb.st_ino);
+
+  // A cached copy whose size no longer matches the entry is re-extracted.
+  ASSERT_EQ(0, truncate(binary_path.c_str(), 0));
+  cmd.clear();
+  ASSERT_TRUE(SetUpNonAbUpdateCommands(package, zip, 1, status_fd, &cmd));
+  sb = {};
+  ASSERT_EQ(0, stat(binary_path.c_str(), &sb));
+  ASSERT_EQ(strlen(UPDATE_BINARY_BODY), static_cast<size_t>(sb.st_size));
+
+  CloseArchive(zip);
+}
+
 TEST(InstallTest, SetUpNonAbUpdateCommands_MissingUpdateBinary) {
   TemporaryFile temp_file;
   // The archive must have something to be opened correctly.
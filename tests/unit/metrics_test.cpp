@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "recovery_utils/metrics.h"
+
+TEST(MetricsTest, SerializeEmpty) {
+  RecoveryMetrics metrics;
+  ASSERT_TRUE(metrics.Serialize().empty());
+}
+
+TEST(MetricsTest, CounterRoundTrip) {
+  RecoveryMetrics metrics;
+  metrics.IncrementCounter("installs");
+  metrics.IncrementCounter("installs", 2);
+  metrics.IncrementCounter("bytes", 1024);
+
+  std::vector<MetricRecord> records;
+  ASSERT_TRUE(RecoveryMetrics::Parse(metrics.Serialize(), &records));
+  ASSERT_EQ(2u, records.size());
+  // Records come back in name order.
+  ASSERT_EQ("bytes", records[0].name);
+  ASSERT_EQ(MetricType::kCounter, records[0].type);
+  ASSERT_EQ(1024, records[0].value);
+  ASSERT_EQ("installs", records[1].name);
+  ASSERT_EQ(3, records[1].value);
+}
+
+TEST(MetricsTest, TimerRoundTrip) {
+  RecoveryMetrics metrics;
+  metrics.RecordDuration("verify", std::chrono::milliseconds(250));
+  metrics.RecordDuration("verify", std::chrono::milliseconds(750));
+
+  std::vector<MetricRecord> records;
+  ASSERT_TRUE(RecoveryMetrics::Parse(metrics.Serialize(), &records));
+  ASSERT_EQ(1u, records.size());
+  ASSERT_EQ(MetricType::kTimer, records[0].type);
+  ASSERT_EQ(std::chrono::nanoseconds(std::chrono::seconds(1)).count(), records[0].value);
+  ASSERT_EQ(2, records[0].count);
+}
+
+TEST(MetricsTest, HistogramRoundTrip) {
+  RecoveryMetrics metrics;
+  metrics.RecordValue("format_ms", 3);
+  metrics.RecordValue("format_ms", 5);
+  metrics.RecordValue("format_ms", 1000);
+
+  std::vector<MetricRecord> records;
+  ASSERT_TRUE(RecoveryMetrics::Parse(metrics.Serialize(), &records));
+  ASSERT_EQ(1u, records.size());
+  const MetricRecord& record = records[0];
+  ASSERT_EQ(MetricType::kHistogram, record.type);
+  ASSERT_EQ(3, record.count);
+  ASSERT_EQ(1008, record.sum);
+  ASSERT_EQ(3, record.min);
+  ASSERT_EQ(1000, record.max);
+  // 3 and 5 land in the floor(log2) buckets 1 and 2; 1000 in bucket 9.
+  ASSERT_EQ(3u, record.buckets.size());
+  ASSERT_EQ(1, record.buckets.at(1));
+  ASSERT_EQ(1, record.buckets.at(2));
+  ASSERT_EQ(1, record.buckets.at(9));
+}
+
+TEST(MetricsTest, MixedTypesOnOneNameDropped) {
+  RecoveryMetrics metrics;
+  metrics.IncrementCounter("name");
+  metrics.RecordValue("name", 10);
+
+  std::vector<MetricRecord> records;
+  ASSERT_TRUE(RecoveryMetrics::Parse(metrics.Serialize(), &records));
+  ASSERT_EQ(1u, records.size());
+  ASSERT_EQ(MetricType::kCounter, records[0].type);
+  ASSERT_EQ(1, records[0].value);
+}
+
+TEST(MetricsTest, ParseConcatenatedBlobs) {
+  RecoveryMetrics first;
+  first.IncrementCounter("from_first");
+  RecoveryMetrics second;
+  second.IncrementCounter("from_second");
+
+  std::vector<MetricRecord> records;
+  ASSERT_TRUE(RecoveryMetrics::Parse(first.Serialize() + second.Serialize(), &records));
+  ASSERT_EQ(2u, records.size());
+  ASSERT_EQ("from_first", records[0].name);
+  ASSERT_EQ("from_second", records[1].name);
+}
+
+TEST(MetricsTest, ParseRejectsMalformedInput) {
+  std::vector<MetricRecord> records;
+  ASSERT_FALSE(RecoveryMetrics::Parse("not a metrics blob", &records));
+
+  RecoveryMetrics metrics;
+  metrics.IncrementCounter("counter");
+  std::string truncated = metrics.Serialize();
+  truncated.resize(truncated.size() - 1);
+  records.clear();
+  ASSERT_FALSE(RecoveryMetrics::Parse(truncated, &records));
+}
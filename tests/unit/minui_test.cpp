@@ -52,3 +52,22 @@ TEST(GRSurfaceTest, Clone) {
   ASSERT_EQ(std::vector(image->data(), image->data() + image->data_size()),
             std::vector(image_copy->data(), image_copy->data() + image->data_size()));
 }
+
+TEST(GRSurfaceTest, CreateAliasView) {
+  auto image = GRSurface::Create(50, 10, 50, 1);
+  for (auto i = 0; i < image->data_size(); i++) {
+    image->data()[i] = rand() % 128;
+  }
+  auto view = image->CreateAliasView();
+  // The view aliases the original pixels instead of copying them.
+  ASSERT_EQ(image->data(), view->data());
+  ASSERT_EQ(image->width, view->width);
+  ASSERT_EQ(image->height, view->height);
+  ASSERT_EQ(image->row_bytes, view->row_bytes);
+  ASSERT_EQ(image->pixel_bytes, view->pixel_bytes);
+
+  // Dropping the view must not free the aliased surface's buffer.
+  auto first_byte = image->data()[0];
+  view.reset();
+  ASSERT_EQ(first_byte, image->data()[0]);
+}
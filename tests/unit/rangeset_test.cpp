@@ -292,6 +292,25 @@ TEST(SortedRangeSetTest, Insert) {
   ASSERT_EQ(static_cast<size_t>(22), rs.blocks());
 }
 
+TEST(SortedRangeSetTest, Intersect) {
+  SortedRangeSet rs({ { 1, 6 }, { 8, 14 }, { 20, 25 } });
+  SortedRangeSet other({ { 4, 10 }, { 13, 22 } });
+  ASSERT_EQ(SortedRangeSet({ { 4, 6 }, { 8, 10 }, { 13, 14 }, { 20, 22 } }), rs.Intersect(other));
+  ASSERT_EQ(rs.Intersect(other), other.Intersect(rs));
+
+  ASSERT_EQ(SortedRangeSet(), rs.Intersect(SortedRangeSet({ { 6, 8 }, { 14, 20 } })));
+  ASSERT_EQ(SortedRangeSet(), rs.Intersect(SortedRangeSet()));
+}
+
+TEST(SortedRangeSetTest, Subtract) {
+  SortedRangeSet rs({ { 1, 6 }, { 8, 14 }, { 20, 25 } });
+  ASSERT_EQ(SortedRangeSet({ { 1, 4 }, { 10, 13 }, { 22, 25 } }),
+            rs.Subtract(SortedRangeSet({ { 4, 10 }, { 13, 22 } })));
+  ASSERT_EQ(rs, rs.Subtract(SortedRangeSet({ { 6, 8 }, { 14, 20 } })));
+  ASSERT_EQ(rs, rs.Subtract(SortedRangeSet()));
+  ASSERT_EQ(SortedRangeSet(), rs.Subtract(SortedRangeSet({ { 0, 30 } })));
+}
+
 TEST(SortedRangeSetTest, file_range) {
   SortedRangeSet rs;
   rs.Insert(4096, 4096);
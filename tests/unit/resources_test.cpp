@@ -17,6 +17,7 @@
 #include <dirent.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <memory>
 #include <string>
@@ -29,6 +30,7 @@
 
 #include "common/test_constants.h"
 #include "minui/minui.h"
+#include "private/resource_pack.h"
 #include "private/resources.h"
 
 static const std::string kLocale = "zu";
@@ -86,6 +88,70 @@ TEST(ResourcesTest, res_create_multi_display_surface) {
   free(frames);
 }
 
+TEST(ResourcesTest, resource_pack_lookup) {
+  // Build a pack with a 2x2 RGB display image and a 4x1 alpha image.
+  ResourcePackHeader header = {};
+  header.magic = kResourcePackMagic;
+  header.version = kResourcePackVersion;
+  header.entry_count = 2;
+
+  ResourcePackEntry display_entry = {};
+  strcpy(display_entry.name, "pack_display");
+  display_entry.channels = 3;
+  display_entry.width = 2;
+  display_entry.height = 2;
+  display_entry.frames = 1;
+  display_entry.fps = 20;
+  display_entry.offset = sizeof(ResourcePackHeader) + 2 * sizeof(ResourcePackEntry);
+  display_entry.size = 12;
+
+  ResourcePackEntry alpha_entry = {};
+  strcpy(alpha_entry.name, "pack_alpha");
+  alpha_entry.channels = 1;
+  alpha_entry.width = 4;
+  alpha_entry.height = 1;
+  alpha_entry.frames = 1;
+  alpha_entry.fps = 20;
+  alpha_entry.offset = display_entry.offset + display_entry.size;
+  alpha_entry.size = 4;
+
+  const uint8_t display_payload[12] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12 };
+  const uint8_t alpha_payload[4] = { 10, 20, 30, 40 };
+
+  std::string blob(reinterpret_cast<const char*>(&header), sizeof(header));
+  blob.append(reinterpret_cast<const char*>(&display_entry), sizeof(display_entry));
+  blob.append(reinterpret_cast<const char*>(&alpha_entry), sizeof(alpha_entry));
+  blob.append(reinterpret_cast<const char*>(display_payload), sizeof(display_payload));
+  blob.append(reinterpret_cast<const char*>(alpha_payload), sizeof(alpha_payload));
+
+  TemporaryDir resource_dir;
+  ASSERT_TRUE(
+      android::base::WriteStringToFile(blob, std::string(resource_dir.path) + "/resources.pak"));
+  res_set_resource_dir(resource_dir.path);
+
+  GRSurface* surface;
+  ASSERT_EQ(0, res_create_display_surface("pack_display", &surface));
+  ASSERT_EQ(2U, surface->width);
+  ASSERT_EQ(2U, surface->height);
+  // With the default (unknown) pixel format the rows expand to RGBX.
+  ASSERT_EQ(1, surface->data()[0]);
+  ASSERT_EQ(2, surface->data()[1]);
+  ASSERT_EQ(3, surface->data()[2]);
+  ASSERT_EQ(0xff, surface->data()[3]);
+  ASSERT_EQ(10, surface->data()[12]);
+  res_free_surface(surface);
+
+  ASSERT_EQ(0, res_create_alpha_surface("pack_alpha", &surface));
+  ASSERT_EQ(4U, surface->width);
+  ASSERT_EQ(0, memcmp(surface->data(), alpha_payload, sizeof(alpha_payload)));
+  res_free_surface(surface);
+
+  // Names not in the pack fall back to the .png files (and fail here, as none exist).
+  ASSERT_NE(0, res_create_display_surface("no_such_resource", &surface));
+
+  res_set_resource_dir("/res/images");
+}
+
 class ResourcesTest : public testing::TestWithParam<std::string> {
  public:
   static std::vector<std::string> png_list;
@@ -102,6 +102,23 @@ TEST(SysUtilTest, MapFileRegularFile) {
   ASSERT_EQ(1U, mapping.ranges());
 }
 
+TEST(SysUtilTest, MapFileAdvise) {
+  TemporaryFile temp_file1;
+  std::string content(8192, 'x');
+  ASSERT_TRUE(android::base::WriteStringToFile(content, temp_file1.path));
+
+  // Advise() is best-effort; this only checks that hints on various windows (including ones past
+  // the end of the map, which are clamped) don't crash or corrupt the mapped data.
+  MemMapping mapping;
+  ASSERT_TRUE(mapping.MapFile(temp_file1.path));
+  mapping.Advise(MemMapping::AccessPattern::kRandom);
+  mapping.Advise(MemMapping::AccessPattern::kSequential, 0, mapping.length);
+  mapping.Advise(MemMapping::AccessPattern::kWillNeed, 4096, 100000);
+  mapping.Advise(MemMapping::AccessPattern::kWillNeed, mapping.length, 4096);
+  mapping.Advise(MemMapping::AccessPattern::kHugePage);
+  ASSERT_EQ(content, std::string(reinterpret_cast<const char*>(mapping.addr), mapping.length));
+}
+
 TEST(SysUtilTest, MapFileBlockMap) {
   // Create a file that has 10 blocks.
   TemporaryFile package;
@@ -197,6 +197,36 @@ TEST_F(UpdateVerifierTest, verify_image_protobuf_empty_fingerprint) {
   ASSERT_FALSE(verifier_.ParseCareMap());
 }
 
+TEST_F(UpdateVerifierTest, verify_image_resumes_from_verified_partitions) {
+  std::vector<std::unordered_map<std::string, std::string>> partitions = {
+    {
+        { "name", "fake_partition" },
+        { "ranges", "2,0,1" },
+        { "id", property_id_ },
+        { "fingerprint", fingerprint_ },
+    },
+  };
+
+  std::string proto = ConstructProto(partitions);
+  ASSERT_TRUE(android::base::WriteStringToFile(proto, care_map_pb_));
+  ASSERT_TRUE(verifier_.ParseCareMap());
+  // No dm block device backs fake_partition, so a fresh verification fails.
+  ASSERT_FALSE(verifier_.VerifyPartitions());
+
+  // A progress record from an interrupted verification of the same build skips the partition.
+  std::string progress_path = care_map_prefix_ + ".progress"s;
+  ASSERT_TRUE(
+      android::base::WriteStringToFile("fake_partition " + fingerprint_ + "\n", progress_path));
+  ASSERT_TRUE(verifier_.VerifyPartitions());
+  // The record is cleared once verification completes.
+  ASSERT_EQ(-1, access(progress_path.c_str(), R_OK));
+
+  // A record tagged with a different build's fingerprint must not be honored.
+  ASSERT_TRUE(android::base::WriteStringToFile("fake_partition stale_fingerprint\n", progress_path));
+  ASSERT_FALSE(verifier_.VerifyPartitions());
+  unlink(progress_path.c_str());
+}
+
 TEST_F(UpdateVerifierTest, verify_image_protobuf_fingerprint_mismatch) {
   // This test relies on dm-verity support.
   if (!verity_supported) {
@@ -143,6 +143,7 @@ class UpdaterTestBase {
     // Each test is run in a separate process (isolated mode). Shared temporary files won't cause
     // conflicts.
     Paths::Get().set_cache_temp_source(temp_saved_source_.path);
+    Paths::Get().set_compiled_script_cache_file(temp_compiled_script_.path);
     Paths::Get().set_last_command_file(temp_last_command_.path);
     Paths::Get().set_stash_directory_base(temp_stash_base_.path);
 
@@ -201,6 +202,7 @@ class UpdaterTestBase {
   Updater updater_;
 
  private:
+  TemporaryFile temp_compiled_script_;
   TemporaryFile temp_last_command_;
   TemporaryFile image_temp_file_;
 };
@@ -274,6 +274,64 @@ class VerifierSuccessTest : public VerifierTest {
 class VerifierFailureTest : public VerifierTest {
 };
 
+TEST(VerifierTest, StreamingVerifier_sequential_reads) {
+  std::vector<Certificate> certs;
+  certs.emplace_back(0, Certificate::KEY_TYPE_RSA, nullptr, nullptr);
+  LoadKeyFromFile(from_testdata_base("testkey_v3.x509.pem"), &certs.back());
+
+  auto package = Package::CreateMemoryPackage(from_testdata_base("otasigned_v3.zip"), nullptr);
+  ASSERT_NE(nullptr, package);
+
+  StreamingVerifier verifier(package.get(), certs);
+  ASSERT_TRUE(verifier.Initialize());
+  package->SetReadObserver([&verifier](const uint8_t* buffer, uint64_t size, uint64_t offset) {
+    verifier.Observe(buffer, size, offset);
+  });
+
+  // Consume the package sequentially in odd-sized chunks, the way a streaming installer would.
+  uint64_t package_size = package->GetPackageSize();
+  std::vector<uint8_t> buffer(123);
+  for (uint64_t offset = 0; offset < package_size; offset += buffer.size()) {
+    uint64_t read_size = std::min<uint64_t>(package_size - offset, buffer.size());
+    ASSERT_TRUE(package->ReadFullyAtOffset(buffer.data(), read_size, offset));
+  }
+
+  ASSERT_EQ(VERIFY_SUCCESS, verifier.Finalize());
+}
+
+TEST(VerifierTest, StreamingVerifier_unread_remainder) {
+  std::vector<Certificate> certs;
+  certs.emplace_back(0, Certificate::KEY_TYPE_RSA, nullptr, nullptr);
+  LoadKeyFromFile(from_testdata_base("testkey_v3.x509.pem"), &certs.back());
+
+  auto package = Package::CreateMemoryPackage(from_testdata_base("otasigned_v3.zip"), nullptr);
+  ASSERT_NE(nullptr, package);
+
+  // Without any observed reads, Finalize() hashes the whole signed region itself.
+  StreamingVerifier verifier(package.get(), certs);
+  ASSERT_TRUE(verifier.Initialize());
+  ASSERT_EQ(VERIFY_SUCCESS, verifier.Finalize());
+}
+
+TEST(VerifierTest, StreamingVerifier_altered_content) {
+  std::vector<Certificate> certs;
+  certs.emplace_back(0, Certificate::KEY_TYPE_RSA, nullptr, nullptr);
+  LoadKeyFromFile(from_testdata_base("testkey_v3.x509.pem"), &certs.back());
+
+  std::string content;
+  ASSERT_TRUE(android::base::ReadFileToString(from_testdata_base("otasigned_v3.zip"), &content));
+  ASSERT_GT(content.size(), static_cast<size_t>(100));
+  content[50] += 1;
+
+  auto package =
+      Package::CreateMemoryPackage(std::vector<uint8_t>(content.begin(), content.end()), nullptr);
+  ASSERT_NE(nullptr, package);
+
+  StreamingVerifier verifier(package.get(), certs);
+  ASSERT_TRUE(verifier.Initialize());
+  ASSERT_EQ(VERIFY_FAILURE, verifier.Finalize());
+}
+
 TEST(VerifierTest, BadPackage_AlteredFooter) {
   std::vector<Certificate> certs;
   certs.emplace_back(0, Certificate::KEY_TYPE_RSA, nullptr, nullptr);
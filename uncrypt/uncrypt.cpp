@@ -89,6 +89,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <inttypes.h>
+#include <linux/fiemap.h>
 #include <linux/fs.h>
 #include <stdarg.h>
 #include <stdio.h>
@@ -101,11 +102,17 @@
 #include <unistd.h>
 
 #include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include <android-base/file.h>
+#include <android-base/hex.h>
 #include <android-base/logging.h>
 #include <android-base/properties.h>
 #include <android-base/stringprintf.h>
@@ -116,6 +123,7 @@
 #include <cutils/sockets.h>
 #include <fs_mgr.h>
 #include <fstab/fstab.h>
+#include <openssl/sha.h>
 
 #include "otautil/error_code.h"
 
@@ -125,7 +133,14 @@ using android::fs_mgr::ReadDefaultFstab;
 static constexpr int WINDOW_SIZE = 5;
 static constexpr int FIBMAP_RETRY_LIMIT = 3;
 
-// uncrypt provides three services: SETUP_BCB, CLEAR_BCB and UNCRYPT.
+// Sizing of the pipelined copy: each chunk covers up to 256 file blocks (1 MiB at the usual
+// 4 KiB block size), the reader keeps up to 4 chunks queued ahead of the writer, and the write
+// side fdatasync's every 32 MiB so the final fsync doesn't stall on gigabytes of dirty pages.
+static constexpr int PIPELINE_CHUNK_BLOCKS = 256;
+static constexpr size_t PIPELINE_QUEUE_DEPTH = 4;
+static constexpr off64_t PIPELINE_SYNC_INTERVAL = 32 * 1024 * 1024;
+
+// uncrypt provides four services: SETUP_BCB, CLEAR_BCB, UNCRYPT and PREPARE.
 //
 // SETUP_BCB and CLEAR_BCB services use socket communication and do not rely
 // on /cache partitions. They will handle requests to reboot into recovery
@@ -135,13 +150,49 @@ static constexpr int FIBMAP_RETRY_LIMIT = 3;
 // UNCRYPT service still needs files on /cache partition (UNCRYPT_PATH_FILE
 // and CACHE_BLOCK_MAP). It will be working (and needed) only for non-A/B
 // devices, on which /cache partitions always exist.
+//
+// PREPARE runs the same work as UNCRYPT ahead of time, typically while the
+// device idles on a charger, writing the block map under a scratch name with
+// a token recording the package it was built from. A later UNCRYPT request
+// adopts the prepared map if the token still matches, so the minutes of
+// read/copy/map cost move out of the user-visible install window.
 static const std::string CACHE_BLOCK_MAP = "/cache/recovery/block.map";
+static const std::string PREPARED_BLOCK_MAP = "/cache/recovery/block.map.prep";
+static const std::string PREPARED_TOKEN = "/cache/recovery/block.map.prep.token";
 static const std::string UNCRYPT_PATH_FILE = "/cache/recovery/uncrypt_file";
 static const std::string UNCRYPT_STATUS = "/cache/recovery/uncrypt_status";
 static const std::string UNCRYPT_SOCKET = "uncrypt";
 
 static Fstab fstab;
 
+static bool write_status_to_socket(int status, int socket) {
+    // If socket equals -1, uncrypt is in debug mode without socket communication.
+    // Skip writing and return success.
+    if (socket == -1) {
+        return true;
+    }
+    int status_out = htonl(status);
+    return android::base::WriteFully(socket, &status_out, sizeof(int));
+}
+
+// Sends a progress percentage without ever stalling the copy loop on the status channel.
+// Progress updates are advisory and latest-value-wins: when the socket buffer is full the value
+// is simply dropped, and a later (higher) percentage supersedes it. Terminal statuses must go
+// through write_status_to_socket() instead, which blocks until delivered.
+static void write_progress_to_socket(int progress, int socket) {
+    if (socket == -1) {
+        return;
+    }
+    int status_out = htonl(progress);
+    ssize_t written = TEMP_FAILURE_RETRY(send(socket, &status_out, sizeof(int), MSG_DONTWAIT));
+    if (written > 0 && written < static_cast<ssize_t>(sizeof(int))) {
+        // The 4-byte frame straddled a full buffer; finish it so the stream stays aligned. This
+        // is the only path that can block, and only for the remainder of one frame.
+        android::base::WriteFully(socket, reinterpret_cast<char*>(&status_out) + written,
+                                  sizeof(int) - written);
+    }
+}
+
 static int write_at_offset(unsigned char* buffer, size_t size, int wfd, off64_t offset) {
     if (TEMP_FAILURE_RETRY(lseek64(wfd, offset, SEEK_SET)) == -1) {
         PLOG(ERROR) << "error seeking to offset " << offset;
@@ -166,6 +217,206 @@ static void add_block_to_ranges(std::vector<int>& ranges, int new_block) {
     }
 }
 
+static void add_extent_to_ranges(std::vector<int>& ranges, int start_block, int block_count) {
+    if (!ranges.empty() && start_block == ranges.back()) {
+        ranges.back() += block_count;
+    } else {
+        ranges.push_back(start_block);
+        ranges.push_back(start_block + block_count);
+    }
+}
+
+// Maps the physical blocks of |fd| with FIEMAP, which returns whole extents per ioctl instead of
+// one block per FIBMAP call (half a million ioctls for a 2 GB package). Returns false without
+// touching |ranges| beyond partial content if the filesystem doesn't support FIEMAP or reports
+// extents that can't be expressed in the block map (inline, encoded, unaligned, holes); the
+// caller then falls back to the per-block FIBMAP walk.
+static bool MapBlocksViaFiemap(int fd, const std::string& name, const struct stat& sb,
+                               std::vector<int>* ranges) {
+    const uint64_t block_size = sb.st_blksize;
+    const uint64_t file_size = sb.st_size;
+    uint64_t remaining_blocks = ((file_size - 1) / block_size) + 1;
+
+    constexpr uint32_t EXTENTS_PER_CALL = 128;
+    std::vector<uint8_t> storage(sizeof(struct fiemap) +
+                                 EXTENTS_PER_CALL * sizeof(struct fiemap_extent));
+    struct fiemap* fm = reinterpret_cast<struct fiemap*>(storage.data());
+
+    uint64_t logical = 0;
+    bool last_extent_seen = false;
+    while (!last_extent_seen && remaining_blocks > 0) {
+        memset(storage.data(), 0, storage.size());
+        fm->fm_start = logical;
+        fm->fm_length = file_size - logical;
+        // FIEMAP_FLAG_SYNC flushes the file first, so delayed allocations get disk blocks.
+        fm->fm_flags = FIEMAP_FLAG_SYNC;
+        fm->fm_extent_count = EXTENTS_PER_CALL;
+        if (ioctl(fd, FS_IOC_FIEMAP, fm) != 0) {
+            PLOG(WARNING) << "FIEMAP failed on \"" << name << "\"";
+            return false;
+        }
+        if (fm->fm_mapped_extents == 0) {
+            LOG(WARNING) << "FIEMAP returned no extents at offset " << logical << " of \"" << name
+                         << "\"";
+            return false;
+        }
+        for (uint32_t i = 0; i < fm->fm_mapped_extents && remaining_blocks > 0; i++) {
+            const struct fiemap_extent& extent = fm->fm_extents[i];
+            // A fully written and synced package should only have plain aligned extents; anything
+            // else can't be read back directly from the block device.
+            if ((extent.fe_flags &
+                 (FIEMAP_EXTENT_UNKNOWN | FIEMAP_EXTENT_DELALLOC | FIEMAP_EXTENT_ENCODED |
+                  FIEMAP_EXTENT_DATA_ENCRYPTED | FIEMAP_EXTENT_NOT_ALIGNED |
+                  FIEMAP_EXTENT_DATA_INLINE | FIEMAP_EXTENT_DATA_TAIL |
+                  FIEMAP_EXTENT_UNWRITTEN)) != 0) {
+                LOG(WARNING) << "\"" << name << "\" has an extent with unsupported flags "
+                             << extent.fe_flags;
+                return false;
+            }
+            // The block map has no way to express a hole, and an extent starting before where we
+            // already are would mean overlapping ranges.
+            if (extent.fe_logical != logical || extent.fe_logical % block_size != 0 ||
+                extent.fe_physical % block_size != 0 || extent.fe_length % block_size != 0) {
+                LOG(WARNING) << "\"" << name << "\" has a hole or misaligned extent at offset "
+                             << logical;
+                return false;
+            }
+
+            uint64_t extent_blocks =
+                std::min<uint64_t>(extent.fe_length / block_size, remaining_blocks);
+            add_extent_to_ranges(*ranges, static_cast<int>(extent.fe_physical / block_size),
+                                 static_cast<int>(extent_blocks));
+            logical += extent.fe_length;
+            remaining_blocks -= extent_blocks;
+
+            if (extent.fe_flags & FIEMAP_EXTENT_LAST) {
+                last_extent_seen = true;
+            }
+        }
+    }
+
+    if (remaining_blocks > 0) {
+        LOG(WARNING) << "FIEMAP mapped \"" << name << "\" short by " << remaining_blocks
+                     << " blocks";
+        return false;
+    }
+    return true;
+}
+
+// A multi-block run of file contents with its destination on the block device.
+struct CopyChunk {
+    off64_t offset;
+    std::vector<unsigned char> data;
+};
+
+// Copies the contents of |fd| onto |wfd| following the precomputed block |ranges|. A reader
+// thread fills multi-block chunks ahead of the main thread writing them, so the read from the
+// encrypted mount and the write to the raw device overlap instead of strictly alternating, and
+// each write submits a whole chunk rather than a single block. Returns kUncryptNoError on
+// success, or the error code of the failed stage.
+static int CopyBlocksPipelined(int fd, int wfd, const std::string& name, const struct stat& sb,
+                               const std::vector<int>& ranges, int socket) {
+    std::mutex mu;
+    std::condition_variable cv;
+    std::deque<CopyChunk> queue;
+    bool read_done = false;
+    bool read_failed = false;
+    bool write_failed = false;
+
+    std::thread reader([&]() {
+        off64_t pos = 0;
+        for (size_t i = 0; i < ranges.size() && pos < sb.st_size; i += 2) {
+            int block = ranges[i];
+            while (block < ranges[i + 1] && pos < sb.st_size) {
+                int chunk_blocks = std::min(PIPELINE_CHUNK_BLOCKS, ranges[i + 1] - block);
+                CopyChunk chunk;
+                chunk.offset = static_cast<off64_t>(sb.st_blksize) * block;
+                chunk.data.resize(static_cast<size_t>(chunk_blocks) * sb.st_blksize);
+                size_t to_read = static_cast<size_t>(
+                        std::min(static_cast<off64_t>(chunk.data.size()), sb.st_size - pos));
+                if (!android::base::ReadFully(fd, chunk.data.data(), to_read)) {
+                    PLOG(ERROR) << "failed to read " << name;
+                    std::lock_guard<std::mutex> lock(mu);
+                    read_failed = true;
+                    break;
+                }
+                pos += to_read;
+                block += chunk_blocks;
+
+                std::unique_lock<std::mutex> lock(mu);
+                cv.wait(lock, [&] {
+                    return queue.size() < PIPELINE_QUEUE_DEPTH || write_failed;
+                });
+                if (write_failed) {
+                    break;
+                }
+                queue.push_back(std::move(chunk));
+                lock.unlock();
+                cv.notify_all();
+            }
+            std::lock_guard<std::mutex> lock(mu);
+            if (read_failed || write_failed) break;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mu);
+            read_done = true;
+        }
+        cv.notify_all();
+    });
+
+    int result = kUncryptNoError;
+    int last_progress = 0;
+    off64_t written = 0;
+    off64_t synced = 0;
+    while (true) {
+        CopyChunk chunk;
+        {
+            std::unique_lock<std::mutex> lock(mu);
+            cv.wait(lock, [&] { return !queue.empty() || read_done || read_failed; });
+            if (queue.empty()) {
+                if (read_failed) {
+                    result = kUncryptReadError;
+                }
+                break;
+            }
+            chunk = std::move(queue.front());
+            queue.pop_front();
+        }
+        cv.notify_all();
+
+        // Update the status file, progress must be between [0, 99].
+        int progress = static_cast<int>(100 * (double(written) / double(sb.st_size)));
+        if (progress > last_progress && progress <= 99) {
+            last_progress = progress;
+            write_progress_to_socket(progress, socket);
+        }
+
+        if (write_at_offset(chunk.data.data(), chunk.data.size(), wfd, chunk.offset) != 0) {
+            result = kUncryptWriteError;
+            break;
+        }
+        written += chunk.data.size();
+
+        if (written - synced >= PIPELINE_SYNC_INTERVAL) {
+            if (fdatasync(wfd) == -1) {
+                PLOG(ERROR) << "failed to fdatasync at " << written << " bytes written";
+                result = kUncryptFileSyncError;
+                break;
+            }
+            synced = written;
+        }
+    }
+
+    if (result != kUncryptNoError) {
+        // Unblock the reader if it's waiting for queue space.
+        std::lock_guard<std::mutex> lock(mu);
+        write_failed = true;
+    }
+    cv.notify_all();
+    reader.join();
+    return result;
+}
+
 // Looks for a volume whose mount point is the prefix of path and returns its block device or an
 // empty string. Sets encryption flags accordingly.
 static std::string FindBlockDevice(const std::string& path, bool* encryptable, bool* encrypted,
@@ -196,16 +447,6 @@ static std::string FindBlockDevice(const std::string& path, bool* encryptable, b
   return "";
 }
 
-static bool write_status_to_socket(int status, int socket) {
-    // If socket equals -1, uncrypt is in debug mode without socket communication.
-    // Skip writing and return success.
-    if (socket == -1) {
-        return true;
-    }
-    int status_out = htonl(status);
-    return android::base::WriteFully(socket, &status_out, sizeof(int));
-}
-
 // Parses the given path file to find the update package name.
 static bool FindUncryptPackage(const std::string& uncrypt_path_file, std::string* package_name) {
   CHECK(package_name != nullptr);
@@ -240,8 +481,18 @@ static int RetryFibmap(int fd, const std::string& name, int* block, const int he
   return kUncryptIoctlError;
 }
 
+// Figures for the final report in UNCRYPT_STATUS: how big the produced map is and where the wall
+// time went.
+struct UncryptStats {
+    size_t extents = 0;
+    int64_t bytes_copied = 0;
+    std::chrono::duration<double> map_time{ 0 };
+    std::chrono::duration<double> copy_time{ 0 };
+};
+
 static int ProductBlockMap(const std::string& path, const std::string& map_file,
-                           const std::string& blk_dev, bool encrypted, bool f2fs_fs, int socket) {
+                           const std::string& blk_dev, bool encrypted, bool f2fs_fs, int socket,
+                           UncryptStats* stats) {
   std::string err;
   if (!android::base::RemoveFileIfExists(map_file, &err)) {
     LOG(ERROR) << "failed to remove the existing map file " << map_file << ": " << err;
@@ -329,14 +580,39 @@ static int ProductBlockMap(const std::string& path, const std::string& map_file,
         }
     }
 
+    // Map the whole file up front with a handful of FIEMAP calls. If the filesystem can't give
+    // clean extents, fall back to walking the file one FIBMAP ioctl per block.
+    bool use_fiemap = false;
+    auto map_start = std::chrono::steady_clock::now();
+    if (std::vector<int> extent_ranges; MapBlocksViaFiemap(fd, path, sb, &extent_ranges)) {
+        ranges = std::move(extent_ranges);
+        use_fiemap = true;
+        LOG(INFO) << "mapped \"" << path << "\" with FIEMAP into " << ranges.size() / 2
+                  << " ranges";
+    }
+    stats->map_time = std::chrono::steady_clock::now() - map_start;
+
     off64_t pos = 0;
     int last_progress = 0;
-    while (pos < sb.st_size) {
+    if (use_fiemap && encrypted) {
+        // The block list is already complete; copy the file contents onto the unencrypted block
+        // device following it, overlapping the reads with the writes.
+        auto copy_start = std::chrono::steady_clock::now();
+        if (int error = CopyBlocksPipelined(fd, wfd, path, sb, ranges, socket);
+            error != kUncryptNoError) {
+            return error;
+        }
+        stats->copy_time = std::chrono::steady_clock::now() - copy_start;
+        stats->bytes_copied = sb.st_size;
+    }
+
+    auto walk_start = std::chrono::steady_clock::now();
+    while (!use_fiemap && pos < sb.st_size) {
         // Update the status file, progress must be between [0, 99].
         int progress = static_cast<int>(100 * (double(pos) / double(sb.st_size)));
         if (progress > last_progress) {
             last_progress = progress;
-            write_status_to_socket(progress, socket);
+            write_progress_to_socket(progress, socket);
         }
 
         if ((tail+1) % WINDOW_SIZE == head) {
@@ -411,6 +687,16 @@ static int ProductBlockMap(const std::string& path, const std::string& map_file,
         ++head_block;
     }
 
+    if (!use_fiemap) {
+        // The FIBMAP walk maps and (when encrypted) copies in one interleaved pass; bill it to
+        // the mapping phase.
+        stats->map_time += std::chrono::steady_clock::now() - walk_start;
+        if (encrypted) {
+            stats->bytes_copied = sb.st_size;
+        }
+    }
+    stats->extents = ranges.size() / 2;
+
     if (!android::base::WriteStringToFd(
             android::base::StringPrintf("%zu\n", ranges.size() / 2), mapfd)) {
         PLOG(ERROR) << "failed to write " << tmp_map_file;
@@ -466,7 +752,8 @@ static int ProductBlockMap(const std::string& path, const std::string& map_file,
     return 0;
 }
 
-static int Uncrypt(const std::string& input_path, const std::string& map_file, int socket) {
+static int Uncrypt(const std::string& input_path, const std::string& map_file, int socket,
+                   UncryptStats* stats) {
   LOG(INFO) << "update package is \"" << input_path << "\"";
 
   // Turn the name of the file we're supposed to convert into an absolute path, so we can find what
@@ -498,7 +785,7 @@ static int Uncrypt(const std::string& input_path, const std::string& map_file, i
   // mounting the partition. On /cache and /sdcard we leave the file alone.
   if (android::base::StartsWith(path, "/data/")) {
     LOG(INFO) << "writing block map " << map_file;
-    return ProductBlockMap(path, map_file, blk_dev, encrypted, f2fs_fs, socket);
+    return ProductBlockMap(path, map_file, blk_dev, encrypted, f2fs_fs, socket, stats);
   }
 
   return 0;
@@ -511,6 +798,76 @@ static void log_uncrypt_error_code(UncryptErrorCode error_code) {
     }
 }
 
+// Identity of the package a prepared block map was built from: path, size, mtime and inode plus
+// a digest over 16 evenly spaced 64 KiB windows of the content (the same sampling the install
+// side uses for its verification token). A package rewritten in place fails the digest; one
+// replaced via rename fails the inode check even when the bytes match, since its blocks moved.
+static std::string PackageToken(const std::string& path) {
+    struct stat sb;
+    if (stat(path.c_str(), &sb) != 0) {
+        return "";
+    }
+    android::base::unique_fd fd(open(path.c_str(), O_RDONLY | O_CLOEXEC));
+    if (fd == -1) {
+        return "";
+    }
+    constexpr uint64_t kSampleWindow = 64 * 1024;
+    constexpr int kSampleCount = 16;
+    uint64_t size = sb.st_size;
+    SHA256_CTX ctx;
+    SHA256_Init(&ctx);
+    std::vector<uint8_t> buffer(kSampleWindow);
+    for (int i = 0; i < kSampleCount; ++i) {
+        uint64_t offset =
+            (size > kSampleWindow) ? (size - kSampleWindow) * i / (kSampleCount - 1) : 0;
+        uint64_t count = std::min<uint64_t>(kSampleWindow, size - offset);
+        if (!android::base::ReadFullyAtOffset(fd, buffer.data(), count, offset)) {
+            return "";
+        }
+        SHA256_Update(&ctx, buffer.data(), count);
+        if (count == size) {
+            break;
+        }
+    }
+    uint8_t digest[SHA256_DIGEST_LENGTH];
+    SHA256_Final(digest, &ctx);
+    return android::base::StringPrintf("%s|%" PRId64 "|%" PRId64 "|%" PRIu64 "|%s", path.c_str(),
+                                       static_cast<int64_t>(sb.st_size),
+                                       static_cast<int64_t>(sb.st_mtime),
+                                       static_cast<uint64_t>(sb.st_ino),
+                                       android::base::HexString(digest, sizeof(digest)).c_str());
+}
+
+// If the PREPARE service already produced a block map for this package and the package hasn't
+// changed since, move the map into place and report how it went. Stale artifacts are discarded
+// so they can't be adopted by a later run either.
+static bool TryAdoptPreparedMap(const std::string& path, const std::string& map_file) {
+    if (map_file != CACHE_BLOCK_MAP) {
+        // The prepared map lives next to CACHE_BLOCK_MAP on /cache; don't try to rename it for
+        // debug runs that write the map elsewhere.
+        return false;
+    }
+    std::string saved;
+    if (!android::base::ReadFileToString(PREPARED_TOKEN, &saved)) {
+        return false;
+    }
+    std::string token = PackageToken(path);
+    if (token.empty() || token != saved) {
+        LOG(INFO) << "prepared block map is stale, discarding";
+        unlink(PREPARED_BLOCK_MAP.c_str());
+        unlink(PREPARED_TOKEN.c_str());
+        return false;
+    }
+    if (rename(PREPARED_BLOCK_MAP.c_str(), map_file.c_str()) != 0) {
+        PLOG(WARNING) << "failed to rename " << PREPARED_BLOCK_MAP << " to " << map_file;
+        unlink(PREPARED_BLOCK_MAP.c_str());
+        unlink(PREPARED_TOKEN.c_str());
+        return false;
+    }
+    unlink(PREPARED_TOKEN.c_str());
+    return true;
+}
+
 static bool uncrypt_wrapper(const char* input_path, const char* map_file, const int socket) {
     // Initialize the uncrypt error to kUncryptErrorPlaceholder.
     log_uncrypt_error_code(kUncryptErrorPlaceholder);
@@ -527,12 +884,36 @@ static bool uncrypt_wrapper(const char* input_path, const char* map_file, const
     }
     CHECK(map_file != nullptr);
 
+    if (TryAdoptPreparedMap(input_path, map_file)) {
+        LOG(INFO) << "using prepared block map for \"" << input_path << "\"";
+        if (!android::base::WriteStringToFile("uncrypt_time: 0\nuncrypt_prepared: 1\n",
+                                              UNCRYPT_STATUS)) {
+            PLOG(WARNING) << "failed to write to " << UNCRYPT_STATUS;
+        }
+        write_status_to_socket(100, socket);
+        return true;
+    }
+
     auto start = std::chrono::system_clock::now();
-    int status = Uncrypt(input_path, map_file, socket);
+    UncryptStats stats;
+    int status = Uncrypt(input_path, map_file, socket, &stats);
     std::chrono::duration<double> duration = std::chrono::system_clock::now() - start;
     int count = static_cast<int>(duration.count());
 
-    std::string uncrypt_message = android::base::StringPrintf("uncrypt_time: %d\n", count);
+    // The per-phase lines break the total down for fleet analysis; consumers that only know
+    // uncrypt_time and uncrypt_error skip the extra keys. Times are in integer milliseconds so
+    // the file stays a list of "key: int" lines.
+    std::string uncrypt_message = android::base::StringPrintf(
+        "uncrypt_time: %d\n"
+        "uncrypt_extents: %zu\n"
+        "uncrypt_bytes: %" PRId64 "\n"
+        "uncrypt_map_ms: %d\n"
+        "uncrypt_copy_ms: %d\n",
+        count, stats.extents, stats.bytes_copied,
+        static_cast<int>(
+            std::chrono::duration_cast<std::chrono::milliseconds>(stats.map_time).count()),
+        static_cast<int>(
+            std::chrono::duration_cast<std::chrono::milliseconds>(stats.copy_time).count()));
     if (status != 0) {
         // Log the time cost and error code if uncrypt fails.
         uncrypt_message += android::base::StringPrintf("uncrypt_error: %d\n", status);
@@ -553,6 +934,42 @@ static bool uncrypt_wrapper(const char* input_path, const char* map_file, const
     return true;
 }
 
+// The PREPARE service: produce the block map ahead of the install request, under a scratch name
+// so a crash mid-write can't be mistaken for a finished map. The token is written only after the
+// map is complete; without a matching token the artifacts are ignored and deleted.
+static bool prepare_uncrypt(const int socket) {
+    std::string package;
+    if (!FindUncryptPackage(UNCRYPT_PATH_FILE, &package)) {
+        write_status_to_socket(-1, socket);
+        return false;
+    }
+
+    unlink(PREPARED_BLOCK_MAP.c_str());
+    unlink(PREPARED_TOKEN.c_str());
+
+    UncryptStats stats;
+    int status = Uncrypt(package, PREPARED_BLOCK_MAP, socket, &stats);
+    if (status != 0) {
+        write_status_to_socket(-1, socket);
+        return false;
+    }
+
+    // Uncrypt() only writes a map for packages on /data; for /cache and /sdcard there is nothing
+    // to prepare and the later install is already cheap.
+    if (access(PREPARED_BLOCK_MAP.c_str(), F_OK) == 0) {
+        std::string token = PackageToken(package);
+        if (token.empty() || !android::base::WriteStringToFile(token, PREPARED_TOKEN)) {
+            PLOG(WARNING) << "failed to record token for prepared block map";
+            unlink(PREPARED_BLOCK_MAP.c_str());
+            write_status_to_socket(-1, socket);
+            return false;
+        }
+    }
+
+    write_status_to_socket(100, socket);
+    return true;
+}
+
 static bool clear_bcb(const int socket) {
     std::string err;
     if (!clear_bootloader_message(&err)) {
@@ -616,10 +1033,12 @@ static void usage(const char* exename) {
     fprintf(stderr, "%s [<package_path> <map_file>]  Uncrypt ota package.\n", exename);
     fprintf(stderr, "%s --clear-bcb  Clear BCB data in misc partition.\n", exename);
     fprintf(stderr, "%s --setup-bcb  Setup BCB data by command file.\n", exename);
+    fprintf(stderr, "%s --prepare  Produce the block map ahead of the install request.\n",
+            exename);
 }
 
 int main(int argc, char** argv) {
-    enum { UNCRYPT, SETUP_BCB, CLEAR_BCB, UNCRYPT_DEBUG } action;
+    enum { UNCRYPT, SETUP_BCB, CLEAR_BCB, PREPARE, UNCRYPT_DEBUG } action;
     const char* input_path = nullptr;
     const char* map_file = CACHE_BLOCK_MAP.c_str();
 
@@ -627,6 +1046,8 @@ int main(int argc, char** argv) {
         action = CLEAR_BCB;
     } else if (argc == 2 && strcmp(argv[1], "--setup-bcb") == 0) {
         action = SETUP_BCB;
+    } else if (argc == 2 && strcmp(argv[1], "--prepare") == 0) {
+        action = PREPARE;
     } else if (argc == 1) {
         action = UNCRYPT;
     } else if (argc == 3) {
@@ -689,6 +1110,9 @@ int main(int argc, char** argv) {
         case CLEAR_BCB:
             success = clear_bcb(socket_fd);
             break;
+        case PREPARE:
+            success = prepare_uncrypt(socket_fd);
+            break;
         default:  // Should never happen.
             LOG(ERROR) << "Invalid uncrypt action code: " << action;
             return 1;
@@ -63,6 +63,9 @@ class UpdateVerifier {
   void set_property_reader(const std::function<std::string(const std::string&)>& property_reader);
 
   std::map<std::string, RangeSet> partition_map_;
+  // The fingerprint of each partition in |partition_map_|, used to tag the verification progress
+  // records so that progress from an interrupted verification of a different OTA is ignored.
+  std::map<std::string, std::string> partition_fingerprints_;
   // The path to the care_map excluding the filename extension; default value:
   // "/data/ota_package/care_map"
   std::string care_map_prefix_;
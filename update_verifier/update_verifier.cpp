@@ -49,7 +49,11 @@
 #include <unistd.h>
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <future>
+#include <memory>
+#include <set>
 #include <thread>
 
 #include <BootControlClient.h>
@@ -66,6 +70,8 @@
 #include <cutils/android_reboot.h>
 
 #include "care_map.pb.h"
+#include "otautil/cpu_topology.h"
+#include "otautil/sysutil.h"
 
 // TODO(xunchang) remove the prefix and use a default path instead.
 constexpr const char* kDefaultCareMapPrefix = "/data/ota_package/care_map";
@@ -133,24 +139,68 @@ std::map<std::string, std::string> UpdateVerifier::FindDmPartitions() {
 
 bool UpdateVerifier::ReadBlocks(const std::string partition_name,
                                 const std::string& dm_block_device, const RangeSet& ranges) {
-  // RangeSet::Split() splits the ranges into multiple groups with same number of blocks (except for
-  // the last group).
-  size_t thread_num = std::thread::hardware_concurrency() ?: 4;
-  std::vector<RangeSet> groups = ranges.Split(thread_num);
+  // The sweep is I/O-bound, so size the pool from the efficiency cluster and keep the threads
+  // there: it runs at first boot, concurrently with services that want the big cores, and a
+  // handful of little cores issuing O_DIRECT reads is enough to keep the device queue full. On
+  // homogeneous systems fall back to one thread per CPU as before.
+  const CpuTopology& topology = GetCpuTopology();
+  size_t thread_num = !topology.efficiency_cpus.empty()
+                          ? topology.efficiency_cpus.size()
+                          : (std::thread::hardware_concurrency() ?: 4);
+
+  static constexpr size_t kBlockSize = 4096;
+  // Cap on a single work item, in blocks. Small enough that a few huge sequential runs still
+  // spread across the threads; large enough that claiming items adds no measurable contention.
+  static constexpr size_t kWorkItemBlocks = (16 << 20) / kBlockSize;
+
+  // A static RangeSet::Split() hands every thread the same number of blocks regardless of
+  // fragmentation, so one thread can draw thousands of tiny discontiguous ranges (each costing a
+  // seek) while another walks one sequential run, and the wall time is set by the unlucky shard.
+  // Chop the ranges into bounded work items instead and let the threads claim the next item as
+  // they finish one, which balances seeks and bytes without having to model either.
+  std::vector<Range> work_items;
+  for (const auto& [range_start, range_end] : ranges) {
+    for (size_t start = range_start; start < range_end; start += kWorkItemBlocks) {
+      work_items.emplace_back(start, std::min(range_end, start + kWorkItemBlocks));
+    }
+  }
+  std::atomic<size_t> next_work_item{ 0 };
 
   std::vector<std::future<bool>> threads;
-  for (const auto& group : groups) {
-    auto thread_func = [&group, &dm_block_device, &partition_name]() {
-      android::base::unique_fd fd(TEMP_FAILURE_RETRY(open(dm_block_device.c_str(), O_RDONLY)));
+  for (size_t t = 0; t < thread_num; ++t) {
+    auto thread_func = [&work_items, &next_work_item, &dm_block_device, &partition_name]() {
+      PinToEfficiencyCores();
+      // This is a one-shot sequential sweep whose data nobody reads again; going through the page
+      // cache at first boot would evict data that services starting up are about to use. Read
+      // O_DIRECT where the dm stack supports it, with a chunk size that grows while reads complete
+      // promptly and shrinks when they stall, so the sweep yields to competing boot-time I/O
+      // instead of monopolizing the queue with 4 MiB requests.
+      static constexpr size_t kMinChunkSize = 64 * kBlockSize;
+      static constexpr size_t kMaxChunkSize = 1024 * kBlockSize;
+      static constexpr auto kSlowRead = std::chrono::milliseconds(50);
+
+      android::base::unique_fd fd(
+          TEMP_FAILURE_RETRY(open(dm_block_device.c_str(), O_RDONLY | O_DIRECT)));
+      if (fd.get() == -1) {
+        fd.reset(TEMP_FAILURE_RETRY(open(dm_block_device.c_str(), O_RDONLY)));
+      }
       if (fd.get() == -1) {
         PLOG(ERROR) << "Error reading " << dm_block_device << " for partition " << partition_name;
         return false;
       }
 
-      static constexpr size_t kBlockSize = 4096;
-      std::vector<uint8_t> buf(1024 * kBlockSize);
+      // O_DIRECT needs a block-aligned buffer; range offsets and sizes are already block-aligned.
+      std::unique_ptr<uint8_t, decltype(&free)> buf(
+          static_cast<uint8_t*>(aligned_alloc(kBlockSize, kMaxChunkSize)), &free);
+      if (buf == nullptr) {
+        PLOG(ERROR) << "Failed to allocate read buffer";
+        return false;
+      }
 
-      for (const auto& [range_start, range_end] : group) {
+      size_t chunk = kMinChunkSize;
+      for (size_t i = next_work_item.fetch_add(1); i < work_items.size();
+           i = next_work_item.fetch_add(1)) {
+        const auto& [range_start, range_end] = work_items[i];
         if (lseek64(fd.get(), static_cast<off64_t>(range_start) * kBlockSize, SEEK_SET) == -1) {
           PLOG(ERROR) << "lseek to " << range_start << " failed";
           return false;
@@ -158,12 +208,18 @@ bool UpdateVerifier::ReadBlocks(const std::string partition_name,
 
         size_t remain = (range_end - range_start) * kBlockSize;
         while (remain > 0) {
-          size_t to_read = std::min(remain, 1024 * kBlockSize);
-          if (!android::base::ReadFully(fd.get(), buf.data(), to_read)) {
+          size_t to_read = std::min(remain, chunk);
+          auto read_start = std::chrono::steady_clock::now();
+          if (!android::base::ReadFully(fd.get(), buf.get(), to_read)) {
             PLOG(ERROR) << "Failed to read blocks " << range_start << " to " << range_end;
             return false;
           }
           remain -= to_read;
+          if (std::chrono::steady_clock::now() - read_start > kSlowRead) {
+            chunk = std::max(chunk / 2, kMinChunkSize);
+          } else if (chunk < kMaxChunkSize) {
+            chunk *= 2;
+          }
         }
       }
       return true;
@@ -203,28 +259,69 @@ bool UpdateVerifier::VerifyPartitions() {
 
   LOG(INFO) << "Partitions not verified by snapuserd daemon";
 
-  auto dm_block_devices = FindDmPartitions();
-  if (dm_block_devices.empty()) {
-    LOG(ERROR) << "No dm-enabled block device is found.";
-    return false;
+  // Load the per-partition progress left behind by an interrupted verification, so a reboot in
+  // the middle of reading a large super partition doesn't restart the whole pass. Each record is
+  // "<partition_name> <fingerprint>"; a record whose fingerprint doesn't match the current build
+  // belongs to a different OTA and is ignored.
+  std::string progress_path = care_map_prefix_ + ".progress";
+  std::set<std::string> verified_partitions;
+  if (std::string content; android::base::ReadFileToString(progress_path, &content)) {
+    for (const auto& line : android::base::Split(content, "\n")) {
+      std::vector<std::string> record = android::base::Split(line, " ");
+      if (record.size() != 2) continue;
+      if (auto it = partition_fingerprints_.find(record[0]);
+          it != partition_fingerprints_.end() && it->second == record[1]) {
+        LOG(INFO) << "Skip reading partition " << record[0]
+                  << ": verified before the last interruption";
+        verified_partitions.insert(record[0]);
+      }
+    }
   }
 
+  std::map<std::string, RangeSet> pending_partitions;
   for (const auto& [partition_name, ranges] : partition_map_) {
-    if (dm_block_devices.find(partition_name) == dm_block_devices.end()) {
-      LOG(ERROR) << "Failed to find dm block device for " << partition_name;
-      return false;
+    if (verified_partitions.find(partition_name) == verified_partitions.end()) {
+      pending_partitions.emplace(partition_name, ranges);
     }
+  }
 
-    if (!ReadBlocks(partition_name, dm_block_devices.at(partition_name), ranges)) {
+  if (!pending_partitions.empty()) {
+    auto dm_block_devices = FindDmPartitions();
+    if (dm_block_devices.empty()) {
+      LOG(ERROR) << "No dm-enabled block device is found.";
       return false;
     }
+
+    for (const auto& [partition_name, ranges] : pending_partitions) {
+      if (dm_block_devices.find(partition_name) == dm_block_devices.end()) {
+        LOG(ERROR) << "Failed to find dm block device for " << partition_name;
+        return false;
+      }
+
+      if (!ReadBlocks(partition_name, dm_block_devices.at(partition_name), ranges)) {
+        return false;
+      }
+
+      // Record the partition before moving on, so an interrupted verification resumes from the
+      // next one.
+      verified_partitions.insert(partition_name);
+      std::string progress;
+      for (const auto& name : verified_partitions) {
+        progress += name + " " + partition_fingerprints_[name] + "\n";
+      }
+      if (!android::base::WriteStringToFile(progress, progress_path)) {
+        PLOG(WARNING) << "Failed to write " << progress_path;
+      }
+    }
   }
 
+  unlink(progress_path.c_str());
   return true;
 }
 
 bool UpdateVerifier::ParseCareMap() {
   partition_map_.clear();
+  partition_fingerprints_.clear();
 
   std::string care_map_name = care_map_prefix_ + ".pb";
   if (access(care_map_name.c_str(), R_OK) == -1) {
@@ -232,28 +329,25 @@ bool UpdateVerifier::ParseCareMap() {
     return false;
   }
 
-  android::base::unique_fd care_map_fd(TEMP_FAILURE_RETRY(open(care_map_name.c_str(), O_RDONLY)));
+  // Map the file instead of copying it onto the heap; the care map runs to several MB on devices
+  // with many dynamic partitions, and the protobuf parser can read the records straight out of
+  // the page cache.
+  MemMapping care_map_data;
   // If the device is flashed before the current boot, it may not have care_map.txt in
   // /data/ota_package. To allow the device to continue booting in this situation, we should
   // print a warning and skip the block verification.
-  if (care_map_fd.get() == -1) {
-    PLOG(WARNING) << "Failed to open " << care_map_name;
-    return false;
-  }
-
-  std::string file_content;
-  if (!android::base::ReadFdToString(care_map_fd.get(), &file_content)) {
-    PLOG(WARNING) << "Failed to read " << care_map_name;
+  if (!care_map_data.MapFile(care_map_name)) {
+    LOG(WARNING) << "Failed to map " << care_map_name;
     return false;
   }
 
-  if (file_content.empty()) {
+  if (care_map_data.length == 0) {
     LOG(WARNING) << "Unexpected empty care map";
     return false;
   }
 
   recovery_update_verifier::CareMap care_map;
-  if (!care_map.ParseFromString(file_content)) {
+  if (!care_map.ParseFromArray(care_map_data.addr, static_cast<int>(care_map_data.length))) {
     LOG(WARNING) << "Failed to parse " << care_map_name << " in protobuf format.";
     return false;
   }
@@ -289,6 +383,7 @@ bool UpdateVerifier::ParseCareMap() {
     }
 
     partition_map_.emplace(partition.name(), ranges);
+    partition_fingerprints_.emplace(partition.name(), fingerprint);
   }
 
   if (partition_map_.empty()) {
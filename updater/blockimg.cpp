@@ -27,21 +27,31 @@
 #include <string.h>
 #include <sys/ioctl.h>
 #include <sys/stat.h>
+#include <sys/sysmacros.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <time.h>
 #include <unistd.h>
 
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <functional>
+#include <map>
+#include <future>
 #include <limits>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 
 #include <android-base/file.h>
 #include <android-base/logging.h>
 #include <android-base/parseint.h>
+#include <android-base/properties.h>
 #include <android-base/stringprintf.h>
 #include <android-base/strings.h>
 #include <android-base/unique_fd.h>
@@ -51,16 +61,22 @@
 #include <openssl/sha.h>
 #include <verity/hash_tree_builder.h>
 #include <ziparchive/zip_archive.h>
+#include <zstd.h>
 
 #include "edify/expr.h"
 #include "edify/updater_interface.h"
+#include "otautil/cpu_topology.h"
 #include "otautil/dirutil.h"
 #include "otautil/error_code.h"
+#include "otautil/hang_watchdog.h"
 #include "otautil/paths.h"
 #include "otautil/print_sha1.h"
 #include "otautil/rangeset.h"
+#include "otautil/sysutil.h"
+#include "otautil/trace.h"
 #include "private/commands.h"
 #include "updater/install.h"
+#include "updater/memory_budget.h"
 
 #ifdef __ANDROID__
 #include <private/android_filesystem_config.h>
@@ -73,6 +89,7 @@
 #endif  // __ANDROID__
 
 static constexpr size_t BLOCKSIZE = 4096;
+static constexpr size_t kTransferListHeaderLines = 4;
 static constexpr mode_t STASH_DIRECTORY_MODE = 0700;
 static constexpr mode_t STASH_FILE_MODE = 0600;
 static constexpr mode_t MARKER_DIRECTORY_MODE = 0700;
@@ -81,6 +98,55 @@ static CauseCode failure_type = kNoCause;
 static bool is_retry = false;
 static std::unordered_map<std::string, RangeSet> stash_map;
 
+// In-memory copies of recently stashed blocks, keyed by stash id. The on-disk stash remains the
+// source of truth for resuming an interrupted update; the cache only saves the read-back from
+// /cache when a stash is consumed within the same run, which is the common case. Entries that
+// don't fit in the budget simply stay on disk.
+static constexpr size_t kStashCacheBudget = 32 * 1024 * 1024;
+static std::mutex stash_cache_mutex;
+static std::unordered_map<std::string, std::vector<uint8_t>> stash_cache;
+static size_t stash_cache_bytes = 0;
+
+static void StashCachePut(const std::string& id, const uint8_t* data, size_t size) {
+  std::lock_guard<std::mutex> lock(stash_cache_mutex);
+  if (stash_cache.find(id) != stash_cache.end()) {
+    return;
+  }
+  if (stash_cache_bytes + size > kStashCacheBudget) {
+    return;  // Over budget; the entry is still available from disk.
+  }
+  stash_cache.emplace(id, std::vector<uint8_t>(data, data + size));
+  stash_cache_bytes += size;
+}
+
+static bool StashCacheGet(const std::string& id, std::vector<uint8_t>* buffer) {
+  std::lock_guard<std::mutex> lock(stash_cache_mutex);
+  auto it = stash_cache.find(id);
+  if (it == stash_cache.end()) {
+    return false;
+  }
+  if (buffer->size() < it->second.size()) {
+    buffer->resize(it->second.size());
+  }
+  std::copy(it->second.begin(), it->second.end(), buffer->begin());
+  return true;
+}
+
+static void StashCacheEvict(const std::string& id) {
+  std::lock_guard<std::mutex> lock(stash_cache_mutex);
+  auto it = stash_cache.find(id);
+  if (it != stash_cache.end()) {
+    stash_cache_bytes -= it->second.size();
+    stash_cache.erase(it);
+  }
+}
+
+static void StashCacheClear() {
+  std::lock_guard<std::mutex> lock(stash_cache_mutex);
+  stash_cache.clear();
+  stash_cache_bytes = 0;
+}
+
 static void DeleteLastCommandFile() {
   const std::string& last_command_file = Paths::Get().last_command_file();
   if (unlink(last_command_file.c_str()) == -1 && errno != ENOENT) {
@@ -226,15 +292,75 @@ static void allocate(size_t size, std::vector<uint8_t>* buffer) {
   buffer->resize(size);
 }
 
+// Preferred size of a single write submission to the target device. The floor is safe everywhere;
+// ProbeBlockDeviceTopology() raises it to the device's advertised optimal I/O size, so that e.g.
+// UFS devices get the 1-4 MiB aligned writes they want instead of a trickle of small ones. The
+// cap bounds the corresponding userspace staging buffers.
+static constexpr size_t kMinWriteChunk = 256 * 1024;
+static constexpr size_t kMaxWriteChunk = 4 * 1024 * 1024;
+static size_t write_chunk_size = kMinWriteChunk;
+
+// Reads a single numeric request-queue attribute; returns 0 when the attribute is missing or
+// malformed, which callers treat as "not reported".
+static size_t ReadQueueAttribute(const std::string& queue_dir, const std::string& attribute) {
+  std::string content;
+  if (!android::base::ReadFileToString(queue_dir + "/" + attribute, &content)) {
+    return 0;
+  }
+  size_t value;
+  if (!android::base::ParseUint(android::base::Trim(content), &value)) {
+    return 0;
+  }
+  return value;
+}
+
+// Probes the request-queue topology of the block device behind |fd| and sizes the write staging
+// buffers from it. Partition nodes don't carry a queue directory of their own, so fall back to
+// the parent disk's. Regular files (the host simulator) and devices that report nothing keep the
+// defaults.
+static void ProbeBlockDeviceTopology(int fd) {
+  write_chunk_size = kMinWriteChunk;
+
+  struct stat sb;
+  if (fstat(fd, &sb) != 0 || !S_ISBLK(sb.st_mode)) {
+    return;
+  }
+
+  std::string base = android::base::StringPrintf("/sys/dev/block/%u:%u", major(sb.st_rdev),
+                                                 minor(sb.st_rdev));
+  std::string queue_dir = base + "/queue";
+  struct stat queue_sb;
+  if (stat(queue_dir.c_str(), &queue_sb) != 0) {
+    queue_dir = base + "/../queue";
+  }
+
+  size_t optimal_io_size = ReadQueueAttribute(queue_dir, "optimal_io_size");
+  size_t discard_granularity = ReadQueueAttribute(queue_dir, "discard_granularity");
+
+  if (optimal_io_size > 0) {
+    // Round up to a whole number of blocks and clamp into the supported window.
+    size_t chunk = (optimal_io_size + BLOCKSIZE - 1) / BLOCKSIZE * BLOCKSIZE;
+    write_chunk_size = std::min(std::max(chunk, kMinWriteChunk), kMaxWriteChunk);
+  }
+
+  LOG(INFO) << "block device topology: optimal_io_size " << optimal_io_size
+            << ", discard_granularity " << discard_granularity << "; using " << write_chunk_size
+            << " byte write chunks";
+}
+
 /**
  * RangeSinkWriter reads data from the given FD, and writes them to the destination specified by the
  * given RangeSet.
  */
 class RangeSinkWriter {
  public:
-  RangeSinkWriter(int fd, const RangeSet& tgt)
+  // With |skip_writes| set the writer consumes its input and advances the cursor without
+  // touching the device; used when the target ranges are known to hold the data already (e.g. a
+  // synced 'new' command being replayed for stream alignment on resume).
+  RangeSinkWriter(int fd, const RangeSet& tgt, bool skip_writes = false)
       : fd_(fd),
         tgt_(tgt),
+        skip_writes_(skip_writes),
         next_range_(0),
         current_range_left_(0),
         bytes_written_(0) {
@@ -268,7 +394,7 @@ class RangeSinkWriter {
         write_now = current_range_left_;
       }
 
-      if (!android::base::WriteFully(fd_, data, write_now)) {
+      if (!skip_writes_ && !android::base::WriteFully(fd_, data, write_now)) {
         failure_type = errno == EIO ? kEioFailure : kFwriteFailure;
         PLOG(ERROR) << "Failed to write " << write_now << " bytes of data";
         break;
@@ -307,6 +433,9 @@ class RangeSinkWriter {
     current_range_left_ = (range.second - range.first) * BLOCKSIZE;
     next_range_++;
 
+    if (skip_writes_) {
+      return true;
+    }
     if (!discard_blocks(fd_, offset, current_range_left_)) {
       return false;
     }
@@ -320,6 +449,8 @@ class RangeSinkWriter {
   int fd_;
   // The destination ranges for the data.
   const RangeSet& tgt_;
+  // Consume input without writing to fd_.
+  bool skip_writes_;
   // The next range that we should write to.
   size_t next_range_;
   // The number of bytes to write before moving to the next range.
@@ -328,6 +459,91 @@ class RangeSinkWriter {
   size_t bytes_written_;
 };
 
+/**
+ * AsyncSinkWriter decouples patch generation from target writes: Write() enqueues the produced
+ * bytes and returns immediately, while a drain thread feeds them to the underlying
+ * RangeSinkWriter. This keeps bspatch/imgpatch computing the next chunk while the previous one is
+ * still being written out. The queue is bounded so a slow device can't pull the whole patched
+ * image into memory.
+ */
+class AsyncSinkWriter {
+ public:
+  explicit AsyncSinkWriter(RangeSinkWriter* writer) : writer_(writer) {
+    drain_ = std::async(std::launch::async, [this]() { DrainLoop(); });
+  }
+
+  ~AsyncSinkWriter() {
+    {
+      std::lock_guard<std::mutex> lock(mu_);
+      done_ = true;
+    }
+    cv_.notify_all();
+    if (drain_.valid()) {
+      drain_.wait();
+    }
+  }
+
+  // Mirrors the RangeSinkWriter contract: returns the number of bytes accepted, with 0
+  // indicating a (possibly earlier, asynchronous) write failure.
+  size_t Write(const uint8_t* data, size_t size) {
+    std::unique_lock<std::mutex> lock(mu_);
+    cv_.wait(lock, [this]() { return failed_ || queued_bytes_ < kQueueLimit; });
+    if (failed_) {
+      return 0;
+    }
+    queue_.emplace_back(data, data + size);
+    queued_bytes_ += size;
+    cv_.notify_all();
+    return size;
+  }
+
+  // Waits for all enqueued bytes to reach the RangeSinkWriter. Returns false if any write failed.
+  bool Finish() {
+    std::unique_lock<std::mutex> lock(mu_);
+    done_ = true;
+    cv_.notify_all();
+    cv_.wait(lock, [this]() { return drained_; });
+    return !failed_;
+  }
+
+ private:
+  void DrainLoop() {
+    std::unique_lock<std::mutex> lock(mu_);
+    while (true) {
+      cv_.wait(lock, [this]() { return !queue_.empty() || done_; });
+      if (queue_.empty()) {
+        break;
+      }
+      std::vector<uint8_t> chunk = std::move(queue_.front());
+      queue_.pop_front();
+      lock.unlock();
+      size_t written = writer_->Write(chunk.data(), chunk.size());
+      lock.lock();
+      queued_bytes_ -= chunk.size();
+      if (written != chunk.size()) {
+        failed_ = true;
+        queue_.clear();
+        queued_bytes_ = 0;
+      }
+      cv_.notify_all();
+    }
+    drained_ = true;
+    cv_.notify_all();
+  }
+
+  static constexpr size_t kQueueLimit = 4 * 1024 * 1024;
+
+  RangeSinkWriter* writer_;
+  std::deque<std::vector<uint8_t>> queue_;
+  size_t queued_bytes_{ 0 };
+  bool done_{ false };
+  bool failed_{ false };
+  bool drained_{ false };
+  std::mutex mu_;
+  std::condition_variable cv_;
+  std::future<void> drain_;
+};
+
 /**
  * All of the data for all the 'new' transfers is contained in one file in the update package,
  * concatenated together in the order in which transfers.list will need it. We want to stream it out
@@ -350,22 +566,37 @@ struct NewThreadInfo {
   ZipArchiveHandle za;
   ZipEntry64 entry{};
   bool brotli_compressed;
+  bool zstd_compressed;
 
   std::unique_ptr<RangeSinkWriter> writer;
   BrotliDecoderState* brotli_decoder_state;
+  ZSTD_DStream* zstd_stream;
   bool receiver_available;
 
+  // Decompressed bytes buffered ahead of the next 'new' command, so the background thread keeps
+  // inflating while the main thread is busy with other commands. Bounded by readahead_limit;
+  // protected by mu.
+  std::vector<uint8_t> pending;
+  size_t readahead_limit;
+
   pthread_mutex_t mu;
   pthread_cond_t cv;
 };
 
+// Default bound for NewThreadInfo::pending. Large enough to ride out a long run of move/diff
+// commands between two 'new' commands, small enough not to matter against the stash budget. The
+// memory budget may shrink the window down to the floor on low-RAM devices; below one block-sized
+// chunk the background thread would make no forward progress.
+static constexpr size_t kNewDataReadAheadLimit = 8 * 1024 * 1024;
+static constexpr size_t kMinNewDataReadAhead = 1024 * 1024;
+
 static bool receive_new_data(const uint8_t* data, size_t size, void* cookie) {
   NewThreadInfo* nti = static_cast<NewThreadInfo*>(cookie);
 
   while (size > 0) {
-    // Wait for nti->writer to be non-null, indicating some of this data is wanted.
+    // Wait for nti->writer to be non-null, or for room in the read-ahead buffer.
     pthread_mutex_lock(&nti->mu);
-    while (nti->writer == nullptr) {
+    while (nti->writer == nullptr && nti->pending.size() >= nti->readahead_limit) {
       // End the new data receiver if we encounter an error when performing block image update.
       if (!nti->receiver_available) {
         pthread_mutex_unlock(&nti->mu);
@@ -373,6 +604,20 @@ static bool receive_new_data(const uint8_t* data, size_t size, void* cookie) {
       }
       pthread_cond_wait(&nti->cv, &nti->mu);
     }
+    if (!nti->receiver_available) {
+      pthread_mutex_unlock(&nti->mu);
+      return false;
+    }
+
+    if (nti->writer == nullptr) {
+      // No command is consuming data right now; buffer ahead so the unzip thread keeps going.
+      size_t take = std::min(size, nti->readahead_limit - nti->pending.size());
+      nti->pending.insert(nti->pending.end(), data, data + take);
+      data += take;
+      size -= take;
+      pthread_mutex_unlock(&nti->mu);
+      continue;
+    }
     pthread_mutex_unlock(&nti->mu);
 
     // At this point nti->writer is set, and we own it. The main thread is waiting for it to
@@ -403,9 +648,9 @@ static bool receive_brotli_new_data(const uint8_t* data, size_t size, void* cook
   NewThreadInfo* nti = static_cast<NewThreadInfo*>(cookie);
 
   while (size > 0 || BrotliDecoderHasMoreOutput(nti->brotli_decoder_state)) {
-    // Wait for nti->writer to be non-null, indicating some of this data is wanted.
+    // Wait for nti->writer to be non-null, or for room in the read-ahead buffer.
     pthread_mutex_lock(&nti->mu);
-    while (nti->writer == nullptr) {
+    while (nti->writer == nullptr && nti->pending.size() >= nti->readahead_limit) {
       // End the receiver if we encounter an error when performing block image update.
       if (!nti->receiver_available) {
         pthread_mutex_unlock(&nti->mu);
@@ -413,20 +658,27 @@ static bool receive_brotli_new_data(const uint8_t* data, size_t size, void* cook
       }
       pthread_cond_wait(&nti->cv, &nti->mu);
     }
-    pthread_mutex_unlock(&nti->mu);
+    if (!nti->receiver_available) {
+      pthread_mutex_unlock(&nti->mu);
+      return false;
+    }
 
-    // At this point nti->writer is set, and we own it. The main thread is waiting for it to
-    // disappear from nti.
+    // With no writer set we decompress ahead into the bounded pending buffer; otherwise we own
+    // the writer until it's cleared. The main thread is waiting for it to disappear from nti.
+    bool buffering = (nti->writer == nullptr);
+    size_t room =
+        buffering ? nti->readahead_limit - nti->pending.size() : nti->writer->AvailableSpace();
+    pthread_mutex_unlock(&nti->mu);
 
-    size_t buffer_size = std::min<size_t>(32768, nti->writer->AvailableSpace());
+    size_t buffer_size = std::min<size_t>(write_chunk_size, room);
     if (buffer_size == 0) {
       LOG(ERROR) << "No space left in output range";
       return false;
     }
-    uint8_t buffer[buffer_size];
+    std::vector<uint8_t> buffer(buffer_size);
     size_t available_in = size;
     size_t available_out = buffer_size;
-    uint8_t* next_out = buffer;
+    uint8_t* next_out = buffer.data();
 
     // The brotli decoder will update |data|, |available_in|, |next_out| and |available_out|.
     BrotliDecoderResult result = BrotliDecoderDecompressStream(
@@ -442,7 +694,15 @@ static bool receive_brotli_new_data(const uint8_t* data, size_t size, void* cook
                << size - available_in << ", decoder status " << result;
 
     size_t write_now = buffer_size - available_out;
-    if (nti->writer->Write(buffer, write_now) != write_now) {
+    if (buffering) {
+      pthread_mutex_lock(&nti->mu);
+      nti->pending.insert(nti->pending.end(), buffer.data(), buffer.data() + write_now);
+      pthread_mutex_unlock(&nti->mu);
+      size = available_in;
+      continue;
+    }
+
+    if (nti->writer->Write(buffer.data(), write_now) != write_now) {
       LOG(ERROR) << "Failed to write " << write_now << " bytes.";
       return false;
     }
@@ -463,10 +723,89 @@ static bool receive_brotli_new_data(const uint8_t* data, size_t size, void* cook
   return true;
 }
 
+static bool receive_zstd_new_data(const uint8_t* data, size_t size, void* cookie) {
+  NewThreadInfo* nti = static_cast<NewThreadInfo*>(cookie);
+
+  ZSTD_inBuffer input{ data, size, 0 };
+  // A full output buffer means the decoder may still hold flushable data, so keep draining even
+  // after the input chunk has been consumed.
+  bool output_full = false;
+  while (input.pos < input.size || output_full) {
+    // Wait for nti->writer to be non-null, or for room in the read-ahead buffer.
+    pthread_mutex_lock(&nti->mu);
+    while (nti->writer == nullptr && nti->pending.size() >= nti->readahead_limit) {
+      // End the receiver if we encounter an error when performing block image update.
+      if (!nti->receiver_available) {
+        pthread_mutex_unlock(&nti->mu);
+        return false;
+      }
+      pthread_cond_wait(&nti->cv, &nti->mu);
+    }
+    if (!nti->receiver_available) {
+      pthread_mutex_unlock(&nti->mu);
+      return false;
+    }
+
+    // With no writer set we decompress ahead into the bounded pending buffer; otherwise we own
+    // the writer until it's cleared. The main thread is waiting for it to disappear from nti.
+    bool buffering = (nti->writer == nullptr);
+    size_t room =
+        buffering ? nti->readahead_limit - nti->pending.size() : nti->writer->AvailableSpace();
+    pthread_mutex_unlock(&nti->mu);
+
+    size_t buffer_size = std::min<size_t>(write_chunk_size, room);
+    if (buffer_size == 0) {
+      LOG(ERROR) << "No space left in output range";
+      return false;
+    }
+    std::vector<uint8_t> buffer(buffer_size);
+    ZSTD_outBuffer output{ buffer.data(), buffer_size, 0 };
+
+    size_t result = ZSTD_decompressStream(nti->zstd_stream, &output, &input);
+    if (ZSTD_isError(result)) {
+      LOG(ERROR) << "Decompression failed with " << ZSTD_getErrorName(result);
+      return false;
+    }
+    output_full = (output.pos == output.size);
+
+    LOG(DEBUG) << "bytes to write: " << output.pos << ", bytes consumed " << input.pos
+               << ", decoder status " << result;
+
+    size_t write_now = output.pos;
+    if (buffering) {
+      pthread_mutex_lock(&nti->mu);
+      nti->pending.insert(nti->pending.end(), buffer.data(), buffer.data() + write_now);
+      pthread_mutex_unlock(&nti->mu);
+      continue;
+    }
+
+    if (nti->writer->Write(buffer.data(), write_now) != write_now) {
+      LOG(ERROR) << "Failed to write " << write_now << " bytes.";
+      return false;
+    }
+
+    if (nti->writer->Finished()) {
+      // We have written all the bytes desired by this writer.
+
+      pthread_mutex_lock(&nti->mu);
+      nti->writer = nullptr;
+      pthread_cond_broadcast(&nti->cv);
+      pthread_mutex_unlock(&nti->mu);
+    }
+  }
+
+  return true;
+}
+
 static void* unzip_new_data(void* cookie) {
   NewThreadInfo* nti = static_cast<NewThreadInfo*>(cookie);
+  // The decompress-ahead thread mostly waits on the consumer once its window is full; run it on
+  // the efficiency cluster so it never displaces a patch worker from a big core.
+  PinToEfficiencyCores();
   if (nti->brotli_compressed) {
     ProcessZipEntryContents(nti->za, &nti->entry, receive_brotli_new_data, nti);
+  } else if (nti->zstd_compressed) {
+    ProcessZipEntryContents(nti->za, &nti->entry, receive_zstd_new_data, nti);
   } else {
     ProcessZipEntryContents(nti->za, &nti->entry, receive_new_data, nti);
   }
@@ -479,15 +818,44 @@ static void* unzip_new_data(void* cookie) {
   return nullptr;
 }
 
+// Merges adjacent entries of |ranges| so the block layer sees fewer, larger requests. The data
+// for a RangeSet is laid out consecutively in the transfer buffer, so two ranges can be combined
+// into a single submission whenever the first one ends where the next begins. Transfer lists
+// generated by the build system routinely contain runs of small back-to-back ranges, and the
+// per-request overhead is measurable.
+static std::vector<Range> CoalesceRanges(const RangeSet& ranges) {
+  std::vector<Range> merged;
+  merged.reserve(ranges.size());
+  for (const auto& range : ranges) {
+    if (!merged.empty() && merged.back().second == range.first) {
+      merged.back().second = range.second;
+    } else {
+      merged.push_back(range);
+    }
+  }
+  return merged;
+}
+
 static int ReadBlocks(const RangeSet& src, std::vector<uint8_t>* buffer, int fd) {
   size_t p = 0;
-  for (const auto& [begin, end] : src) {
-    if (!check_lseek(fd, static_cast<off64_t>(begin) * BLOCKSIZE, SEEK_SET)) {
-      return -1;
+  std::vector<Range> ranges = CoalesceRanges(src);
+  for (size_t i = 0; i < ranges.size(); i++) {
+    const auto& [begin, end] = ranges[i];
+    off64_t offset = static_cast<off64_t>(begin) * BLOCKSIZE;
+    size_t size = (end - begin) * BLOCKSIZE;
+
+    // Ask the kernel to start fetching the next range asynchronously, so the device keeps
+    // working while we consume the current range. Transfer lists routinely contain tens of
+    // thousands of small ranges; without the overlap the per-range latency adds up.
+    if (i + 1 < ranges.size()) {
+      const auto& [next_begin, next_end] = ranges[i + 1];
+      posix_fadvise64(fd, static_cast<off64_t>(next_begin) * BLOCKSIZE,
+                      (next_end - next_begin) * BLOCKSIZE, POSIX_FADV_WILLNEED);
     }
 
-    size_t size = (end - begin) * BLOCKSIZE;
-    if (!android::base::ReadFully(fd, buffer->data() + p, size)) {
+    // Positioned reads don't touch the fd offset, which keeps this safe to call from the
+    // parallel command workers sharing a block device.
+    if (!android::base::ReadFullyAtOffset(fd, buffer->data() + p, size, offset)) {
       failure_type = errno == EIO ? kEioFailure : kFreadFailure;
       PLOG(ERROR) << "Failed to read " << size << " bytes of data";
       return -1;
@@ -501,18 +869,14 @@ static int ReadBlocks(const RangeSet& src, std::vector<uint8_t>* buffer, int fd)
 
 static int WriteBlocks(const RangeSet& tgt, const std::vector<uint8_t>& buffer, int fd) {
   size_t written = 0;
-  for (const auto& [begin, end] : tgt) {
+  for (const auto& [begin, end] : CoalesceRanges(tgt)) {
     off64_t offset = static_cast<off64_t>(begin) * BLOCKSIZE;
     size_t size = (end - begin) * BLOCKSIZE;
     if (!discard_blocks(fd, offset, size)) {
       return -1;
     }
 
-    if (!check_lseek(fd, offset, SEEK_SET)) {
-      return -1;
-    }
-
-    if (!android::base::WriteFully(fd, buffer.data() + written, size)) {
+    if (!android::base::WriteFullyAtOffset(fd, buffer.data() + written, size, offset)) {
       failure_type = errno == EIO ? kEioFailure : kFwriteFailure;
       PLOG(ERROR) << "Failed to write " << size << " bytes of data";
       return -1;
@@ -544,9 +908,66 @@ struct CommandParameters {
     pthread_t thread;
     std::vector<uint8_t> buffer;
     uint8_t* patch_start;
+    // The mapping of the whole package, for access-pattern hints on the patch windows; may be
+    // nullptr.
+    const MemMapping* package_map{ nullptr };
     bool target_verified;  // The target blocks have expected contents already.
+    // Set while resuming for 'new' commands at or before the saved resume index. Their data has
+    // already been written and synced; the stream still has to be decompressed in order to stay
+    // aligned, but the target writes can be skipped.
+    bool new_skip_writes{ false };
 };
 
+// Writes the payload of a move command, skipping the chunks that already sit at their target
+// location. Moves with overlapping source and target ranges usually shift only part of the data,
+// so runs of blocks whose source and target numbers coincide never need to touch the disk.
+static int WriteMovedBlocks(CommandParameters& params, const RangeSet& tgt) {
+  RangeSet src;
+  // Only the plain "<hash> <tgt_range> <src_blk_count> <src_range>" form keeps the buffer in
+  // source order; moves involving stashes or a <src_loc> rearrangement write everything.
+  if (params.tokens.size() == 5 && params.tokens[4] != "-") {
+    src = RangeSet::Parse(params.tokens[4]);
+  }
+  if (!src || !src.Overlaps(tgt)) {
+    return WriteBlocks(tgt, params.buffer, params.fd);
+  }
+
+  size_t blocks = tgt.blocks();
+  size_t skipped = 0;
+  size_t i = 0;
+  while (i < blocks) {
+    // Extend a run of blocks that either all stay in place or all move to a contiguous target.
+    bool in_place = src.GetBlockNumber(i) == tgt.GetBlockNumber(i);
+    size_t j = i + 1;
+    while (j < blocks && tgt.GetBlockNumber(j) == tgt.GetBlockNumber(j - 1) + 1 &&
+           (src.GetBlockNumber(j) == tgt.GetBlockNumber(j)) == in_place) {
+      j++;
+    }
+
+    if (in_place) {
+      skipped += j - i;
+    } else {
+      off64_t offset = static_cast<off64_t>(tgt.GetBlockNumber(i)) * BLOCKSIZE;
+      size_t size = (j - i) * BLOCKSIZE;
+      if (!discard_blocks(params.fd, offset, size)) {
+        return -1;
+      }
+      if (!android::base::WriteFullyAtOffset(params.fd, params.buffer.data() + i * BLOCKSIZE, size,
+                                             offset)) {
+        failure_type = errno == EIO ? kEioFailure : kFwriteFailure;
+        PLOG(ERROR) << "Failed to write " << size << " bytes of data";
+        return -1;
+      }
+    }
+    i = j;
+  }
+
+  if (skipped > 0) {
+    LOG(INFO) << "  " << skipped << " of " << blocks << " moved blocks already in place";
+  }
+  return 0;
+}
+
 // Print the hash in hex for corrupted source blocks (excluding the stashed blocks which is
 // handled separately).
 static void PrintHashForCorruptedSourceBlocks(const CommandParameters& params,
@@ -650,19 +1071,36 @@ static void PrintHashForMissingStashedBlocks(const std::string& id, int fd) {
   PrintHashForCorruptedStashedBlocks(id, buffer, src);
 }
 
+// Compares a raw SHA-1 digest against its expected lower-case hex form without formatting the
+// digest into a temporary string. VerifyBlocks runs once or twice per transfer command, so the
+// hot path shouldn't allocate.
+static bool DigestEqualsHex(const uint8_t digest[SHA_DIGEST_LENGTH], const std::string& hex) {
+  if (hex.size() != SHA_DIGEST_LENGTH * 2) {
+    return false;
+  }
+  static constexpr char kHexChars[] = "0123456789abcdef";
+  for (size_t i = 0; i < SHA_DIGEST_LENGTH; i++) {
+    if (hex[i * 2] != kHexChars[digest[i] >> 4] || hex[i * 2 + 1] != kHexChars[digest[i] & 0xf]) {
+      return false;
+    }
+  }
+  return true;
+}
+
 static int VerifyBlocks(const std::string& expected, const std::vector<uint8_t>& buffer,
                         const size_t blocks, bool printerror) {
+  ScopedTrace trace("verify_blocks");
   uint8_t digest[SHA_DIGEST_LENGTH];
-  const uint8_t* data = buffer.data();
-
-  SHA1(data, blocks * BLOCKSIZE, digest);
 
-  std::string hexdigest = print_sha1(digest);
+  // BoringSSL's SHA1 dispatches to the vectorized (NEON / SHA extension) implementation at
+  // runtime, so the bulk hashing is as fast as the hardware allows; what's left to trim here is
+  // the per-call string work around it.
+  SHA1(buffer.data(), blocks * BLOCKSIZE, digest);
 
-  if (hexdigest != expected) {
+  if (!DigestEqualsHex(digest, expected)) {
     if (printerror) {
-      LOG(ERROR) << "failed to verify blocks (expected " << expected << ", read " << hexdigest
-                 << ")";
+      LOG(ERROR) << "failed to verify blocks (expected " << expected << ", read "
+                 << print_sha1(digest) << ")";
     }
     return -1;
   }
@@ -722,6 +1160,8 @@ static void DeleteStash(const std::string& base) {
 
   LOG(INFO) << "deleting stash " << base;
 
+  StashCacheClear();
+
   std::string dirname = GetStashFileName(base, "", "");
   EnumerateStash(dirname, DeleteFile);
 
@@ -734,6 +1174,7 @@ static void DeleteStash(const std::string& base) {
 
 static int LoadStash(const CommandParameters& params, const std::string& id, bool verify,
                      std::vector<uint8_t>* buffer, bool printnoent) {
+  ScopedTrace trace("load_stash");
   // In verify mode, if source range_set was saved for the given hash, check contents in the source
   // blocks first. If the check fails, search for the stashed files on /cache as usual.
   if (!params.canwrite) {
@@ -756,6 +1197,13 @@ static int LoadStash(const CommandParameters& params, const std::string& id, boo
     }
   }
 
+  // Serve from the in-memory copy when possible; the contents were verified against |id| at the
+  // time they were stashed, so the disk round-trip is pure overhead.
+  if (StashCacheGet(id, buffer)) {
+    LOG(INFO) << " loading stash " << id << " from memory";
+    return 0;
+  }
+
   std::string fn = GetStashFileName(params.stashbase, id, "");
 
   struct stat sb;
@@ -808,6 +1256,7 @@ static int LoadStash(const CommandParameters& params, const std::string& id, boo
 
 static int WriteStash(const std::string& base, const std::string& id, int blocks,
                       const std::vector<uint8_t>& buffer, bool checkspace, bool* exists) {
+  ScopedTrace trace("write_stash");
   if (base.empty()) {
     return -1;
   }
@@ -851,6 +1300,14 @@ static int WriteStash(const std::string& base, const std::string& id, int blocks
     return -1;
   }
 
+  // Reserve the full extent up front so the filesystem can hand out one contiguous allocation
+  // instead of growing the file write by write. Not all filesystems support fallocate; in that
+  // case we just fall back to regular extending writes.
+  if (fallocate(fd, 0, 0, static_cast<off64_t>(blocks) * BLOCKSIZE) == -1 &&
+      errno != EOPNOTSUPP && errno != ENOSYS) {
+    PLOG(WARNING) << "fallocate \"" << fn << "\" failed";
+  }
+
   if (!android::base::WriteFully(fd, buffer.data(), blocks * BLOCKSIZE)) {
     failure_type = errno == EIO ? kEioFailure : kFwriteFailure;
     PLOG(ERROR) << "Failed to write " << blocks * BLOCKSIZE << " bytes of data";
@@ -863,6 +1320,10 @@ static int WriteStash(const std::string& base, const std::string& id, int blocks
     return -1;
   }
 
+  // Stash files are written once and typically read back much later (if at all), so don't let
+  // them push more useful pages out of the cache.
+  posix_fadvise64(fd, 0, static_cast<off64_t>(blocks) * BLOCKSIZE, POSIX_FADV_DONTNEED);
+
   if (rename(fn.c_str(), cn.c_str()) == -1) {
     PLOG(ERROR) << "rename(\"" << fn << "\", \"" << cn << "\") failed";
     return -1;
@@ -873,6 +1334,8 @@ static int WriteStash(const std::string& base, const std::string& id, int blocks
     return -1;
   }
 
+  StashCachePut(id, buffer.data(), blocks * BLOCKSIZE);
+
   return 0;
 }
 
@@ -917,17 +1380,17 @@ static int CreateStash(State* state, size_t maxblocks, const std::string& base)
 
   LOG(INFO) << "using existing stash " << dirname;
 
-  // If the directory already exists, calculate the space already allocated to stash files and check
-  // if there's enough for all required blocks. Delete any partially completed stash files first.
-  EnumerateStash(dirname, [](const std::string& fn) {
-    if (android::base::EndsWith(fn, ".partial")) {
-      DeleteFile(fn);
-    }
-  });
-
+  // If the directory already exists, calculate the space already allocated to stash files and
+  // check if there's enough for all required blocks, deleting any partially completed stash files
+  // along the way. A single directory pass covers both: the file names are the content hashes, so
+  // nothing here needs to be read back or re-hashed to be identified.
   size_t existing = 0;
   EnumerateStash(dirname, [&existing](const std::string& fn) {
     if (fn.empty()) return;
+    if (android::base::EndsWith(fn, ".partial")) {
+      DeleteFile(fn);
+      return;
+    }
     struct stat sb;
     if (stat(fn.c_str(), &sb) == -1) {
       PLOG(ERROR) << "stat \"" << fn << "\" failed";
@@ -953,6 +1416,7 @@ static int FreeStash(const std::string& base, const std::string& id) {
     return -1;
   }
 
+  StashCacheEvict(id);
   DeleteFile(GetStashFileName(base, id, ""));
 
   return 0;
@@ -1192,7 +1656,7 @@ static int PerformCommandMove(CommandParameters& params) {
     if (status == 0) {
       LOG(INFO) << "  moving " << blocks << " blocks";
 
-      if (WriteBlocks(tgt, params.buffer, params.fd) == -1) {
+      if (WriteMovedBlocks(params, tgt) == -1) {
         return -1;
       }
     } else {
@@ -1283,13 +1747,33 @@ static int PerformCommandZero(CommandParameters& params) {
 
   LOG(INFO) << "  zeroing " << tgt.blocks() << " blocks";
 
-  allocate(BLOCKSIZE, &params.buffer);
-  memset(params.buffer.data(), 0, BLOCKSIZE);
+  allocate(write_chunk_size, &params.buffer);
+  memset(params.buffer.data(), 0, write_chunk_size);
 
   if (params.canwrite) {
-    for (const auto& [begin, end] : tgt) {
+    // Zero commands routinely cover gigabytes of don't-care regions, so let the device zero them
+    // itself where it can: BLKZEROOUT translates to WRITE SAME / deallocate in the block layer
+    // and avoids pushing the zero buffers through userspace. Filesystem targets (the simulator)
+    // and kernels without the ioctl fall back to the write loop. Adjacent ranges are merged
+    // first so each submission covers as much as possible.
+    struct stat sb;
+    bool try_blkzeroout = fstat(params.fd, &sb) == 0 && S_ISBLK(sb.st_mode);
+    for (const auto& [begin, end] : CoalesceRanges(tgt)) {
       off64_t offset = static_cast<off64_t>(begin) * BLOCKSIZE;
       size_t size = (end - begin) * BLOCKSIZE;
+
+      if (try_blkzeroout) {
+        uint64_t args[2] = { static_cast<uint64_t>(offset), size };
+        if (ioctl(params.fd, BLKZEROOUT, &args) == 0) {
+          continue;
+        }
+        if (errno != EOPNOTSUPP && errno != ENOTTY) {
+          PLOG(ERROR) << "BLKZEROOUT ioctl failed";
+          return -1;
+        }
+        try_blkzeroout = false;
+      }
+
       if (!discard_blocks(params.fd, offset, size)) {
         return -1;
       }
@@ -1298,12 +1782,16 @@ static int PerformCommandZero(CommandParameters& params) {
         return -1;
       }
 
-      for (size_t j = begin; j < end; ++j) {
-        if (!android::base::WriteFully(params.fd, params.buffer.data(), BLOCKSIZE)) {
+      // Submit the zero buffer in device-sized chunks rather than block by block.
+      size_t remaining = size;
+      while (remaining > 0) {
+        size_t write_now = std::min(remaining, write_chunk_size);
+        if (!android::base::WriteFully(params.fd, params.buffer.data(), write_now)) {
           failure_type = errno == EIO ? kEioFailure : kFwriteFailure;
-          PLOG(ERROR) << "Failed to write " << BLOCKSIZE << " bytes of data";
+          PLOG(ERROR) << "Failed to write " << write_now << " bytes of data";
           return -1;
         }
+        remaining -= write_now;
       }
     }
   }
@@ -1327,23 +1815,58 @@ static int PerformCommandNew(CommandParameters& params) {
   CHECK(static_cast<bool>(tgt));
 
   if (params.canwrite) {
-    LOG(INFO) << " writing " << tgt.blocks() << " blocks of new data";
-
-    pthread_mutex_lock(&params.nti.mu);
-    params.nti.writer = std::make_unique<RangeSinkWriter>(params.fd, tgt);
-    pthread_cond_broadcast(&params.nti.cv);
+    if (params.new_skip_writes) {
+      LOG(INFO) << " skipping writes of " << tgt.blocks()
+                << " already synced blocks of new data";
+    } else {
+      LOG(INFO) << " writing " << tgt.blocks() << " blocks of new data";
+    }
+
+    auto writer = std::make_unique<RangeSinkWriter>(params.fd, tgt, params.new_skip_writes);
+
+    // Drain the read-ahead buffer before handing the writer to the unzip thread. This loops
+    // because the unzip thread may refill the buffer while we're writing; the handover only
+    // happens once the buffer is empty, which preserves the stream order.
+    while (!writer->Finished()) {
+      pthread_mutex_lock(&params.nti.mu);
+      if (params.nti.pending.empty()) {
+        params.nti.writer = std::move(writer);
+        pthread_cond_broadcast(&params.nti.cv);
+
+        while (params.nti.writer != nullptr) {
+          if (!params.nti.receiver_available) {
+            LOG(ERROR) << "missing "
+                       << (tgt.blocks() * BLOCKSIZE - params.nti.writer->BytesWritten())
+                       << " bytes of new data";
+            pthread_mutex_unlock(&params.nti.mu);
+            return -1;
+          }
+          pthread_cond_wait(&params.nti.cv, &params.nti.mu);
+        }
 
-    while (params.nti.writer != nullptr) {
-      if (!params.nti.receiver_available) {
-        LOG(ERROR) << "missing " << (tgt.blocks() * BLOCKSIZE - params.nti.writer->BytesWritten())
-                   << " bytes of new data";
         pthread_mutex_unlock(&params.nti.mu);
+        break;
+      }
+
+      std::vector<uint8_t> pending = std::move(params.nti.pending);
+      params.nti.pending.clear();
+      pthread_cond_broadcast(&params.nti.cv);
+      pthread_mutex_unlock(&params.nti.mu);
+
+      size_t write_now = std::min(pending.size(), writer->AvailableSpace());
+      if (writer->Write(pending.data(), write_now) != write_now) {
+        LOG(ERROR) << "Failed to write " << write_now << " bytes of buffered new data";
         return -1;
       }
-      pthread_cond_wait(&params.nti.cv, &params.nti.mu);
+      if (write_now < pending.size()) {
+        // The leftover belongs to a later 'new' command; it goes back in front of anything the
+        // unzip thread has buffered in the meantime.
+        pthread_mutex_lock(&params.nti.mu);
+        params.nti.pending.insert(params.nti.pending.begin(), pending.begin() + write_now,
+                                  pending.end());
+        pthread_mutex_unlock(&params.nti.mu);
+      }
     }
-
-    pthread_mutex_unlock(&params.nti.mu);
   }
 
   params.written += tgt.blocks();
@@ -1391,15 +1914,23 @@ static int PerformCommandDiff(CommandParameters& params) {
   if (params.canwrite) {
     if (status == 0) {
       LOG(INFO) << "patching " << blocks << " blocks to " << tgt.blocks();
-      Value patch_value(
-          Value::Type::BLOB,
-          std::string(reinterpret_cast<const char*>(params.patch_start + offset), len));
+      // Borrow the patch bytes straight out of the mapped package; copying them into an owning
+      // Value used to cost a multi-MB allocation per diff command.
+      std::string_view patch_value(reinterpret_cast<const char*>(params.patch_start + offset), len);
+      if (params.package_map != nullptr) {
+        // Kick off asynchronous readahead of the whole patch window, rather than faulting it in
+        // page by page as bspatch walks it.
+        params.package_map->Advise(MemMapping::AccessPattern::kWillNeed,
+                                   params.patch_start + offset - params.package_map->addr, len);
+      }
 
       RangeSinkWriter writer(params.fd, tgt);
+      AsyncSinkWriter async_writer(&writer);
+      auto sink = [&async_writer](const uint8_t* data, size_t size) {
+        return async_writer.Write(data, size);
+      };
       if (params.cmdname[0] == 'i') {  // imgdiff
-        if (ApplyImagePatch(params.buffer.data(), blocks * BLOCKSIZE, patch_value,
-                            std::bind(&RangeSinkWriter::Write, &writer, std::placeholders::_1,
-                                      std::placeholders::_2),
+        if (ApplyImagePatch(params.buffer.data(), blocks * BLOCKSIZE, patch_value, sink,
                             nullptr) != 0) {
           LOG(ERROR) << "Failed to apply image patch.";
           failure_type = kPatchApplicationFailure;
@@ -1407,14 +1938,19 @@ static int PerformCommandDiff(CommandParameters& params) {
         }
       } else {
         if (ApplyBSDiffPatch(params.buffer.data(), blocks * BLOCKSIZE, patch_value, 0,
-                             std::bind(&RangeSinkWriter::Write, &writer, std::placeholders::_1,
-                                       std::placeholders::_2)) != 0) {
+                             sink) != 0) {
           LOG(ERROR) << "Failed to apply bsdiff patch.";
           failure_type = kPatchApplicationFailure;
           return -1;
         }
       }
 
+      if (!async_writer.Finish()) {
+        LOG(ERROR) << "Failed to write patched data.";
+        failure_type = kPatchApplicationFailure;
+        return -1;
+      }
+
       // We expect the output of the patcher to fill the tgt ranges exactly.
       if (!writer.Finished()) {
         LOG(ERROR) << "Failed to fully write target blocks (range sink underrun): Missing "
@@ -1422,6 +1958,14 @@ static int PerformCommandDiff(CommandParameters& params) {
         failure_type = kPatchApplicationFailure;
         return -1;
       }
+
+      // The patch stream is consumed at increasing offsets and this window won't be read again,
+      // so release its pages; otherwise resident patch pages accumulate over the install and peak
+      // RSS grows with the total patch size. A resume simply refaults them from the package.
+      if (params.package_map != nullptr) {
+        params.package_map->Advise(MemMapping::AccessPattern::kDontNeed,
+                                   params.patch_start + offset - params.package_map->addr, len);
+      }
     } else {
       LOG(INFO) << "skipping " << blocks << " blocks already patched to " << tgt.blocks() << " ["
                 << params.cmdline << "]";
@@ -1465,7 +2009,9 @@ static int PerformCommandErase(CommandParameters& params) {
   if (params.canwrite) {
     LOG(INFO) << " erasing " << tgt.blocks() << " blocks";
 
-    for (const auto& [begin, end] : tgt) {
+    // Merge adjacent ranges so the block layer sees one discard per contiguous region instead of
+    // one ioctl per transfer-list range.
+    for (const auto& [begin, end] : CoalesceRanges(tgt)) {
       off64_t offset = static_cast<off64_t>(begin) * BLOCKSIZE;
       size_t size = (end - begin) * BLOCKSIZE;
       if (!discard_blocks(params.fd, offset, size, true /* force */)) {
@@ -1537,25 +2083,60 @@ static int PerformCommandComputeHashTree(CommandParameters& params) {
   }
 
   // Iterates through every block in the source_ranges and updates the hash tree structure
-  // accordingly.
+  // accordingly. The tree levels live inside HashTreeBuilder, so the hashing itself is
+  // sequential; what we can overlap is the I/O. Source blocks are read in multi-block chunks
+  // (instead of one read(2) per 4 KiB block), and the next chunk is fetched on a separate thread
+  // while the current one is being hashed.
+  constexpr size_t kHashChunkBlocks = 256;  // 1 MiB per chunk
+
+  struct HashChunk {
+    size_t first_block;
+    size_t block_count;
+  };
+  std::vector<HashChunk> chunks;
   for (const auto& [begin, end] : source_ranges) {
-    uint8_t buffer[BLOCKSIZE];
-    if (!check_lseek(params.fd, static_cast<off64_t>(begin) * BLOCKSIZE, SEEK_SET)) {
-      PLOG(ERROR) << "Failed to seek to block: " << begin;
-      return -1;
+    for (size_t block = begin; block < end; block += kHashChunkBlocks) {
+      chunks.push_back({ block, std::min(kHashChunkBlocks, end - block) });
     }
+  }
 
-    for (size_t i = begin; i < end; i++) {
-      if (!android::base::ReadFully(params.fd, buffer, BLOCKSIZE)) {
-        failure_type = errno == EIO ? kEioFailure : kFreadFailure;
-        LOG(ERROR) << "Failed to read data in " << begin << ":" << end;
-        return -1;
-      }
+  auto read_chunk = [&params](const HashChunk& chunk, uint8_t* buffer) {
+    if (!check_lseek(params.fd, static_cast<off64_t>(chunk.first_block) * BLOCKSIZE, SEEK_SET)) {
+      PLOG(ERROR) << "Failed to seek to block: " << chunk.first_block;
+      return false;
+    }
+    if (!android::base::ReadFully(params.fd, buffer, chunk.block_count * BLOCKSIZE)) {
+      failure_type = errno == EIO ? kEioFailure : kFreadFailure;
+      LOG(ERROR) << "Failed to read data at block " << chunk.first_block;
+      return false;
+    }
+    return true;
+  };
 
-      if (!builder.Update(reinterpret_cast<unsigned char*>(buffer), BLOCKSIZE)) {
-        LOG(ERROR) << "Failed to update hash tree builder";
+  std::vector<uint8_t> current_chunk(kHashChunkBlocks * BLOCKSIZE);
+  std::vector<uint8_t> next_chunk(kHashChunkBlocks * BLOCKSIZE);
+  if (!chunks.empty() && !read_chunk(chunks[0], current_chunk.data())) {
+    return -1;
+  }
+  for (size_t i = 0; i < chunks.size(); ++i) {
+    // Only the prefetch thread touches params.fd until it's joined below.
+    std::future<bool> next_read;
+    if (i + 1 < chunks.size()) {
+      next_read = std::async(std::launch::async, [&read_chunk, &chunks, &next_chunk, i] {
+        return read_chunk(chunks[i + 1], next_chunk.data());
+      });
+    }
+
+    if (!builder.Update(current_chunk.data(), chunks[i].block_count * BLOCKSIZE)) {
+      LOG(ERROR) << "Failed to update hash tree builder";
+      return -1;
+    }
+
+    if (next_read.valid()) {
+      if (!next_read.get()) {
         return -1;
       }
+      std::swap(current_chunk, next_chunk);
     }
   }
 
@@ -1586,6 +2167,338 @@ using CommandFunction = std::function<int(CommandParameters&)>;
 
 using CommandMap = std::unordered_map<Command::Type, CommandFunction>;
 
+// Wall-clock execution time per command type, aggregated over one block_image_update/verify call
+// across both the sequential path and parallel batch workers. The per-type breakdown separates
+// the I/O-bound command types (move/zero/new) from the CPU-bound ones (bsdiff/imgdiff), which is
+// usually enough to tell whether a slow install in the field was limited by the media or by
+// patching.
+class CommandTimer {
+ public:
+  void Record(const std::string& cmdname, std::chrono::steady_clock::duration elapsed) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Entry& entry = entries_[cmdname];
+    entry.count++;
+    entry.elapsed += elapsed;
+  }
+
+  void SetLastCommandIndex(size_t index) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    last_command_index_ = index;
+    last_command_time_ = time(nullptr);
+  }
+
+  // Logs the per-type totals and exports them as "<type> <count> <seconds>" lines, prefixed with
+  // start/finish timestamps and the index of the last executed command, to a flat file next to
+  // the temporary install log. The file is rewritten on every install, like the log itself.
+  void Report(time_t start_time, int rc) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::string report = android::base::StringPrintf(
+        "start %" PRId64 "\nfinish %" PRId64 "\nresult %d\n", static_cast<int64_t>(start_time),
+        static_cast<int64_t>(time(nullptr)), rc);
+    if (last_command_time_ != 0) {
+      report += android::base::StringPrintf("last_command %zu %" PRId64 "\n", last_command_index_,
+                                            static_cast<int64_t>(last_command_time_));
+    }
+    for (const auto& [cmdname, entry] : entries_) {
+      double seconds = std::chrono::duration<double>(entry.elapsed).count();
+      report += android::base::StringPrintf("%s %zu %.3f\n", cmdname.c_str(), entry.count, seconds);
+      LOG(INFO) << "  " << cmdname << ": " << entry.count << " commands in " << seconds << "s";
+    }
+
+    std::string stats_file = Paths::Get().temporary_log_file() + ".block_stats";
+    if (!android::base::WriteStringToFile(report, stats_file)) {
+      PLOG(WARNING) << "Failed to write command stats to " << stats_file;
+    }
+  }
+
+ private:
+  struct Entry {
+    size_t count = 0;
+    std::chrono::steady_clock::duration elapsed{};
+  };
+
+  mutable std::mutex mutex_;
+  std::map<std::string, Entry> entries_;
+  size_t last_command_index_ = 0;
+  time_t last_command_time_ = 0;
+};
+
+// Maximum number of transfer commands dispatched concurrently by ExecuteParallelBatch. The
+// effective limit is further capped to the performance-cluster size: the CPU-bound bspatch and
+// hashing work is what we want to overlap, and spilling workers onto the little cores just
+// makes the slowest worker set the batch's wall time.
+static constexpr size_t kMaxParallelCommands = 8;
+
+// Concurrent command limit for this device: bounded by the performance-cluster size, but never
+// below two — even with a single big core, pairing commands still overlaps one command's I/O
+// with another's compute.
+static size_t MaxParallelCommands() {
+  static const size_t limit = std::min(
+      kMaxParallelCommands, std::max<size_t>(GetCpuTopology().performance_cpus.size(), 2));
+  return limit;
+}
+
+// Splits the transfer list blob into per-line views. The blob is owned by the evaluated script
+// argument and outlives the whole update, so the views stay valid; materializing strings here
+// instead costs tens of MB of short-lived allocations on the 300k-line transfer lists that large
+// incremental OTAs produce. Mirrors android::base::Split's handling of a trailing newline.
+static std::vector<std::string_view> SplitTransferLines(std::string_view blob) {
+  std::vector<std::string_view> lines;
+  size_t begin = 0;
+  while (begin <= blob.size()) {
+    size_t end = blob.find('\n', begin);
+    if (end == std::string_view::npos) {
+      lines.push_back(blob.substr(begin));
+      break;
+    }
+    lines.push_back(blob.substr(begin, end - begin));
+    begin = end + 1;
+  }
+  return lines;
+}
+
+// Tokenizes a command line into space-separated views, reusing |tokens|'s storage across calls.
+// Empty fields are preserved, matching android::base::Split.
+static void TokenizeLine(std::string_view line, std::vector<std::string_view>* tokens) {
+  tokens->clear();
+  size_t begin = 0;
+  while (begin <= line.size()) {
+    size_t end = line.find(' ', begin);
+    if (end == std::string_view::npos) {
+      tokens->push_back(line.substr(begin));
+      break;
+    }
+    tokens->push_back(line.substr(begin, end - begin));
+    begin = end + 1;
+  }
+}
+
+// ParseUint counterpart for unmaterialized tokens.
+static bool ParseUintView(std::string_view text, size_t* value) {
+  auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), *value);
+  return ec == std::errc() && ptr == text.data() + text.size();
+}
+
+// Single entry of a parallel command batch (see CollectParallelBatch).
+struct ParallelCommand {
+  size_t index;  // command index within the transfer list
+  std::string line;
+  std::vector<std::string> tokens;
+  Command::Type type;
+  RangeSet src;
+  RangeSet tgt;
+};
+
+// Extracts the source/target RangeSets of a transfer command, provided the command neither
+// references stashed data nor rearranges the loaded source buffer. Commands that cannot be
+// analyzed this way (stash/free/new/erase/hash-tree, or move/diff involving stashes) act as
+// barriers for parallel dispatch and return false.
+static bool ParseCommandRanges(const std::vector<std::string_view>& tokens, Command::Type type,
+                               RangeSet* src, RangeSet* tgt) {
+  switch (type) {
+    case Command::Type::ZERO:
+      // zero <tgt_range>
+      if (tokens.size() != 2) return false;
+      *src = RangeSet();
+      *tgt = RangeSet::Parse(tokens[1]);
+      return static_cast<bool>(*tgt);
+    case Command::Type::MOVE:
+      // move <hash> <tgt_range> <src_blk_count> <src_range>
+      if (tokens.size() != 5 || tokens[4] == "-") return false;
+      *src = RangeSet::Parse(tokens[4]);
+      *tgt = RangeSet::Parse(tokens[2]);
+      return static_cast<bool>(*src) && static_cast<bool>(*tgt);
+    case Command::Type::BSDIFF:
+    case Command::Type::IMGDIFF:
+      // bsdiff/imgdiff <offset> <len> <src_hash> <tgt_hash> <tgt_range> <src_blk_count> <src_range>
+      if (tokens.size() != 8 || tokens[7] == "-") return false;
+      *src = RangeSet::Parse(tokens[7]);
+      *tgt = RangeSet::Parse(tokens[5]);
+      return static_cast<bool>(*src) && static_cast<bool>(*tgt);
+    default:
+      return false;
+  }
+}
+
+// Collects a run of consecutive commands starting at line |start| that can safely execute
+// concurrently. A command joins the batch only if its source and target ranges are disjoint from
+// the target ranges of every other command in the batch (and vice versa), so the combined result
+// is identical to sequential execution. Commands whose source overlaps their own target are
+// excluded as well, since those take the stashing path in LoadSrcTgtVersion3(). Each worker in
+// the batch allocates a private source buffer, so the batch also stops growing once the combined
+// source size would exceed what the memory budget has left; the first command always joins, since
+// running it sequentially needs the same buffer anyway.
+static std::vector<ParallelCommand> CollectParallelBatch(const std::vector<std::string_view>& lines,
+                                                         size_t start) {
+  std::vector<ParallelCommand> batch;
+  size_t batch_src_bytes = 0;
+  const size_t available = MemoryBudget::Get().Available();
+  std::vector<std::string_view> tokens;
+  for (size_t i = start; i < lines.size() && batch.size() < MaxParallelCommands(); i++) {
+    std::string_view line = lines[i];
+    if (line.empty()) break;
+
+    TokenizeLine(line, &tokens);
+    Command::Type type = Command::ParseType(tokens[0]);
+
+    RangeSet src;
+    RangeSet tgt;
+    if (!ParseCommandRanges(tokens, type, &src, &tgt)) break;
+    if (src && src.Overlaps(tgt)) break;
+
+    bool conflict = false;
+    for (const auto& cmd : batch) {
+      if (tgt.Overlaps(cmd.tgt) || (src && src.Overlaps(cmd.tgt)) ||
+          (cmd.src && cmd.src.Overlaps(tgt))) {
+        conflict = true;
+        break;
+      }
+    }
+    if (conflict) break;
+
+    size_t src_bytes = src ? src.blocks() * BLOCKSIZE : 0;
+    if (!batch.empty() && batch_src_bytes + src_bytes > available) break;
+    batch_src_bytes += src_bytes;
+
+    // Tokens are materialized only for commands that actually join a batch; the workers' command
+    // parameters carry owned strings.
+    batch.push_back({ i - kTransferListHeaderLines, std::string(line),
+                      std::vector<std::string>(tokens.begin(), tokens.end()), type, std::move(src),
+                      std::move(tgt) });
+  }
+  return batch;
+}
+
+// Executes a batch of mutually independent commands across a pool of worker threads, so that
+// reads, bspatch CPU work and writes from different commands overlap. Each worker gets a private
+// CommandParameters with its own fd on the block device; the written/stashed counters are folded
+// back into |params| once all workers have finished. Returns false if any command failed.
+static bool ExecuteParallelBatch(const std::vector<ParallelCommand>& batch,
+                                 CommandParameters& params, const CommandMap& command_map,
+                                 const std::string& block_device_path, CommandTimer* timer) {
+  std::vector<CommandParameters> workers(batch.size());
+  for (size_t i = 0; i < batch.size(); i++) {
+    CommandParameters& worker = workers[i];
+    worker.canwrite = params.canwrite;
+    worker.createdstash = params.createdstash;
+    worker.stashbase = params.stashbase;
+    worker.version = params.version;
+    worker.patch_start = params.patch_start;
+    worker.package_map = params.package_map;
+    worker.tokens = batch[i].tokens;
+    worker.cpos = 1;
+    worker.cmdname = worker.tokens[0];
+    worker.cmdline = batch[i].line;
+    worker.fd.reset(TEMP_FAILURE_RETRY(open(block_device_path.c_str(), O_RDWR)));
+    if (worker.fd == -1) {
+      failure_type = errno == EIO ? kEioFailure : kFileOpenFailure;
+      PLOG(ERROR) << "open \"" << block_device_path << "\" failed";
+      return false;
+    }
+  }
+
+  std::vector<std::future<int>> futures;
+  for (size_t i = 0; i < batch.size(); i++) {
+    // Commands mapped to nullptr (e.g. "zero" during block_image_verify) are skipped, matching
+    // the sequential path.
+    CommandFunction performer = command_map.at(batch[i].type);
+    futures.emplace_back(
+        std::async(std::launch::async,
+                   [performer = std::move(performer), &worker = workers[i], timer]() {
+                     if (!performer) return 0;
+                     // Keep the patch/hash work off the little cores; on homogeneous systems
+                     // this is a no-op.
+                     PinToPerformanceCores();
+                     auto start = std::chrono::steady_clock::now();
+                     int result;
+                     {
+                       ScopedTrace trace(worker.cmdname);
+                       result = performer(worker);
+                     }
+                     timer->Record(worker.cmdname, std::chrono::steady_clock::now() - start);
+                     return result;
+                   }));
+  }
+
+  bool ok = true;
+  for (size_t i = 0; i < batch.size(); i++) {
+    if (futures[i].get() == -1) {
+      LOG(ERROR) << "failed to execute command [" << batch[i].line << "]";
+      ok = false;
+    }
+  }
+
+  for (const auto& worker : workers) {
+    params.written += worker.written;
+    params.stashed += worker.stashed;
+    params.foundwrites = params.foundwrites || worker.foundwrites;
+    params.isunresumable = params.isunresumable || worker.isunresumable;
+  }
+  return ok;
+}
+
+// How far ahead of the executing command the source prefetcher may run, in advised bytes. Large
+// enough to cover the read latency of several typical diff commands, small enough that the pages
+// are still resident when the command that wants them finally executes.
+static constexpr size_t kSourcePrefetchBudget = 32 * 1024 * 1024;
+// Smallest window the prefetcher still helps with; below this the advice rarely completes before
+// the command that wanted it.
+static constexpr size_t kMinSourcePrefetch = 4 * 1024 * 1024;
+
+// Walks the transfer list ahead of the executing command and issues POSIX_FADV_WILLNEED for the
+// source ranges of upcoming commands, so the kernel fetches them while the current command is busy
+// patching or hashing. The command stream is fully known after parsing, which makes the lookahead
+// exact rather than heuristic. The window is bounded by the constructor-supplied budget of
+// not-yet-consumed advice (kSourcePrefetchBudget when memory permits); commands whose ranges ParseCommandRanges() cannot extract (stash-based loads and the
+// barrier commands) are simply stepped over.
+class SourcePrefetcher {
+ public:
+  SourcePrefetcher(const std::vector<std::string_view>& lines, int fd, size_t budget)
+      : lines_(lines), fd_(fd), budget_(budget) {}
+
+  // Called as execution reaches the command on line |current|: retires advice that execution has
+  // caught up with, then extends the window until the budget is spent again.
+  void AdvanceTo(size_t current) {
+    while (!window_.empty() && window_.front().first <= current) {
+      outstanding_ -= window_.front().second;
+      window_.pop_front();
+    }
+    if (cursor_ <= current) {
+      cursor_ = current + 1;
+    }
+    while (cursor_ < lines_.size() && outstanding_ < budget_) {
+      std::string_view line = lines_[cursor_];
+      if (!line.empty()) {
+        TokenizeLine(line, &tokens_);
+        RangeSet src;
+        RangeSet tgt;
+        if (ParseCommandRanges(tokens_, Command::ParseType(tokens_[0]), &src, &tgt) && src) {
+          size_t bytes = 0;
+          for (const auto& [begin, end] : CoalesceRanges(src)) {
+            posix_fadvise64(fd_, static_cast<off64_t>(begin) * BLOCKSIZE,
+                            (end - begin) * BLOCKSIZE, POSIX_FADV_WILLNEED);
+            bytes += (end - begin) * BLOCKSIZE;
+          }
+          outstanding_ += bytes;
+          window_.emplace_back(cursor_, bytes);
+        }
+      }
+      cursor_++;
+    }
+  }
+
+ private:
+  const std::vector<std::string_view>& lines_;
+  int fd_;
+  size_t budget_;
+  // Scratch token storage, reused across lines.
+  std::vector<std::string_view> tokens_;
+  size_t cursor_{ kTransferListHeaderLines };
+  size_t outstanding_{ 0 };
+  // (line index, advised bytes) pairs still ahead of execution.
+  std::deque<std::pair<size_t, size_t>> window_;
+};
+
 static bool Sha1DevicePath(const std::string& path, uint8_t digest[SHA_DIGEST_LENGTH]) {
   auto device_name = android::base::Basename(path);
   auto dm_target_name_path = "/sys/block/" + device_name + "/dm/name";
@@ -1623,11 +2536,77 @@ static bool Sha1DevicePath(const std::string& path, uint8_t digest[SHA_DIGEST_LE
   return true;
 }
 
+// Summary of a transfer list, gathered in a single preflight pass before any command runs. The
+// per-type block counts give a cost breakdown of the update in the log (useful when comparing
+// install times across builds), and the largest single-command source load lets us size the
+// shared command buffer once instead of growing it incrementally.
+struct TransferListStats {
+  size_t commands = 0;
+  size_t moved_blocks = 0;
+  size_t patched_blocks = 0;
+  size_t new_blocks = 0;
+  size_t zeroed_blocks = 0;
+  size_t stashed_blocks = 0;
+  size_t max_src_blocks = 0;
+};
+
+static TransferListStats AnalyzeTransferList(const std::vector<std::string_view>& lines) {
+  TransferListStats stats;
+  std::vector<std::string_view> tokens;
+  for (size_t i = kTransferListHeaderLines; i < lines.size(); i++) {
+    if (lines[i].empty()) continue;
+    TokenizeLine(lines[i], &tokens);
+    stats.commands++;
+
+    size_t src_blocks = 0;
+    RangeSet tgt;
+    switch (Command::ParseType(tokens[0])) {
+      case Command::Type::MOVE:
+        // move <hash> <tgt_range> <src_blk_count> ...
+        if (tokens.size() < 4) break;
+        if ((tgt = RangeSet::Parse(tokens[2]))) stats.moved_blocks += tgt.blocks();
+        ParseUintView(tokens[3], &src_blocks);
+        break;
+      case Command::Type::BSDIFF:
+      case Command::Type::IMGDIFF:
+        // bsdiff/imgdiff <offset> <len> <src_hash> <tgt_hash> <tgt_range> <src_blk_count> ...
+        if (tokens.size() < 7) break;
+        if ((tgt = RangeSet::Parse(tokens[5]))) stats.patched_blocks += tgt.blocks();
+        ParseUintView(tokens[6], &src_blocks);
+        break;
+      case Command::Type::NEW:
+        if (tokens.size() < 2) break;
+        if ((tgt = RangeSet::Parse(tokens[1]))) stats.new_blocks += tgt.blocks();
+        break;
+      case Command::Type::ZERO:
+      case Command::Type::ERASE:
+        if (tokens.size() < 2) break;
+        if ((tgt = RangeSet::Parse(tokens[1]))) stats.zeroed_blocks += tgt.blocks();
+        break;
+      case Command::Type::STASH: {
+        // stash <stash_id> <src_range>
+        if (tokens.size() < 3) break;
+        RangeSet src = RangeSet::Parse(tokens[2]);
+        if (src) {
+          stats.stashed_blocks += src.blocks();
+          src_blocks = src.blocks();
+        }
+        break;
+      }
+      default:
+        break;
+    }
+    stats.max_src_blocks = std::max(stats.max_src_blocks, src_blocks);
+  }
+  return stats;
+}
+
 static Value* PerformBlockImageUpdate(const char* name, State* state,
                                       const std::vector<std::unique_ptr<Expr>>& argv,
                                       const CommandMap& command_map, bool dryrun) {
   CommandParameters params{};
   stash_map.clear();
+  StashCacheClear();
   params.canwrite = !dryrun;
 
   LOG(INFO) << "performing " << (dryrun ? "verification" : "update");
@@ -1693,6 +2672,13 @@ static Value* PerformBlockImageUpdate(const char* name, State* state,
     return StringValue("");
   }
   params.patch_start = updater->GetMappedPackageAddress() + patch_entry.offset;
+  params.package_map = updater->GetMappedPackage();
+  if (params.package_map != nullptr) {
+    // The patch blobs are consumed at increasing offsets into this entry (transfer-list order),
+    // unlike the rest of the package; let readahead run ahead of the diff commands there.
+    params.package_map->Advise(MemMapping::AccessPattern::kSequential, patch_entry.offset,
+                               patch_entry.uncompressed_length);
+  }
 
   std::string_view new_data(new_data_fn->data);
   ZipEntry64 new_entry;
@@ -1708,6 +2694,9 @@ static Value* PerformBlockImageUpdate(const char* name, State* state,
     return StringValue("");
   }
 
+  // Size write buffers from the device's request-queue topology before any command runs.
+  ProbeBlockDeviceTopology(params.fd);
+
   uint8_t digest[SHA_DIGEST_LENGTH];
   if (!Sha1DevicePath(block_device_path, digest)) {
     return StringValue("");
@@ -1734,8 +2723,10 @@ static Value* PerformBlockImageUpdate(const char* name, State* state,
     }
   }
 
-  static constexpr size_t kTransferListHeaderLines = 4;
-  std::vector<std::string> lines = android::base::Split(transfer_list_value->data, "\n");
+  // Views into the transfer list blob, which is owned by |args| and outlives the whole update.
+  // Command lines are tokenized lazily into views as well; owned strings are only materialized
+  // for the command about to execute.
+  std::vector<std::string_view> lines = SplitTransferLines(transfer_list_value->data);
   if (lines.size() < kTransferListHeaderLines) {
     ErrorAbort(state, kArgsParsingFailure, "too few lines in the transfer list [%zu]",
                lines.size());
@@ -1743,7 +2734,7 @@ static Value* PerformBlockImageUpdate(const char* name, State* state,
   }
 
   // First line in transfer list is the version number.
-  if (!android::base::ParseInt(lines[0], &params.version, 3, 4)) {
+  if (!android::base::ParseInt(std::string(lines[0]), &params.version, 3, 4)) {
     LOG(ERROR) << "unexpected transfer list version [" << lines[0] << "]";
     return StringValue("");
   }
@@ -1752,8 +2743,9 @@ static Value* PerformBlockImageUpdate(const char* name, State* state,
 
   // Second line in transfer list is the total number of blocks we expect to write.
   size_t total_blocks;
-  if (!android::base::ParseUint(lines[1], &total_blocks)) {
-    ErrorAbort(state, kArgsParsingFailure, "unexpected block count [%s]", lines[1].c_str());
+  if (!ParseUintView(lines[1], &total_blocks)) {
+    ErrorAbort(state, kArgsParsingFailure, "unexpected block count [%s]",
+               std::string(lines[1]).c_str());
     return StringValue("");
   }
 
@@ -1766,9 +2758,9 @@ static Value* PerformBlockImageUpdate(const char* name, State* state,
 
   // Fourth line is the maximum number of blocks that will be stashed simultaneously
   size_t stash_max_blocks;
-  if (!android::base::ParseUint(lines[3], &stash_max_blocks)) {
+  if (!ParseUintView(lines[3], &stash_max_blocks)) {
     ErrorAbort(state, kArgsParsingFailure, "unexpected maximum stash blocks [%s]",
-               lines[3].c_str());
+               std::string(lines[3]).c_str());
     return StringValue("");
   }
 
@@ -1778,6 +2770,24 @@ static Value* PerformBlockImageUpdate(const char* name, State* state,
   }
   params.createdstash = res;
 
+  // Bytes reserved against the process memory budget for this update, given back at pbiudone.
+  size_t budget_reserved = 0;
+
+  // Preflight: parse the command stream once, log the cost breakdown, and size the shared source
+  // buffer for the largest command up front.
+  {
+    TransferListStats stats = AnalyzeTransferList(lines);
+    LOG(INFO) << "transfer list: " << stats.commands << " commands; " << stats.moved_blocks
+              << " moved, " << stats.patched_blocks << " patched, " << stats.new_blocks
+              << " new, " << stats.zeroed_blocks << " zeroed, " << stats.stashed_blocks
+              << " stashed blocks; largest source load " << stats.max_src_blocks << " blocks";
+    // The shared source buffer is a hard requirement at this size, so its floor equals its ask;
+    // reserving it first makes the elastic windows below adapt to what's left.
+    size_t source_buffer_bytes = stats.max_src_blocks * BLOCKSIZE;
+    budget_reserved += MemoryBudget::Get().Reserve(source_buffer_bytes, source_buffer_bytes);
+    allocate(source_buffer_bytes, &params.buffer);
+  }
+
   // Set up the new data writer.
   if (params.canwrite) {
     params.nti.za = za;
@@ -1787,7 +2797,17 @@ static Value* PerformBlockImageUpdate(const char* name, State* state,
       // Initialize brotli decoder state.
       params.nti.brotli_decoder_state = BrotliDecoderCreateInstance(nullptr, nullptr, nullptr);
     }
+    params.nti.zstd_compressed = android::base::EndsWith(new_data_fn->data, ".zst");
+    if (params.nti.zstd_compressed) {
+      params.nti.zstd_stream = ZSTD_createDStream();
+      // Accept frames produced with long-distance matching, up to the format's 2 GiB window
+      // limit; the streaming decoder allocates only what the frame actually requires.
+      ZSTD_DCtx_setParameter(params.nti.zstd_stream, ZSTD_d_windowLogMax, 31);
+    }
     params.nti.receiver_available = true;
+    params.nti.readahead_limit =
+        MemoryBudget::Get().Reserve(kNewDataReadAheadLimit, kMinNewDataReadAhead);
+    budget_reserved += params.nti.readahead_limit;
 
     pthread_mutex_init(&params.nti.mu, nullptr);
     pthread_cond_init(&params.nti.cv, nullptr);
@@ -1803,7 +2823,7 @@ static Value* PerformBlockImageUpdate(const char* name, State* state,
   }
 
   // When performing an update, save the index and cmdline of the current command into the
-  // last_command_file.
+  // last_command_file (group-committed every few commands; see advance_resume_marker below).
   // Upon resuming an update, read the saved index first; then
   //   1. In verification mode, check if the 'move' or 'diff' commands before the saved index has
   //      the expected target blocks already. If not, these commands cannot be skipped and we need
@@ -1822,16 +2842,96 @@ static Value* PerformBlockImageUpdate(const char* name, State* state,
 
   int rc = -1;
 
+  // Lookahead readahead of source blocks: while each command computes, the kernel pulls in the
+  // source ranges of the commands that follow. Without it the install alternates between
+  // CPU-bound phases (bspatch, hashing) with the disk idle and read phases with the CPU idle.
+  // The window is elastic: when the hard reservations above left little room, a smaller window
+  // just means less overlap, not a broken install.
+  size_t prefetch_window = MemoryBudget::Get().Reserve(kSourcePrefetchBudget, kMinSourcePrefetch);
+  budget_reserved += prefetch_window;
+  SourcePrefetcher prefetcher(lines, params.fd, prefetch_window);
+
+  CommandTimer command_timer;
+  time_t update_start_time = time(nullptr);
+
+  // A command stuck in a dying flash controller never returns and never logs; without a watchdog
+  // the user eventually pulls the battery mid-write. After the timeout the watchdog dumps every
+  // thread's kernel stack and exits the updater: blocks are synced before the resume marker
+  // advances, so dying here costs no more than the in-flight command, and the next attempt
+  // resumes from last_command_file. The default leaves headroom for one large command on slow
+  // flash; ro.recovery.hang_timeout_s tunes it, 0 disables.
+  HangWatchdog watchdog(
+      "block_image_update",
+      std::chrono::seconds(
+          android::base::GetUintProperty<uint64_t>("ro.recovery.hang_timeout_s", 600)),
+      []() { _exit(EXIT_FAILURE); });
+
+  // Rewriting the resume marker durably after every synced command adds an fsync (plus a
+  // directory fsync) to each of the ~100k commands in a typical transfer list, several percent of
+  // update wall time on eMMC. Group-commit the marker instead: land it once every
+  // ro.recovery.resume_marker_commands commands or ro.recovery.resume_marker_interval_ms,
+  // whichever comes first. The marker only ever trails the synced data, so a crash inside the
+  // window merely re-runs commands whose target blocks already verify; the resume pass re-checks
+  // at most the uncommitted window via the source/target hashes it already computes.
+  const uint64_t marker_command_group =
+      android::base::GetUintProperty<uint64_t>("ro.recovery.resume_marker_commands", 100);
+  const auto marker_interval = std::chrono::milliseconds(
+      android::base::GetUintProperty<uint64_t>("ro.recovery.resume_marker_interval_ms", 1000));
+  uint64_t marker_pending_count = 0;
+  size_t marker_pending_index = 0;
+  std::string marker_pending_line;
+  auto last_marker_commit = std::chrono::steady_clock::now();
+  auto commit_resume_marker = [&]() {
+    if (marker_pending_count == 0) return;
+    if (!UpdateLastCommandIndex(marker_pending_index, marker_pending_line)) {
+      LOG(WARNING) << "Failed to update the last command file.";
+    }
+    marker_pending_count = 0;
+    last_marker_commit = std::chrono::steady_clock::now();
+  };
+  auto advance_resume_marker = [&](size_t cmdindex, const std::string& cmdline) {
+    marker_pending_index = cmdindex;
+    marker_pending_line = cmdline;
+    ++marker_pending_count;
+    if (marker_pending_count >= marker_command_group ||
+        std::chrono::steady_clock::now() - last_marker_commit >= marker_interval) {
+      commit_resume_marker();
+    }
+  };
+
+  // Writing "set_progress" after every synced command wakes the recovery process thousands of
+  // times per install for sub-pixel bar movements. Coalesce the reports: only write when the bar
+  // can visibly move, at most ten times a second, and always deliver the final position.
+  double reported_progress = -1.0;
+  auto last_progress_report = std::chrono::steady_clock::now();
+  auto report_progress = [&](double fraction) {
+    auto report_time = std::chrono::steady_clock::now();
+    if (fraction < 1.0 &&
+        (fraction - reported_progress < 0.005 ||
+         report_time - last_progress_report < std::chrono::milliseconds(100))) {
+      return;
+    }
+    reported_progress = fraction;
+    last_progress_report = report_time;
+    updater->WriteToCommandPipe(android::base::StringPrintf("set_progress %.4f", fraction), true);
+  };
+
+  // Scratch token views, reused across commands.
+  std::vector<std::string_view> token_views;
+
   // Subsequent lines are all individual transfer commands
   for (size_t i = kTransferListHeaderLines; i < lines.size(); i++) {
-    const std::string& line = lines[i];
+    std::string_view line = lines[i];
     if (line.empty()) continue;
 
     size_t cmdindex = i - kTransferListHeaderLines;
-    params.tokens = android::base::Split(line, " ");
+    // Owned strings are materialized only here, for the one command about to execute; the
+    // preflight, prefetch and batching passes all stay on views.
+    TokenizeLine(line, &token_views);
+    params.tokens.assign(token_views.begin(), token_views.end());
     params.cpos = 0;
     params.cmdname = params.tokens[params.cpos++];
-    params.cmdline = line;
+    params.cmdline = std::string(line);
     params.target_verified = false;
 
     Command::Type cmd_type = Command::ParseType(params.cmdname);
@@ -1858,7 +2958,60 @@ static Value* PerformBlockImageUpdate(const char* name, State* state,
       continue;
     }
 
-    if (performer(params) == -1) {
+    // Those 'new' commands still run to keep the compressed stream aligned, but their blocks hit
+    // the disk and were synced before the resume marker advanced past them, so the replay only
+    // needs to decompress and discard; it can skip the writes.
+    params.new_skip_writes = params.canwrite && skip_executed_command &&
+                             cmdindex <= saved_last_command_index &&
+                             cmd_type == Command::Type::NEW;
+
+    // This command is going to run: top up the source readahead window first, so the device
+    // works on the next commands' blocks while this one computes. Skipped commands never get
+    // here, which keeps a resume replay from fetching data it will not use.
+    prefetcher.AdvanceTo(i);
+
+    // Try to batch this command with the following independent ones and execute them
+    // concurrently. In update mode this overlaps reads, patching and writes from different
+    // commands; in verify mode it spreads the SHA-1 hashing of the source/target blocks across
+    // cores. Commands at or before the saved resume index are left on the sequential path, since
+    // the resume bookkeeping depends on visiting them in order.
+    if (!(skip_executed_command && cmdindex <= saved_last_command_index)) {
+      std::vector<ParallelCommand> batch = CollectParallelBatch(lines, i);
+      if (batch.size() > 1) {
+        LOG(INFO) << "executing " << batch.size() << " independent commands in parallel";
+        if (!ExecuteParallelBatch(batch, params, command_map, block_device_path, &command_timer)) {
+          goto pbiudone;
+        }
+        i += batch.size() - 1;
+        watchdog.Pet();
+
+        if (params.canwrite) {
+          if (fsync(params.fd) == -1) {
+            failure_type = errno == EIO ? kEioFailure : kFsyncFailure;
+            PLOG(ERROR) << "fsync failed";
+            goto pbiudone;
+          }
+
+          // The batch either completes or fails as a whole, so only advance the resume marker
+          // once every command in it has been synced.
+          advance_resume_marker(batch.back().index, batch.back().line);
+          command_timer.SetLastCommandIndex(batch.back().index);
+
+          report_progress(static_cast<double>(params.written) / total_blocks);
+        }
+        continue;
+      }
+    }
+
+    auto command_start = std::chrono::steady_clock::now();
+    int command_result;
+    {
+      ScopedTrace trace(params.cmdname);
+      command_result = performer(params);
+    }
+    command_timer.Record(params.cmdname, std::chrono::steady_clock::now() - command_start);
+    watchdog.Pet();
+    if (command_result == -1) {
       LOG(ERROR) << "failed to execute command [" << line << "]";
       if (cmd_type == Command::Type::COMPUTE_HASH_TREE && failure_type == kNoCause) {
         failure_type = kHashTreeComputationFailure;
@@ -1888,25 +3041,33 @@ static Value* PerformBlockImageUpdate(const char* name, State* state,
         goto pbiudone;
       }
 
-      if (!UpdateLastCommandIndex(cmdindex, params.cmdline)) {
-        LOG(WARNING) << "Failed to update the last command file.";
-      }
+      advance_resume_marker(cmdindex, params.cmdline);
+      command_timer.SetLastCommandIndex(cmdindex);
 
-      updater->WriteToCommandPipe(
-          android::base::StringPrintf("set_progress %.4f",
-                                      static_cast<double>(params.written) / total_blocks),
-          true);
+      report_progress(static_cast<double>(params.written) / total_blocks);
     }
   }
 
   rc = 0;
 
 pbiudone:
+  // Land the marker for any commands still inside the group-commit window, so a resume after a
+  // failure doesn't redo work that was already synced. On success the file is deleted below.
+  if (params.canwrite && rc != 0) {
+    commit_resume_marker();
+  }
+  MemoryBudget::Get().Release(budget_reserved);
+  command_timer.Report(update_start_time, rc);
+
   if (params.canwrite) {
     pthread_mutex_lock(&params.nti.mu);
     if (params.nti.receiver_available) {
       LOG(WARNING) << "new data receiver is still available after executing all commands.";
     }
+    if (rc == 0 && !params.nti.pending.empty()) {
+      LOG(WARNING) << params.nti.pending.size()
+                   << " bytes of new data were decompressed but never consumed.";
+    }
     params.nti.receiver_available = false;
     pthread_cond_broadcast(&params.nti.cv);
     pthread_mutex_unlock(&params.nti.mu);
@@ -1958,6 +3119,9 @@ pbiudone:
   if (params.nti.brotli_decoder_state != nullptr) {
     BrotliDecoderDestroyInstance(params.nti.brotli_decoder_state);
   }
+  if (params.nti.zstd_stream != nullptr) {
+    ZSTD_freeDStream(params.nti.zstd_stream);
+  }
 
   // Delete the last command file if the update cannot be resumed.
   if (params.isunresumable) {
@@ -2134,6 +3298,67 @@ Value* RangeSha1Fn(const char* name, State* state, const std::vector<std::unique
   return StringValue(print_sha1(digest));
 }
 
+// Outcome of the first-block check on one partition, so the edify wrappers can decide between
+// LOG, ErrorAbort and UiPrint on the caller's thread.
+struct FirstBlockCheckResult {
+  bool ok = false;
+  CauseCode cause_code = kNoCause;
+  std::string error;
+  std::vector<std::string> warnings;
+};
+
+// Shared body of check_first_block/check_first_blocks: resolves |partition| to its block device,
+// reads the first block and inspects the ext4 superblock mount fields. Safe to run from multiple
+// threads, one partition each; all output is returned in the result rather than printed.
+static FirstBlockCheckResult CheckFirstBlockOnDevice(UpdaterInterface* updater,
+                                                     const std::string& partition) {
+  FirstBlockCheckResult result;
+
+  auto block_device_path = updater->FindBlockDeviceName(partition);
+  if (block_device_path.empty()) {
+    result.error = "Block device path for " + partition + " not found.";
+    return result;
+  }
+
+  android::base::unique_fd fd(open(block_device_path.c_str(), O_RDONLY));
+  if (fd == -1) {
+    result.cause_code = errno == EIO ? kEioFailure : kFileOpenFailure;
+    result.error = android::base::StringPrintf("open \"%s\" failed: %s", block_device_path.c_str(),
+                                               strerror(errno));
+    return result;
+  }
+
+  RangeSet blk0(std::vector<Range>{ Range{ 0, 1 } });
+  std::vector<uint8_t> block0_buffer(BLOCKSIZE);
+
+  if (ReadBlocks(blk0, &block0_buffer, fd) == -1) {
+    result.cause_code = errno == EIO ? kEioFailure : kFreadFailure;
+    result.error = android::base::StringPrintf("failed to read %s: %s", block_device_path.c_str(),
+                                               strerror(errno));
+    return result;
+  }
+
+  // https://ext4.wiki.kernel.org/index.php/Ext4_Disk_Layout
+  // Super block starts from block 0, offset 0x400
+  //   0x2C: len32 Mount time
+  //   0x30: len32 Write time
+  //   0x34: len16 Number of mounts since the last fsck
+  //   0x38: len16 Magic signature 0xEF53
+
+  time_t mount_time = *reinterpret_cast<uint32_t*>(&block0_buffer[0x400 + 0x2C]);
+  uint16_t mount_count = *reinterpret_cast<uint16_t*>(&block0_buffer[0x400 + 0x34]);
+
+  if (mount_count > 0) {
+    result.warnings.push_back(
+        android::base::StringPrintf("Device was remounted R/W %" PRIu16 " times", mount_count));
+    result.warnings.push_back(
+        android::base::StringPrintf("Last remount happened on %s", ctime(&mount_time)));
+  }
+
+  result.ok = true;
+  return result;
+}
+
 // This function checks if a device has been remounted R/W prior to an incremental
 // OTA update. This is an common cause of update abortion. The function reads the
 // 1st block of each partition and check for mounting time/count. It return string "t"
@@ -2159,49 +3384,74 @@ Value* CheckFirstBlockFn(const char* name, State* state,
     return StringValue("");
   }
 
-  auto block_device_path = state->updater->FindBlockDeviceName(arg_filename->data);
-  if (block_device_path.empty()) {
-    LOG(ERROR) << "Block device path for " << arg_filename->data << " not found. " << name
-               << " failed.";
+  FirstBlockCheckResult result = CheckFirstBlockOnDevice(state->updater, arg_filename->data);
+  if (!result.ok) {
+    if (result.cause_code != kNoCause) {
+      ErrorAbort(state, result.cause_code, "%s", result.error.c_str());
+    } else {
+      LOG(ERROR) << result.error << " " << name << " failed.";
+    }
     return StringValue("");
   }
-
-  android::base::unique_fd fd(open(block_device_path.c_str(), O_RDONLY));
-  if (fd == -1) {
-    CauseCode cause_code = errno == EIO ? kEioFailure : kFileOpenFailure;
-    ErrorAbort(state, cause_code, "open \"%s\" failed: %s", block_device_path.c_str(),
-               strerror(errno));
-    return StringValue("");
+  for (const auto& warning : result.warnings) {
+    state->updater->UiPrint(warning);
   }
 
-  RangeSet blk0(std::vector<Range>{ Range{ 0, 1 } });
-  std::vector<uint8_t> block0_buffer(BLOCKSIZE);
+  return StringValue("t");
+}
 
-  if (ReadBlocks(blk0, &block0_buffer, fd) == -1) {
-    CauseCode cause_code = errno == EIO ? kEioFailure : kFreadFailure;
-    ErrorAbort(state, cause_code, "failed to read %s: %s", block_device_path.c_str(),
-               strerror(errno));
+// Batched form of check_first_block: takes one or more partition names and runs the first-block
+// check on all of them concurrently. Resolving and opening device-mapper nodes dominates the cost
+// of the check, so the pre-install fence over N partitions collapses to one parallel round
+// instead of N serialized opens. All partitions are checked even if an early one fails, so the
+// log shows every problem at once.
+Value* CheckFirstBlocksFn(const char* name, State* state,
+                          const std::vector<std::unique_ptr<Expr>>& argv) {
+  if (argv.empty()) {
+    ErrorAbort(state, kArgsParsingFailure, "check_first_blocks expects at least 1 argument");
     return StringValue("");
   }
 
-  // https://ext4.wiki.kernel.org/index.php/Ext4_Disk_Layout
-  // Super block starts from block 0, offset 0x400
-  //   0x2C: len32 Mount time
-  //   0x30: len32 Write time
-  //   0x34: len16 Number of mounts since the last fsck
-  //   0x38: len16 Magic signature 0xEF53
+  std::vector<std::unique_ptr<Value>> args;
+  if (!ReadValueArgs(state, argv, &args)) {
+    return nullptr;
+  }
 
-  time_t mount_time = *reinterpret_cast<uint32_t*>(&block0_buffer[0x400 + 0x2C]);
-  uint16_t mount_count = *reinterpret_cast<uint16_t*>(&block0_buffer[0x400 + 0x34]);
+  std::vector<std::string> partitions;
+  for (const auto& arg : args) {
+    if (arg->type != Value::Type::STRING) {
+      ErrorAbort(state, kArgsParsingFailure, "arguments to %s must be strings", name);
+      return StringValue("");
+    }
+    partitions.push_back(arg->data);
+  }
 
-  if (mount_count > 0) {
-    state->updater->UiPrint(
-        android::base::StringPrintf("Device was remounted R/W %" PRIu16 " times", mount_count));
-    state->updater->UiPrint(
-        android::base::StringPrintf("Last remount happened on %s", ctime(&mount_time)));
+  std::vector<std::future<FirstBlockCheckResult>> futures;
+  for (const auto& partition : partitions) {
+    futures.push_back(std::async(std::launch::async, CheckFirstBlockOnDevice, state->updater,
+                                 partition));
   }
 
-  return StringValue("t");
+  bool ok = true;
+  for (size_t i = 0; i < futures.size(); i++) {
+    FirstBlockCheckResult result = futures[i].get();
+    if (!result.ok) {
+      // Abort with the first failure that carries a cause code; plain lookup failures only log,
+      // matching check_first_block.
+      if (result.cause_code != kNoCause && ok) {
+        ErrorAbort(state, result.cause_code, "%s", result.error.c_str());
+      } else {
+        LOG(ERROR) << result.error << " " << name << " failed.";
+      }
+      ok = false;
+      continue;
+    }
+    for (const auto& warning : result.warnings) {
+      state->updater->UiPrint(partitions[i] + ": " + warning);
+    }
+  }
+
+  return ok ? StringValue("t") : StringValue("");
 }
 
 Value* BlockImageRecoverFn(const char* name, State* state,
@@ -2264,15 +3514,27 @@ Value* BlockImageRecoverFn(const char* name, State* state,
     return StringValue("");
   }
 
-  uint8_t buffer[BLOCKSIZE];
+  // Read ranges through the fec handle in large batches rather than a block at a time.
+  // libfec verifies each block against the verity hash tree as it is read and only runs
+  // the (expensive) RS decode on blocks that fail verification, so intact blocks already
+  // skip decode; batching amortizes the syscall and per-read locking overhead inside
+  // libfec, which serializes reads on an internal mutex. That internal mutex is also why
+  // the ranges are recovered sequentially instead of from multiple threads.
+  constexpr size_t kRecoverChunkBlocks = 256;  // 1 MiB
+  std::vector<uint8_t> buffer(kRecoverChunkBlocks * BLOCKSIZE);
   for (const auto& [begin, end] : rs) {
-    for (size_t j = begin; j < end; ++j) {
+    for (size_t j = begin; j < end; j += kRecoverChunkBlocks) {
       // Stay within the data area, libfec validates and corrects metadata
       if (status.data_size <= static_cast<uint64_t>(j) * BLOCKSIZE) {
-        continue;
+        break;
       }
 
-      if (fh.pread(buffer, BLOCKSIZE, static_cast<off64_t>(j) * BLOCKSIZE) != BLOCKSIZE) {
+      uint64_t chunk_bytes = std::min<uint64_t>(end - j, kRecoverChunkBlocks) * BLOCKSIZE;
+      chunk_bytes = std::min<uint64_t>(chunk_bytes,
+                                       status.data_size - static_cast<uint64_t>(j) * BLOCKSIZE);
+
+      if (fh.pread(buffer.data(), chunk_bytes, static_cast<off64_t>(j) * BLOCKSIZE) !=
+          static_cast<ssize_t>(chunk_bytes)) {
         ErrorAbort(state, kLibfecFailure, "failed to recover %s (block %zu): %s",
                    block_device_path.c_str(), j, strerror(errno));
         return StringValue("");
@@ -2299,5 +3561,6 @@ void RegisterBlockImageFunctions() {
   RegisterFunction("block_image_update", BlockImageUpdateFn);
   RegisterFunction("block_image_recover", BlockImageRecoverFn);
   RegisterFunction("check_first_block", CheckFirstBlockFn);
+  RegisterFunction("check_first_blocks", CheckFirstBlocksFn);
   RegisterFunction("range_sha1", RangeSha1Fn);
 }
@@ -18,7 +18,9 @@
 
 #include <stdio.h>
 
+#include <atomic>
 #include <set>
+#include <thread>
 #include <vector>
 
 #include <android-base/logging.h>
@@ -42,6 +44,17 @@ bool BuildInfo::ParseTargetFile(const std::string_view target_file_path, bool ex
     return false;
   }
 
+  // Resolve which entry backs each mount point up front, then extract and convert the images with
+  // a pool of workers; extracting a multi-image target file dominates the simulator setup time and
+  // the images are independent. Each worker opens its own handle on the target file, since a
+  // ZipArchiveHandle shouldn't be shared across threads.
+  struct ExtractionJob {
+    const FstabInfo* fstab_info;
+    std::string entry_name;
+    TemporaryFile* image_file;
+    bool ok = false;
+  };
+  std::vector<ExtractionJob> jobs;
   for (const auto& fstab_info : fstab_info_list) {
     for (const auto& directory : { "IMAGES", "RADIO" }) {
       std::string entry_name = directory + fstab_info.mount_point + ".img";
@@ -51,31 +64,65 @@ bool BuildInfo::ParseTargetFile(const std::string_view target_file_path, bool ex
       }
 
       temp_files_.emplace_back(work_dir_);
-      auto& image_file = temp_files_.back();
-      if (!target_file.ExtractImage(entry_name, fstab_info, work_dir_, &image_file)) {
-        LOG(ERROR) << "Failed to set up source image files.";
-        return false;
-      }
+      jobs.push_back(ExtractionJob{ &fstab_info, std::move(entry_name), &temp_files_.back() });
+      break;
+    }
+  }
 
-      std::string mapped_path = image_file.path;
-      // Rename the images to more readable ones if we want to keep the image.
-      if (keep_images_) {
-        mapped_path = work_dir_ + fstab_info.mount_point + ".img";
-        image_file.release();
-        if (rename(image_file.path, mapped_path.c_str()) != 0) {
-          PLOG(ERROR) << "Failed to rename " << image_file.path << " to " << mapped_path;
-          return false;
+  size_t worker_count =
+      std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), jobs.size());
+  std::atomic<size_t> next_job{ 0 };
+  std::atomic<bool> failed{ false };
+  std::vector<std::thread> workers;
+  for (size_t i = 0; i < worker_count; ++i) {
+    workers.emplace_back([&, this] {
+      TargetFile worker_file(std::string(target_file_path), extracted_input);
+      if (!worker_file.Open()) {
+        failed = true;
+        return;
+      }
+      for (size_t job_index; (job_index = next_job.fetch_add(1)) < jobs.size();) {
+        if (failed) {
+          return;
+        }
+        auto& job = jobs[job_index];
+        job.ok = worker_file.ExtractImage(job.entry_name, *job.fstab_info, work_dir_,
+                                          job.image_file);
+        if (!job.ok) {
+          failed = true;
         }
       }
+    });
+  }
+  for (auto& worker : workers) {
+    worker.join();
+  }
 
-      LOG(INFO) << "Mounted " << fstab_info.mount_point << "\nMapping: " << fstab_info.blockdev_name
-                << " to " << mapped_path;
-
-      blockdev_map_.emplace(
-          fstab_info.blockdev_name,
-          FakeBlockDevice(fstab_info.blockdev_name, fstab_info.mount_point, mapped_path));
-      break;
+  for (auto& job : jobs) {
+    if (!job.ok) {
+      LOG(ERROR) << "Failed to set up source image files.";
+      return false;
+    }
+    const auto& fstab_info = *job.fstab_info;
+    auto& image_file = *job.image_file;
+
+    std::string mapped_path = image_file.path;
+    // Rename the images to more readable ones if we want to keep the image.
+    if (keep_images_) {
+      mapped_path = work_dir_ + fstab_info.mount_point + ".img";
+      image_file.release();
+      if (rename(image_file.path, mapped_path.c_str()) != 0) {
+        PLOG(ERROR) << "Failed to rename " << image_file.path << " to " << mapped_path;
+        return false;
+      }
     }
+
+    LOG(INFO) << "Mounted " << fstab_info.mount_point << "\nMapping: " << fstab_info.blockdev_name
+              << " to " << mapped_path;
+
+    blockdev_map_.emplace(
+        fstab_info.blockdev_name,
+        FakeBlockDevice(fstab_info.blockdev_name, fstab_info.mount_point, mapped_path));
   }
 
   return true;
@@ -87,27 +134,34 @@ std::string BuildInfo::GetProperty(const std::string_view key,
   // More details in common.py BuildInfo.GetBuildProp.
   // TODO(xunchang) handle the oem property and the source order defined in
   // ro.product.property_source_order
-  const std::set<std::string, std::less<>> ro_product_props = {
+  static const std::set<std::string, std::less<>> ro_product_props = {
     "ro.product.brand", "ro.product.device", "ro.product.manufacturer", "ro.product.model",
     "ro.product.name"
   };
-  const std::vector<std::string> source_order = {
+  static const std::vector<std::string> source_order = {
     "product", "odm", "vendor", "system_ext", "system",
   };
   if (ro_product_props.find(key) != ro_product_props.end()) {
+    if (auto cached = resolved_props_.find(key); cached != resolved_props_.end()) {
+      return cached->second;
+    }
     std::string_view key_suffix(key);
     CHECK(android::base::ConsumePrefix(&key_suffix, "ro.product"));
     for (const auto& source : source_order) {
       std::string resolved_key = "ro.product." + source + std::string(key_suffix);
       if (auto entry = build_props_.find(resolved_key); entry != build_props_.end()) {
+        resolved_props_.emplace(key, entry->second);
         return entry->second;
       }
     }
     LOG(WARNING) << "Failed to find property: " << key;
     return std::string(default_value);
   } else if (key == "ro.build.fingerprint") {
+    if (auto cached = resolved_props_.find(key); cached != resolved_props_.end()) {
+      return cached->second;
+    }
     // clang-format off
-    return android::base::StringPrintf("%s/%s/%s:%s/%s/%s:%s/%s",
+    std::string fingerprint = android::base::StringPrintf("%s/%s/%s:%s/%s/%s:%s/%s",
         GetProperty("ro.product.brand", "").c_str(),
         GetProperty("ro.product.name", "").c_str(),
         GetProperty("ro.product.device", "").c_str(),
@@ -117,6 +171,8 @@ std::string BuildInfo::GetProperty(const std::string_view key,
         GetProperty("ro.build.type", "").c_str(),
         GetProperty("ro.build.tags", "").c_str());
     // clang-format on
+    resolved_props_.emplace(key, fingerprint);
+    return fingerprint;
   }
 
   auto entry = build_props_.find(key);
@@ -45,7 +45,7 @@ Command::Command(Type type, size_t index, std::string cmdline, HashTreeInfo hash
   CHECK(type == Type::COMPUTE_HASH_TREE);
 }
 
-Command::Type Command::ParseType(const std::string& type_str) {
+Command::Type Command::ParseType(std::string_view type_str) {
   if (type_str == "abort") {
     if (!abort_allowed_) {
       LOG(ERROR) << "ABORT disallowed";
@@ -21,6 +21,7 @@
 #include <functional>
 #include <ostream>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include <gtest/gtest_prod.h>  // FRIEND_TEST
@@ -319,8 +320,9 @@ class Command {
   // evaluates to false, and the specific error message will be set in 'err'.
   static Command Parse(const std::string& line, size_t index, std::string* err);
 
-  // Parses the command type from the given string.
-  static Type ParseType(const std::string& type_str);
+  // Parses the command type from the given string. Takes a view so transfer-list passes can hand
+  // in unmaterialized slices of the command line.
+  static Type ParseType(std::string_view type_str);
 
   Type type() const {
     return type_;
@@ -62,6 +62,9 @@ class BuildInfo {
  private:
   // A map to store the system properties during simulation.
   std::map<std::string, std::string, std::less<>> build_props_;
+  // Memoized derived properties: the source-order resolution of the ro.product.* keys and the
+  // composed fingerprint, filled in on first query. Scripts call getprop() on these repeatedly.
+  mutable std::map<std::string, std::string, std::less<>> resolved_props_;
   // A file that contains the oem properties.
   std::string oem_settings_;
   // A map from the blockdev_name to the FakeBlockDevice object, which contains the path to the
@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+#include <mutex>
+
+// Process-wide budget for the updater's large memory consumers: the package mapping, the shared
+// source buffer, the new-data readahead, the source prefetch window and parallel-batch source
+// loads. Each of them is individually bounded, but their bounds were chosen in isolation; on a
+// low-RAM device the sum can push the updater past what the kernel will tolerate mid-flash. The
+// budget makes the elastic consumers (readahead and prefetch windows, batch size) shrink to fit
+// what the hard requirements leave over, instead of overcommitting and getting OOM-killed.
+//
+// The budget defaults to half of MemAvailable at process start; devices can pin it with the
+// ro.recovery.updater_memory_budget_mb property.
+class MemoryBudget {
+ public:
+  static MemoryBudget& Get();
+
+  // Reserves up to |wanted| bytes against the budget and returns the granted amount. The grant
+  // never drops below |minimum|: a consumer's floor is a correctness requirement (e.g. the source
+  // buffer must hold the largest command), so the budget overcommits with a warning rather than
+  // failing the install. Elastic consumers pass a small |minimum| and size their windows to the
+  // grant.
+  size_t Reserve(size_t wanted, size_t minimum);
+
+  // Returns a previous grant to the budget.
+  void Release(size_t bytes);
+
+  // Bytes not yet reserved; CollectParallelBatch uses it to stop growing a batch before the
+  // batch's reservation would overcommit.
+  size_t Available() const;
+
+  size_t total() const {
+    return total_;
+  }
+
+ private:
+  MemoryBudget();
+
+  size_t total_;
+  size_t used_ = 0;
+  mutable std::mutex mutex_;
+};
@@ -19,7 +19,9 @@
 #include <stdint.h>
 #include <stdio.h>
 
+#include <chrono>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <string_view>
 
@@ -68,6 +70,9 @@ class Updater : public UpdaterInterface {
   size_t GetMappedPackageLength() const override {
     return mapped_package_.length;
   }
+  const MemMapping* GetMappedPackage() const override {
+    return &mapped_package_;
+  }
 
  private:
   friend class UpdaterTestBase;
@@ -82,6 +87,12 @@ class Updater : public UpdaterInterface {
   // Parses the error code embedded in state->errmsg; and reports the error code and cause code.
   void ParseAndReportErrorCode(State* state);
 
+  // Sends any batched ui_print lines down the command pipe as a single write. Must be called
+  // before any other pipe command so the parent sees output in script order.
+  void FlushUiPrint() const;
+  // The unsynchronized flush body; the caller must hold ui_print_mutex_.
+  void FlushUiPrintLocked() const;
+
   std::unique_ptr<UpdaterRuntimeInterface> runtime_;
 
   MemMapping mapped_package_;
@@ -91,6 +102,14 @@ class Updater : public UpdaterInterface {
   bool is_retry_{ false };
   std::unique_ptr<FILE, decltype(&fclose)> cmd_pipe_{ nullptr, fclose };
 
+  // ui_print lines waiting to be written to the command pipe, already in wire format. Mutable
+  // because UiPrint() is const in the UpdaterInterface contract. The mutex serializes prints
+  // from parallel() branches, which run updater functions on worker threads.
+  mutable std::mutex ui_print_mutex_;
+  mutable std::string pending_ui_print_;
+  mutable size_t pending_ui_print_lines_{ 0 };
+  mutable std::chrono::steady_clock::time_point last_ui_print_flush_;
+
   std::string result_;
   std::vector<std::string> skipped_functions_;
 };
@@ -1325,8 +1325,10 @@ void RegisterInstallFunctions() {
   //                          "selabel", "u:object_r:system_file:s0", "capabilities", 0x0);
   RegisterFunction("set_metadata_recursive", SetMetadataFn);
 
-  RegisterFunction("getprop", GetPropFn);
-  RegisterFunction("file_getprop", FileGetPropFn);
+  // Pure lookups: scripts call these repeatedly with identical arguments (a dozen
+  // getprop("ro.product.device") calls is typical), so their results are memoized per run.
+  RegisterPureFunction("getprop", GetPropFn);
+  RegisterPureFunction("file_getprop", FileGetPropFn);
 
   RegisterFunction("apply_patch_space", ApplyPatchSpaceFn);
   RegisterFunction("patch_partition", PatchPartitionFn);
@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "updater/memory_budget.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/parseint.h>
+#include <android-base/properties.h>
+#include <android-base/strings.h>
+
+// Fallback when /proc/meminfo can't be read. Small enough for the 2 GB devices that motivated the
+// budget; the elastic consumers still get usable windows out of it.
+static constexpr size_t kFallbackBudget = 256 * 1024 * 1024;
+
+// Returns MemAvailable in bytes, or 0 when it can't be determined.
+static size_t ReadMemAvailable() {
+  std::string meminfo;
+  if (!android::base::ReadFileToString("/proc/meminfo", &meminfo)) {
+    return 0;
+  }
+  for (const auto& line : android::base::Split(meminfo, "\n")) {
+    if (!android::base::StartsWith(line, "MemAvailable:")) {
+      continue;
+    }
+    std::vector<std::string> fields = android::base::Split(line, " ");
+    // "MemAvailable:      123456 kB", with a run of spaces Split turns into empty tokens.
+    for (const auto& field : fields) {
+      size_t kb;
+      if (!field.empty() && field != "MemAvailable:" && android::base::ParseUint(field, &kb)) {
+        return kb * 1024;
+      }
+    }
+    return 0;
+  }
+  return 0;
+}
+
+MemoryBudget& MemoryBudget::Get() {
+  static MemoryBudget budget;
+  return budget;
+}
+
+MemoryBudget::MemoryBudget() {
+  uint64_t configured_mb =
+      android::base::GetUintProperty<uint64_t>("ro.recovery.updater_memory_budget_mb", 0);
+  if (configured_mb > 0) {
+    total_ = configured_mb * 1024 * 1024;
+  } else if (size_t available = ReadMemAvailable(); available > 0) {
+    // Half of what's available leaves room for the page cache the install I/O itself needs, and
+    // for allocations (zip state, brotli/zstd decoders, edify) that aren't budget-tracked.
+    total_ = available / 2;
+  } else {
+    total_ = kFallbackBudget;
+  }
+  LOG(INFO) << "updater memory budget: " << (total_ >> 20) << " MiB";
+}
+
+size_t MemoryBudget::Reserve(size_t wanted, size_t minimum) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  size_t available = total_ > used_ ? total_ - used_ : 0;
+  size_t granted = std::min(wanted, available);
+  if (granted < minimum) {
+    LOG(WARNING) << "memory budget overcommitted: granting required " << (minimum >> 10)
+                 << " KiB with " << (available >> 10) << " KiB left of " << (total_ >> 20)
+                 << " MiB";
+    granted = minimum;
+  }
+  used_ += granted;
+  return granted;
+}
+
+void MemoryBudget::Release(size_t bytes) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  used_ -= std::min(bytes, used_);
+}
+
+size_t MemoryBudget::Available() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return total_ > used_ ? total_ - used_ : 0;
+}
@@ -19,15 +19,19 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <mntent.h>
+#include <poll.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/mount.h>
+#include <unistd.h>
 
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include <android-base/logging.h>
+#include <android-base/unique_fd.h>
 
 struct MountedVolume {
   std::string device;
@@ -37,12 +41,42 @@ struct MountedVolume {
 };
 
 static std::vector<MountedVolume*> g_mounts_state;
+static std::unordered_map<std::string, MountedVolume*> g_mounts_by_mount_point;
+
+// Change detector for the cached mount table. The kernel flags POLLERR|POLLPRI on an open
+// /proc/mounts fd whenever the mount table changes since it was last read, so a zero-timeout
+// poll() tells us whether the cached parse is still current without re-reading anything.
+static android::base::unique_fd g_mounts_poll_fd;
+static bool g_mounts_cache_valid = false;
 
 bool scan_mounted_volumes() {
+  if (g_mounts_poll_fd == -1) {
+    g_mounts_poll_fd.reset(TEMP_FAILURE_RETRY(open("/proc/mounts", O_RDONLY | O_CLOEXEC)));
+  }
+
+  if (g_mounts_cache_valid && g_mounts_poll_fd != -1) {
+    struct pollfd pfd = { .fd = g_mounts_poll_fd.get(), .events = POLLERR | POLLPRI };
+    if (TEMP_FAILURE_RETRY(poll(&pfd, 1, 0)) == 0) {
+      // No mount table change since the last parse; keep the cached state.
+      return true;
+    }
+  }
+
+  // Re-arm the notification by consuming the detector fd before parsing, so a change that races
+  // with the parse re-signals instead of going unnoticed.
+  if (g_mounts_poll_fd != -1) {
+    char drain[4096];
+    lseek(g_mounts_poll_fd.get(), 0, SEEK_SET);
+    while (TEMP_FAILURE_RETRY(read(g_mounts_poll_fd.get(), drain, sizeof(drain))) > 0) {
+    }
+  }
+
   for (size_t i = 0; i < g_mounts_state.size(); ++i) {
     delete g_mounts_state[i];
   }
   g_mounts_state.clear();
+  g_mounts_by_mount_point.clear();
+  g_mounts_cache_valid = false;
 
   // Open and read mount table entries.
   FILE* fp = setmntent("/proc/mounts", "re");
@@ -57,16 +91,17 @@ bool scan_mounted_volumes() {
     v->filesystem = e->mnt_type;
     v->flags = e->mnt_opts;
     g_mounts_state.push_back(v);
+    // Keep the first entry on duplicate mount points, matching the old linear scan.
+    g_mounts_by_mount_point.emplace(v->mount_point, v);
   }
   endmntent(fp);
+  g_mounts_cache_valid = true;
   return true;
 }
 
 MountedVolume* find_mounted_volume_by_mount_point(const char* mount_point) {
-  for (size_t i = 0; i < g_mounts_state.size(); ++i) {
-    if (g_mounts_state[i]->mount_point == mount_point) return g_mounts_state[i];
-  }
-  return nullptr;
+  auto it = g_mounts_by_mount_point.find(mount_point);
+  return it != g_mounts_by_mount_point.end() ? it->second : nullptr;
 }
 
 int unmount_mounted_volume(MountedVolume* volume) {
@@ -74,6 +109,9 @@ int unmount_mounted_volume(MountedVolume* volume) {
   // already unmounted using this function.
   std::string mount_point = volume->mount_point;
   volume->mount_point.clear();
+  // The entry above is now out of sync with the kernel whether or not the umount succeeds, so
+  // force the next scan to re-parse rather than serve the cache.
+  g_mounts_cache_valid = false;
   int result = umount(mount_point.c_str());
   if (result == -1) {
     PLOG(WARNING) << "Failed to umount " << mount_point;
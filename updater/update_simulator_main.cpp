@@ -15,14 +15,23 @@
  */
 
 #include <getopt.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <chrono>
+#include <map>
 #include <string>
 #include <string_view>
+#include <thread>
+#include <vector>
 
 #include <android-base/file.h>
 #include <android-base/logging.h>
+#include <android-base/parseint.h>
+#include <android-base/stringprintf.h>
 #include <android-base/strings.h>
 
 #include "edify/expr.h"
@@ -41,7 +50,7 @@ void Usage(std::string_view name) {
   LOG(INFO) << "Usage: " << name << "[--oem_settings <oem_property_file>]"
             << "[--skip_functions <skip_function_file>]"
             << " --source <source_target_file>"
-            << " --ota_package <ota_package>";
+            << " (--ota_package <ota_package> | --corpus <package_list_file> [--jobs <n>])";
 }
 
 Value* SimulatorPlaceHolderFn(const char* name, State* /* state */,
@@ -50,6 +59,96 @@ Value* SimulatorPlaceHolderFn(const char* name, State* /* state */,
   return StringValue("t");
 }
 
+// Simulates one OTA package against the parsed source build. The scratch files that the updater
+// reaches through Paths (saved source, last command, stashes, compiled script cache) are created
+// here so every scenario gets its own set.
+static bool RunScenario(BuildInfo* build_info, const std::string& package,
+                        const std::string& compiled_script_cache) {
+  TemporaryFile temp_saved_source;
+  TemporaryFile temp_last_command;
+  TemporaryDir temp_stash_base;
+
+  Paths::Get().set_cache_temp_source(temp_saved_source.path);
+  Paths::Get().set_last_command_file(temp_last_command.path);
+  Paths::Get().set_stash_directory_base(temp_stash_base.path);
+  Paths::Get().set_compiled_script_cache_file(compiled_script_cache);
+
+  TemporaryFile cmd_pipe;
+  Updater updater(std::make_unique<SimulatorRuntime>(build_info));
+  if (!updater.Init(cmd_pipe.release(), package, false)) {
+    return false;
+  }
+
+  if (!updater.RunUpdate()) {
+    return false;
+  }
+
+  LOG(INFO) << "\nscript succeeded, result: " << updater.GetResult();
+  return true;
+}
+
+// Runs every package in the corpus against the already-parsed source build, |jobs| at a time.
+// Isolation is by worker process rather than worker thread: edify's function registry and
+// otautil's Paths are process-wide singletons, so forking after the source target file has been
+// parsed gives each scenario its own copy-on-write BuildInfo and Paths while the parsed source
+// stays physically shared between workers. Each scenario logs to its own file under |work_dir|;
+// the parent prints one PASS/FAIL line with the wall time per scenario.
+static int RunCorpus(BuildInfo* build_info, const std::vector<std::string>& packages,
+                     const std::string& work_dir, size_t jobs) {
+  struct Scenario {
+    size_t index;
+    std::chrono::steady_clock::time_point start;
+  };
+  std::map<pid_t, Scenario> running;
+  size_t next = 0;
+  size_t failures = 0;
+
+  while (next < packages.size() || !running.empty()) {
+    while (next < packages.size() && running.size() < jobs) {
+      std::string log_path = android::base::StringPrintf("%s/scenario_%03zu.log",
+                                                         work_dir.c_str(), next);
+      pid_t pid = fork();
+      if (pid == 0) {
+        // Give each scenario its own log, so concurrent output doesn't interleave.
+        freopen(log_path.c_str(), "w", stdout);
+        freopen(log_path.c_str(), "w", stderr);
+        bool ok = RunScenario(
+            build_info, packages[next],
+            android::base::StringPrintf("%s/compiled_script_%03zu", work_dir.c_str(), next));
+        fflush(stdout);
+        fflush(stderr);
+        _exit(ok ? EXIT_SUCCESS : EXIT_FAILURE);
+      }
+      if (pid == -1) {
+        PLOG(ERROR) << "Failed to fork scenario worker";
+        return EXIT_FAILURE;
+      }
+      running.emplace(pid, Scenario{ next, std::chrono::steady_clock::now() });
+      ++next;
+    }
+
+    int status;
+    pid_t pid = TEMP_FAILURE_RETRY(waitpid(-1, &status, 0));
+    auto it = running.find(pid);
+    if (it == running.end()) {
+      continue;
+    }
+    bool ok = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    if (!ok) {
+      ++failures;
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - it->second.start;
+    LOG(INFO) << (ok ? "PASS" : "FAIL") << " [" << it->second.index + 1 << "/" << packages.size()
+              << "] " << packages[it->second.index]
+              << android::base::StringPrintf(" (%.2fs)", elapsed.count());
+    running.erase(it);
+  }
+
+  LOG(INFO) << packages.size() - failures << "/" << packages.size() << " scenarios passed, logs"
+            << " under " << work_dir;
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
 int main(int argc, char** argv) {
   // Write the logs to stdout.
   android::base::InitLogging(argv, &android::base::StderrLogger);
@@ -58,10 +157,14 @@ int main(int argc, char** argv) {
   std::string skip_function_file;
   std::string source_target_file;
   std::string package_name;
+  std::string corpus_file;
   std::string work_dir;
+  size_t jobs = std::max(1u, std::thread::hardware_concurrency());
   bool keep_images = false;
 
   constexpr struct option OPTIONS[] = {
+    { "corpus", required_argument, nullptr, 0 },
+    { "jobs", required_argument, nullptr, 0 },
     { "keep_images", no_argument, nullptr, 0 },
     { "oem_settings", required_argument, nullptr, 0 },
     { "ota_package", required_argument, nullptr, 0 },
@@ -90,6 +193,13 @@ int main(int argc, char** argv) {
       source_target_file = optarg;
     } else if (option_name == "ota_package"s) {
       package_name = optarg;
+    } else if (option_name == "corpus"s) {
+      corpus_file = optarg;
+    } else if (option_name == "jobs"s) {
+      if (!android::base::ParseUint(optarg, &jobs) || jobs == 0) {
+        LOG(ERROR) << "Invalid jobs count " << optarg;
+        return EXIT_FAILURE;
+      }
     } else if (option_name == "keep_images"s) {
       keep_images = true;
     } else if (option_name == "work_dir"s) {
@@ -100,7 +210,7 @@ int main(int argc, char** argv) {
     }
   }
 
-  if (source_target_file.empty() || package_name.empty()) {
+  if (source_target_file.empty() || (package_name.empty() == corpus_file.empty())) {
     Usage(argv[0]);
     return EXIT_FAILURE;
   }
@@ -127,15 +237,6 @@ int main(int argc, char** argv) {
     }
   }
 
-  TemporaryFile temp_saved_source;
-  TemporaryFile temp_last_command;
-  TemporaryDir temp_stash_base;
-
-  Paths::Get().set_cache_temp_source(temp_saved_source.path);
-  Paths::Get().set_last_command_file(temp_last_command.path);
-  Paths::Get().set_stash_directory_base(temp_stash_base.path);
-
-  TemporaryFile cmd_pipe;
   TemporaryDir source_temp_dir;
   if (work_dir.empty()) {
     work_dir = source_temp_dir.path;
@@ -152,16 +253,30 @@ int main(int argc, char** argv) {
     source_build_info.SetOemSettings(oem_settings);
   }
 
-  Updater updater(std::make_unique<SimulatorRuntime>(&source_build_info));
-  if (!updater.Init(cmd_pipe.release(), package_name, false)) {
-    return EXIT_FAILURE;
-  }
-
-  if (!updater.RunUpdate()) {
-    return EXIT_FAILURE;
+  if (!corpus_file.empty()) {
+    std::string content;
+    if (!android::base::ReadFileToString(corpus_file, &content)) {
+      PLOG(ERROR) << "Failed to read " << corpus_file;
+      return EXIT_FAILURE;
+    }
+    std::vector<std::string> packages;
+    for (const auto& line : android::base::Split(content, "\n")) {
+      auto package = android::base::Trim(line);
+      if (package.empty() || android::base::StartsWith(package, "#")) {
+        continue;
+      }
+      packages.push_back(package);
+    }
+    if (packages.empty()) {
+      LOG(ERROR) << "Corpus " << corpus_file << " lists no packages";
+      return EXIT_FAILURE;
+    }
+    return RunCorpus(&source_build_info, packages, work_dir, jobs);
   }
 
-  LOG(INFO) << "\nscript succeeded, result: " << updater.GetResult();
-
-  return 0;
+  // Keep the compiled script cache in the work dir, so repeated simulations of the same package
+  // with a persistent --work_dir skip re-parsing the script.
+  return RunScenario(&source_build_info, package_name, work_dir + "/compiled_script")
+             ? EXIT_SUCCESS
+             : EXIT_FAILURE;
 }
@@ -19,14 +19,29 @@
 #include <string.h>
 #include <unistd.h>
 
+#include <chrono>
+#include <mutex>
 #include <string>
 
+#include <android-base/file.h>
 #include <android-base/logging.h>
 #include <android-base/strings.h>
 
 #include "edify/updater_runtime_interface.h"
+#include "otautil/paths.h"
+#include "updater/memory_budget.h"
+
+// ui_print batching: every line sent down the pipe wakes the parent and redraws the screen log,
+// and scripts that print per file emit thousands of lines. Flush a batch once it reaches this
+// many lines, or on the first line printed after the latency window has passed — so chatty
+// phases coalesce while occasional prints still show up immediately.
+static constexpr size_t kUiPrintBatchLines = 32;
+static constexpr auto kUiPrintMaxLatency = std::chrono::milliseconds(100);
 
 Updater::~Updater() {
+  if (cmd_pipe_) {
+    FlushUiPrint();
+  }
   if (package_handle_) {
     CloseArchive(package_handle_);
   }
@@ -41,11 +56,23 @@ bool Updater::Init(int fd, const std::string_view package_filename, bool is_retr
   }
 
   setlinebuf(cmd_pipe_.get());
+  last_ui_print_flush_ = std::chrono::steady_clock::now();
 
   if (!mapped_package_.MapFile(std::string(package_filename))) {
     LOG(ERROR) << "failed to map package " << package_filename;
     return false;
   }
+  // Both the zip central directory walk and the per-command patch reads jump around the package;
+  // the default readahead only thrashes the page cache on devices that can't hold the whole
+  // package in RAM. Consumers hint the sequential windows themselves.
+  mapped_package_.Advise(MemMapping::AccessPattern::kRandom);
+
+  // The mapping is file-backed and reclaimable, but its resident pages compete with everything
+  // else the install allocates; charging it makes the elastic consumers in blockimg size their
+  // windows around it. A zero floor keeps a package bigger than the whole budget from counting
+  // as an overcommit — it can't be unmapped, the rest just falls back to minimum windows. Never
+  // released: the package stays mapped for the whole run.
+  MemoryBudget::Get().Reserve(mapped_package_.length, 0);
   if (int open_err = OpenArchiveFromMemory(mapped_package_.addr, mapped_package_.length,
                                            std::string(package_filename).c_str(), &package_handle_);
       open_err != 0) {
@@ -65,13 +92,22 @@ bool Updater::Init(int fd, const std::string_view package_filename, bool is_retr
 bool Updater::RunUpdate() {
   CHECK(runtime_);
 
-  // Parse the script.
-  std::unique_ptr<Expr> root;
-  int error_count = 0;
-  int error = ParseString(updater_script_, &root, &error_count);
-  if (error != 0 || error_count > 0) {
-    LOG(ERROR) << error_count << " parse errors";
-    return false;
+  // Parse the script, reusing the compiled tree cached by a previous run of the same script
+  // (e.g. the first attempt of a retried install) when there is one.
+  std::string script_cache = Paths::Get().compiled_script_cache_file();
+  std::unique_ptr<Expr> root = LoadCompiledScript(updater_script_, script_cache);
+  if (root) {
+    LOG(INFO) << "Loaded compiled script from " << script_cache;
+  } else {
+    int error_count = 0;
+    int error = ParseString(updater_script_, &root, &error_count);
+    if (error != 0 || error_count > 0) {
+      LOG(ERROR) << error_count << " parse errors";
+      return false;
+    }
+    if (!script_cache.empty() && !SaveCompiledScript(updater_script_, root.get(), script_cache)) {
+      LOG(WARNING) << "Failed to cache compiled script at " << script_cache;
+    }
   }
 
   // Evaluate the parsed script.
@@ -79,6 +115,7 @@ bool Updater::RunUpdate() {
   state.is_retry = is_retry_;
 
   bool status = Evaluate(&state, root, &result_);
+  FlushUiPrint();
   if (status) {
     fprintf(cmd_pipe_.get(), "ui_print script succeeded: result was [%s]\n", result_.c_str());
     // Even though the script doesn't abort, still log the cause code if result is empty.
@@ -96,6 +133,9 @@ bool Updater::RunUpdate() {
 }
 
 void Updater::WriteToCommandPipe(const std::string_view message, bool flush) const {
+  // Keep the pipe in script order: any ui_print lines still sitting in the batch predate this
+  // command and must reach the parent first.
+  FlushUiPrint();
   fprintf(cmd_pipe_.get(), "%s\n", std::string(message).c_str());
   if (flush) {
     fflush(cmd_pipe_.get());
@@ -106,9 +146,21 @@ void Updater::UiPrint(const std::string_view message) const {
   // "line1\nline2\n" will be split into 3 tokens: "line1", "line2" and "".
   // so skip sending empty strings to ui.
   std::vector<std::string> lines = android::base::Split(std::string(message), "\n");
-  for (const auto& line : lines) {
-    if (!line.empty()) {
-      fprintf(cmd_pipe_.get(), "ui_print %s\n", line.c_str());
+  {
+    std::lock_guard<std::mutex> lock(ui_print_mutex_);
+    for (const auto& line : lines) {
+      if (!line.empty()) {
+        pending_ui_print_ += "ui_print ";
+        pending_ui_print_ += line;
+        pending_ui_print_ += '\n';
+        ++pending_ui_print_lines_;
+      }
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    if (pending_ui_print_lines_ >= kUiPrintBatchLines ||
+        now - last_ui_print_flush_ >= kUiPrintMaxLatency) {
+      FlushUiPrintLocked();
     }
   }
 
@@ -118,12 +170,34 @@ void Updater::UiPrint(const std::string_view message) const {
   LOG(INFO) << message;
 }
 
+void Updater::FlushUiPrint() const {
+  std::lock_guard<std::mutex> lock(ui_print_mutex_);
+  FlushUiPrintLocked();
+}
+
+void Updater::FlushUiPrintLocked() const {
+  if (pending_ui_print_.empty()) {
+    return;
+  }
+  // The pipe stream is line buffered, so going through stdio would turn the batch back into one
+  // write per line. Flush any buffered stream output for ordering, then push the whole batch to
+  // the fd in a single write.
+  fflush(cmd_pipe_.get());
+  if (!android::base::WriteStringToFd(pending_ui_print_, fileno(cmd_pipe_.get()))) {
+    PLOG(ERROR) << "Failed to write ui_print batch to the command pipe";
+  }
+  pending_ui_print_.clear();
+  pending_ui_print_lines_ = 0;
+  last_ui_print_flush_ = std::chrono::steady_clock::now();
+}
+
 std::string Updater::FindBlockDeviceName(const std::string_view name) const {
   return runtime_->FindBlockDeviceName(name);
 }
 
 void Updater::ParseAndReportErrorCode(State* state) {
   CHECK(state);
+  FlushUiPrint();
   if (state->errmsg.empty()) {
     LOG(ERROR) << "script aborted (no error message)";
     fprintf(cmd_pipe_.get(), "ui_print script aborted (no error message)\n");
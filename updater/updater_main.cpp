@@ -18,7 +18,11 @@
 #include <string.h>
 #include <unistd.h>
 
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
 #include <string>
+#include <thread>
 
 #include <android-base/logging.h>
 #include <android-base/parseint.h>
@@ -28,6 +32,7 @@
 #include <selinux/selinux.h>
 
 #include "edify/expr.h"
+#include "otautil/trace.h"
 #include "updater/blockimg.h"
 #include "updater/dynamic_partitions.h"
 #include "updater/install.h"
@@ -39,10 +44,84 @@
 // registration functions for device-specific extensions.
 #include "register.inc"
 
-static void UpdaterLogger(android::base::LogId /* id */, android::base::LogSeverity /* severity */,
+// Hot loops in blockimg and applypatch log per command or per range, and stdout is deliberately
+// unbuffered, so every LOG() line used to cost a write(2) — 3-4% of update CPU in profiles, and
+// verbose failure paths (e.g. the per-block stash hash dumps) emit thousands of lines. Buffer the
+// lines instead and let a dedicated thread write them out in batches, so a hot-path log costs an
+// in-memory append. Warnings and errors request an immediate flush, keeping failure context out
+// of the buffer when something goes wrong.
+class BufferedLogWriter {
+ public:
+  BufferedLogWriter() : flusher_(&BufferedLogWriter::Flusher, this) {}
+
+  // Detaches the global logger first so a LOG() from a later destructor falls back to the
+  // direct fprintf path instead of a dead writer.
+  ~BufferedLogWriter();
+
+  void Write(android::base::LogSeverity severity, const char* message) {
+    bool flush_now;
+    {
+      std::lock_guard<std::mutex> lg(mutex_);
+      buffer_ += message;
+      buffer_ += '\n';
+      flush_now = severity >= android::base::WARNING || buffer_.size() >= kFlushBytes;
+      flush_requested_ |= flush_now;
+    }
+    if (flush_now) {
+      cond_.notify_one();
+    }
+  }
+
+ private:
+  // Bounds how long an INFO line can sit in the buffer before it reaches the log.
+  static constexpr auto kFlushInterval = std::chrono::milliseconds(100);
+  static constexpr size_t kFlushBytes = 64 * 1024;
+
+  void Flusher() {
+    std::unique_lock<std::mutex> lk(mutex_);
+    while (true) {
+      cond_.wait_for(lk, kFlushInterval, [this] { return stop_ || flush_requested_; });
+      if (buffer_.empty()) {
+        if (stop_) return;
+        continue;
+      }
+      std::string out;
+      out.swap(buffer_);
+      flush_requested_ = false;
+      lk.unlock();
+      fwrite(out.data(), 1, out.size(), stdout);
+      lk.lock();
+    }
+  }
+
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::string buffer_;
+  bool flush_requested_ = false;
+  bool stop_ = false;
+  std::thread flusher_;
+};
+
+static BufferedLogWriter* g_log_writer = nullptr;
+
+BufferedLogWriter::~BufferedLogWriter() {
+  g_log_writer = nullptr;
+  {
+    std::lock_guard<std::mutex> lg(mutex_);
+    stop_ = true;
+  }
+  cond_.notify_all();
+  flusher_.join();
+}
+
+static void UpdaterLogger(android::base::LogId /* id */, android::base::LogSeverity severity,
                           const char* /* tag */, const char* /* file */, unsigned int /* line */,
                           const char* message) {
-  fprintf(stdout, "%s\n", message);
+  if (g_log_writer) {
+    g_log_writer->Write(severity, message);
+  } else {
+    fprintf(stdout, "%s\n", message);
+  }
 }
 
 int main(int argc, char** argv) {
@@ -57,6 +136,10 @@ int main(int argc, char** argv) {
   // (which is redirected to recovery.log).
   android::base::InitLogging(argv, &UpdaterLogger);
 
+  // From here on LOG() lines are batched; the writer flushes what's left when main returns.
+  BufferedLogWriter log_writer;
+  g_log_writer = &log_writer;
+
   // Run the libcrypto KAT(known answer tests) based self tests.
   if (BORINGSSL_self_test() != 1) {
     LOG(ERROR) << "Failed to run the boringssl self tests";
@@ -103,14 +186,16 @@ int main(int argc, char** argv) {
   auto sehandle = selinux_android_file_context_handle();
   selinux_android_set_sehandle(sehandle);
 
+  // /cache is mounted by recovery before it execs us, so the trace flag file is visible here.
+  InitTracing();
+
   Updater updater(std::make_unique<UpdaterRuntime>(sehandle));
   if (!updater.Init(fd, package_name, is_retry)) {
     return EXIT_FAILURE;
   }
 
-  if (!updater.RunUpdate()) {
-    return EXIT_FAILURE;
-  }
+  bool update_ok = updater.RunUpdate();
+  DumpTrace();
 
-  return EXIT_SUCCESS;
+  return update_ok ? EXIT_SUCCESS : EXIT_FAILURE;
 }
\ No newline at end of file
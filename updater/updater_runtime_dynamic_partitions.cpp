@@ -338,6 +338,9 @@ bool UpdaterRuntime::UpdateDynamicPartitions(const std::string_view op_list_valu
     // clang-format on
   };
 
+  // The ops only mutate the in-memory builder (plus unmapping stale device-mapper devices);
+  // the single Export()/UpdatePartitionTable() below is the only metadata write, so the whole
+  // op_list commits to super in one flush or not at all.
   std::vector<std::string> lines = android::base::Split(std::string(op_list_value), "\n");
   for (const auto& line : lines) {
     auto comment_idx = line.find('#');
@@ -353,7 +356,7 @@ bool UpdaterRuntime::UpdateDynamicPartitions(const std::string_view op_list_valu
       return false;
     }
     OpParameters params;
-    params.tokens = tokens;
+    params.tokens = std::move(tokens);
     params.builder = builder.get();
     if (!it->second(params)) {
       return false;
@@ -76,6 +76,8 @@ class Disk {
 
     void listVolumes(VolumeBase::Type type, std::list<std::string>& list);
 
+    const std::vector<std::shared_ptr<VolumeBase>>& getVolumes() const { return mVolumes; }
+
     virtual status_t create();
     virtual status_t destroy();
 
@@ -28,6 +28,12 @@
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include <atomic>
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+
 #define LOG_TAG "ProcessKiller"
 
 #include <android-base/file.h>
@@ -176,35 +182,208 @@ int Process::killProcessesWithOpenFiles(const char* path, int signal) {
         return count;
     }
 
+    std::vector<int> pids;
     while ((de = readdir(dir))) {
         int pid = getPid(de->d_name);
-        if (pid == -1) continue;
+        if (pid != -1) pids.push_back(pid);
+    }
+    closedir(dir);
+
+    // Probe the pids concurrently: each probe is a burst of tiny /proc reads that mostly blocks
+    // in the kernel, and the checks for one pid stop at the first hit. The process name is only
+    // looked up for pids that match, which saves a cmdline read per innocent process. No result
+    // is cached between calls, since the whole point of re-scanning after a signal is to observe
+    // which processes are still holding references.
+    std::vector<std::string> reasons(pids.size());
+    std::atomic<size_t> next_pid{ 0 };
+    size_t worker_count =
+        std::min(pids.size(), static_cast<size_t>(std::thread::hardware_concurrency() ?: 4));
+    std::vector<std::future<void>> workers;
+    for (size_t w = 0; w < worker_count; ++w) {
+        workers.emplace_back(std::async(std::launch::async, [&pids, &reasons, &next_pid, path]() {
+            for (size_t i = next_pid.fetch_add(1); i < pids.size(); i = next_pid.fetch_add(1)) {
+                int pid = pids[i];
+                char openfile[PATH_MAX];
+                if (checkFileDescriptorSymLinks(pid, path, openfile, sizeof(openfile))) {
+                    reasons[i] = StringPrintf("has open file %s", openfile);
+                } else if (checkFileMaps(pid, path, openfile, sizeof(openfile))) {
+                    reasons[i] = StringPrintf("has open filemap for %s", openfile);
+                } else if (checkSymLink(pid, path, "cwd")) {
+                    reasons[i] = StringPrintf("has cwd within %s", path);
+                } else if (checkSymLink(pid, path, "root")) {
+                    reasons[i] = StringPrintf("has chroot within %s", path);
+                } else if (checkSymLink(pid, path, "exe")) {
+                    reasons[i] = StringPrintf("has executable path within %s", path);
+                }
+            }
+        }));
+    }
+    for (auto& worker : workers) {
+        worker.wait();
+    }
+
+    // Log and signal serially, in pid order, so the output reads the same as the old single
+    // threaded scan.
+    for (size_t i = 0; i < pids.size(); ++i) {
+        if (reasons[i].empty()) continue;
 
         std::string name;
-        getProcessName(pid, name);
-
-        char openfile[PATH_MAX];
-
-        if (checkFileDescriptorSymLinks(pid, path, openfile, sizeof(openfile))) {
-            SLOGE("Process %s (%d) has open file %s", name.c_str(), pid, openfile);
-        } else if (checkFileMaps(pid, path, openfile, sizeof(openfile))) {
-            SLOGE("Process %s (%d) has open filemap for %s", name.c_str(), pid, openfile);
-        } else if (checkSymLink(pid, path, "cwd")) {
-            SLOGE("Process %s (%d) has cwd within %s", name.c_str(), pid, path);
-        } else if (checkSymLink(pid, path, "root")) {
-            SLOGE("Process %s (%d) has chroot within %s", name.c_str(), pid, path);
-        } else if (checkSymLink(pid, path, "exe")) {
-            SLOGE("Process %s (%d) has executable path within %s", name.c_str(), pid, path);
-        } else {
-            continue;
-        }
+        getProcessName(pids[i], name);
+        SLOGE("Process %s (%d) %s", name.c_str(), pids[i], reasons[i].c_str());
 
         if (signal != 0) {
-            SLOGW("Sending %s to process %d", strsignal(signal), pid);
-            kill(pid, signal);
+            SLOGW("Sending %s to process %d", strsignal(signal), pids[i]);
+            kill(pids[i], signal);
             count++;
         }
     }
+    return count;
+}
+
+// Collects every path the given process references: open fds, file-backed maps, and the cwd,
+// root and exe links. Mirrors the probes in killProcessesWithOpenFiles(), in the same precedence
+// order, but records all hits instead of stopping at the first match against one mount point.
+void Process::collectProcessRefs(int pid, std::vector<OpenFilesSnapshot::Ref>* refs) {
+    char path[PATH_MAX];
+    char link[PATH_MAX];
+
+    snprintf(path, sizeof(path), "/proc/%d/fd", pid);
+    if (DIR* dir = opendir(path)) {
+        int parent_length = strlen(path);
+        path[parent_length++] = '/';
+
+        struct dirent* de;
+        while ((de = readdir(dir))) {
+            if (!strcmp(de->d_name, ".") || !strcmp(de->d_name, "..") ||
+                strlen(de->d_name) + parent_length + 1 >= PATH_MAX)
+                continue;
+
+            path[parent_length] = 0;
+            strlcat(path, de->d_name, PATH_MAX);
+
+            if (readSymLink(path, link, sizeof(link)) && link[0] == '/') {
+                refs->push_back({ link, OpenFilesSnapshot::RefKind::kOpenFile });
+            }
+        }
+        closedir(dir);
+    }
+
+    snprintf(path, sizeof(path), "/proc/%d/maps", pid);
+    if (FILE* file = fopen(path, "re")) {
+        char buffer[PATH_MAX + 100];
+        while (fgets(buffer, sizeof(buffer), file)) {
+            const char* mapped = strchr(buffer, '/');
+            if (!mapped) continue;
+
+            std::string mapped_path(mapped);
+            while (!mapped_path.empty() &&
+                   (mapped_path.back() == '\n' || mapped_path.back() == '\r')) {
+                mapped_path.pop_back();
+            }
+            refs->push_back({ std::move(mapped_path), OpenFilesSnapshot::RefKind::kFileMap });
+        }
+        fclose(file);
+    }
+
+    static const struct {
+        const char* name;
+        OpenFilesSnapshot::RefKind kind;
+    } kLinks[] = {
+        { "cwd", OpenFilesSnapshot::RefKind::kCwd },
+        { "root", OpenFilesSnapshot::RefKind::kRoot },
+        { "exe", OpenFilesSnapshot::RefKind::kExe },
+    };
+    for (const auto& l : kLinks) {
+        snprintf(path, sizeof(path), "/proc/%d/%s", pid, l.name);
+        if (readSymLink(path, link, sizeof(link)) && link[0] == '/') {
+            refs->push_back({ link, l.kind });
+        }
+    }
+}
+
+Process::OpenFilesSnapshot Process::takeOpenFilesSnapshot() {
+    OpenFilesSnapshot snapshot;
+
+    DIR* dir = opendir("/proc");
+    if (!dir) {
+        SLOGE("opendir failed (%s)", strerror(errno));
+        return snapshot;
+    }
+
+    std::vector<int> pids;
+    struct dirent* de;
+    while ((de = readdir(dir))) {
+        int pid = getPid(de->d_name);
+        if (pid != -1) pids.push_back(pid);
+    }
     closedir(dir);
+
+    // Same concurrent probe scheme as killProcessesWithOpenFiles() above.
+    std::vector<OpenFilesSnapshot::Entry> entries(pids.size());
+    std::atomic<size_t> next_pid{ 0 };
+    size_t worker_count =
+        std::min(pids.size(), static_cast<size_t>(std::thread::hardware_concurrency() ?: 4));
+    std::vector<std::future<void>> workers;
+    for (size_t w = 0; w < worker_count; ++w) {
+        workers.emplace_back(std::async(std::launch::async, [&pids, &entries, &next_pid]() {
+            for (size_t i = next_pid.fetch_add(1); i < pids.size(); i = next_pid.fetch_add(1)) {
+                entries[i].pid = pids[i];
+                collectProcessRefs(pids[i], &entries[i].refs);
+            }
+        }));
+    }
+    for (auto& worker : workers) {
+        worker.wait();
+    }
+
+    for (auto& entry : entries) {
+        if (!entry.refs.empty()) {
+            snapshot.mEntries.push_back(std::move(entry));
+        }
+    }
+    return snapshot;
+}
+
+int Process::OpenFilesSnapshot::killProcessesWithOpenFiles(const char* path, int signal) const {
+    int count = 0;
+    for (const auto& entry : mEntries) {
+        const Ref* match = nullptr;
+        for (const auto& ref : entry.refs) {
+            if (Process::pathMatchesMountPoint(ref.path.c_str(), path)) {
+                match = &ref;
+                break;
+            }
+        }
+        if (match == nullptr) continue;
+
+        std::string reason;
+        switch (match->kind) {
+            case RefKind::kOpenFile:
+                reason = StringPrintf("has open file %s", match->path.c_str());
+                break;
+            case RefKind::kFileMap:
+                reason = StringPrintf("has open filemap for %s", match->path.c_str());
+                break;
+            case RefKind::kCwd:
+                reason = StringPrintf("has cwd within %s", path);
+                break;
+            case RefKind::kRoot:
+                reason = StringPrintf("has chroot within %s", path);
+                break;
+            case RefKind::kExe:
+                reason = StringPrintf("has executable path within %s", path);
+                break;
+        }
+
+        std::string name;
+        Process::getProcessName(entry.pid, name);
+        SLOGE("Process %s (%d) %s", name.c_str(), entry.pid, reason.c_str());
+
+        if (signal != 0) {
+            SLOGW("Sending %s to process %d", strsignal(signal), entry.pid);
+            kill(entry.pid, signal);
+            count++;
+        }
+    }
     return count;
 }
@@ -18,8 +18,37 @@
 #ifndef _PROCESS_H
 #define _PROCESS_H
 
+#include <string>
+#include <vector>
+
 class Process {
   public:
+    // One-shot index of every file reference (open fds, maps, cwd/root/exe) in /proc, built with
+    // a single sweep so that several mount points can be queried without rescanning. The snapshot
+    // goes stale as soon as a signal dislodges a holder, so use it for the first kill round only.
+    class OpenFilesSnapshot {
+      public:
+        // Signals every snapshotted process holding a reference under |path|. Returns the number
+        // of processes signalled.
+        int killProcessesWithOpenFiles(const char* path, int signal) const;
+
+      private:
+        friend class Process;
+
+        enum class RefKind { kOpenFile, kFileMap, kCwd, kRoot, kExe };
+        struct Ref {
+            std::string path;
+            RefKind kind;
+        };
+        struct Entry {
+            int pid;
+            std::vector<Ref> refs;
+        };
+        std::vector<Entry> mEntries;
+    };
+
+    static OpenFilesSnapshot takeOpenFilesSnapshot();
+
     static int killProcessesWithOpenFiles(const char* path, int signal);
     static int getPid(const char* s);
     static int checkSymLink(int pid, const char* path, const char* name);
@@ -33,6 +62,7 @@ class Process {
   private:
     static int readSymLink(const char* path, char* link, size_t max);
     static int pathMatchesMountPoint(const char* path, const char* mountPoint);
+    static void collectProcessRefs(int pid, std::vector<OpenFilesSnapshot::Ref>* refs);
 };
 
 #endif
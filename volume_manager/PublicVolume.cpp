@@ -29,6 +29,7 @@
 #include <android-base/logging.h>
 #include <android-base/stringprintf.h>
 #include <cutils/fs.h>
+#include <cutils/properties.h>
 #include <private/android_filesystem_config.h>
 
 #include <fcntl.h>
@@ -39,11 +40,44 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 
+#include <map>
+#include <mutex>
+
 using android::base::StringPrintf;
 
 namespace android {
 namespace volmgr {
 
+// Probe results keyed by partition device. Probing costs a blkid pass plus a trial mount, and a
+// disk rescan recreates its volumes from scratch, so without the cache every trip into the
+// storage menu re-pays that for media that hasn't changed. Entries carry the generation current
+// when they were probed; netlink change/remove events bump the generation, which invalidates
+// everything probed before the media could have been swapped.
+struct ProbeCacheEntry {
+    uint64_t generation;
+    std::string fsType;
+    std::string fsUuid;
+    std::string partLabel;
+    bool mountable;
+    bool mountableValid;
+};
+static std::mutex sProbeCacheLock;
+static std::map<dev_t, ProbeCacheEntry> sProbeCache;
+static uint64_t sProbeCacheGeneration = 0;
+
+// Clean tokens: partition devices whose filesystem this recovery session mounted and unmounted
+// cleanly, keyed with the UUID observed at the time. Unlike the probe cache they survive
+// generation bumps: after e.g. a change-event rescan, a matching UUID on the same device means
+// the media wasn't swapped, so the trial mount that detectMountable() would pay again can be
+// skipped. Set |kForceProbeProp| to re-probe regardless.
+static const char* kForceProbeProp = "volmgr.force_probe";
+static std::map<dev_t, std::string> sCleanTokens;
+
+void PublicVolume::InvalidateProbeCache() {
+    std::lock_guard<std::mutex> lock(sProbeCacheLock);
+    sProbeCacheGeneration++;
+}
+
 PublicVolume::PublicVolume(dev_t device, const std::string& nickname,
                            const std::string& fstype /* = "" */,
                            const std::string& mntopts /* = "" */)
@@ -57,6 +91,21 @@ PublicVolume::~PublicVolume() {}
 
 status_t PublicVolume::readMetadata() {
     std::string label;
+    {
+        std::lock_guard<std::mutex> lock(sProbeCacheLock);
+        auto it = sProbeCache.find(mDevice);
+        if (it != sProbeCache.end() && it->second.generation == sProbeCacheGeneration) {
+            mFsType = it->second.fsType;
+            mFsUuid = it->second.fsUuid;
+            if (!it->second.partLabel.empty()) {
+                setPartLabel(it->second.partLabel);
+            }
+            VolumeManager::Instance()->notifyEvent(ResponseCode::VolumeFsTypeChanged, mFsType);
+            VolumeManager::Instance()->notifyEvent(ResponseCode::VolumeFsUuidChanged, mFsUuid);
+            return OK;
+        }
+    }
+
     status_t res = ReadMetadataUntrusted(mDevPath, mFsType, mFsUuid, label);
     if (!label.empty()) {
         setPartLabel(label);
@@ -66,6 +115,10 @@ status_t PublicVolume::readMetadata() {
             mFsUuid = label;
         }
     }
+    if (res == OK) {
+        std::lock_guard<std::mutex> lock(sProbeCacheLock);
+        sProbeCache[mDevice] = { sProbeCacheGeneration, mFsType, mFsUuid, label, false, false };
+    }
     VolumeManager::Instance()->notifyEvent(ResponseCode::VolumeFsTypeChanged, mFsType);
     VolumeManager::Instance()->notifyEvent(ResponseCode::VolumeFsUuidChanged, mFsUuid);
     return res;
@@ -92,6 +145,33 @@ status_t PublicVolume::doDestroy() {
     return DestroyDeviceNode(mDevPath);
 }
 
+bool PublicVolume::detectMountable() {
+    {
+        std::lock_guard<std::mutex> lock(sProbeCacheLock);
+        auto it = sProbeCache.find(mDevice);
+        if (it != sProbeCache.end() && it->second.generation == sProbeCacheGeneration &&
+            it->second.mountableValid) {
+            return it->second.mountable;
+        }
+
+        auto token = sCleanTokens.find(mDevice);
+        if (token != sCleanTokens.end() && !mFsUuid.empty() && token->second == mFsUuid &&
+            !property_get_bool(kForceProbeProp, false)) {
+            return true;
+        }
+    }
+
+    bool mountable = VolumeBase::detectMountable();
+
+    std::lock_guard<std::mutex> lock(sProbeCacheLock);
+    auto it = sProbeCache.find(mDevice);
+    if (it != sProbeCache.end() && it->second.generation == sProbeCacheGeneration) {
+        it->second.mountable = mountable;
+        it->second.mountableValid = true;
+    }
+    return mountable;
+}
+
 status_t PublicVolume::doMount() {
     if (!IsFilesystemSupported(mFsType)) {
         LOG(ERROR) << getId() << " unsupported filesystem " << mFsType;
@@ -123,6 +203,9 @@ status_t PublicVolume::doMount() {
     }
     if (ret) {
         PLOG(ERROR) << getId() << " failed to mount " << mDevPath;
+        // The clean token promised this would mount; don't let it promise again.
+        std::lock_guard<std::mutex> lock(sProbeCacheLock);
+        sCleanTokens.erase(mDevice);
         return -EIO;
     }
 
@@ -130,10 +213,17 @@ status_t PublicVolume::doMount() {
 }
 
 status_t PublicVolume::doUnmount(bool detach /* = false */) {
-    ForceUnmount(getPath(), detach);
+    status_t res = ForceUnmount(getPath(), detach);
 
     rmdir(getPath().c_str());
 
+    if (res == OK && !mFsUuid.empty()) {
+        // The filesystem went away cleanly; remember that, so the next rescan of unswapped
+        // media doesn't pay another trial mount.
+        std::lock_guard<std::mutex> lock(sProbeCacheLock);
+        sCleanTokens[mDevice] = mFsUuid;
+    }
+
     return OK;
 }
 
@@ -44,6 +44,9 @@ class PublicVolume : public VolumeBase {
                  const std::string& fstype = "");
     virtual ~PublicVolume();
 
+    /* Drops all cached probe results; call when media may have changed underneath us */
+    static void InvalidateProbeCache();
+
   protected:
     status_t doCreate() override;
     status_t doDestroy() override;
@@ -52,6 +55,8 @@ class PublicVolume : public VolumeBase {
 
     status_t readMetadata();
 
+    bool detectMountable() override;
+
   private:
     /* Kernel device representing partition */
     dev_t mDevice;
@@ -31,6 +31,7 @@
 #include <dirent.h>
 #include <fcntl.h>
 #include <linux/fs.h>
+#include <spawn.h>
 #include <stdlib.h>
 #include <sys/mount.h>
 #include <sys/stat.h>
@@ -38,6 +39,7 @@
 #include <sys/sysmacros.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <atomic>
 #include <mutex>
 #include <thread>
 
@@ -123,6 +125,14 @@ status_t PrepareDir(const std::string& path, mode_t mode, uid_t uid, gid_t gid)
     }
 }
 
+// Shared /proc open-files snapshot for the duration of an unmountAll() sweep, so concurrent
+// ForceUnmount() calls don't each rescan /proc for their first kill round.
+static std::atomic<const Process::OpenFilesSnapshot*> gUnmountSweepSnapshot{ nullptr };
+
+void SetUnmountSweepSnapshot(const Process::OpenFilesSnapshot* snapshot) {
+    gUnmountSweepSnapshot = snapshot;
+}
+
 status_t ForceUnmount(const std::string& path, bool detach /* = false */) {
     const char* cpath = path.c_str();
     if (detach) {
@@ -138,7 +148,13 @@ status_t ForceUnmount(const std::string& path, bool detach /* = false */) {
     }
     sleep(1);
 
-    Process::killProcessesWithOpenFiles(cpath, SIGINT);
+    // The first round may be served from the sweep-wide snapshot. Later rounds always rescan,
+    // since the snapshot no longer reflects which holders the earlier signal dislodged.
+    if (const Process::OpenFilesSnapshot* snapshot = gUnmountSweepSnapshot.load()) {
+        snapshot->killProcessesWithOpenFiles(cpath, SIGINT);
+    } else {
+        Process::killProcessesWithOpenFiles(cpath, SIGINT);
+    }
     sleep(1);
     if (!umount2(cpath, UMOUNT_NOFOLLOW) || errno == EINVAL || errno == ENOENT) {
         return OK;
@@ -226,12 +242,13 @@ status_t ForkExecvp(const std::vector<std::string>& args) {
     return ForkExecvp(args, nullptr);
 }
 
+extern "C" char** environ;
+
 status_t ForkExecvp(const std::vector<std::string>& args, char* context) {
-    std::vector<std::string> output;
     size_t argc = args.size();
-    char** argv = (char**)calloc(argc + 1, sizeof(char*));
+    std::vector<char*> argv(argc + 1, nullptr);
     for (size_t i = 0; i < argc; i++) {
-        argv[i] = (char*)args[i].c_str();
+        argv[i] = const_cast<char*>(args[i].c_str());
         if (i == 0) {
             LOG(VERBOSE) << args[i];
         } else {
@@ -239,38 +256,45 @@ status_t ForkExecvp(const std::vector<std::string>& args, char* context) {
         }
     }
 
+    // posix_spawn() doesn't have to duplicate our address space the way a plain fork() does, which
+    // matters with recovery's footprint when several volumes appear at once. The exec security
+    // context is a per-thread attribute that the spawned child inherits, so the setexeccon()
+    // bracket works the same as it did around fork().
+    posix_spawn_file_actions_t file_actions;
+    posix_spawn_file_actions_init(&file_actions);
+    posix_spawn_file_actions_addclose(&file_actions, STDIN_FILENO);
+    posix_spawn_file_actions_addclose(&file_actions, STDOUT_FILENO);
+    posix_spawn_file_actions_addclose(&file_actions, STDERR_FILENO);
+
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+#ifdef POSIX_SPAWN_USEVFORK
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_USEVFORK);
+#endif
+
     if (setexeccon(context)) {
         LOG(ERROR) << "Failed to setexeccon";
         abort();
     }
 
-    pid_t pid = fork();
-    int fork_errno = errno;
-    if (pid == 0) {
-        close(STDIN_FILENO);
-        close(STDOUT_FILENO);
-        close(STDERR_FILENO);
-
-        if (execvp(argv[0], argv)) {
-            PLOG(ERROR) << "Failed to exec";
-        }
-
-        _exit(1);
-    }
+    pid_t pid;
+    int res = posix_spawnp(&pid, argv[0], &file_actions, &attr, argv.data(), environ);
 
     if (setexeccon(nullptr)) {
         LOG(ERROR) << "Failed to setexeccon";
         abort();
     }
 
-    if (pid == -1) {
-        PLOG(ERROR) << "Failed to exec";
-        return -fork_errno;
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&file_actions);
+
+    if (res != 0) {
+        LOG(ERROR) << "Failed to spawn " << args[0] << ": " << strerror(res);
+        return -res;
     }
 
     waitpid(pid, nullptr, 0);
 
-    free(argv);
     return OK;
 }
 
@@ -22,6 +22,8 @@
 #include <selinux/selinux.h>
 #include <utils/Errors.h>
 
+#include "Process.h"
+
 #include <chrono>
 #include <string>
 #include <vector>
@@ -54,6 +56,10 @@ status_t PrepareDir(const std::string& path, mode_t mode, uid_t uid, gid_t gid);
 /* Really unmounts the path, killing active processes along the way */
 status_t ForceUnmount(const std::string& path, bool detach = false);
 
+/* Installs (or clears, with nullptr) a shared /proc open-files snapshot that ForceUnmount()'s
+ * first kill round is served from while an unmountAll() sweep is in flight */
+void SetUnmountSweepSnapshot(const Process::OpenFilesSnapshot* snapshot);
+
 /* Kills any processes using given path */
 status_t KillProcessesUsingPath(const std::string& path);
 
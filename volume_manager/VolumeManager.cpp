@@ -25,6 +25,9 @@
 
 #define LOG_TAG "VolumeManager"
 
+#include <future>
+#include <thread>
+
 #include <android-base/logging.h>
 #include <cutils/properties.h>
 
@@ -35,8 +38,11 @@
 #include "Disk.h"
 #include "DiskPartition.h"
 #include "EmulatedVolume.h"
+#include "PublicVolume.h"
 #include "VolumeBase.h"
 #include "NetlinkManager.h"
+#include "Process.h"
+#include "Utils.h"
 
 #include "sehandle.h"
 
@@ -151,7 +157,11 @@ VolumeManager* VolumeManager::Instance(void) {
 }
 
 VolumeManager::VolumeManager(void)
-    : mWatcher(nullptr), mNetlinkManager(NetlinkManager::Instance()), mInternalEmulated(nullptr) {
+    : mWatcher(nullptr),
+      mNetlinkManager(NetlinkManager::Instance()),
+      mInternalEmulated(nullptr),
+      mPendingScans(0),
+      mChangeWorkerRunning(false) {
     // Empty
 }
 
@@ -194,7 +204,19 @@ bool VolumeManager::start(VolumeWatcher* watcher) {
     return true;
 }
 
+void VolumeManager::waitForPendingScans(void) {
+    {
+        std::unique_lock<std::mutex> lock(mScanLock);
+        mScanCv.wait(lock, [this] { return mPendingScans == 0; });
+    }
+    // Also let coalesced change rescans settle; the worker clears the flag once the last
+    // quiescence window has expired and its scan round is done.
+    std::unique_lock<std::mutex> lock(mChangeLock);
+    mChangeCv.wait(lock, [this] { return !mChangeWorkerRunning; });
+}
+
 void VolumeManager::stop(void) {
+    waitForPendingScans();
     for (auto& disk : mDisks) {
         disk->destroy();
         delete disk;
@@ -213,21 +235,85 @@ bool VolumeManager::reset(void) {
     return false;
 }
 
+// Whether |child| mounts somewhere strictly below |parent|, in which case it must be ejected
+// before |parent| can unmount.
+static bool pathNestsUnder(const std::string& child, const std::string& parent) {
+    return child.size() > parent.size() && child.compare(0, parent.size(), parent) == 0 &&
+           child[parent.size()] == '/';
+}
+
 bool VolumeManager::unmountAll(void) {
+    waitForPendingScans();
     std::lock_guard<std::mutex> lock(mLock);
 
+    std::vector<VolumeBase*> volumes;
     if (mInternalEmulated) {
-        mInternalEmulated->unmount();
+        volumes.push_back(mInternalEmulated);
     }
-
     for (auto& disk : mDisks) {
-        disk->unmountAll();
+        for (const auto& vol : disk->getVolumes()) {
+            volumes.push_back(vol.get());
+        }
+    }
+    if (volumes.empty()) {
+        return true;
     }
 
+    // One /proc open-files scan serves the first kill round of every busy volume in the sweep;
+    // a volume that stays busy after SIGINT rescans on its own (see ForceUnmount()).
+    Process::OpenFilesSnapshot snapshot = Process::takeOpenFilesSnapshot();
+    SetUnmountSweepSnapshot(&snapshot);
+
+    // Unmount in passes: each pass ejects, concurrently, every volume that has no other volume
+    // still mounted beneath its path. Independent volumes (sdcard vs. OTG, say) thus overlap
+    // their open-files scans, signal-escalation sleeps and kernel-side writeback, while nested
+    // mounts keep the child-before-parent order the serial walk gave us.
+    std::vector<bool> done(volumes.size(), false);
+    size_t remaining = volumes.size();
+    while (remaining > 0) {
+        std::vector<size_t> ready;
+        for (size_t i = 0; i < volumes.size(); ++i) {
+            if (done[i]) continue;
+            bool has_pending_child = false;
+            for (size_t j = 0; j < volumes.size(); ++j) {
+                if (j == i || done[j]) continue;
+                if (pathNestsUnder(volumes[j]->getPath(), volumes[i]->getPath())) {
+                    has_pending_child = true;
+                    break;
+                }
+            }
+            if (!has_pending_child) {
+                ready.push_back(i);
+            }
+        }
+        if (ready.empty()) {
+            // Mount paths can't nest cyclically, but never risk spinning here.
+            for (size_t i = 0; i < volumes.size(); ++i) {
+                if (!done[i]) ready.push_back(i);
+            }
+        }
+
+        std::vector<std::future<void>> tasks;
+        for (size_t idx : ready) {
+            tasks.emplace_back(
+                std::async(std::launch::async, [vol = volumes[idx]]() { vol->unmount(); }));
+        }
+        for (auto& task : tasks) {
+            task.wait();
+        }
+
+        for (size_t idx : ready) {
+            done[idx] = true;
+        }
+        remaining -= ready.size();
+    }
+
+    SetUnmountSweepSnapshot(nullptr);
     return true;
 }
 
 void VolumeManager::getVolumeInfo(std::vector<VolumeInfo>& info) {
+    waitForPendingScans();
     std::lock_guard<std::mutex> lock(mLock);
 
     info.clear();
@@ -253,6 +339,7 @@ VolumeBase* VolumeManager::findVolume(const std::string& id) {
 }
 
 bool VolumeManager::volumeMount(const std::string& id) {
+    waitForPendingScans();
     std::lock_guard<std::mutex> lock(mLock);
     auto vol = findVolume(id);
     if (!vol) {
@@ -263,6 +350,7 @@ bool VolumeManager::volumeMount(const std::string& id) {
 }
 
 bool VolumeManager::volumeUnmount(const std::string& id, bool detach /* = false */) {
+    waitForPendingScans();
     std::lock_guard<std::mutex> lock(mLock);
     auto vol = findVolume(id);
     if (!vol) {
@@ -279,8 +367,6 @@ void VolumeManager::addDiskSource(DiskSource* source) {
 }
 
 void VolumeManager::handleBlockEvent(NetlinkEvent* evt) {
-    std::lock_guard<std::mutex> lock(mLock);
-
     const char* param;
     param = evt->findParam("DEVTYPE");
     std::string devType(param ? param : "");
@@ -294,6 +380,14 @@ void VolumeManager::handleBlockEvent(NetlinkEvent* evt) {
     int minor = atoi(evt->findParam("MINOR"));
     dev_t device = makedev(major, minor);
 
+    // A removal must not race a scan still in flight for the disk. Change events no longer
+    // rescan inline (see below), so they don't need to wait and keep draining during a burst.
+    if (evt->getAction() == NetlinkEvent::Action::kRemove) {
+        waitForPendingScans();
+    }
+
+    std::lock_guard<std::mutex> lock(mLock);
+
     switch (evt->getAction()) {
         case NetlinkEvent::Action::kAdd: {
             for (const auto& source : mDiskSources) {
@@ -317,8 +411,20 @@ void VolumeManager::handleBlockEvent(NetlinkEvent* evt) {
                                      : new DiskPartition(eventPath, device, source->getNickname(),
                                                          flags, source->getPartNum(),
                                                          source->getFsType(), source->getMntOpts());
-                    disk->create();
                     mDisks.push_back(disk);
+                    // Probing the partition table takes hundreds of milliseconds per disk, so
+                    // run it on a worker thread; disks that appear together during coldboot
+                    // then scan concurrently instead of back to back on the netlink thread.
+                    {
+                        std::lock_guard<std::mutex> scan_lock(mScanLock);
+                        ++mPendingScans;
+                    }
+                    std::thread([this, disk]() {
+                        disk->create();
+                        std::lock_guard<std::mutex> scan_lock(mScanLock);
+                        --mPendingScans;
+                        mScanCv.notify_all();
+                    }).detach();
                     break;
                 }
             }
@@ -326,15 +432,23 @@ void VolumeManager::handleBlockEvent(NetlinkEvent* evt) {
         }
         case NetlinkEvent::Action::kChange: {
             LOG(DEBUG) << "Disk at " << major << ":" << minor << " changed";
-            for (const auto& disk : mDisks) {
-                if (disk->getDevice() == device) {
-                    disk->readMetadata();
-                    disk->readPartitions();
-                }
-            }
+            // The media may have been swapped; probe results recorded so far can't be trusted.
+            PublicVolume::InvalidateProbeCache();
+            // Don't rescan inline: hotplug bursts deliver many change events per disk back to
+            // back, and each rescan costs hundreds of milliseconds. Let the burst go quiet
+            // first and scan each device once.
+            scheduleDiskChange(device);
             break;
         }
         case NetlinkEvent::Action::kRemove: {
+            // Whatever replaces this disk may reuse its device numbers.
+            PublicVolume::InvalidateProbeCache();
+            {
+                // The disk is going away; a rescan still waiting out its quiescence window
+                // would only find a stale device node.
+                std::lock_guard<std::mutex> change_lock(mChangeLock);
+                mPendingChanges.erase(device);
+            }
             auto i = mDisks.begin();
             while (i != mDisks.end()) {
                 if ((*i)->getDevice() == device) {
@@ -353,6 +467,77 @@ void VolumeManager::handleBlockEvent(NetlinkEvent* evt) {
     }
 }
 
+// How long a disk has to stay quiet after its last change event before we rescan it. Long enough
+// to swallow the event train a media swap or hub insertion produces, short enough to be
+// imperceptible next to the scan itself.
+static constexpr auto kChangeQuiescence = std::chrono::milliseconds(100);
+
+void VolumeManager::scheduleDiskChange(dev_t device) {
+    std::lock_guard<std::mutex> lock(mChangeLock);
+    // Every repeat event pushes the deadline out; the device is only scanned once it goes quiet.
+    mPendingChanges[device] = std::chrono::steady_clock::now() + kChangeQuiescence;
+    mChangeCv.notify_all();
+
+    if (mChangeWorkerRunning) {
+        return;
+    }
+    mChangeWorkerRunning = true;
+    std::thread(&VolumeManager::diskChangeWorker, this).detach();
+}
+
+void VolumeManager::diskChangeWorker(void) {
+    std::unique_lock<std::mutex> lock(mChangeLock);
+    while (!mPendingChanges.empty()) {
+        auto now = std::chrono::steady_clock::now();
+        auto next_deadline = std::chrono::steady_clock::time_point::max();
+        std::vector<dev_t> ready;
+        for (const auto& [device, deadline] : mPendingChanges) {
+            if (deadline <= now) {
+                ready.push_back(device);
+            } else {
+                next_deadline = std::min(next_deadline, deadline);
+            }
+        }
+        if (ready.empty()) {
+            mChangeCv.wait_until(lock, next_deadline);
+            continue;
+        }
+        for (dev_t device : ready) {
+            mPendingChanges.erase(device);
+        }
+
+        // Rescan outside |mChangeLock| so fresh events keep coalescing, but under |mLock| so a
+        // removal can't destroy a disk mid-scan. Distinct disks scan in parallel.
+        lock.unlock();
+        {
+            // Let any initial create() scans finish first; rescanning a disk that is still
+            // probing its partition table would trample its volume list.
+            std::unique_lock<std::mutex> scan_lock(mScanLock);
+            mScanCv.wait(scan_lock, [this] { return mPendingScans == 0; });
+        }
+        {
+            std::lock_guard<std::mutex> vol_lock(mLock);
+            std::vector<std::future<void>> tasks;
+            for (dev_t device : ready) {
+                for (const auto& disk : mDisks) {
+                    if (disk->getDevice() == device) {
+                        tasks.emplace_back(std::async(std::launch::async, [disk]() {
+                            disk->readMetadata();
+                            disk->readPartitions();
+                        }));
+                    }
+                }
+            }
+            for (auto& task : tasks) {
+                task.wait();
+            }
+        }
+        lock.lock();
+    }
+    mChangeWorkerRunning = false;
+    mChangeCv.notify_all();
+}
+
 void VolumeManager::notifyEvent(int code) {
     std::vector<std::string> argv;
     notifyEvent(code, argv);
@@ -365,6 +550,10 @@ void VolumeManager::notifyEvent(int code, const std::string& arg) {
 }
 
 void VolumeManager::notifyEvent(int code, const std::vector<std::string>& argv) {
+    // Volume state changes can arrive from several unmountAll() workers at once; the watcher
+    // only expects one event at a time.
+    static std::mutex watcher_mutex;
+    std::lock_guard<std::mutex> lock(watcher_mutex);
     mWatcher->handleEvent(code, argv);
 }
 
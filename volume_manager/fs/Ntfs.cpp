@@ -41,6 +41,23 @@ status_t Mount(const std::string& source, const std::string& target, bool ro, bo
     const char* c_source = source.c_str();
     const char* c_target = target.c_str();
 
+    // Prefer an in-kernel driver when the kernel ships one: it needs no fork of the FUSE helper
+    // and no userspace round trip per request afterwards. A kernel without the driver fails the
+    // attempt immediately with ENODEV, so trying costs nothing. The legacy ntfs driver is
+    // read-only, so it's only good enough when a read-only mount was asked for.
+    unsigned long kernelFlags = MS_NODEV | MS_NOSUID | MS_DIRSYNC | MS_NOATIME;
+    if (!executable) kernelFlags |= MS_NOEXEC;
+    if (ro) kernelFlags |= MS_RDONLY;
+    if (remount) kernelFlags |= MS_REMOUNT;
+    auto kernelData = StringPrintf("uid=%d,gid=%d,fmask=%o,dmask=%o", ownerUid, ownerGid, permMask,
+                                   permMask);
+    if (mount(c_source, c_target, "ntfs3", kernelFlags, kernelData.c_str()) == 0) {
+        return OK;
+    }
+    if (ro && mount(c_source, c_target, "ntfs", kernelFlags, kernelData.c_str()) == 0) {
+        return OK;
+    }
+
     sprintf(mountData,
             "utf8,uid=%d,gid=%d,fmask=%o,dmask=%o,"
             "shortname=mixed,nodev,nosuid,dirsync",
@@ -22,7 +22,10 @@
 #include <pthread.h>
 #include <stdlib.h>
 
+#include <chrono>
+#include <condition_variable>
 #include <list>
+#include <map>
 #include <mutex>
 #include <string>
 
@@ -121,12 +124,36 @@ class VolumeManager {
     void notifyEvent(int code, const std::vector<std::string>& argv);
 
   private:
+    // Blocks until no disk scan is running on a worker thread. Must be called before taking
+    // |mLock| by any path that reads or destroys disk/volume state.
+    void waitForPendingScans(void);
+
+    // Queues a rescan of the disk at |device| after a short quiescence window, collapsing uevent
+    // bursts (hubs with several card readers fire dozens of change events back to back) into a
+    // single scan round per device.
+    void scheduleDiskChange(dev_t device);
+    void diskChangeWorker(void);
+
     VolumeWatcher* mWatcher;
     NetlinkManager* mNetlinkManager;
     std::mutex mLock;
     VolumeBase* mInternalEmulated;
     std::list<DiskSource*> mDiskSources;
     std::list<Disk*> mDisks;
+
+    // Newly added disks are scanned on worker threads, so several disks (sdcard, USB-OTG)
+    // probe their partition tables concurrently instead of back to back on the netlink thread.
+    std::mutex mScanLock;
+    std::condition_variable mScanCv;
+    size_t mPendingScans;
+
+    // Pending change-event rescans: device -> deadline at which its quiescence window expires.
+    // Never acquire |mChangeLock| while waiting for |mLock|; the worker drops it before taking
+    // |mLock| for the scan round.
+    std::mutex mChangeLock;
+    std::condition_variable mChangeCv;
+    std::map<dev_t, std::chrono::steady_clock::time_point> mPendingChanges;
+    bool mChangeWorkerRunning;
 };
 
 }  // namespace volmgr